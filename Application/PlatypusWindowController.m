@@ -825,6 +825,9 @@
         [statusItemSettingsButton setEnabled:NO];
         [statusItemSettingsButton setHidden:YES];
     }
+    
+    // Apps get the ScriptExec variant for their interface type
+    [self updateEstimatedAppSize];
 }
 
 // Clear all controls to their default value
@@ -869,7 +872,9 @@
     estimatedAppSize += [WORKSPACE fileOrFolderSize:[iconController icnsFilePath]];
     estimatedAppSize += [WORKSPACE fileOrFolderSize:[dropSettingsController docIconPath]];
     estimatedAppSize += [WORKSPACE fileOrFolderSize:[scriptPathTextField stringValue]];
-    estimatedAppSize += ([WORKSPACE fileOrFolderSize:[[NSBundle mainBundle] pathForResource:CMDLINE_SCRIPTEXEC_GZIP_NAME ofType:nil]] * 3.8);
+    NSString *execPath = [[NSBundle mainBundle] pathForResource:CMDLINE_SCRIPTEXEC_GZIP_NAME ofType:nil];
+    execPath = [PlatypusAppSpec executablePath:execPath forInterfaceType:[interfaceTypePopupButton titleOfSelectedItem]];
+    estimatedAppSize += [self uncompressedSizeOfGzipFile:execPath];
     
     // Nib size is much smaller if compiled with ibtool
     UInt64 nibSize = [WORKSPACE fileOrFolderSize:[[NSBundle mainBundle] pathForResource:@"MainMenu.nib" ofType:nil]];
@@ -884,6 +889,24 @@
     return [WORKSPACE fileSizeAsHumanReadableString:estimatedAppSize];
 }
 
+// Gzip files end with the size of the uncompressed data, modulo 2^32
+- (UInt64)uncompressedSizeOfGzipFile:(NSString *)path {
+    NSFileHandle *fileHandle = [NSFileHandle fileHandleForReadingAtPath:path];
+    unsigned long long length = [fileHandle seekToEndOfFile];
+    if (fileHandle == nil || length < 18) {
+        [fileHandle closeFile];
+        return [WORKSPACE fileOrFolderSize:path] * 3.8; // Typical compression ratio
+    }
+    [fileHandle seekToFileOffset:length - 4];
+    NSData *trailer = [fileHandle readDataOfLength:4];
+    [fileHandle closeFile];
+    if ([trailer length] != 4) {
+        return [WORKSPACE fileOrFolderSize:path] * 3.8;
+    }
+    const uint8_t *b = [trailer bytes];
+    return (UInt64)b[0] | ((UInt64)b[1] << 8) | ((UInt64)b[2] << 16) | ((UInt64)b[3] << 24);
+}
+
 #pragma mark -
 
 // Create an NSTask from settings
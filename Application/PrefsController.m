@@ -409,7 +409,9 @@
             @"CMDLINE_MANDIR_PATH": CMDLINE_MANDIR_PATH,
             @"CMDLINE_MANPAGE_PATH": CMDLINE_MANPAGE_PATH,
             @"CMDLINE_NIB_PATH": CMDLINE_NIB_PATH,
-            @"CMDLINE_SCRIPT_EXEC_PATH": CMDLINE_SCRIPT_EXEC_PATH};
+            @"CMDLINE_SCRIPT_EXEC_PATH": CMDLINE_SCRIPT_EXEC_PATH,
+            @"CMDLINE_SUBMIT_TOOL_NAME": CMDLINE_SUBMIT_TOOL_NAME,
+            @"CMDLINE_SUBMIT_TOOL_PATH": CMDLINE_SUBMIT_TOOL_PATH};
 }
 
 #pragma mark - Utils
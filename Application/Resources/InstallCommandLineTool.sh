@@ -23,6 +23,11 @@ cd "$1"
 echo "Copying resources to share directory"
 # ScriptExec binary
 gunzip -c "%%CMDLINE_SCRIPTEXEC_GZIP_NAME%%" > "%%CMDLINE_SCRIPT_EXEC_PATH%%"
+# ScriptExec variants for a single interface type, if built
+for VARIANT in "%%CMDLINE_SCRIPTEXEC_BIN_NAME%%"-*.gz; do
+    [ -f "${VARIANT}" ] || continue
+    gunzip -c "${VARIANT}" > "%%CMDLINE_SHARE_PATH%%/$(basename "${VARIANT}" .gz)"
+done
 # Nib
 cp -r "%%CMDLINE_NIB_NAME%%" "%%CMDLINE_SHARE_PATH%%"
 # Set permissions
@@ -35,6 +40,12 @@ gunzip -c "%%CMDLINE_PROGNAME_BUNDLE%%" > "%%CMDLINE_TOOL_PATH%%"
 chown ${REAL_USER_ID} "%%CMDLINE_TOOL_PATH%%"
 chmod +x "%%CMDLINE_TOOL_PATH%%"
 
+# Job submission tool
+echo "Installing job submission tool"
+cp "%%CMDLINE_SUBMIT_TOOL_NAME%%" "%%CMDLINE_SUBMIT_TOOL_PATH%%"
+chown ${REAL_USER_ID} "%%CMDLINE_SUBMIT_TOOL_PATH%%"
+chmod 755 "%%CMDLINE_SUBMIT_TOOL_PATH%%"
+
 # Man page
 echo "Installing man page"
 rm "%%CMDLINE_MANPAGE_PATH%%" &> /dev/null
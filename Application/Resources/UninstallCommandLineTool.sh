@@ -18,6 +18,11 @@ if [ -e "%%CMDLINE_TOOL_PATH%%" ]; then
     rm "%%CMDLINE_TOOL_PATH%%" &> /dev/null
 fi
 
+if [ -e "%%CMDLINE_SUBMIT_TOOL_PATH%%" ]; then
+    echo "Deleting %%CMDLINE_SUBMIT_TOOL_NAME%% in %%CMDLINE_SUBMIT_TOOL_PATH%%"
+    rm "%%CMDLINE_SUBMIT_TOOL_PATH%%" &> /dev/null
+fi
+
 if [ -e "%%CMDLINE_MANPAGE_PATH%%" ]; then
     echo "Deleting %%CMDLINE_PROGNAME%% man page"
     rm "%%CMDLINE_MANPAGE_PATH%%" &> /dev/null
@@ -29,7 +29,7 @@
 */
 
 #import "SyntaxCheckerController.h"
-#import "PlatypusScriptUtils.h"
+#import "PlatypusSyntaxChecker.h"
 
 @interface SyntaxCheckerController()
 {
@@ -56,9 +56,13 @@
     
     [scriptNameTextField setStringValue:scriptName];
     
-    NSString *reportText = [PlatypusScriptUtils checkSyntaxOfFile:filePath
-                                              usingInterpreterAtPath:interpreterPath];
-    [textView setString:reportText];
+    // Check runs in the background, report is filled in when done
+    [textView setString:@"Checking syntax..."];
+    [[PlatypusSyntaxChecker sharedChecker] checkFiles:@[filePath]
+                               usingInterpreterAtPath:interpreterPath
+                                    completionHandler:^(NSArray<PlatypusSyntaxCheckResult *> *results) {
+        [self->textView setString:[[results firstObject] report]];
+    }];
     
     [NSApp beginSheet:[self window]
        modalForWindow:parentWindow
@@ -43,21 +43,26 @@
 
 #import "Common.h"
 #import "PlatypusAppSpec.h"
+#import "PlatypusSyntaxChecker.h"
+#import "PlatypusJobLimits.h"
+#import "PlatypusMachO.h"
 #import "NSFileManager+TempFiles.h"
 
 static NSString *ReadStandardInputToFile(void);
 static NSString *MakeAbsolutePath(NSString *path);
 static NSArray *FindDuplicateFileNames(NSArray *paths);
+static int CheckSyntax(NSArray <NSString *> *scriptPaths, NSArray <NSString *> *bundledFiles, NSString *interpreterPath);
 static void PrintVersion(void);
 static void PrintHelp(void);
 static void NSPrintErr(NSString *format, ...);
 static void NSPrint(NSString *format, ...);
 
-static const char optstring[] = "P:f:a:o:i:u:p:V:I:Q:AOZDBWRFNydlvhxX:T:G:C:b:g:n:K:Y:L:cqU:";
+static const char optstring[] = "P:f:a:o:i:u:p:V:I:Q:AOZDBWRFNEjJkydlvhxX:T:G:C:b:g:n:K:Y:L:cqU:wrMSHe:t:z";
 
 static struct option long_options[] = {
 
     {"generate-profile",          no_argument,        0, 'O'},
+    {"check-syntax",              no_argument,        0, 'k'},
 
     {"load-profile",              required_argument,  0, 'P'},
     {"name",                      required_argument,  0, 'a'},
@@ -79,6 +84,14 @@ static struct option long_options[] = {
     {"background",                no_argument,        0, 'B'},
     {"notifications",             no_argument,        0, 'W'},
     {"quit-after-execution",      no_argument,        0, 'R'},
+    {"exec-interpreter",          no_argument,        0, 'E'},
+    {"control-channel-only",      no_argument,        0, 'j'},
+    {"large-output-view",         no_argument,        0, 'J'},
+    {"log-output",                no_argument,        0, 'w'},
+    {"persistent-queue",          no_argument,        0, 'r'},
+    {"job-server",                no_argument,        0, 'M'},
+    {"privileged-helper",         no_argument,        0, 'S'},
+    {"prespawn-interpreter",      no_argument,        0, 'H'},
 
     {"text-background-color",     required_argument,  0, 'b'},
     {"text-foreground-color",     required_argument,  0, 'g'},
@@ -88,6 +101,7 @@ static struct option long_options[] = {
     {"uri-schemes",               required_argument,  0, 'U'},
     {"interpreter-args",          required_argument,  0, 'G'},
     {"script-args",               required_argument,  0, 'C'},
+    {"job-limits",                required_argument,  0, 'e'},
 
     {"status-item-kind",          required_argument,  0, 'K'},
     {"status-item-title",         required_argument,  0, 'Y'},
@@ -103,6 +117,8 @@ static struct option long_options[] = {
     {"symlink",                   no_argument,        0, 'd'},
     {"development-version",       no_argument,        0, 'd'}, // Backwards compatibility!
     {"optimize-nib",              no_argument,        0, 'l'},
+    {"architectures",             required_argument,  0, 't'},
+    {"precompile-bytecode",       no_argument,        0, 'z'},
     {"help",                      no_argument,        0, 'h'},
     {"version",                   no_argument,        0, 'v'},
     
@@ -115,6 +131,7 @@ int main(int argc, const char *argv[]) {
     NSMutableDictionary *properties = [NSMutableDictionary dictionary];
     
     BOOL createProfile = FALSE;
+    BOOL checkSyntax = FALSE;
     BOOL loadedProfile = FALSE;
     BOOL deleteScript = FALSE;
     
@@ -130,6 +147,13 @@ int main(int argc, const char *argv[]) {
             }
                 break;
             
+            // Check syntax of scripts instead of creating an app
+            case 'k':
+            {
+                checkSyntax = TRUE;
+            }
+                break;
+            
             // Load profile
             case 'P':
             {
@@ -365,6 +389,46 @@ int main(int argc, const char *argv[]) {
                 properties[AppSpecKey_RemainRunning] = @NO;
                 break;
             
+            // Replace app process with interpreter
+            case 'E':
+                properties[AppSpecKey_ExecInterpreter] = @YES;
+                break;
+            
+            // Only accept commands via control channel, pass all output through
+            case 'j':
+                properties[AppSpecKey_ControlChannelOnly] = @YES;
+                break;
+            
+            // Text Window draws only visible lines of output
+            case 'J':
+                properties[AppSpecKey_LargeOutputView] = @YES;
+                break;
+            
+            // Script output is appended to a rotating log file
+            case 'w':
+                properties[AppSpecKey_LogOutput] = @YES;
+                break;
+            
+            // Queued jobs are journaled and resumed on next launch
+            case 'r':
+                properties[AppSpecKey_PersistentJobQueue] = @YES;
+                break;
+            
+            // Jobs can be submitted via a Unix domain socket
+            case 'M':
+                properties[AppSpecKey_JobServer] = @YES;
+                break;
+            
+            // Privileged jobs are run by a helper launched once
+            case 'S':
+                properties[AppSpecKey_PrivilegedHelper] = @YES;
+                break;
+            
+            // Interpreters for queued jobs are started ahead of time
+            case 'H':
+                properties[AppSpecKey_PrespawnInterpreter] = @YES;
+                break;
+            
             // Write plists in XML format (DEPRECATED)
             case 'x':
                 break;
@@ -417,6 +481,18 @@ int main(int argc, const char *argv[]) {
             }
                 break;
             
+            // Timeout and resource limits for each job
+            case 'e':
+            {
+                PlatypusJobLimits limits;
+                if (PlatypusJobLimitsParse(optarg, &limits) != 0) {
+                    NSPrintErr(@"Error: Invalid job limits '%s'. Should be e.g. 'timeout=600,cpu=300,memory=2048,files=256'.", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                properties[AppSpecKey_JobLimits] = @(optarg);
+            }
+                break;
+            
             // Overwrite mode
             case 'y':
                 properties[AppSpecKey_Overwrite] = @YES;
@@ -432,6 +508,25 @@ int main(int argc, const char *argv[]) {
                 properties[AppSpecKey_StripNib] = @YES;
                 break;
             
+            // Architectures to thin executable to
+            case 't':
+            {
+                NSArray *archs = [@(optarg) componentsSeparatedByString:CMDLINE_ARG_SEPARATOR];
+                for (NSString *arch in archs) {
+                    if (!PlatypusMachOArchitectureIsKnown([arch UTF8String])) {
+                        NSPrintErr(@"Error: Unknown architecture '%@'. Should be e.g. 'arm64' or 'x86_64'.", arch);
+                        exit(EXIT_FAILURE);
+                    }
+                }
+                properties[AppSpecKey_Architectures] = archs;
+            }
+                break;
+            
+            // Compile bundled sources to bytecode
+            case 'z':
+                properties[AppSpecKey_PrecompileBytecode] = @YES;
+                break;
+            
             // Set display kind for Status Menu interface
             case 'K':
             {
@@ -505,6 +600,24 @@ int main(int argc, const char *argv[]) {
         }
     }
     
+    // Syntax check mode checks all scripts passed as arguments, plus
+    // script and bundled files of a loaded profile or passed with -f
+    if (checkSyntax) {
+        NSMutableArray *scriptPaths = [NSMutableArray array];
+        if (loadedProfile && [properties[AppSpecKey_ScriptPath] length]) {
+            [scriptPaths addObject:properties[AppSpecKey_ScriptPath]];
+        }
+        while (optind < argc) {
+            [scriptPaths addObject:MakeAbsolutePath(@(argv[optind]))];
+            optind += 1;
+        }
+        if ([scriptPaths count] == 0 && [properties[AppSpecKey_BundledFiles] count] == 0) {
+            NSPrintErr(@"Error: No files to check.");
+            exit(EXIT_FAILURE);
+        }
+        exit(CheckSyntax(scriptPaths, properties[AppSpecKey_BundledFiles], properties[AppSpecKey_InterpreterPath]));
+    }
+    
     // We always need one more argument, either script file path or app name
     if (argc - optind < 1) {
         NSPrintErr(@"Error: Missing argument.");
@@ -681,6 +794,44 @@ static NSArray *FindDuplicateFileNames(NSArray *paths) {
     return [duplicateFileNames copy];
 }
 
+// Check syntax of files in parallel and print results as JSON. Scripts are checked
+// with the given interpreter, if any, while bundled files are checked with the
+// interpreter determined from their shebang line or suffix.
+static int CheckSyntax(NSArray <NSString *> *scriptPaths, NSArray <NSString *> *bundledFiles, NSString *interpreterPath) {
+    PlatypusSyntaxChecker *checker = [PlatypusSyntaxChecker sharedChecker];
+    NSMutableArray *results = [NSMutableArray array];
+    [results addObjectsFromArray:[checker resultsOfCheckingFiles:scriptPaths usingInterpreterAtPath:interpreterPath]];
+    if ([bundledFiles count]) {
+        [results addObjectsFromArray:[checker resultsOfCheckingFiles:bundledFiles usingInterpreterAtPath:nil]];
+    }
+    
+    BOOL failed = NO;
+    NSMutableArray *output = [NSMutableArray array];
+    for (PlatypusSyntaxCheckResult *result in results) {
+        [output addObject:[result dictionaryRepresentation]];
+        // Bundled files need not be scripts at all
+        BOOL isBundledFile = [bundledFiles containsObject:[result path]];
+        switch ([result status]) {
+            case PlatypusSyntaxCheckStatus_Error:
+            case PlatypusSyntaxCheckStatus_Missing:
+                failed = YES;
+                break;
+            case PlatypusSyntaxCheckStatus_NoInterpreter:
+                failed = failed || !isBundledFile;
+                break;
+            default:
+                break;
+        }
+    }
+    
+    NSData *json = [NSJSONSerialization dataWithJSONObject:output
+                                                   options:NSJSONWritingPrettyPrinted | NSJSONWritingSortedKeys
+                                                     error:nil];
+    NSPrint(@"%@", [[NSString alloc] initWithData:json encoding:NSUTF8StringEncoding]);
+    
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
 #pragma mark -
 
 static void PrintVersion(void) {
@@ -696,6 +847,7 @@ platypus [OPTIONS] scriptPath [destinationPath]\n\
 Options:\n\
 \n\
     -O --generate-profile              Generate a profile instead of an app\n\
+    -k --check-syntax                  Check syntax of scripts and bundled files, print JSON report\n\
 \n\
     -P --load-profile [profilePath]    Load settings from profile document\n\
     -a --name [name]                   Set name of application bundle\n\
@@ -715,6 +867,14 @@ Options:\n\
     -N --service                       App registers as a Mac OS X Service\n\
     -B --background                    App runs in background (LSUIElement)\n\
     -R --quit-after-execution          App quits after executing script\n\
+    -E --exec-interpreter              App process is replaced by script interpreter (None interface only)\n\
+    -j --control-channel-only          App only accepts commands via control channel, not script output\n\
+    -J --large-output-view             Text Window output view handles very large output (no text styling)\n\
+    -w --log-output                    App appends script output to a log file in ~/Library/Logs\n\
+    -r --persistent-queue              App resumes queued jobs after quitting or crashing\n\
+    -M --job-server                    App accepts jobs from platypus_submit via a Unix domain socket\n\
+    -S --privileged-helper             App runs privileged jobs through a helper process launched once\n\
+    -H --prespawn-interpreter          App starts the next queued job's interpreter while a job runs\n\
 \n\
     -b --text-background-color [color] Set background color of text view (e.g. '#ffffff')\n\
     -g --text-foreground-color [color] Set foreground color of text view (e.g. '#000000')\n\
@@ -724,6 +884,7 @@ Options:\n\
     -U --uri-schemes                   Set URI schemes handled by app, separated by |\n\
     -G --interpreter-args [arguments]  Set arguments for script interpreter, separated by |\n\
     -C --script-args [arguments]       Set arguments for script, separated by |\n\
+    -e --job-limits [limits]           Set timeout and resource limits for each job, e.g. 'timeout=600,cpu=300'\n\
 \n\
     -K --status-item-kind [kind]       Set Status Item kind ('Icon' or 'Text')\n\
     -Y --status-item-title [title]     Set title of Status Item\n\
@@ -736,6 +897,8 @@ Options:\n\
     -y --overwrite                     Overwrite any file/folder at destination path\n\
     -d --symlink                       Symlink to script and bundled files instead of copying\n\
     -l --optimize-nib                  Strip and compile bundled nib file to reduce size\n\
+    -t --architectures [archs]         Only keep executable code for architectures, separated by |\n\
+    -z --precompile-bytecode           Compile bundled sources to bytecode loaded by the interpreter\n\
     -h --help                          Prints help\n\
     -v --version                       Prints program name and version\n\
 \n\
@@ -0,0 +1,452 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// platypus_submit: submits jobs to a running Platypus app created with
+// the --job-server option, e.g.
+//
+//     platypus_submit -b org.myorg.MyApp ~/Desktop/file.txt
+//     find ~/Pictures -name '*.jpg' | platypus_submit -b org.myorg.MyApp -f -
+//
+// In list mode, each line is submitted as a job with that line as its only
+// argument. Submissions are pipelined over a single connection, without
+// waiting for replies, so large batches are limited only by how fast the
+// app can queue them. Plain C, so that it starts quickly.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "PlatypusJobProtocol.h"
+#include "PlatypusJobLimits.h"
+
+#define PROGNAME            "platypus_submit"
+// Stop generating submissions from a list while this much is unsent
+#define MAX_UNSENT_BYTES    (256 * 1024)
+
+typedef struct Options {
+    const char *socketPath;
+    int32_t priority;
+    const char **metadata;
+    int metadataCount;
+    const char *limits;
+    int streamOutput;
+    int wait;
+    char *input;
+    size_t inputLength;
+} Options;
+
+typedef struct Progress {
+    uint32_t submitted;
+    uint32_t replied;
+    uint32_t accepted;
+    uint32_t finished;
+    uint32_t failed;
+    int lastStatus;
+} Progress;
+
+static void PrintHelp(void) {
+    fprintf(stderr, "\
+usage: %s (-s socketPath | -b bundleIdentifier) [options] [arg ...]\n\
+       %s (-s socketPath | -b bundleIdentifier) [options] -f listFile\n\
+\n\
+Options:\n\
+\n\
+    -s [path]       Path to the app's job server socket\n\
+    -b [identifier] Bundle identifier of the app, to find its socket\n\
+    -f [file]       Submit a job for each line in file (- for stdin)\n\
+    -i              Pass standard input to the script\n\
+    -p [priority]   Queue jobs with low, normal or high priority\n\
+    -m [KEY=value]  Set PLATYPUS_JOB_KEY in the script's environment\n\
+    -l [limits]     Limit jobs, e.g. timeout=60,cpu=30,memory=512,files=64\n\
+    -w              Wait for jobs to finish\n\
+    -o              Print script output as jobs run (implies -w)\n\
+    -h              Print help\n\
+\n\
+Exits with the script's exit status when waiting for a single job,\n\
+otherwise with 1 if any job was rejected or failed.\n\
+", PROGNAME, PROGNAME);
+}
+
+static void Fail(const char *message) {
+    fprintf(stderr, "%s: %s\n", PROGNAME, message);
+    exit(EXIT_FAILURE);
+}
+
+static char *DefaultSocketPath(const char *bundleIdentifier) {
+    const char *home = getenv("HOME");
+    if (home == NULL) {
+        Fail("HOME is not set");
+    }
+    const char *format = "%s/Library/Application Support/%s/%s";
+    size_t size = strlen(home) + strlen(bundleIdentifier) + strlen(format) + strlen(PLATYPUS_JOB_SOCKET_NAME);
+    char *path = malloc(size);
+    if (path == NULL) {
+        Fail("out of memory");
+    }
+    snprintf(path, size, format, home, bundleIdentifier, PLATYPUS_JOB_SOCKET_NAME);
+    return path;
+}
+
+static char *ReadAll(FILE *file, size_t *length) {
+    size_t capacity = 65536;
+    char *bytes = malloc(capacity);
+    *length = 0;
+    size_t n;
+    while (bytes && (n = fread(bytes + *length, 1, capacity - *length, file)) > 0) {
+        *length += n;
+        if (*length == capacity) {
+            capacity *= 2;
+            char *grown = realloc(bytes, capacity);
+            if (grown == NULL) {
+                free(bytes);
+            }
+            bytes = grown;
+        }
+    }
+    if (bytes == NULL) {
+        Fail("out of memory");
+    }
+    return bytes;
+}
+
+static int Connect(const char *path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        Fail("socket path is too long");
+    }
+    strcpy(addr.sun_path, path);
+    
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        fprintf(stderr, "%s: unable to connect to %s: %s\n", PROGNAME, path, strerror(errno));
+        fprintf(stderr, "%s: is the app running, and was it created with --job-server?\n", PROGNAME);
+        exit(EXIT_FAILURE);
+    }
+    // Replies are read while submissions are still being written
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    return fd;
+}
+
+static void AddSubmission(PlatypusJobBuffer *out, const Options *options, char **args, int argCount) {
+    PlatypusJobFrameBegin(out, PlatypusJobFrame_Submit);
+    for (int i = 0; i < argCount; i++) {
+        PlatypusJobFrameAddString(out, PlatypusJobField_Argument, args[i]);
+    }
+    if (options->input) {
+        PlatypusJobFrameAddField(out, PlatypusJobField_Input, options->input, options->inputLength);
+    }
+    if (options->priority) {
+        PlatypusJobFrameAddUInt32(out, PlatypusJobField_Priority, (uint32_t)options->priority);
+    }
+    for (int i = 0; i < options->metadataCount; i++) {
+        PlatypusJobFrameAddString(out, PlatypusJobField_Metadata, options->metadata[i]);
+    }
+    if (options->limits) {
+        PlatypusJobFrameAddString(out, PlatypusJobField_Limits, options->limits);
+    }
+    if (options->streamOutput) {
+        PlatypusJobFrameAddUInt32(out, PlatypusJobField_StreamOutput, 1);
+    }
+    int err = PlatypusJobFrameEnd(out);
+    if (err) {
+        Fail(err == EMSGSIZE ? "job is too large" : "out of memory");
+    }
+}
+
+static void HandleReply(const PlatypusJobFrame *frame, Progress *progress) {
+    uint32_t sequence = 0;
+    uint32_t status = 0;
+    const uint8_t *data = NULL;
+    size_t dataLength = 0;
+    
+    size_t offset = 0;
+    PlatypusJobField field;
+    const uint8_t *value;
+    size_t length;
+    while (PlatypusJobFrameNextField(frame, &offset, &field, &value, &length) == 1) {
+        if (field == PlatypusJobField_Sequence) {
+            sequence = PlatypusJobFieldUInt32(value, length);
+        } else if (field == PlatypusJobField_Status) {
+            status = PlatypusJobFieldUInt32(value, length);
+        } else if (field == PlatypusJobField_Data || field == PlatypusJobField_Message) {
+            data = value;
+            dataLength = length;
+        }
+    }
+    
+    switch (frame->type) {
+        case PlatypusJobFrame_Accepted:
+            progress->replied++;
+            progress->accepted++;
+            break;
+            
+        case PlatypusJobFrame_Rejected:
+            progress->replied++;
+            progress->failed++;
+            fprintf(stderr, "%s: job %u rejected: %.*s\n", PROGNAME, sequence, (int)dataLength, (const char *)data);
+            break;
+            
+        case PlatypusJobFrame_Output:
+            if (dataLength) {
+                fwrite(data, 1, dataLength, stdout);
+            }
+            break;
+            
+        case PlatypusJobFrame_Finished:
+            progress->finished++;
+            progress->lastStatus = (int32_t)status;
+            if (status != 0) {
+                progress->failed++;
+            }
+            break;
+            
+        default:
+            break;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    Options options;
+    memset(&options, 0, sizeof(options));
+    const char *bundleIdentifier = NULL;
+    const char *listPath = NULL;
+    int readInput = 0;
+    
+    options.metadata = calloc(argc, sizeof(char *));
+    if (options.metadata == NULL) {
+        Fail("out of memory");
+    }
+    
+    int optch;
+    while ((optch = getopt(argc, argv, "s:b:f:ip:m:l:woh")) != -1) {
+        switch (optch) {
+            case 's':
+                options.socketPath = optarg;
+                break;
+            case 'b':
+                bundleIdentifier = optarg;
+                break;
+            case 'f':
+                listPath = optarg;
+                break;
+            case 'i':
+                readInput = 1;
+                break;
+            case 'p':
+                if (strcmp(optarg, "low") == 0) {
+                    options.priority = -1;
+                } else if (strcmp(optarg, "high") == 0) {
+                    options.priority = 1;
+                } else if (strcmp(optarg, "normal") == 0) {
+                    options.priority = 0;
+                } else {
+                    Fail("priority must be low, normal or high");
+                }
+                break;
+            case 'm':
+                if (strchr(optarg, '=') == NULL) {
+                    Fail("metadata must be KEY=value");
+                }
+                options.metadata[options.metadataCount++] = optarg;
+                break;
+            case 'l':
+            {
+                PlatypusJobLimits limits;
+                if (PlatypusJobLimitsParse(optarg, &limits) != 0) {
+                    Fail("limits must be a list of timeout, cpu, memory and files, e.g. timeout=60,cpu=30");
+                }
+                options.limits = optarg;
+            }
+                break;
+            case 'o':
+                options.streamOutput = 1;
+                options.wait = 1;
+                break;
+            case 'w':
+                options.wait = 1;
+                break;
+            case 'h':
+                PrintHelp();
+                return EXIT_SUCCESS;
+            default:
+                PrintHelp();
+                return EXIT_FAILURE;
+        }
+    }
+    argc -= optind;
+    argv += optind;
+    
+    if (options.socketPath == NULL && bundleIdentifier == NULL) {
+        PrintHelp();
+        return EXIT_FAILURE;
+    }
+    if (listPath && argc) {
+        Fail("arguments can't be combined with -f");
+    }
+    if (listPath && readInput && strcmp(listPath, "-") == 0) {
+        Fail("-i can't be combined with -f -");
+    }
+    char *defaultSocketPath = NULL;
+    if (options.socketPath == NULL) {
+        defaultSocketPath = DefaultSocketPath(bundleIdentifier);
+        options.socketPath = defaultSocketPath;
+    }
+    
+    FILE *list = NULL;
+    if (listPath) {
+        list = strcmp(listPath, "-") == 0 ? stdin : fopen(listPath, "r");
+        if (list == NULL) {
+            fprintf(stderr, "%s: %s: %s\n", PROGNAME, listPath, strerror(errno));
+            return EXIT_FAILURE;
+        }
+    }
+    if (readInput) {
+        options.input = ReadAll(stdin, &options.inputLength);
+    }
+    
+    // Write errors are handled where they happen
+    signal(SIGPIPE, SIG_IGN);
+    int fd = Connect(options.socketPath);
+    
+    PlatypusJobBuffer out;
+    PlatypusJobBufferInit(&out);
+    PlatypusJobReader reader;
+    PlatypusJobReaderInit(&reader);
+    Progress progress;
+    memset(&progress, 0, sizeof(progress));
+    
+    int submitting = 1;
+    if (list == NULL) {
+        AddSubmission(&out, &options, argv, argc);
+        progress.submitted++;
+        submitting = 0;
+    }
+    
+    char *line = NULL;
+    size_t lineCapacity = 0;
+    int writeClosed = 0;
+    
+    while (1) {
+        // Generate submissions as the previous ones are sent
+        while (submitting && out.length < MAX_UNSENT_BYTES) {
+            ssize_t len = getline(&line, &lineCapacity, list);
+            if (len == -1) {
+                submitting = 0;
+                break;
+            }
+            if (len && line[len - 1] == '\n') {
+                line[--len] = '\0';
+            }
+            if (len == 0) {
+                continue;
+            }
+            AddSubmission(&out, &options, &line, 1);
+            progress.submitted++;
+        }
+        
+        // Tell the app we're done submitting, so it closes the
+        // connection once it has replied to everything
+        if (!submitting && out.length == 0 && !writeClosed) {
+            shutdown(fd, SHUT_WR);
+            writeClosed = 1;
+        }
+        
+        if (writeClosed && progress.replied == progress.submitted &&
+            (!options.wait || progress.finished == progress.accepted)) {
+            break;
+        }
+        
+        struct pollfd pfd = { fd, POLLIN | (out.length ? POLLOUT : 0), 0 };
+        if (poll(&pfd, 1, -1) == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            Fail(strerror(errno));
+        }
+        
+        if (pfd.revents & POLLOUT) {
+            ssize_t n = write(fd, out.bytes, out.length);
+            if (n == -1 && errno != EINTR && errno != EAGAIN) {
+                Fail("connection closed by app");
+            }
+            if (n > 0) {
+                PlatypusJobBufferConsume(&out, (size_t)n);
+            }
+        }
+        
+        if (pfd.revents & (POLLIN | POLLHUP | POLLERR)) {
+            char buf[65536];
+            ssize_t n = read(fd, buf, sizeof(buf));
+            if (n == -1 && (errno == EINTR || errno == EAGAIN)) {
+                continue;
+            }
+            if (n <= 0) {
+                Fail("connection closed by app");
+            }
+            if (PlatypusJobReaderAppend(&reader, buf, (size_t)n) != 0) {
+                Fail("out of memory");
+            }
+            PlatypusJobFrame frame;
+            int result;
+            while ((result = PlatypusJobReaderNext(&reader, &frame)) == 1) {
+                HandleReply(&frame, &progress);
+            }
+            if (result == -1) {
+                Fail("malformed reply from app");
+            }
+        }
+    }
+    
+    fflush(stdout);
+    close(fd);
+    free(line);
+    free(options.input);
+    free(options.metadata);
+    free(defaultSocketPath);
+    PlatypusJobBufferFree(&out);
+    PlatypusJobReaderFree(&reader);
+    
+    if (list == NULL && options.wait && progress.accepted) {
+        int status = progress.lastStatus;
+        return (status >= 0 && status <= 255) ? status : EXIT_FAILURE;
+    }
+    return progress.failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -73,15 +73,21 @@
 #define CMDLINE_MANPAGE_PATH        @"/usr/local/share/man/man1/platypus.1.gz"
 #define CMDLINE_NIB_PATH            @"/usr/local/share/platypus/MainMenu.nib"
 #define CMDLINE_SCRIPT_EXEC_PATH    @"/usr/local/share/platypus/ScriptExec"
+#define CMDLINE_SUBMIT_TOOL_NAME    @"platypus_submit"
+#define CMDLINE_SUBMIT_TOOL_PATH    @"/usr/local/bin/platypus_submit"
 #define CMDLINE_ARG_SEPARATOR       @"|"
 
 #define IBTOOL_PATH                 @"/usr/bin/ibtool"
 #define PERL_PATH                   @"/usr/bin/perl"
 #define CODESIGN_PATH               @"/usr/bin/codesign"
 
+#define PRECOMPILE_TIMEOUT          120.0
+
 #define APPBUNDLE_SUFFIX            @".app"
 #define GZIP_SUFFIX                 @".gz"
 
+#define APP_SETTINGS_SNAPSHOT_NAME  @"AppSettings.bin"
+
 #define DEFAULT_TEXT_FONT_NAME      @"Monaco"
 #define DEFAULT_TEXT_FONT_SIZE      13.0
 #define DEFAULT_TEXT_FG_COLOR       @"#000000"
@@ -174,6 +180,8 @@ extern NSString * const AppSpecKey_DestinationPath;
 extern NSString * const AppSpecKey_Overwrite;
 extern NSString * const AppSpecKey_SymlinkFiles;
 extern NSString * const AppSpecKey_StripNib;
+extern NSString * const AppSpecKey_Architectures;
+extern NSString * const AppSpecKey_PrecompileBytecode;
 extern NSString * const AppSpecKey_Name;
 extern NSString * const AppSpecKey_ScriptPath;
 extern NSString * const AppSpecKey_InterfaceType;
@@ -190,6 +198,15 @@ extern NSString * const AppSpecKey_Authenticate;
 extern NSString * const AppSpecKey_RemainRunning;
 extern NSString * const AppSpecKey_RunInBackground;
 extern NSString * const AppSpecKey_SendNotifications;
+extern NSString * const AppSpecKey_ExecInterpreter;
+extern NSString * const AppSpecKey_ControlChannelOnly;
+extern NSString * const AppSpecKey_LargeOutputView;
+extern NSString * const AppSpecKey_LogOutput;
+extern NSString * const AppSpecKey_PersistentJobQueue;
+extern NSString * const AppSpecKey_JobServer;
+extern NSString * const AppSpecKey_JobLimits;
+extern NSString * const AppSpecKey_PrivilegedHelper;
+extern NSString * const AppSpecKey_PrespawnInterpreter;
 
 extern NSString * const AppSpecKey_BundledFiles;
 
@@ -240,6 +257,15 @@ extern NSString * const DefaultsKey_SigningIdentity;
 // NSUserDefaults keys for ScriptExec app
 extern NSString * const ScriptExecDefaultsKey_UserFontSize;
 extern NSString * const ScriptExecDefaultsKey_ShowDetails;
+extern NSString * const ScriptExecDefaultsKey_DisableHeadless;
+extern NSString * const ScriptExecDefaultsKey_OutputLogMaxSize;
+extern NSString * const ScriptExecDefaultsKey_OutputLogRotationInterval;
+extern NSString * const ScriptExecDefaultsKey_OutputLogSegments;
+extern NSString * const ScriptExecDefaultsKey_OutputLogCompress;
+extern NSString * const ScriptExecDefaultsKey_MetricsFile;
+extern NSString * const ScriptExecDefaultsKey_MetricsSocket;
+extern NSString * const ScriptExecDefaultsKey_AuthorizationLifetime;
+extern NSString * const ScriptExecDefaultsKey_SpareInterpreters;
 
 // Abbreviations. Objective-C is often tediously verbose
 #define FILEMGR     [NSFileManager defaultManager]
@@ -39,6 +39,8 @@ NSString * const AppSpecKey_DestinationPath = @"Destination";
 NSString * const AppSpecKey_Overwrite = @"Overwrite";
 NSString * const AppSpecKey_SymlinkFiles = @"DevelopmentVersion";
 NSString * const AppSpecKey_StripNib = @"OptimizeApplication";
+NSString * const AppSpecKey_Architectures = @"Architectures";
+NSString * const AppSpecKey_PrecompileBytecode = @"PrecompileBytecode";
 NSString * const AppSpecKey_Name = @"Name";
 NSString * const AppSpecKey_ScriptPath = @"ScriptPath";
 NSString * const AppSpecKey_InterfaceType = @"InterfaceType";
@@ -55,6 +57,15 @@ NSString * const AppSpecKey_Authenticate = @"Authentication";
 NSString * const AppSpecKey_RemainRunning = @"RemainRunning";
 NSString * const AppSpecKey_RunInBackground = @"RunInBackground";
 NSString * const AppSpecKey_SendNotifications = @"SendNotifications";
+NSString * const AppSpecKey_ExecInterpreter = @"ExecInterpreter";
+NSString * const AppSpecKey_ControlChannelOnly = @"ControlChannelOnly";
+NSString * const AppSpecKey_LargeOutputView = @"LargeOutputView";
+NSString * const AppSpecKey_LogOutput = @"LogOutput";
+NSString * const AppSpecKey_PersistentJobQueue = @"PersistentJobQueue";
+NSString * const AppSpecKey_JobServer = @"JobServer";
+NSString * const AppSpecKey_JobLimits = @"JobLimits";
+NSString * const AppSpecKey_PrivilegedHelper = @"PrivilegedHelper";
+NSString * const AppSpecKey_PrespawnInterpreter = @"PrespawnInterpreter";
 
 NSString * const AppSpecKey_BundledFiles = @"BundledFiles";
 
@@ -105,6 +116,15 @@ NSString * const DefaultsKey_SigningIdentity = @"SigningIdentity";
 // NSUserDefaults keys for ScriptExec app
 NSString * const ScriptExecDefaultsKey_UserFontSize = @"UserFontSize";
 NSString * const ScriptExecDefaultsKey_ShowDetails = @"UserShowDetails";
+NSString * const ScriptExecDefaultsKey_DisableHeadless = @"DisableHeadless";
+NSString * const ScriptExecDefaultsKey_OutputLogMaxSize = @"OutputLogMaxSize";
+NSString * const ScriptExecDefaultsKey_OutputLogRotationInterval = @"OutputLogRotationInterval";
+NSString * const ScriptExecDefaultsKey_OutputLogSegments = @"OutputLogSegments";
+NSString * const ScriptExecDefaultsKey_OutputLogCompress = @"OutputLogCompress";
+NSString * const ScriptExecDefaultsKey_MetricsFile = @"MetricsFile";
+NSString * const ScriptExecDefaultsKey_MetricsSocket = @"MetricsSocket";
+NSString * const ScriptExecDefaultsKey_AuthorizationLifetime = @"AuthorizationLifetime";
+NSString * const ScriptExecDefaultsKey_SpareInterpreters = @"SpareInterpreters";
 
 
 BOOL UTTypeIsValid(NSString *inUTI) {
@@ -0,0 +1,358 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "SEANSIParser.h"
+
+#define ESC     0x1B
+#define BEL     0x07
+
+enum {
+    State_Ground = 0,
+    State_Escape,
+    State_EscapeIntermediate,
+    State_CSI,
+    State_String,
+    State_StringEscape
+};
+
+#pragma mark - Output
+
+void SEANSIOutputInit(SEANSIOutput *output) {
+    memset(output, 0, sizeof(SEANSIOutput));
+}
+
+void SEANSIOutputClear(SEANSIOutput *output) {
+    output->length = 0;
+    output->runCount = 0;
+}
+
+void SEANSIOutputFree(SEANSIOutput *output) {
+    free(output->text);
+    free(output->runs);
+    SEANSIOutputInit(output);
+}
+
+static int Reserve(void **buffer, size_t *capacity, size_t needed, size_t elementSize) {
+    if (needed <= *capacity) {
+        return 0;
+    }
+    size_t newCapacity = *capacity ? *capacity : 256;
+    while (newCapacity < needed) {
+        newCapacity *= 2;
+    }
+    void *newBuffer = realloc(*buffer, newCapacity * elementSize);
+    if (newBuffer == NULL) {
+        return ENOMEM;
+    }
+    *buffer = newBuffer;
+    *capacity = newCapacity;
+    return 0;
+}
+
+static int AppendText(SEANSIOutput *output, const char *bytes, size_t length, const SEANSIStyle *style) {
+    if (length == 0) {
+        return 0;
+    }
+    if (Reserve((void **)&output->text, &output->capacity, output->length + length, 1)) {
+        return ENOMEM;
+    }
+    memcpy(output->text + output->length, bytes, length);
+    output->length += length;
+    
+    // Extend the last run if the style hasn't changed
+    if (output->runCount && SEANSIStyleEqual(&output->runs[output->runCount - 1].style, style)) {
+        output->runs[output->runCount - 1].length += length;
+        return 0;
+    }
+    if (Reserve((void **)&output->runs, &output->runCapacity, output->runCount + 1, sizeof(SEANSIRun))) {
+        return ENOMEM;
+    }
+    output->runs[output->runCount].length = length;
+    output->runs[output->runCount].style = *style;
+    output->runCount++;
+    return 0;
+}
+
+#pragma mark - Styles
+
+int SEANSIStyleIsDefault(const SEANSIStyle *style) {
+    return style->flags == 0 &&
+           style->foreground.type == SEANSIColor_Default &&
+           style->background.type == SEANSIColor_Default;
+}
+
+static int ColorEqual(const SEANSIColor *a, const SEANSIColor *b) {
+    if (a->type != b->type) {
+        return 0;
+    }
+    switch (a->type) {
+        case SEANSIColor_Indexed:
+            return a->index == b->index;
+        case SEANSIColor_RGB:
+            return a->red == b->red && a->green == b->green && a->blue == b->blue;
+        default:
+            return 1;
+    }
+}
+
+int SEANSIStyleEqual(const SEANSIStyle *a, const SEANSIStyle *b) {
+    return a->flags == b->flags &&
+           ColorEqual(&a->foreground, &b->foreground) &&
+           ColorEqual(&a->background, &b->background);
+}
+
+void SEANSIPaletteColor(uint8_t index, uint8_t *red, uint8_t *green, uint8_t *blue) {
+    static const uint8_t standard[16][3] = {
+        { 0x00, 0x00, 0x00 }, { 0xcd, 0x00, 0x00 }, { 0x00, 0xcd, 0x00 }, { 0xcd, 0xcd, 0x00 },
+        { 0x00, 0x00, 0xee }, { 0xcd, 0x00, 0xcd }, { 0x00, 0xcd, 0xcd }, { 0xe5, 0xe5, 0xe5 },
+        { 0x7f, 0x7f, 0x7f }, { 0xff, 0x00, 0x00 }, { 0x00, 0xff, 0x00 }, { 0xff, 0xff, 0x00 },
+        { 0x5c, 0x5c, 0xff }, { 0xff, 0x00, 0xff }, { 0x00, 0xff, 0xff }, { 0xff, 0xff, 0xff }
+    };
+    static const uint8_t cubeLevels[6] = { 0, 95, 135, 175, 215, 255 };
+    
+    if (index < 16) {
+        *red = standard[index][0];
+        *green = standard[index][1];
+        *blue = standard[index][2];
+    } else if (index < 232) {
+        // 6x6x6 color cube
+        int i = index - 16;
+        *red = cubeLevels[i / 36];
+        *green = cubeLevels[(i / 6) % 6];
+        *blue = cubeLevels[i % 6];
+    } else {
+        // Grayscale ramp
+        *red = *green = *blue = (uint8_t)(8 + (index - 232) * 10);
+    }
+}
+
+static SEANSIColor IndexedColor(int index) {
+    SEANSIColor color = { SEANSIColor_Indexed, (uint8_t)index, 0, 0, 0 };
+    return color;
+}
+
+static uint8_t ParamByte(int param) {
+    return (param < 0) ? 0 : (param > 255) ? 255 : (uint8_t)param;
+}
+
+// Parses 5;n or 2;r;g;b following 38 or 48. Returns number of parameters used.
+static int ExtendedColor(const int *params, int count, SEANSIColor *color) {
+    if (count >= 2 && params[0] == 5) {
+        color->type = SEANSIColor_Indexed;
+        color->index = ParamByte(params[1]);
+        return 2;
+    }
+    if (count >= 4 && params[0] == 2) {
+        color->type = SEANSIColor_RGB;
+        color->red = ParamByte(params[1]);
+        color->green = ParamByte(params[2]);
+        color->blue = ParamByte(params[3]);
+        return 4;
+    }
+    // Malformed, ignore the rest of the sequence
+    return count;
+}
+
+static void ApplySGR(SEANSIStyle *style, const int *params, int count) {
+    static const SEANSIStyle defaultStyle;
+    
+    // ESC[m is the same as ESC[0m
+    if (count == 0) {
+        *style = defaultStyle;
+        return;
+    }
+    
+    for (int i = 0; i < count; i++) {
+        int p = (params[i] < 0) ? 0 : params[i];
+        
+        if (p >= 30 && p <= 37) {
+            style->foreground = IndexedColor(p - 30);
+        } else if (p >= 40 && p <= 47) {
+            style->background = IndexedColor(p - 40);
+        } else if (p >= 90 && p <= 97) {
+            style->foreground = IndexedColor(p - 90 + 8);
+        } else if (p >= 100 && p <= 107) {
+            style->background = IndexedColor(p - 100 + 8);
+        } else {
+            switch (p) {
+                case 0:  *style = defaultStyle;                                         break;
+                case 1:  style->flags |= SEANSIStyle_Bold;                              break;
+                case 2:  style->flags |= SEANSIStyle_Faint;                             break;
+                case 3:  style->flags |= SEANSIStyle_Italic;                            break;
+                case 4:
+                case 21: style->flags |= SEANSIStyle_Underline;                         break;
+                case 7:  style->flags |= SEANSIStyle_Inverse;                           break;
+                case 9:  style->flags |= SEANSIStyle_Strikethrough;                     break;
+                case 22: style->flags &= ~(SEANSIStyle_Bold | SEANSIStyle_Faint);       break;
+                case 23: style->flags &= ~SEANSIStyle_Italic;                           break;
+                case 24: style->flags &= ~SEANSIStyle_Underline;                        break;
+                case 27: style->flags &= ~SEANSIStyle_Inverse;                          break;
+                case 29: style->flags &= ~SEANSIStyle_Strikethrough;                    break;
+                case 39: style->foreground = defaultStyle.foreground;                   break;
+                case 49: style->background = defaultStyle.background;                   break;
+                case 38:
+                    i += ExtendedColor(params + i + 1, count - i - 1, &style->foreground);
+                    break;
+                case 48:
+                    i += ExtendedColor(params + i + 1, count - i - 1, &style->background);
+                    break;
+                default:
+                    // Blink, conceal, fonts etc. aren't supported
+                    break;
+            }
+        }
+    }
+}
+
+#pragma mark - Parser
+
+void SEANSIParserInit(SEANSIParser *parser) {
+    memset(parser, 0, sizeof(SEANSIParser));
+}
+
+int SEANSIParserFeed(SEANSIParser *parser, const char *bytes, size_t length, SEANSIOutput *output) {
+    const unsigned char *b = (const unsigned char *)bytes;
+    size_t i = 0;
+    
+    while (i < length) {
+        unsigned char c = b[i];
+        
+        switch (parser->state) {
+            case State_Ground:
+            {
+                // Copy text up to the next escape sequence in one go
+                size_t start = i;
+                while (i < length && b[i] != ESC && b[i] != BEL) {
+                    i++;
+                }
+                if (AppendText(output, bytes + start, i - start, &parser->style)) {
+                    return ENOMEM;
+                }
+                if (i < length) {
+                    if (b[i] == ESC) {
+                        parser->state = State_Escape;
+                    }
+                    i++;
+                }
+                continue;
+            }
+                
+            case State_Escape:
+                if (c == '[') {
+                    parser->state = State_CSI;
+                    parser->paramCount = 0;
+                    parser->privateMarker = 0;
+                } else if (c == ']' || c == 'P' || c == 'X' || c == '^' || c == '_') {
+                    // OSC, DCS, SOS, PM and APC strings
+                    parser->state = State_String;
+                } else if (c >= 0x20 && c <= 0x2F) {
+                    // e.g. ESC ( B character set selection
+                    parser->state = State_EscapeIntermediate;
+                } else if (c == ESC) {
+                    // Stay in escape state
+                } else {
+                    if (c == 'c') {
+                        // Full reset
+                        SEANSIParserInit(parser);
+                    }
+                    parser->state = State_Ground;
+                }
+                break;
+                
+            case State_EscapeIntermediate:
+                if (c < 0x20 || c > 0x2F) {
+                    parser->state = State_Ground;
+                }
+                break;
+                
+            case State_CSI:
+                if (c >= '0' && c <= '9') {
+                    if (parser->paramCount == 0) {
+                        parser->params[parser->paramCount++] = -1;
+                    }
+                    int *p = &parser->params[parser->paramCount - 1];
+                    *p = (*p < 0) ? (c - '0') : (*p * 10) + (c - '0');
+                    if (*p > 65535) {
+                        *p = 65535;
+                    }
+                } else if (c == ';' || c == ':') {
+                    // Colon separated sub-parameters are treated as parameters
+                    if (parser->paramCount == 0) {
+                        parser->params[parser->paramCount++] = -1;
+                    }
+                    if (parser->paramCount < SE_ANSI_MAX_PARAMS) {
+                        parser->params[parser->paramCount++] = -1;
+                    }
+                } else if (c >= '<' && c <= '?') {
+                    parser->privateMarker = c;
+                } else if (c >= 0x20 && c <= 0x2F) {
+                    // Intermediate bytes, ignored
+                } else if (c >= 0x40 && c <= 0x7E) {
+                    if (c == 'm' && parser->privateMarker == 0) {
+                        ApplySGR(&parser->style, parser->params, parser->paramCount);
+                    }
+                    parser->state = State_Ground;
+                } else {
+                    // Malformed. Abandon the sequence and treat the byte as text.
+                    parser->state = State_Ground;
+                    continue;
+                }
+                break;
+                
+            case State_String:
+                if (c == BEL) {
+                    parser->state = State_Ground;
+                } else if (c == ESC) {
+                    parser->state = State_StringEscape;
+                } else if (c == '\n') {
+                    // Don't let an unterminated string swallow all further output
+                    parser->state = State_Ground;
+                    continue;
+                }
+                break;
+                
+            case State_StringEscape:
+                if (c == '\\') {
+                    parser->state = State_Ground;
+                } else {
+                    parser->state = State_Escape;
+                    continue;
+                }
+                break;
+        }
+        i++;
+    }
+    
+    return 0;
+}
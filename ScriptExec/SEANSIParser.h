@@ -0,0 +1,132 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Parser for the subset of ANSI/VT100 escape sequences that scripts use to
+// style their output.
+//
+// Bytes are fed in as they arrive. Printable text is copied to an output
+// buffer together with runs recording the style of each stretch of text,
+// and escape sequences are removed. Consecutive text in the same style is
+// a single run, so the output can be applied with one attribute change
+// per run rather than per escape sequence. Sequences split between calls
+// are handled, since parser state is kept between them.
+//
+// SGR (ESC [ ... m) sequences set the style: bold, faint, italic,
+// underline, inverse and strikethrough, and foreground and background
+// colors from the 16 color palette, the 256 color palette or 24-bit RGB.
+// All other CSI sequences, OSC strings (e.g. window titles) and character
+// set selection are recognised and dropped. Portable C.
+
+#ifndef SE_ANSI_PARSER_H
+#define SE_ANSI_PARSER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SE_ANSI_MAX_PARAMS  32
+
+typedef enum SEANSIColorType {
+    SEANSIColor_Default = 0,
+    SEANSIColor_Indexed,    // Palette index 0-255. 0-15 are the standard colors.
+    SEANSIColor_RGB
+} SEANSIColorType;
+
+typedef struct SEANSIColor {
+    uint8_t type;
+    uint8_t index;
+    uint8_t red;
+    uint8_t green;
+    uint8_t blue;
+} SEANSIColor;
+
+typedef enum SEANSIStyleFlag {
+    SEANSIStyle_Bold            = 1 << 0,
+    SEANSIStyle_Faint           = 1 << 1,
+    SEANSIStyle_Italic          = 1 << 2,
+    SEANSIStyle_Underline       = 1 << 3,
+    SEANSIStyle_Inverse         = 1 << 4,
+    SEANSIStyle_Strikethrough   = 1 << 5
+} SEANSIStyleFlag;
+
+typedef struct SEANSIStyle {
+    SEANSIColor foreground;
+    SEANSIColor background;
+    uint8_t flags;
+} SEANSIStyle;
+
+typedef struct SEANSIRun {
+    size_t length; // Bytes of text
+    SEANSIStyle style;
+} SEANSIRun;
+
+// Text and runs produced by the parser
+typedef struct SEANSIOutput {
+    char *text;
+    size_t length;
+    size_t capacity;
+    SEANSIRun *runs;
+    size_t runCount;
+    size_t runCapacity;
+} SEANSIOutput;
+
+typedef struct SEANSIParser {
+    int state;
+    SEANSIStyle style;
+    int params[SE_ANSI_MAX_PARAMS];
+    int paramCount;
+    int privateMarker;
+} SEANSIParser;
+
+void SEANSIParserInit(SEANSIParser *parser);
+
+// Parses bytes, appending text and runs to output.
+// Returns 0 on success, otherwise an errno value.
+int SEANSIParserFeed(SEANSIParser *parser, const char *bytes, size_t length, SEANSIOutput *output);
+
+// True if a style is the terminal's default style
+int SEANSIStyleIsDefault(const SEANSIStyle *style);
+int SEANSIStyleEqual(const SEANSIStyle *a, const SEANSIStyle *b);
+
+// RGB value of a 256 color palette index, using the xterm palette
+void SEANSIPaletteColor(uint8_t index, uint8_t *red, uint8_t *green, uint8_t *blue);
+
+void SEANSIOutputInit(SEANSIOutput *output);
+void SEANSIOutputClear(SEANSIOutput *output);
+void SEANSIOutputFree(SEANSIOutput *output);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
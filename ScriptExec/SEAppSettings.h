@@ -0,0 +1,85 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Settings for a Platypus-generated app, loaded either from the precompiled
+// AppSettings.bin snapshot or from AppSettings.plist.
+
+#import <Foundation/Foundation.h>
+#import "Common.h"
+
+@interface SEAppSettings : NSObject
+
+@property (nonatomic, readonly) BOOL loadedFromSnapshot;
+
+@property (nonatomic, readonly, copy) NSString *interpreterPath;
+@property (nonatomic, readonly, copy) NSArray <NSString *> *interpreterArgs;
+@property (nonatomic, readonly, copy) NSArray <NSString *> *scriptArgs;
+
+@property (nonatomic, readonly, copy) NSString *interfaceTypeName;
+@property (nonatomic, readonly) PlatypusInterfaceType interfaceType;
+@property (nonatomic, readonly) PlatypusExecStyle execStyle;
+
+@property (nonatomic, readonly) BOOL remainRunning;
+@property (nonatomic, readonly) BOOL sendsNotifications;
+@property (nonatomic, readonly) BOOL acceptsFiles;
+@property (nonatomic, readonly) BOOL acceptsText;
+@property (nonatomic, readonly) BOOL promptForFile;
+@property (nonatomic, readonly) BOOL execInterpreter;
+@property (nonatomic, readonly) BOOL controlChannelOnly;
+@property (nonatomic, readonly) BOOL largeOutputView;
+@property (nonatomic, readonly) BOOL logOutput;
+@property (nonatomic, readonly) BOOL persistentJobQueue;
+@property (nonatomic, readonly) BOOL jobServer;
+@property (nonatomic, readonly, copy) NSString *jobLimits;
+@property (nonatomic, readonly) BOOL privilegedHelper;
+@property (nonatomic, readonly) BOOL prespawnInterpreter;
+
+@property (nonatomic, readonly, copy) NSString *textFontName;
+@property (nonatomic, readonly) CGFloat textSize;
+@property (nonatomic, readonly) uint32_t textColor;             // 0xRRGGBB
+@property (nonatomic, readonly) uint32_t textBackgroundColor;   // 0xRRGGBB
+
+@property (nonatomic, readonly, copy) NSArray <NSString *> *suffixes;
+@property (nonatomic, readonly, copy) NSArray <NSString *> *uniformTypes;
+@property (nonatomic, readonly, copy) NSArray <NSString *> *URISchemes;
+
+@property (nonatomic, readonly, copy) NSString *statusItemDisplayType;
+@property (nonatomic, readonly, copy) NSString *statusItemTitle;
+@property (nonatomic, readonly, copy) NSData *statusItemIcon;
+@property (nonatomic, readonly) BOOL statusItemUsesSystemFont;
+@property (nonatomic, readonly) BOOL statusItemIconIsTemplate;
+
+// Returns nil if there is no usable snapshot at path, or if the property list
+// it was made from has been modified since
++ (instancetype)settingsWithSnapshotAtPath:(NSString *)path propertyListPath:(NSString *)plistPath;
+// Returns nil if the property list can't be read
++ (instancetype)settingsWithPropertyListAtPath:(NSString *)path;
+
+@end
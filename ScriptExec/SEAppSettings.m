@@ -0,0 +1,217 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#import "SEAppSettings.h"
+#import "PlatypusSettingsSnapshot.h"
+
+@interface SEAppSettings()
+
+@property (nonatomic, readwrite) BOOL loadedFromSnapshot;
+
+@property (nonatomic, readwrite, copy) NSString *interpreterPath;
+@property (nonatomic, readwrite, copy) NSArray <NSString *> *interpreterArgs;
+@property (nonatomic, readwrite, copy) NSArray <NSString *> *scriptArgs;
+
+@property (nonatomic, readwrite, copy) NSString *interfaceTypeName;
+@property (nonatomic, readwrite) PlatypusInterfaceType interfaceType;
+@property (nonatomic, readwrite) PlatypusExecStyle execStyle;
+
+@property (nonatomic, readwrite) BOOL remainRunning;
+@property (nonatomic, readwrite) BOOL sendsNotifications;
+@property (nonatomic, readwrite) BOOL acceptsFiles;
+@property (nonatomic, readwrite) BOOL acceptsText;
+@property (nonatomic, readwrite) BOOL promptForFile;
+@property (nonatomic, readwrite) BOOL execInterpreter;
+@property (nonatomic, readwrite) BOOL controlChannelOnly;
+@property (nonatomic, readwrite) BOOL largeOutputView;
+@property (nonatomic, readwrite) BOOL logOutput;
+@property (nonatomic, readwrite) BOOL persistentJobQueue;
+@property (nonatomic, readwrite) BOOL jobServer;
+@property (nonatomic, readwrite, copy) NSString *jobLimits;
+@property (nonatomic, readwrite) BOOL privilegedHelper;
+@property (nonatomic, readwrite) BOOL prespawnInterpreter;
+
+@property (nonatomic, readwrite, copy) NSString *textFontName;
+@property (nonatomic, readwrite) CGFloat textSize;
+@property (nonatomic, readwrite) uint32_t textColor;
+@property (nonatomic, readwrite) uint32_t textBackgroundColor;
+
+@property (nonatomic, readwrite, copy) NSArray <NSString *> *suffixes;
+@property (nonatomic, readwrite, copy) NSArray <NSString *> *uniformTypes;
+@property (nonatomic, readwrite, copy) NSArray <NSString *> *URISchemes;
+
+@property (nonatomic, readwrite, copy) NSString *statusItemDisplayType;
+@property (nonatomic, readwrite, copy) NSString *statusItemTitle;
+@property (nonatomic, readwrite, copy) NSData *statusItemIcon;
+@property (nonatomic, readwrite) BOOL statusItemUsesSystemFont;
+@property (nonatomic, readwrite) BOOL statusItemIconIsTemplate;
+
+@end
+
+static NSString *SnapshotString(const PlatypusSnapshot *snapshot, PlatypusSnapshotString which) {
+    const char *str = PlatypusSnapshotGetString(snapshot, which);
+    return str ? @(str) : nil;
+}
+
+static NSArray <NSString *> *SnapshotList(const PlatypusSnapshot *snapshot, PlatypusSnapshotList which) {
+    uint32_t count = PlatypusSnapshotGetListCount(snapshot, which);
+    NSMutableArray *list = [NSMutableArray arrayWithCapacity:count];
+    for (uint32_t i = 0; i < count; i++) {
+        [list addObject:@(PlatypusSnapshotGetListItem(snapshot, which, i))];
+    }
+    return list;
+}
+
+@implementation SEAppSettings
+
++ (instancetype)settingsWithSnapshotAtPath:(NSString *)path propertyListPath:(NSString *)plistPath {
+    PlatypusSnapshot snapshot;
+    if (PlatypusSnapshotLoad([path fileSystemRepresentation], &snapshot) != 0) {
+        return nil;
+    }
+    
+    const PlatypusSnapshotHeader *h = snapshot.header;
+    
+    // AppSettings.plist has been edited by hand since the app was created
+    if (!PlatypusSnapshotMatchesSource(&snapshot, [plistPath fileSystemRepresentation])) {
+        PlatypusSnapshotUnload(&snapshot);
+        return nil;
+    }
+    
+    // Let AppSettings.plist path report invalid interface types
+    if (!IsValidInterfaceType(h->interfaceType)) {
+        PlatypusSnapshotUnload(&snapshot);
+        return nil;
+    }
+    
+    SEAppSettings *settings = [[self alloc] init];
+    settings.loadedFromSnapshot = YES;
+    
+    settings.interpreterPath = SnapshotString(&snapshot, PlatypusSnapshotString_InterpreterPath);
+    settings.interpreterArgs = SnapshotList(&snapshot, PlatypusSnapshotList_InterpreterArgs);
+    settings.scriptArgs = SnapshotList(&snapshot, PlatypusSnapshotList_ScriptArgs);
+    
+    settings.interfaceType = (PlatypusInterfaceType)h->interfaceType;
+    settings.interfaceTypeName = PLATYPUS_INTERFACE_TYPE_NAMES[h->interfaceType];
+    settings.execStyle = (PlatypusExecStyle)h->execStyle;
+    
+    settings.remainRunning = (h->flags & PlatypusSnapshotFlag_RemainRunning) != 0;
+    settings.sendsNotifications = (h->flags & PlatypusSnapshotFlag_SendNotifications) != 0;
+    settings.acceptsFiles = (h->flags & PlatypusSnapshotFlag_AcceptFiles) != 0;
+    settings.acceptsText = (h->flags & PlatypusSnapshotFlag_AcceptText) != 0;
+    settings.promptForFile = (h->flags & PlatypusSnapshotFlag_PromptForFile) != 0;
+    settings.execInterpreter = (h->flags & PlatypusSnapshotFlag_ExecInterpreter) != 0;
+    settings.controlChannelOnly = (h->flags & PlatypusSnapshotFlag_ControlChannelOnly) != 0;
+    settings.largeOutputView = (h->flags & PlatypusSnapshotFlag_LargeOutputView) != 0;
+    settings.logOutput = (h->flags & PlatypusSnapshotFlag_LogOutput) != 0;
+    settings.persistentJobQueue = (h->flags & PlatypusSnapshotFlag_PersistentJobQueue) != 0;
+    settings.jobServer = (h->flags & PlatypusSnapshotFlag_JobServer) != 0;
+    settings.jobLimits = SnapshotString(&snapshot, PlatypusSnapshotString_JobLimits);
+    settings.privilegedHelper = (h->flags & PlatypusSnapshotFlag_PrivilegedHelper) != 0;
+    settings.prespawnInterpreter = (h->flags & PlatypusSnapshotFlag_PrespawnInterpreter) != 0;
+    
+    settings.textFontName = SnapshotString(&snapshot, PlatypusSnapshotString_TextFont);
+    settings.textSize = h->textSize;
+    settings.textColor = h->textColor;
+    settings.textBackgroundColor = h->textBackgroundColor;
+    
+    settings.suffixes = SnapshotList(&snapshot, PlatypusSnapshotList_Suffixes);
+    settings.uniformTypes = SnapshotList(&snapshot, PlatypusSnapshotList_Utis);
+    settings.URISchemes = SnapshotList(&snapshot, PlatypusSnapshotList_URISchemes);
+    
+    settings.statusItemDisplayType = SnapshotString(&snapshot, PlatypusSnapshotString_StatusItemDisplayType);
+    settings.statusItemTitle = SnapshotString(&snapshot, PlatypusSnapshotString_StatusItemTitle);
+    size_t iconLength;
+    const void *icon = PlatypusSnapshotGetBlob(&snapshot, PlatypusSnapshotBlob_StatusItemIcon, &iconLength);
+    if (icon) {
+        settings.statusItemIcon = [NSData dataWithBytes:icon length:iconLength];
+    }
+    settings.statusItemUsesSystemFont = (h->flags & PlatypusSnapshotFlag_StatusItemUseSysfont) != 0;
+    settings.statusItemIconIsTemplate = (h->flags & PlatypusSnapshotFlag_StatusItemIconIsTemplate) != 0;
+    
+    PlatypusSnapshotUnload(&snapshot);
+    
+    return settings;
+}
+
++ (instancetype)settingsWithPropertyListAtPath:(NSString *)path {
+    NSDictionary *plist = [NSDictionary dictionaryWithContentsOfFile:path];
+    if (plist == nil) {
+        return nil;
+    }
+    
+    SEAppSettings *settings = [[self alloc] init];
+    
+    settings.interpreterPath = plist[AppSpecKey_InterpreterPath];
+    settings.interpreterArgs = plist[AppSpecKey_InterpreterArgs];
+    settings.scriptArgs = plist[AppSpecKey_ScriptArgs];
+    
+    settings.interfaceTypeName = plist[AppSpecKey_InterfaceType];
+    if (IsValidInterfaceTypeString(settings.interfaceTypeName)) {
+        settings.interfaceType = InterfaceTypeForString(settings.interfaceTypeName);
+    }
+    settings.execStyle = (PlatypusExecStyle)[plist[AppSpecKey_Authenticate] intValue];
+    
+    settings.remainRunning = [plist[AppSpecKey_RemainRunning] boolValue];
+    settings.sendsNotifications = [plist[AppSpecKey_SendNotifications] boolValue];
+    settings.acceptsFiles = [plist[AppSpecKey_AcceptFiles] boolValue];
+    settings.acceptsText = [plist[AppSpecKey_AcceptText] boolValue];
+    settings.promptForFile = [plist[AppSpecKey_PromptForFile] boolValue];
+    settings.execInterpreter = [plist[AppSpecKey_ExecInterpreter] boolValue];
+    settings.controlChannelOnly = [plist[AppSpecKey_ControlChannelOnly] boolValue];
+    settings.largeOutputView = [plist[AppSpecKey_LargeOutputView] boolValue];
+    settings.logOutput = [plist[AppSpecKey_LogOutput] boolValue];
+    settings.persistentJobQueue = [plist[AppSpecKey_PersistentJobQueue] boolValue];
+    settings.jobServer = [plist[AppSpecKey_JobServer] boolValue];
+    settings.jobLimits = plist[AppSpecKey_JobLimits];
+    settings.privilegedHelper = [plist[AppSpecKey_PrivilegedHelper] boolValue];
+    settings.prespawnInterpreter = [plist[AppSpecKey_PrespawnInterpreter] boolValue];
+    
+    settings.textFontName = plist[AppSpecKey_TextFont];
+    settings.textSize = [plist[AppSpecKey_TextSize] floatValue];
+    NSString *fg = plist[AppSpecKey_TextColor] ? plist[AppSpecKey_TextColor] : DEFAULT_TEXT_FG_COLOR;
+    NSString *bg = plist[AppSpecKey_TextBackgroundColor] ? plist[AppSpecKey_TextBackgroundColor] : DEFAULT_TEXT_BG_COLOR;
+    settings.textColor = PlatypusSnapshotRGBFromHexString([fg UTF8String]);
+    settings.textBackgroundColor = PlatypusSnapshotRGBFromHexString([bg UTF8String]);
+    
+    settings.suffixes = plist[AppSpecKey_Suffixes] ? plist[AppSpecKey_Suffixes] : @[];
+    settings.uniformTypes = plist[AppSpecKey_Utis] ? plist[AppSpecKey_Utis] : @[];
+    settings.URISchemes = plist[AppSpecKey_URISchemes] ? plist[AppSpecKey_URISchemes] : @[];
+    
+    settings.statusItemDisplayType = plist[AppSpecKey_StatusItemDisplayType];
+    settings.statusItemTitle = plist[AppSpecKey_StatusItemTitle];
+    settings.statusItemIcon = plist[AppSpecKey_StatusItemIcon];
+    settings.statusItemUsesSystemFont = [plist[AppSpecKey_StatusItemUseSysfont] boolValue];
+    settings.statusItemIconIsTemplate = [plist[AppSpecKey_StatusItemIconIsTemplate] boolValue];
+    
+    return settings;
+}
+
+@end
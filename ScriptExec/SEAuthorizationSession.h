@@ -0,0 +1,62 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Authorization for running privileged jobs, kept for a while so that
+// consecutive jobs, e.g. for a batch of dropped files, don't each prompt
+// for an administrator password and round-trip through the security server.
+// Rights are obtained once, and the same AuthorizationRef passed to
+// -[STPrivilegedTask launchWithAuthorization:] for every job until the
+// session expires or is revoked. Revoking destroys the rights, so they
+// don't linger in the user's security session either.
+
+#import <Foundation/Foundation.h>
+#import <Security/Authorization.h>
+
+@interface SEAuthorizationSession : NSObject
+
+// Seconds from when rights are obtained until the session expires.
+// With 0, every job is authorized on its own.
+@property (nonatomic, readonly) NSTimeInterval lifetime;
+@property (nonatomic, readonly) BOOL isAuthorized;
+// Called whenever rights are revoked, e.g. once the session has expired
+@property (nonatomic, copy) void (^revocationHandler)(void);
+
+- (instancetype)initWithLifetime:(NSTimeInterval)lifetime;
+
+// Returns an authorization with the right to execute the tool, prompting
+// for it if the session has none, or NULL with the error in *status. Valid
+// until the session is revoked, which may happen as soon as the job has
+// been launched.
+- (AuthorizationRef)authorizationToExecute:(NSString *)toolPath status:(OSStatus *)status;
+// Call once the job has been launched with the authorization, or failed to
+- (void)authorizationUsedWithStatus:(OSStatus)status;
+- (void)revoke;
+
+@end
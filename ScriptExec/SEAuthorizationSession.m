@@ -0,0 +1,131 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#import <Security/AuthorizationTags.h>
+
+#import "Common.h"
+#import "SEAuthorizationSession.h"
+
+@interface SEAuthorizationSession()
+{
+    AuthorizationRef authorization;
+    NSString *authorizedToolPath;
+    NSDate *expirationDate;
+}
+@end
+
+@implementation SEAuthorizationSession
+
+- (instancetype)initWithLifetime:(NSTimeInterval)lifetime {
+    self = [super init];
+    if (self) {
+        _lifetime = MAX(lifetime, 0);
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [self revoke];
+}
+
+- (BOOL)isAuthorized {
+    return authorization != NULL;
+}
+
+- (AuthorizationRef)authorizationToExecute:(NSString *)toolPath status:(OSStatus *)status {
+    if (authorization && ([expirationDate timeIntervalSinceNow] <= 0 || ![toolPath isEqualToString:authorizedToolPath])) {
+        [self revoke];
+    }
+    if (authorization) {
+        *status = errAuthorizationSuccess;
+        return authorization;
+    }
+    
+    AuthorizationRef ref;
+    OSStatus err = AuthorizationCreate(NULL, kAuthorizationEmptyEnvironment, kAuthorizationFlagDefaults, &ref);
+    if (err != errAuthorizationSuccess) {
+        *status = err;
+        return NULL;
+    }
+    
+    const char *path = [toolPath fileSystemRepresentation];
+    AuthorizationItem item = { kAuthorizationRightExecute, strlen(path), (void *)path, 0 };
+    AuthorizationRights rights = { 1, &item };
+    AuthorizationFlags flags = kAuthorizationFlagDefaults | kAuthorizationFlagInteractionAllowed |
+                               kAuthorizationFlagPreAuthorize | kAuthorizationFlagExtendRights;
+    err = AuthorizationCopyRights(ref, &rights, kAuthorizationEmptyEnvironment, flags, NULL);
+    if (err != errAuthorizationSuccess) {
+        AuthorizationFree(ref, kAuthorizationFlagDefaults);
+        *status = err;
+        return NULL;
+    }
+    
+    authorization = ref;
+    authorizedToolPath = [toolPath copy];
+    expirationDate = [NSDate dateWithTimeIntervalSinceNow:_lifetime];
+    // Rights shouldn't outlive the session just because no more jobs come along
+    if (_lifetime > 0) {
+        [self performSelector:@selector(revokeIfExpired) withObject:nil afterDelay:_lifetime];
+    }
+    *status = errAuthorizationSuccess;
+    return authorization;
+}
+
+- (void)authorizationUsedWithStatus:(OSStatus)status {
+    // Authorization that failed to launch a job is never tried again
+    if (status != errAuthorizationSuccess) {
+        [self revoke];
+    } else {
+        [self revokeIfExpired];
+    }
+}
+
+- (void)revokeIfExpired {
+    if (authorization && [expirationDate timeIntervalSinceNow] <= 0) {
+        DLog(@"Authorization session expired");
+        [self revoke];
+    }
+}
+
+- (void)revoke {
+    [NSObject cancelPreviousPerformRequestsWithTarget:self selector:@selector(revokeIfExpired) object:nil];
+    BOOL wasAuthorized = (authorization != NULL);
+    if (authorization) {
+        AuthorizationFree(authorization, kAuthorizationFlagDestroyRights);
+        authorization = NULL;
+    }
+    authorizedToolPath = nil;
+    expirationDate = nil;
+    if (wasAuthorized && _revocationHandler) {
+        _revocationHandler();
+    }
+}
+
+@end
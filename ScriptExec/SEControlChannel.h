@@ -0,0 +1,83 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Out-of-band control channel for scripts.
+//
+// A named pipe is created in a private temporary directory and its path is
+// exported to the script in the PLATYPUS_CONTROL environment variable, so a
+// shell script can do
+//
+//     exec 3>"$PLATYPUS_CONTROL"
+//     echo '{"command": "progress", "value": 50}' >&3
+//
+// and keep its standard output for data only. Each line written to the pipe
+// is one command, either a JSON object or a line in the in-band syntax also
+// recognised in script output (e.g. PROGRESS:50). Commands are delivered as
+// dictionaries with a "command" key and command-specific arguments:
+//
+//     quit, refresh
+//     alert, notification     title, text
+//     progress                value (number)
+//     details                 visible (boolean)
+//     location                url
+//     cancel                  arguments (array), input (optional)
+//
+// Lines up to PIPE_BUF bytes are written atomically, so several writers
+// can share the channel. Ordering relative to standard output isn't
+// guaranteed, since they are separate pipes.
+
+#import <Foundation/Foundation.h>
+#import "SEOutputCommands.h"
+
+#define SE_CONTROL_CHANNEL_ENV_VAR "PLATYPUS_CONTROL"
+
+typedef void (^SEControlCommandHandler)(NSDictionary *command);
+
+@interface SEControlChannel : NSObject
+
+@property (nonatomic, readonly, copy) NSString *path;
+@property (nonatomic, readonly) int fileDescriptor;
+
+// Creates the named pipe and opens it for reading. Returns nil on failure.
++ (instancetype)channel;
+
+// Reads all commands currently available, without blocking
+- (void)readCommandsWithHandler:(SEControlCommandHandler)handler;
+// Calls handler on the main queue as commands arrive
+- (void)startMonitoringWithHandler:(SEControlCommandHandler)handler;
+// Sets PLATYPUS_CONTROL for this process, and thus for the scripts it runs
+- (void)exportToEnvironment;
+// Stops monitoring, closes and deletes the named pipe
+- (void)close;
+
+@end
+
+// Converts a command parsed from script output. Returns nil for regular output.
+NSDictionary *SEControlCommandFromOutputCommand(const SEOutputCommand *command);
@@ -0,0 +1,260 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#import <fcntl.h>
+#import <sys/stat.h>
+#import <unistd.h>
+
+#import "Common.h"
+#import "SEControlChannel.h"
+
+@interface SEControlChannel()
+{
+    int readFd;
+    int keepAliveFd;
+    NSString *directory;
+    NSMutableData *pending;
+    dispatch_source_t source;
+}
+@end
+
+@implementation SEControlChannel
+
++ (instancetype)channel {
+    SEControlChannel *channel = [[self alloc] init];
+    return [channel open] ? channel : nil;
+}
+
+- (instancetype)init {
+    self = [super init];
+    if (self) {
+        readFd = -1;
+        keepAliveFd = -1;
+        pending = [NSMutableData data];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [self close];
+}
+
+- (BOOL)open {
+    NSString *template = [NSTemporaryDirectory() stringByAppendingPathComponent:@"PlatypusControl.XXXXXX"];
+    char *dir = strdup([template fileSystemRepresentation]);
+    if (dir == NULL || mkdtemp(dir) == NULL) {
+        free(dir);
+        return NO;
+    }
+    directory = [FILEMGR stringWithFileSystemRepresentation:dir length:strlen(dir)];
+    free(dir);
+    
+    _path = [directory stringByAppendingPathComponent:@"control"];
+    if (mkfifo([_path fileSystemRepresentation], S_IRUSR | S_IWUSR) != 0) {
+        [self close];
+        return NO;
+    }
+    
+    // Non-blocking, so opening doesn't wait for a writer. We also keep the pipe
+    // open for writing ourselves, so reads don't hit EOF whenever the last
+    // writer closes it, e.g. between two echo commands in a shell script.
+    readFd = open([_path fileSystemRepresentation], O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (readFd != -1) {
+        keepAliveFd = open([_path fileSystemRepresentation], O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+    }
+    if (readFd == -1 || keepAliveFd == -1) {
+        [self close];
+        return NO;
+    }
+    
+    return YES;
+}
+
+- (int)fileDescriptor {
+    return readFd;
+}
+
+- (void)exportToEnvironment {
+    setenv(SE_CONTROL_CHANNEL_ENV_VAR, [_path fileSystemRepresentation], 1);
+}
+
+- (void)close {
+    if (source) {
+        dispatch_source_cancel(source);
+        source = nil;
+    }
+    if (readFd != -1) {
+        close(readFd);
+        readFd = -1;
+    }
+    if (keepAliveFd != -1) {
+        close(keepAliveFd);
+        keepAliveFd = -1;
+    }
+    if (_path) {
+        unlink([_path fileSystemRepresentation]);
+        const char *env = getenv(SE_CONTROL_CHANNEL_ENV_VAR);
+        if (env && strcmp(env, [_path fileSystemRepresentation]) == 0) {
+            unsetenv(SE_CONTROL_CHANNEL_ENV_VAR);
+        }
+    }
+    if (directory) {
+        rmdir([directory fileSystemRepresentation]);
+        directory = nil;
+    }
+}
+
+#pragma mark - Reading
+
+- (void)startMonitoringWithHandler:(SEControlCommandHandler)handler {
+    if (readFd == -1 || source) {
+        return;
+    }
+    source = dispatch_source_create(DISPATCH_SOURCE_TYPE_READ, readFd, 0, dispatch_get_main_queue());
+    __weak SEControlChannel *weakSelf = self;
+    dispatch_source_set_event_handler(source, ^{
+        [weakSelf readCommandsWithHandler:handler];
+    });
+    dispatch_resume(source);
+}
+
+- (void)readCommandsWithHandler:(SEControlCommandHandler)handler {
+    if (readFd == -1) {
+        return;
+    }
+    
+    char buf[4096];
+    ssize_t n;
+    while ((n = read(readFd, buf, sizeof(buf))) != 0) {
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break; // EAGAIN, nothing more to read for now
+        }
+        [pending appendBytes:buf length:n];
+    }
+    
+    const char *bytes = [pending bytes];
+    size_t len = [pending length];
+    size_t start = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (bytes[i] != '\n') {
+            continue;
+        }
+        size_t lineLen = i - start;
+        if (lineLen && bytes[start + lineLen - 1] == '\r') {
+            lineLen--;
+        }
+        NSDictionary *command = [self commandFromBytes:bytes + start length:lineLen];
+        start = i + 1;
+        if (command) {
+            handler(command);
+        }
+    }
+    [pending replaceBytesInRange:NSMakeRange(0, start) withBytes:NULL length:0];
+    
+    // Discard runaway input that never ends a line
+    if ([pending length] > 65536) {
+        [pending setLength:0];
+    }
+}
+
+- (NSDictionary *)commandFromBytes:(const char *)bytes length:(size_t)len {
+    size_t i = 0;
+    while (i < len && (bytes[i] == ' ' || bytes[i] == '\t')) {
+        i++;
+    }
+    if (i == len) {
+        return nil;
+    }
+    
+    if (bytes[i] == '{') {
+        NSData *json = [NSData dataWithBytesNoCopy:(void *)(bytes + i) length:len - i freeWhenDone:NO];
+        id obj = [NSJSONSerialization JSONObjectWithData:json options:0 error:nil];
+        if ([obj isKindOfClass:[NSDictionary class]] && [obj[@"command"] isKindOfClass:[NSString class]]) {
+            return obj;
+        }
+        DLog(@"Invalid control command: %@", [[NSString alloc] initWithData:json encoding:NSUTF8StringEncoding]);
+        return nil;
+    }
+    
+    SEOutputCommand command;
+    SEOutputCommandParse(bytes, len, &command);
+    return SEControlCommandFromOutputCommand(&command);
+}
+
+@end
+
+#pragma mark - In-band syntax
+
+static NSString *ArgumentString(const SEOutputCommand *command) {
+    NSString *str = [[NSString alloc] initWithBytes:command->argument
+                                             length:command->argumentLength
+                                           encoding:DEFAULT_TEXT_ENCODING];
+    return str ? str : @"";
+}
+
+static NSDictionary *TitleAndTextCommand(NSString *name, const SEOutputCommand *command, NSString *separator) {
+    NSArray *components = [ArgumentString(command) componentsSeparatedByString:separator];
+    NSString *title = components[0];
+    NSString *text = ([components count] >= 2) ? components[1] : title;
+    return @{ @"command": name, @"title": title, @"text": text };
+}
+
+NSDictionary *SEControlCommandFromOutputCommand(const SEOutputCommand *command) {
+    switch (command->type) {
+        case SEOutputCommand_None:
+            return nil;
+        case SEOutputCommand_Quit:
+            return @{ @"command": @"quit" };
+        case SEOutputCommand_Refresh:
+            return @{ @"command": @"refresh" };
+        case SEOutputCommand_Notification:
+            return TitleAndTextCommand(@"notification", command, @"|");
+        case SEOutputCommand_Alert:
+            return TitleAndTextCommand(@"alert", command, CMDLINE_ARG_SEPARATOR);
+        case SEOutputCommand_Progress:
+            if (command->hasProgress) {
+                return @{ @"command": @"progress", @"value": @(command->progress) };
+            }
+            return @{ @"command": @"progress" };
+        case SEOutputCommand_DetailsShow:
+            return @{ @"command": @"details", @"visible": @YES };
+        case SEOutputCommand_DetailsHide:
+            return @{ @"command": @"details", @"visible": @NO };
+        case SEOutputCommand_Location:
+        {
+            NSString *urlString = [ArgumentString(command) stringByReplacingOccurrencesOfString:@" " withString:@""];
+            return @{ @"command": @"location", @"url": urlString };
+        }
+    }
+    return nil;
+}
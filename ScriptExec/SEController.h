@@ -33,6 +33,7 @@
 
 #import <Cocoa/Cocoa.h>
 #import "STDragWebView.h"
+#import "SEOutputLog.h"
 
 @interface SEController : NSObject <NSApplicationDelegate,
                                     NSMenuDelegate,
@@ -40,4 +41,7 @@
                                     NSUserNotificationCenterDelegate,
                                     STDragWebViewDelegate>
 
++ (NSArray *)commandLineArguments;
++ (SEOutputLog *)openOutputLogForAppName:(NSString *)name;
+
 @end
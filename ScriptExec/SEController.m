@@ -32,8 +32,11 @@
  bundled into Platypus-generated applications */
 
 #import <Security/Authorization.h>
+#ifndef SE_WITHOUT_WEBKIT
 #import <WebKit/WebKit.h>
+#endif
 #import <sys/stat.h>
+#import <signal.h>
 
 #import "Common.h"
 #import "SEController.h"
@@ -43,10 +46,26 @@
 #import "STDragWebView.h"
 #import "Alerts.h"
 #import "SEJob.h"
-
-#ifdef DEBUG
-    #import "NSTask+Description.h"
-#endif
+#import "SEJobQueue.h"
+#import "SEAppSettings.h"
+#import "SEControlChannel.h"
+#import "SEOutputView.h"
+#import "SEANSIParser.h"
+#import "SEMetrics.h"
+#import "SEJobJournal.h"
+#import "SEJobServer.h"
+#import "SEJobTask.h"
+#import "SEInterpreterPool.h"
+#import "SEProcessTree.h"
+#import "SEAuthorizationSession.h"
+#import "SEPrivilegedHelperConnection.h"
+#import "SEVariant.h"
+#import "PlatypusJobProtocol.h"
+#import "PlatypusSpawn.h"
+#import "PlatypusJobLimits.h"
+
+// Constant in ScriptExec variants built for a single interface type
+#define INTERFACE_TYPE  SEVariantInterfaceType(interfaceType)
 
 @interface SEController()
 {
@@ -69,7 +88,7 @@
     // Web View
     IBOutlet NSWindow *webViewWindow;
     IBOutlet NSButton *webViewCancelButton;
-    IBOutlet WebView *webView;
+    IBOutlet STDragWebView *webView;
     IBOutlet NSProgressIndicator *webViewProgressIndicator;
     IBOutlet NSTextField *webViewMessageTextField;
     
@@ -95,14 +114,15 @@
     IBOutlet NSMenu *viewMenu;
     
     NSTextView *outputTextView;
+    SEOutputView *outputView;
     
-    NSTask *task;
+    SEJobTask *task;
     STPrivilegedTask *privilegedTask;
         
-    NSPipe *inputPipe;
     NSFileHandle *inputWriteFileHandle;
-    NSPipe *outputPipe;
     NSFileHandle *outputReadFileHandle;
+    SEControlChannel *controlChannel;
+    SEOutputLog *outputLog;
     
     NSMutableArray <NSString *> *arguments;
     NSArray <NSString *> *commandLineArguments;
@@ -130,6 +150,10 @@
     BOOL runInBackground;
     BOOL isService;
     BOOL sendsNotifications;
+    BOOL controlChannelOnly;
+    BOOL largeOutputView;
+    BOOL persistentJobQueue;
+    BOOL jobServerEnabled;
     
     NSArray <NSString *> *droppableSuffixes;
     NSArray <NSString *> *droppableUniformTypes;
@@ -145,14 +169,55 @@
     BOOL hasFinishedLaunching;
     
     NSString *scriptText;
-    NSString *remnants;
-    
-    NSMutableArray <SEJob *> *jobQueue;
+    NSMutableData *pendingOutput;
+    NSURL *locationURL;
+    
+    double pendingProgress;
+    BOOL progressUpdateScheduled;
+    
+    SEANSIParser ansiParser;
+    SEANSIOutput ansiOutput;
+    NSMutableDictionary <NSData *, NSDictionary *> *ansiAttributes;
+    BOOL hasStyledOutput;
+    
+    SEJobQueue *jobQueue;
+    SEJob *currentJob;
+    SEMetrics *metrics;
+    SEJobJournal *jobJournal;
+    BOOL jobJournalSyncScheduled;
+    SEJobServer *jobServer;
+    SEInterpreterPool *interpreterPool;
+    BOOL launchFailureReported;
+    PlatypusJobLimits jobLimits;
+    SEProcessTree terminatingProcesses;
+    SEAuthorizationSession *authorizationSession;
+    BOOL usesPrivilegedHelper;
+    SEPrivilegedHelperConnection *privilegedHelper;
 }
 @end
 
 static const NSInteger detailsHeight = 224;
 
+// Seconds privileged jobs are run without asking for authorization again
+static const NSTimeInterval defaultAuthorizationLifetime = 300;
+
+// Control command arguments received as JSON may be of any type
+static NSString *CommandArgument(NSDictionary *command, NSString *key) {
+    id value = command[key];
+    return value ? [value description] : @"";
+}
+
+// Colors from ANSI escape sequences
+static NSColor *ColorForANSIColor(const SEANSIColor *color) {
+    uint8_t red = color->red;
+    uint8_t green = color->green;
+    uint8_t blue = color->blue;
+    if (color->type == SEANSIColor_Indexed) {
+        SEANSIPaletteColor(color->index, &red, &green, &blue);
+    }
+    return [NSColor colorWithSRGBRed:red / 255.0 green:green / 255.0 blue:blue / 255.0 alpha:1.0];
+}
+
 @implementation SEController
 
 - (instancetype)init {
@@ -160,15 +225,36 @@ static const NSInteger detailsHeight = 224;
     if (self) {
         arguments = [NSMutableArray array];
         outputEmpty = YES;
-        jobQueue = [NSMutableArray array];
+        jobQueue = [[SEJobQueue alloc] init];
+        metrics = SEMetricsCreate();
+        SEANSIParserInit(&ansiParser);
+        SEANSIOutputInit(&ansiOutput);
+        ansiAttributes = [NSMutableDictionary dictionary];
+        SEProcessTreeInit(&terminatingProcesses);
     }
     return self;
 }
 
+- (void)dealloc {
+    SEANSIOutputFree(&ansiOutput);
+    SEMetricsFree(metrics);
+    SEProcessTreeFree(&terminatingProcesses);
+}
+
 - (void)awakeFromNib {
-    // Load settings from AppSettings.plist in app bundle
+    // Load settings from app bundle
     [self loadAppSettings];
     
+    // Queue jobs left over from last time the app ran
+    if (persistentJobQueue) {
+        [self openJobJournal];
+    }
+    
+    // Accept jobs from platypus_submit and other clients
+    if (jobServerEnabled) {
+        [self startJobServer];
+    }
+    
     // Prepare UI
     [self initialiseInterface];
     
@@ -180,7 +266,7 @@ static const NSInteger detailsHeight = 224;
     
     
     // Listen for terminate notification
-    NSString *notificationName = NSTaskDidTerminateNotification;
+    NSString *notificationName = SEJobTaskDidTerminateNotification;
     if (execStyle == PlatypusExecStyle_Authenticated) {
         notificationName = STPrivilegedTaskDidTerminateNotification;
     }
@@ -206,11 +292,23 @@ static const NSInteger detailsHeight = 224;
     if (sendsNotifications) {
         [[NSUserNotificationCenter defaultUserNotificationCenter] setDelegate:self];
     }
+    
+    // Control channel is exported via environment, so all script runs inherit it
+    controlChannel = [SEControlChannel channel];
+    if (controlChannel) {
+        [controlChannel exportToEnvironment];
+        __weak SEController *weakSelf = self;
+        [controlChannel startMonitoringWithHandler:^(NSDictionary *command) {
+            [weakSelf controlChannelCommandReceived:command];
+        }];
+    } else {
+        DLog(@"Unable to create control channel");
+    }
 }
 
 #pragma mark - App Settings
 
-// Load configuration from AppSettings.plist and Info.plist, sanitize values, etc.
+// Load configuration from AppSettings.bin/.plist and Info.plist, sanitize values, etc.
 - (void)loadAppSettings {
     // Application bundle
     NSBundle *bundle = [NSBundle mainBundle];
@@ -227,51 +325,44 @@ static const NSInteger detailsHeight = 224;
     runInBackground = [infoPlist[@"LSUIElement"] boolValue];
     isService = (infoPlist[@"NSServices"] != nil);
     
-    // Check if script file exists
-    scriptPath = [bundle pathForResource:@"script" ofType:nil];
-    if ([FILEMGR fileExistsAtPath:scriptPath] == NO) {
-        [Alerts fatalAlert:@"Corrupt app bundle"
-                   subText:@"Script missing from application bundle."];
-    }
+    NSString *resourcePath = [bundle resourcePath];
     
-    // Make sure script is executable (and make it so if not)
-//    if ([FILEMGR isExecutableFileAtPath:scriptPath] == NO) {
-    //    NSNumber *permissions = [NSNumber numberWithUnsignedLong:493];
-    //    NSDictionary *attributes = @{ NSFilePosixPermissions:permissions };
-    //    [FILEMGR setAttributes:attributes ofItemAtPath:scriptPath error:nil];
-
-//        [Alerts fatalAlert:@"Corrupt app bundle"
-//                   subText:@"Script file is not executable."];
-//    }
-
-    // Make sure script is a readable fiile
-    if ([FILEMGR isReadableFileAtPath:scriptPath] == NO) {
-        [Alerts fatalAlert:@"Corrupt app bundle"
-                   subText:@"Script file is not readable."];
-    }
-    
-    // Make sure there's an AppSettings.plist file
-    NSString *appSettingsPath = [bundle pathForResource:@"AppSettings.plist" ofType:nil];
-    if (![FILEMGR fileExistsAtPath:appSettingsPath]) {
+    // Check if script file exists and is readable. One access() call
+    // covers both, errno tells us which check failed.
+    scriptPath = [resourcePath stringByAppendingPathComponent:@"script"];
+    if (access([scriptPath fileSystemRepresentation], R_OK) != 0) {
         [Alerts fatalAlert:@"Corrupt app bundle"
-                   subText:@"AppSettings.plist not found in application bundle."];
+                   subText:(errno == ENOENT) ? @"Script missing from application bundle." : @"Script file is not readable."];
     }
     
-    // Load settings from property list
-    NSDictionary *appSettings = [NSDictionary dictionaryWithContentsOfFile:appSettingsPath];
+    // Load settings from the precompiled snapshot if there is one and it is
+    // up to date. Apps created by older versions of Platypus only have
+    // AppSettings.plist, and users may have edited it by hand.
+    NSString *appSettingsPath = [resourcePath stringByAppendingPathComponent:@"AppSettings.plist"];
+    NSString *snapshotPath = [resourcePath stringByAppendingPathComponent:APP_SETTINGS_SNAPSHOT_NAME];
+    SEAppSettings *appSettings = [SEAppSettings settingsWithSnapshotAtPath:snapshotPath propertyListPath:appSettingsPath];
     if (appSettings == nil) {
-        [Alerts fatalAlert:@"Corrupt app settings"
-                   subText:@"Unable to read AppSettings.plist."];
+        // Make sure there's an AppSettings.plist file
+        if (![FILEMGR fileExistsAtPath:appSettingsPath]) {
+            [Alerts fatalAlert:@"Corrupt app bundle"
+                       subText:@"AppSettings.plist not found in application bundle."];
+        }
+        
+        // Load settings from property list
+        appSettings = [SEAppSettings settingsWithPropertyListAtPath:appSettingsPath];
+        if (appSettings == nil) {
+            [Alerts fatalAlert:@"Corrupt app settings"
+                       subText:@"Unable to read AppSettings.plist."];
+        }
     }
     
     // Validate interpreter specified in settings
-    interpreterPath = appSettings[AppSpecKey_InterpreterPath];
+    interpreterPath = appSettings.interpreterPath;
     if ([FILEMGR fileExistsAtPath:interpreterPath] == NO) {
         BOOL ok = FALSE;
         // See if it's a relative path that exists within app bundle
         if (![interpreterPath hasPrefix:@"/"]) {
-            NSString *rsrcPath = [[NSBundle mainBundle] resourcePath];
-            NSString *absPath = [rsrcPath stringByAppendingPathComponent:interpreterPath];
+            NSString *absPath = [resourcePath stringByAppendingPathComponent:interpreterPath];
             if ([FILEMGR fileExistsAtPath:absPath]) {
                 interpreterPath = absPath;
                 ok = TRUE;
@@ -284,23 +375,28 @@ static const NSInteger detailsHeight = 224;
     }
     
     // Determine interface type
-    NSString *interfaceTypeStr = appSettings[AppSpecKey_InterfaceType];
-    if (IsValidInterfaceTypeString(interfaceTypeStr) == NO) {
+    if (IsValidInterfaceTypeString(appSettings.interfaceTypeName) == NO) {
         [Alerts fatalAlert:@"Corrupt app settings"
-             subTextFormat:@"Invalid Interface Type: '%@'.", interfaceTypeStr];
+             subTextFormat:@"Invalid Interface Type: '%@'.", appSettings.interfaceTypeName];
     }
-    interfaceType = InterfaceTypeForString(interfaceTypeStr);
+    interfaceType = appSettings.interfaceType;
+#ifdef SE_INTERFACE_TYPE
+    if (interfaceType != SE_INTERFACE_TYPE) {
+        [Alerts fatalAlert:@"Corrupt app settings"
+             subTextFormat:@"This app's executable can't run Interface Type '%@'.", appSettings.interfaceTypeName];
+    }
+#endif
     
     // Text styling - we ignore those values unless output mode has a text view
-    if (IsTextStyledInterfaceType(interfaceType)) {
+    if (IsTextStyledInterfaceType(INTERFACE_TYPE)) {
         
         // Font and size
         NSNumber *userFontSizeNum = [DEFAULTS objectForKey:ScriptExecDefaultsKey_UserFontSize];
-        CGFloat fontSize = userFontSizeNum ? [userFontSizeNum floatValue] : [appSettings[AppSpecKey_TextSize] floatValue];
+        CGFloat fontSize = userFontSizeNum ? [userFontSizeNum floatValue] : appSettings.textSize;
         fontSize = fontSize != 0 ? fontSize : DEFAULT_TEXT_FONT_SIZE;
         
-        if (appSettings[AppSpecKey_TextFont]) {
-            textFont = [NSFont fontWithName:appSettings[AppSpecKey_TextFont] size:fontSize];
+        if (appSettings.textFontName) {
+            textFont = [NSFont fontWithName:appSettings.textFontName size:fontSize];
         }
         if (textFont == nil) {
             textFont = [NSFont fontWithName:DEFAULT_TEXT_FONT_NAME size:DEFAULT_TEXT_FONT_SIZE];
@@ -310,41 +406,32 @@ static const NSInteger detailsHeight = 224;
         if (@available(macOS 10.14, *)) {
             darkMode = ([[[NSAppearance currentAppearance] name] isEqualToString:NSAppearanceNameDarkAqua]);
         }
-            // Foreground color
-        if (appSettings[AppSpecKey_TextColor]) {
-            textForegroundColor = [NSColor colorFromHexString:appSettings[AppSpecKey_TextColor]];
-        }
-        if (textForegroundColor == nil) {
-            textForegroundColor = [NSColor colorFromHexString:DEFAULT_TEXT_FG_COLOR];
-        }
+        
+        // Foreground color
+        textForegroundColor = [NSColor colorFromRGBValue:appSettings.textColor];
         if (darkMode) {
             textForegroundColor = [textForegroundColor inverted];
         }
         
         // Background color
-        if (appSettings[AppSpecKey_TextBackgroundColor]) {
-            textBackgroundColor = [NSColor colorFromHexString:appSettings[AppSpecKey_TextBackgroundColor]];
-        }
-        if (textBackgroundColor == nil) {
-            textBackgroundColor = [NSColor colorFromHexString:DEFAULT_TEXT_BG_COLOR];
-        }
+        textBackgroundColor = [NSColor colorFromRGBValue:appSettings.textBackgroundColor];
         if (darkMode) {
             textBackgroundColor = [textBackgroundColor inverted];
         }
     }
     
     // Status menu interface has some additional settings
-    if (interfaceType == PlatypusInterfaceType_StatusMenu) {
-        NSString *statusItemDisplayType = appSettings[AppSpecKey_StatusItemDisplayType];
+    if (INTERFACE_TYPE == PlatypusInterfaceType_StatusMenu) {
+        NSString *statusItemDisplayType = appSettings.statusItemDisplayType;
 
         if ([statusItemDisplayType isEqualToString:PLATYPUS_STATUSITEM_DISPLAY_TYPE_TEXT]) {
-            statusItemTitle = [appSettings[AppSpecKey_StatusItemTitle] copy];
+            statusItemTitle = [appSettings.statusItemTitle copy];
             if (statusItemTitle == nil) {
                 [Alerts alert:@"Error getting title" subText:@"Failed to get Status Item title."];
             }
         }
         else if ([statusItemDisplayType isEqualToString:PLATYPUS_STATUSITEM_DISPLAY_TYPE_ICON]) {
-            statusItemImage = [[NSImage alloc] initWithData:appSettings[AppSpecKey_StatusItemIcon]];
+            statusItemImage = [[NSImage alloc] initWithData:appSettings.statusItemIcon];
             if (statusItemImage == nil) {
                 [Alerts alert:@"Error loading icon" subText:@"Failed to load Status Item icon."];
             }
@@ -355,24 +442,78 @@ static const NSInteger detailsHeight = 224;
             statusItemTitle = DEFAULT_STATUS_ITEM_TITLE;
         }
         
-        statusItemUsesSystemFont = [appSettings[AppSpecKey_StatusItemUseSysfont] boolValue];
-        statusItemIconIsTemplate = [appSettings[AppSpecKey_StatusItemIconIsTemplate] boolValue];
+        statusItemUsesSystemFont = appSettings.statusItemUsesSystemFont;
+        statusItemIconIsTemplate = appSettings.statusItemIconIsTemplate;
+    }
+    
+    interpreterArgs = appSettings.interpreterArgs;
+    scriptArgs = appSettings.scriptArgs;
+    execStyle = appSettings.execStyle;
+    remainRunning = appSettings.remainRunning;
+    sendsNotifications = appSettings.sendsNotifications;
+    controlChannelOnly = appSettings.controlChannelOnly;
+    largeOutputView = appSettings.largeOutputView;
+    persistentJobQueue = appSettings.persistentJobQueue;
+    jobServerEnabled = appSettings.jobServer;
+    if (PlatypusJobLimitsParse([appSettings.jobLimits UTF8String], &jobLimits) != 0) {
+        DLog(@"Ignoring invalid job limits '%@'", appSettings.jobLimits);
+    }
+    if (execStyle == PlatypusExecStyle_Authenticated) {
+        NSTimeInterval lifetime = defaultAuthorizationLifetime;
+        if ([DEFAULTS objectForKey:ScriptExecDefaultsKey_AuthorizationLifetime]) {
+            lifetime = [DEFAULTS doubleForKey:ScriptExecDefaultsKey_AuthorizationLifetime];
+        }
+        authorizationSession = [[SEAuthorizationSession alloc] initWithLifetime:lifetime];
+        
+        // The privileged helper doesn't outlive the authorization it was
+        // launched with, though a job it's running is let finish
+        usesPrivilegedHelper = appSettings.privilegedHelper;
+        __weak SEController *weakSelf = self;
+        [authorizationSession setRevocationHandler:^{
+            [weakSelf closePrivilegedHelperIfIdle];
+        }];
+    }
+    // Pointless if every job has resource limits, which can only be set as
+    // the interpreter starts
+    if (appSettings.prespawnInterpreter && execStyle != PlatypusExecStyle_Authenticated &&
+        interfaceType != PlatypusInterfaceType_StatusMenu && !PlatypusJobLimitsAnyResource(&jobLimits)) {
+        interpreterPool = [[SEInterpreterPool alloc] initWithInterpreterPath:interpreterPath
+                                                                   arguments:interpreterArgs
+                                                            currentDirectory:[[NSBundle mainBundle] resourcePath]];
+        if (interpreterPool == nil) {
+            DLog(@"Interpreter %@ can't be started ahead of time", interpreterPath);
+        } else if ([DEFAULTS objectForKey:ScriptExecDefaultsKey_SpareInterpreters]) {
+            [interpreterPool setMaximumSpareCount:[DEFAULTS integerForKey:ScriptExecDefaultsKey_SpareInterpreters]];
+        }
+    }
+    if (appSettings.logOutput) {
+        outputLog = [SEController openOutputLogForAppName:appName];
+    }
+    
+    // Job metrics are always collected, but only exported if configured
+    NSString *metricsFile = [DEFAULTS stringForKey:ScriptExecDefaultsKey_MetricsFile];
+    if (metricsFile) {
+        int err = SEMetricsOpenJSONLinesFile(metrics, [[metricsFile stringByExpandingTildeInPath] fileSystemRepresentation]);
+        if (err) {
+            DLog(@"Unable to open metrics file %@: %s", metricsFile, strerror(err));
+        }
+    }
+    NSString *metricsSocket = [DEFAULTS stringForKey:ScriptExecDefaultsKey_MetricsSocket];
+    if (metricsSocket) {
+        int err = SEMetricsStartServer(metrics, [[metricsSocket stringByExpandingTildeInPath] fileSystemRepresentation]);
+        if (err) {
+            DLog(@"Unable to serve metrics on %@: %s", metricsSocket, strerror(err));
+        }
     }
-    
-    interpreterArgs = [appSettings[AppSpecKey_InterpreterArgs] copy];
-    scriptArgs = [appSettings[AppSpecKey_ScriptArgs] copy];
-    execStyle = (PlatypusExecStyle)[appSettings[AppSpecKey_Authenticate] intValue];
-    remainRunning = [appSettings[AppSpecKey_RemainRunning] boolValue];
-    sendsNotifications = [appSettings[AppSpecKey_SendNotifications] boolValue];
     isDroppable = NO;
-    promptForFileOnLaunch = [appSettings[AppSpecKey_PromptForFile] boolValue];
+    promptForFileOnLaunch = appSettings.promptForFile;
     
     // Read and store command line arguments to the ScriptExec application binary
-    commandLineArguments = [self readCommandLineArguments];
+    commandLineArguments = [SEController commandLineArguments];
     
     // Load settings for drop acceptance
-    acceptsFiles = appSettings[AppSpecKey_AcceptFiles] ? [appSettings[AppSpecKey_AcceptFiles] boolValue] : NO;
-    acceptsText = appSettings[AppSpecKey_AcceptText] ? [appSettings[AppSpecKey_AcceptText] boolValue] : NO;
+    acceptsFiles = appSettings.acceptsFiles;
+    acceptsText = appSettings.acceptsText;
     
     if (acceptsFiles || acceptsText) {
         isDroppable = TRUE;
@@ -381,19 +522,12 @@ static const NSInteger detailsHeight = 224;
     acceptAnyDroppedItem = NO;
     acceptDroppedFolders = NO;
 
-    // If app is droppable, the AppSettings.plist contains list of accepted file types / suffixes
+    // If app is droppable, the app settings contain list of accepted file types / suffixes
     // We use them later as a criterion for drop acceptance
     if (acceptsFiles) {
-        // Get list of accepted suffixes
-        droppableSuffixes = [NSArray array];
-        droppableUniformTypes = [NSArray array];
+        droppableSuffixes = appSettings.suffixes;
+        droppableUniformTypes = appSettings.uniformTypes;
 
-        if (appSettings[AppSpecKey_Suffixes]) {
-            droppableSuffixes = [appSettings[AppSpecKey_Suffixes] copy];
-        }
-        if (appSettings[AppSpecKey_Utis]) {
-            droppableUniformTypes = [appSettings[AppSpecKey_Utis] copy];
-        }
         if ([droppableSuffixes containsObject:@"*"] || [droppableUniformTypes containsObject:@"public.data"]) {
             acceptAnyDroppedItem = YES;
         }
@@ -403,15 +537,53 @@ static const NSInteger detailsHeight = 224;
     }
     
     // We never have privileged execution or droppable with status menu apps
-    if (interfaceType == PlatypusInterfaceType_StatusMenu) {
+    if (INTERFACE_TYPE == PlatypusInterfaceType_StatusMenu) {
         remainRunning = YES;
         execStyle = PlatypusExecStyle_Normal;
         isDroppable = NO;
     }
 }
 
+// Open the log that script output is appended to, if the app logs output.
+// Rotation can be tuned via user defaults.
++ (SEOutputLog *)openOutputLogForAppName:(NSString *)name {
+    NSString *logDir = [[NSHomeDirectory() stringByAppendingPathComponent:@"Library/Logs"] stringByAppendingPathComponent:name];
+    if (![FILEMGR createDirectoryAtPath:logDir withIntermediateDirectories:YES attributes:nil error:nil]) {
+        DLog(@"Unable to create log directory %@", logDir);
+        return NULL;
+    }
+    NSString *logPath = [logDir stringByAppendingPathComponent:@"Output.log"];
+    
+    SEOutputLogConfig config = {
+        .path = [logPath fileSystemRepresentation],
+        .maxSize = SE_OUTPUT_LOG_DEFAULT_MAX_SIZE,
+        .rotationInterval = SE_OUTPUT_LOG_DEFAULT_ROTATION_INTERVAL,
+        .segments = SE_OUTPUT_LOG_DEFAULT_SEGMENTS,
+        .compress = 1
+    };
+    if ([DEFAULTS objectForKey:ScriptExecDefaultsKey_OutputLogMaxSize]) {
+        config.maxSize = MAX(0, [DEFAULTS integerForKey:ScriptExecDefaultsKey_OutputLogMaxSize]);
+    }
+    if ([DEFAULTS objectForKey:ScriptExecDefaultsKey_OutputLogRotationInterval]) {
+        config.rotationInterval = MAX(0, [DEFAULTS integerForKey:ScriptExecDefaultsKey_OutputLogRotationInterval]);
+    }
+    if ([DEFAULTS objectForKey:ScriptExecDefaultsKey_OutputLogSegments]) {
+        config.segments = (unsigned int)MAX(0, [DEFAULTS integerForKey:ScriptExecDefaultsKey_OutputLogSegments]);
+    }
+    if ([DEFAULTS objectForKey:ScriptExecDefaultsKey_OutputLogCompress]) {
+        config.compress = [DEFAULTS boolForKey:ScriptExecDefaultsKey_OutputLogCompress];
+    }
+    
+    int err = 0;
+    SEOutputLog *log = SEOutputLogOpen(&config, &err);
+    if (log == NULL) {
+        DLog(@"Unable to open output log %@: %s", logPath, strerror(err));
+    }
+    return log;
+}
+
 // Read and filter command line arguments passed to the app binary
-- (NSArray *)readCommandLineArguments {
++ (NSArray *)commandLineArguments {
     NSMutableArray *processArgs = [[[NSProcessInfo processInfo] arguments] mutableCopy];
     NSMutableArray *cltArgs = [NSMutableArray new];
     
@@ -454,7 +626,7 @@ static const NSInteger detailsHeight = 224;
     
     // Status menu apps just run when item is clicked
     // For all others, we run the script once app has launched
-    if (interfaceType == PlatypusInterfaceType_StatusMenu) {
+    if (INTERFACE_TYPE == PlatypusInterfaceType_StatusMenu) {
         return;
     }
     
@@ -504,13 +676,16 @@ static const NSInteger detailsHeight = 224;
 }
 
 - (NSApplicationTerminateReply)applicationShouldTerminate:(NSApplication *)sender {
-    // Terminate task
+    // Terminate task, along with any processes it has started, and
+    // whatever is left of jobs cancelled earlier
     if (task != nil) {
-        if ([task isRunning]) {
+        if ([task isRunning] && SEProcessTreeCollect(&terminatingProcesses, [task processIdentifier], YES) != 0) {
             [task terminate];
         }
         task = nil;
     }
+    [NSObject cancelPreviousPerformRequestsWithTarget:self selector:@selector(killTerminatingProcesses) object:nil];
+    SEProcessTreeTerminate(&terminatingProcesses, SE_PROCESS_TREE_GRACE_PERIOD);
     
     // Terminate privileged task
     if (privilegedTask != nil) {
@@ -519,12 +694,32 @@ static const NSInteger detailsHeight = 224;
         }
         privilegedTask = nil;
     }
+    // The helper terminates any jobs it's still running once let go
+    [privilegedHelper close];
+    privilegedHelper = nil;
+    // Don't leave administrator rights behind
+    [authorizationSession revoke];
     
     // Hide status item
     if (statusItem) {
         [[NSStatusBar systemStatusBar] removeStatusItem:statusItem];
     }
     
+    [controlChannel close];
+    [jobServer close];
+    [interpreterPool drain];
+    
+    SEOutputLogClose(outputLog);
+    outputLog = NULL;
+    
+    // Jobs still queued or running are run again on next launch
+    SEJobJournalClose(jobJournal);
+    jobJournal = NULL;
+    
+    // Removes the metrics socket
+    SEMetricsFree(metrics);
+    metrics = NULL;
+    
     return NSTerminateNow;
 }
 
@@ -554,7 +749,7 @@ static const NSInteger detailsHeight = 224;
         [fileMenu removeItemAtIndex:0]; // Open Recent..
         [fileMenu removeItemAtIndex:0]; // Separator
     }
-    if (!IsTextSizableInterfaceType(interfaceType)) {
+    if (!IsTextSizableInterfaceType(INTERFACE_TYPE)) {
         [viewMenu removeItemAtIndex:0];
         [viewMenu removeItemAtIndex:0];
         [viewMenu removeItemAtIndex:0];
@@ -573,7 +768,7 @@ static const NSInteger detailsHeight = 224;
     }
     
     // Prepare controls etc. for different interface types
-    switch (interfaceType) {
+    switch (INTERFACE_TYPE) {
         case PlatypusInterfaceType_None:
             // Nothing to do
             break;
@@ -621,10 +816,21 @@ static const NSInteger detailsHeight = 224;
             }
             
             [textWindowProgressIndicator setUsesThreadedAnimation:YES];
-            [outputTextView setBackgroundColor:textBackgroundColor];
-            [outputTextView setTextColor:textForegroundColor];
-            [outputTextView setFont:textFont];
-            [[outputTextView textStorage] setFont:textFont];
+            
+            if (largeOutputView) {
+                // Output goes in a view that only draws visible lines
+                outputView = [SEOutputView outputViewReplacingTextView:textWindowTextView];
+                [outputView setBackgroundColor:textBackgroundColor];
+                [outputView setTextColor:textForegroundColor];
+                [outputView setFont:textFont];
+            } else {
+                [outputTextView setBackgroundColor:textBackgroundColor];
+                [outputTextView setTextColor:textForegroundColor];
+                [outputTextView setFont:textFont];
+                [[outputTextView textStorage] setFont:textFont];
+                [outputTextView setUsesFindBar:YES];
+                [outputTextView setIncrementalSearchingEnabled:YES];
+            }
             
             // Prepare window
             [textWindow setTitle:appName];
@@ -647,6 +853,7 @@ static const NSInteger detailsHeight = 224;
         }
             break;
             
+#ifndef SE_WITHOUT_STATUS_ITEM
         case PlatypusInterfaceType_StatusMenu:
         {
             // Create and activate status item
@@ -675,6 +882,7 @@ static const NSInteger detailsHeight = 224;
             [statusItem setEnabled:YES];
         }
             break;
+#endif
             
         case PlatypusInterfaceType_Droplet:
         {
@@ -694,8 +902,11 @@ static const NSInteger detailsHeight = 224;
 // Prepare all the controls, windows, etc prior to executing script
 - (void)prepareInterfaceForExecution {
     [outputTextView setString:@""];
+    [outputView clear];
+    SEANSIParserInit(&ansiParser);
+    hasStyledOutput = NO;
     
-    switch (interfaceType) {
+    switch (INTERFACE_TYPE) {
         case PlatypusInterfaceType_None:
         case PlatypusInterfaceType_StatusMenu:
             break;
@@ -764,12 +975,19 @@ static const NSInteger detailsHeight = 224;
 - (void)cleanupInterface {
     
     // if there are any remnants, we append them to output
-    if (remnants != nil) {
-        [self appendString:remnants];
-        remnants = nil;
+    if ([pendingOutput length]) {
+        [pendingOutput appendBytes:"\n" length:1];
+        [self appendOutputBytes:[pendingOutput bytes] length:[pendingOutput length]];
+    }
+    pendingOutput = nil;
+    
+    // Drop any progress update still waiting to be shown
+    if (progressUpdateScheduled) {
+        [NSObject cancelPreviousPerformRequestsWithTarget:self selector:@selector(applyPendingProgress) object:nil];
+        progressUpdateScheduled = NO;
     }
     
-    switch (interfaceType) {
+    switch (INTERFACE_TYPE) {
             
         case PlatypusInterfaceType_None:
         case PlatypusInterfaceType_StatusMenu:
@@ -858,7 +1076,7 @@ static const NSInteger detailsHeight = 224;
     
     // Finally, dequeue job and add arguments
     if ([jobQueue count] > 0) {
-        SEJob *job = jobQueue[0];
+        SEJob *job = [jobQueue removeFirstJob];
 
         // We have files in the queue, to append as arguments
         // We take the first job's arguments and put them into the arg list
@@ -867,7 +1085,7 @@ static const NSInteger detailsHeight = 224;
         }
         stdinString = [[job standardInputString] copy];
         
-        [jobQueue removeObjectAtIndex:0];
+        SEMetricsSetQueueDepth(metrics, (unsigned int)[jobQueue count]);
     }
 }
 
@@ -880,10 +1098,19 @@ static const NSInteger detailsHeight = 224;
     }
     outputEmpty = NO;
     
+    // Runs without a queued job, e.g. on launch, are accounted as jobs too
+    currentJob = [jobQueue count] ? [jobQueue firstJob] : [SEJob jobWithArguments:nil andStandardInput:nil];
+    
     [self prepareForExecution];
     [self prepareInterfaceForExecution];
     
     isTaskRunning = YES;
+    [currentJob markStarted];
+    SEMetricsJobStarted(metrics);
+    if (jobJournal && [currentJob journalIdentifier]) {
+        SEJobJournalMarkStarted(jobJournal, [currentJob journalIdentifier]);
+        [self jobJournalChanged];
+    }
     
     // Run the task
     if (execStyle == PlatypusExecStyle_Authenticated) {
@@ -893,46 +1120,86 @@ static const NSInteger detailsHeight = 224;
     }
 }
 
+#ifndef SE_WITHOUT_STATUS_ITEM
 - (NSString *)executeScriptForStatusMenu {
 
     [self prepareForExecution];
     [self prepareInterfaceForExecution];
     
-    // Create task and apply settings
-    task = [[NSTask alloc] init];
-    [task setLaunchPath:interpreterPath];
-    [task setCurrentDirectoryPath:[[NSBundle mainBundle] resourcePath]];
-    [task setArguments:arguments];
-
-    outputPipe = [NSPipe pipe];
-    [task setStandardOutput:outputPipe];
-    [task setStandardError:outputPipe];
-    outputReadFileHandle = [outputPipe fileHandleForReading];
-    
-    // Set it off
-    //DLog(@"Running task\n%@", [task humanDescription]);
-    [task launch];
-    // This is blocking
-    [task waitUntilExit];
-    
-    NSData *outData = [outputReadFileHandle readDataToEndOfFile];
-    return [[NSString alloc] initWithData:outData encoding:DEFAULT_TEXT_ENCODING];
+    // Run to completion, collecting output as it comes so that the
+    // script can't block on a full pipe while we wait for it to exit
+    char **argv = PlatypusSpawnArguments([@[interpreterPath] arrayByAddingObjectsFromArray:arguments]);
+    PlatypusSpawnAttributes attributes;
+    PlatypusSpawnAttributesInit(&attributes, argv[0], argv);
+    attributes.directory = [[[NSBundle mainBundle] resourcePath] fileSystemRepresentation];
+    attributes.processGroup = 1;
+    char *output = NULL;
+    size_t length = 0;
+    int status;
+    double timeout = (jobLimits.timeout > 0) ? jobLimits.timeout : -1;
+    int err = PlatypusSpawnRun(&attributes, timeout, &output, &length, &status);
+    free(argv);
+    if (err) {
+        DLog(@"Unable to run %@: %s", interpreterPath, strerror(err));
+        return @"";
+    }
+    
+    NSString *outputString = [[NSString alloc] initWithBytes:output length:length encoding:DEFAULT_TEXT_ENCODING];
+    free(output);
+    return outputString ? outputString : @"";
 }
+#endif
 
-// Launch regular user-privileged process using NSTask
+// Launch regular user-privileged process
 - (void)executeScriptWithoutPrivileges {
 
-    // Create task and apply settings
-    task = [[NSTask alloc] init];
-    [task setLaunchPath:interpreterPath];
-    [task setCurrentDirectoryPath:[[NSBundle mainBundle] resourcePath]];
-    [task setArguments:arguments];
+    // The job may tighten the app's limits, never relax them
+    PlatypusJobLimits limits = jobLimits;
+    PlatypusJobLimits currentJobLimits = [currentJob limits];
+    PlatypusJobLimitsCombine(&limits, &currentJobLimits);
+    
+    // Hand the job to an interpreter started while the previous job ran, if
+    // there is one. Resource limits can only be set as the process starts.
+    task = nil;
+    int err = 0;
+    if (interpreterPool && !PlatypusJobLimitsAnyResource(&limits)) {
+        NSUInteger scriptArgsStart = [interpreterArgs count] + 1;
+        NSRange range = NSMakeRange(scriptArgsStart, [arguments count] - scriptArgsStart);
+        task = [interpreterPool taskRunningScript:scriptPath
+                                        arguments:[arguments subarrayWithRange:range]
+                                      environment:[currentJob environment]];
+    }
+    if (task) {
+        DLog(@"Running task started ahead of time\n%@", [task description]);
+    } else {
+        // Create task and apply settings
+        task = [[SEJobTask alloc] init];
+        [task setLaunchPath:interpreterPath];
+        [task setCurrentDirectoryPath:[[NSBundle mainBundle] resourcePath]];
+        [task setArguments:arguments];
+        [task setEnvironment:[currentJob environment]];
+        [task setLimits:limits];
+        
+        // Set it off
+        DLog(@"Running task\n%@", [task description]);
+        err = [task launch];
+    }
+    if (err) {
+        DLog(@"Unable to run %@: %s", interpreterPath, strerror(err));
+        task = nil;
+        [self finishJobThatDidNotLaunch];
+        // Shown once, rather than for every queued job, until a job launches
+        if (!launchFailureReported) {
+            launchFailureReported = YES;
+            [Alerts alert:@"Failed to execute script"
+            subTextFormat:@"Unable to launch %@: %s.", interpreterPath, strerror(err)];
+        }
+        return;
+    }
+    launchFailureReported = NO;
     
     // Direct output to file handle and start monitoring it if script provides feedback
-    outputPipe = [NSPipe pipe];
-    [task setStandardOutput:outputPipe];
-    [task setStandardError:outputPipe];
-    outputReadFileHandle = [outputPipe fileHandleForReading];
+    outputReadFileHandle = [task outputFileHandle];
     [[NSNotificationCenter defaultCenter] addObserver:self
                                              selector:@selector(gotOutputData:)
                                                  name:NSFileHandleReadCompletionNotification
@@ -940,37 +1207,50 @@ static const NSInteger detailsHeight = 224;
     [outputReadFileHandle readInBackgroundAndNotify];
     
     // Set up stdin for writing
-    inputPipe = [NSPipe pipe];
-    [task setStandardInput:inputPipe];
-    inputWriteFileHandle = [[task standardInput] fileHandleForWriting];
+    inputWriteFileHandle = [task inputFileHandle];
     
-    // Set it off
-    //DLog(@"Running task\n%@", [task humanDescription]);
-    [task launch];
+    if (limits.timeout > 0) {
+        [self performSelector:@selector(taskTimedOut:) withObject:task afterDelay:limits.timeout];
+    }
     
     // Write input, if any, to stdin, and then close
     if (stdinString) {
         [inputWriteFileHandle writeData:[stdinString dataUsingEncoding:NSUTF8StringEncoding]];
     }
     [inputWriteFileHandle closeFile];
-    stdinString = nil;    
+    stdinString = nil;
+    
+    // Get interpreters ready for the next jobs while this one runs
+    [interpreterPool fillForJobCount:[jobQueue count]];
 }
 
-// Launch task with admin privileges using Authentication API
+// Launch task with admin privileges using Authentication API, or through
+// the privileged helper if the app uses one
 - (void)executeScriptWithPrivileges {
-    // Create task
-    privilegedTask = [[STPrivilegedTask alloc] init];
-    [privilegedTask setLaunchPath:interpreterPath];
-    [privilegedTask setCurrentDirectoryPath:[[NSBundle mainBundle] resourcePath]];
-    [privilegedTask setArguments:arguments];
-    
-    // Set it off
-    DLog(@"Running task\n%@", [privilegedTask description]);
-    OSStatus err = [privilegedTask launch];
+    OSStatus err = errAuthorizationFnNoLongerExists;
+    if (usesPrivilegedHelper) {
+        err = [self launchPrivilegedHelperTask];
+    } else {
+        // Create task
+        privilegedTask = [[STPrivilegedTask alloc] init];
+        [privilegedTask setLaunchPath:interpreterPath];
+        [privilegedTask setCurrentDirectoryPath:[[NSBundle mainBundle] resourcePath]];
+        [privilegedTask setArguments:arguments];
+        
+        // Set it off, with authorization kept from earlier jobs if the
+        // session hasn't expired
+        DLog(@"Running task\n%@", [privilegedTask description]);
+        if ([STPrivilegedTask authorizationFunctionAvailable]) {
+            AuthorizationRef authorization = [authorizationSession authorizationToExecute:interpreterPath status:&err];
+            if (authorization) {
+                err = [privilegedTask launchWithAuthorization:authorization];
+                [authorizationSession authorizationUsedWithStatus:err];
+            }
+        }
+    }
     if (err != errAuthorizationSuccess) {
         if (err == errAuthorizationCanceled) {
-            outputEmpty = YES;
-            [self taskFinished:nil];
+            [self finishJobThatDidNotLaunch];
             return;
         }  else {
             // Something went wrong
@@ -988,6 +1268,59 @@ static const NSInteger detailsHeight = 224;
     [outputReadFileHandle readInBackgroundAndNotify];
 }
 
+// Hands the job to the privileged helper, launching the helper first if
+// there is none, or the one there is has gone away or outlived its
+// authorization. The helper applies the job's limits and timeout itself,
+// since the app can't signal processes running as root.
+- (OSStatus)launchPrivilegedHelperTask {
+    if (privilegedHelper && (![privilegedHelper isConnected] || ![authorizationSession isAuthorized])) {
+        [privilegedHelper close];
+        privilegedHelper = nil;
+    }
+    OSStatus err = errAuthorizationSuccess;
+    BOOL authorizationUsed = NO;
+    if (privilegedHelper == nil) {
+        if (![STPrivilegedTask authorizationFunctionAvailable]) {
+            return errAuthorizationFnNoLongerExists;
+        }
+        AuthorizationRef authorization = [authorizationSession authorizationToExecute:[[NSBundle mainBundle] executablePath] status:&err];
+        if (authorization == NULL) {
+            return err;
+        }
+        privilegedHelper = [SEPrivilegedHelperConnection connectionWithAuthorization:authorization status:&err];
+        authorizationUsed = YES;
+    }
+    
+    if (privilegedHelper) {
+        PlatypusJobLimits limits = jobLimits;
+        PlatypusJobLimits currentJobLimits = [currentJob limits];
+        PlatypusJobLimitsCombine(&limits, &currentJobLimits);
+        
+        SEPrivilegedHelperTask *helperTask = [privilegedHelper taskWithLaunchPath:interpreterPath
+                                                                        arguments:arguments
+                                                                 currentDirectory:[[NSBundle mainBundle] resourcePath]];
+        [helperTask setEnvironment:[currentJob environment]];
+        [helperTask setLimits:limits];
+        privilegedTask = helperTask;
+        DLog(@"Running task through privileged helper\n%@", [privilegedTask description]);
+        err = [privilegedTask launch];
+    }
+    // Only once the job is running, so the helper isn't let go straight
+    // away if the authorization expires now
+    if (authorizationUsed) {
+        [authorizationSession authorizationUsedWithStatus:err];
+    }
+    return err;
+}
+
+- (void)closePrivilegedHelperIfIdle {
+    if (privilegedHelper && ![privilegedTask isRunning]) {
+        DLog(@"Closing privileged helper");
+        [privilegedHelper close];
+        privilegedHelper = nil;
+    }
+}
+
 #pragma mark - Task completion
 
 // OK, called when we receive notification that task is finished
@@ -999,6 +1332,13 @@ static const NSInteger detailsHeight = 224;
     }
     isTaskRunning = NO;
     DLog(@"Task finished");
+    [NSObject cancelPreviousPerformRequestsWithTarget:self selector:@selector(taskTimedOut:) object:task];
+    
+    int status = task ? [task terminationStatus] : [privilegedTask terminationStatus];
+    if ([privilegedTask isKindOfClass:[SEPrivilegedHelperTask class]] && [(SEPrivilegedHelperTask *)privilegedTask timedOut]) {
+        [currentJob markTimedOut];
+    }
+    [self finishCurrentJobWithStatus:status];
         
     // Did we receive all the data?
     // If no data left, we do clean up
@@ -1009,7 +1349,84 @@ static const NSInteger detailsHeight = 224;
     // If there are more jobs waiting for us, execute
     if ([jobQueue count] > 0 /*&& remainRunning*/) {
         [self executeScript];
+    } else {
+        [interpreterPool drain];
+    }
+}
+
+// The next job is started on the next pass through the run loop, so that a
+// queue of jobs that can't be launched isn't worked through recursively
+- (void)finishJobThatDidNotLaunch {
+    isTaskRunning = NO;
+    outputEmpty = YES;
+    [self finishCurrentJobWithStatus:-1];
+    // Any output still being read is the previous job's, which cleans up
+    // after itself
+    [self cleanupInterface];
+    if ([jobQueue count] > 0) {
+        [self performSelector:@selector(executeQueuedJob) withObject:nil afterDelay:0.0];
+    } else {
+        [interpreterPool drain];
+    }
+}
+
+- (void)taskTimedOut:(SEJobTask *)timedOutTask {
+    if (timedOutTask != task || !isTaskRunning) {
+        return;
+    }
+    DLog(@"Task timed out");
+    [currentJob markTimedOut];
+    [self terminateTask];
+}
+
+// Asks the task and every process it has started to exit, and kills those
+// still running after a grace period. The job then finishes as usual, so
+// the queue keeps going.
+- (void)terminateTask {
+    // Privileged jobs can only be terminated by the helper running them
+    if ([privilegedTask isRunning]) {
+        [privilegedTask terminate];
+        return;
+    }
+    if (task == nil || ![task isRunning]) {
+        return;
+    }
+    // Processes are stopped as they're found, so none can slip away by
+    // starting more while the tree is collected
+    if (SEProcessTreeCollect(&terminatingProcesses, [task processIdentifier], YES) != 0) {
+        [task terminate];
+        return;
+    }
+    SEProcessTreeSignal(&terminatingProcesses, SIGTERM);
+    SEProcessTreeSignal(&terminatingProcesses, SIGCONT);
+    [NSObject cancelPreviousPerformRequestsWithTarget:self selector:@selector(killTerminatingProcesses) object:nil];
+    [self performSelector:@selector(killTerminatingProcesses) withObject:nil afterDelay:SE_PROCESS_TREE_GRACE_PERIOD];
+}
+
+- (void)killTerminatingProcesses {
+    if (SEProcessTreeSignal(&terminatingProcesses, SIGKILL)) {
+        DLog(@"Killed processes that didn't exit when terminated");
+    }
+    SEProcessTreeClear(&terminatingProcesses);
+}
+
+- (void)finishCurrentJobWithStatus:(int)status {
+    if (currentJob == nil) {
+        return;
+    }
+    [currentJob markFinishedWithStatus:status];
+    SEJobRecord record = [currentJob record];
+    SEMetricsJobFinished(metrics, &record);
+    if (jobJournal && [currentJob journalIdentifier]) {
+        SEJobJournalMarkCompleted(jobJournal, [currentJob journalIdentifier]);
+        [self jobJournalChanged];
+    }
+    if ([currentJob completionHandler]) {
+        [currentJob completionHandler](status);
+        [currentJob setCompletionHandler:nil];
+        [currentJob setOutputHandler:nil];
     }
+    currentJob = nil;
 }
 
 - (void)cleanup {
@@ -1063,141 +1480,275 @@ static const NSInteger detailsHeight = 224;
 }
 
 - (void)parseOutput:(NSData *)data {
-    // Create string from output data
-    NSMutableString *outputString = [[NSMutableString alloc] initWithData:data encoding:DEFAULT_TEXT_ENCODING];
+    if (outputLog) {
+        SEOutputLogWrite(outputLog, [data bytes], [data length]);
+    }
+    currentJob.outputBytes += [data length];
+    if ([currentJob outputHandler]) {
+        [currentJob outputHandler](data);
+    }
     
-    if (outputString == nil) {
-        DLog(@"Warning: Output string is nil");
-        return;
+    // Prepend incomplete line left over from last time
+    NSData *output = data;
+    if ([pendingOutput length]) {
+        [pendingOutput appendData:data];
+        output = pendingOutput;
+    }
+    const char *bytes = [output bytes];
+    size_t length = [output length];
+    
+    // Output following the last line terminator isn't a complete
+    // line. It'll be prepended next time we get output.
+    size_t end = length;
+    while (end > 0 && bytes[end - 1] != '\n' && bytes[end - 1] != '\r') {
+        end--;
     }
     
-    DLog(@"Output:%@", outputString);
+    // Parse output looking for commands. Consecutive lines of regular
+    // output are appended in one go once a command or the end is reached.
+    size_t runStart = 0;
+    if (!controlChannelOnly) {
+        size_t lineStart = 0;
+        for (size_t i = 0; i < end; i++) {
+            if (bytes[i] != '\n' && bytes[i] != '\r') {
+                continue;
+            }
+            SEOutputCommand command;
+            if (SEOutputCommandParse(bytes + lineStart, i - lineStart, &command) != SEOutputCommand_None) {
+                [self appendOutputBytes:bytes + runStart length:lineStart - runStart];
+                // Commands that don't apply to the interface type are shown as output
+                runStart = [self performOutputCommand:&command] ? i + 1 : lineStart;
+            }
+            lineStart = i + 1;
+        }
+    }
+    [self appendOutputBytes:bytes + runStart length:end - runStart];
+    
+    pendingOutput = (end < length) ? [NSMutableData dataWithBytes:bytes + end length:length - end] : nil;
+    
+    // If web output, we continually re-render to accomodate incoming data
+    if (INTERFACE_TYPE == PlatypusInterfaceType_WebView) {
+        [self reloadWebView];
+    }
+    
+    // The output view follows output by itself
+    if (IsTextViewScrollableInterfaceType(INTERFACE_TYPE) && outputView == nil) {
+        [outputTextView scrollRangeToVisible:NSMakeRange([[outputTextView textStorage] length], 0)];
+    }
+}
+
+// Append complete lines of output, each terminated by \r or \n
+- (void)appendOutputBytes:(const char *)bytes length:(size_t)length {
+    if (length == 0) {
+        return;
+    }
     
-    if (remnants) {
-        [outputString insertString:remnants atIndex:0];
+    // ANSI escape sequences are rendered as text styles in the text view and
+    // stripped elsewhere. Headless apps pass them on to the terminal.
+    BOOL parseEscapes = (INTERFACE_TYPE != PlatypusInterfaceType_None) &&
+                        (memchr(bytes, 0x1B, length) || ansiParser.state || !SEANSIStyleIsDefault(&ansiParser.style));
+    BOOL styled = (outputView == nil && IsTextViewScrollableInterfaceType(INTERFACE_TYPE)) &&
+                  (parseEscapes || hasStyledOutput);
+    if (parseEscapes || styled) {
+        SEANSIOutputClear(&ansiOutput);
+        if (SEANSIParserFeed(&ansiParser, bytes, length, &ansiOutput) != 0) {
+            return;
+        }
+        bytes = ansiOutput.text;
+        length = ansiOutput.length;
+        if (length == 0) {
+            return;
+        }
     }
     
-    // Parse line by line
-    NSCharacterSet *characterSet = [NSCharacterSet characterSetWithCharactersInString:@"\r\n"];
-    NSMutableArray *lines = [[outputString componentsSeparatedByCharactersInSet:characterSet] mutableCopy];
+    NSString *text = [[NSString alloc] initWithBytes:bytes length:length encoding:DEFAULT_TEXT_ENCODING];
+    if (text == nil) {
+        DLog(@"Warning: Output string is nil");
+        return;
+    }
+    // Every \r or \n ends a line
+    if (memchr(bytes, '\r', length)) {
+        text = [text stringByReplacingOccurrencesOfString:@"\r" withString:@"\n"];
+    }
+    DLog(@"Output:%@", text);
     
-    // If the string did not end with a newline, it wasn't a complete line of output
-    // Thus, we store this last non-newline-terminated string
-    // It'll be prepended next time we get output
-    if ([[lines lastObject] length] > 0) { // Output didn't end with a newline
-        remnants = [lines lastObject];
+    if (styled) {
+        // Once styled text has been appended, plain text appended after it
+        // would take on its style, so all further output is appended styled
+        hasStyledOutput = YES;
+        [self appendStyledOutputText:text];
     } else {
-        remnants = nil;
+        [self appendOutputText:text];
     }
     
-    [lines removeLastObject];
+    // Show last line in our GUI text field
+    if (INTERFACE_TYPE == PlatypusInterfaceType_Droplet || INTERFACE_TYPE == PlatypusInterfaceType_ProgressBar) {
+        NSString *lines = [text substringToIndex:[text length] - 1];
+        NSRange lastNewline = [lines rangeOfString:@"\n" options:NSBackwardsSearch];
+        NSString *lastLine = (lastNewline.location == NSNotFound) ? lines : [lines substringFromIndex:NSMaxRange(lastNewline)];
+        [self showOutputMessage:lastLine];
+    }
+}
+
+- (void)showOutputMessage:(NSString *)line {
+    if (INTERFACE_TYPE == PlatypusInterfaceType_Droplet) {
+        [dropletMessageTextField setStringValue:line];
+    }
+    if (INTERFACE_TYPE == PlatypusInterfaceType_ProgressBar) {
+        [progressBarMessageTextField setStringValue:line];
+    }
+}
+
+// Perform command parsed from script output. Returns NO if the command
+// doesn't apply to this interface type.
+- (BOOL)performOutputCommand:(const SEOutputCommand *)command {
+    // Scripts may report progress thousands of times per second,
+    // so skip creating a command dictionary for each update
+    if (command->type == SEOutputCommand_Progress) {
+        if (INTERFACE_TYPE != PlatypusInterfaceType_ProgressBar) {
+            return NO;
+        }
+        if (command->hasProgress) {
+            [self setProgress:command->progress];
+        }
+        return YES;
+    }
+    return [self performControlCommand:SEControlCommandFromOutputCommand(command)];
+}
+
+// Perform command received via control channel or parsed from script output.
+// Returns NO if the command doesn't apply to this interface type, in which case
+// an in-band command is shown as regular output.
+- (BOOL)performControlCommand:(NSDictionary *)command {
+    NSString *name = command[@"command"];
     
-    NSURL *locationURL = nil;
+    if ([name isEqualToString:@"quit"]) {
+        [[NSApplication sharedApplication] terminate:self];
+        return YES;
+    }
     
-    // Parse output looking for commands; if none, append line to output text field
-    for (NSString *theLine in lines) {
-        
-//        if ([theLine length] == 0) {
-//            [self appendString:@""];
-//            continue;
-//        }
-        
-        if ([theLine isEqualToString:@"QUITAPP"]) {
-            [[NSApplication sharedApplication] terminate:self];
-            continue;
+    if ([name isEqualToString:@"refresh"]) {
+        [self clearOutputBuffer];
+        return YES;
+    }
+    
+    if ([name isEqualToString:@"notification"]) {
+        NSString *title = CommandArgument(command, @"title");
+        NSString *text = command[@"text"] ? CommandArgument(command, @"text") : title;
+        [self showNotification:title text:text];
+        return YES;
+    }
+    
+    // Cancel all queued jobs, or the one with the given arguments and input
+    if ([name isEqualToString:@"cancel"]) {
+        id args = command[@"arguments"];
+        id input = command[@"input"];
+        if (args == nil && input == nil) {
+            [self cancelQueuedJobs:[jobQueue removeAllJobs]];
+            return YES;
         }
-        
-        if ([theLine isEqualToString:@"REFRESH"]) {
-            [self clearOutputBuffer];
-            continue;
+        if ((args && ![args isKindOfClass:[NSArray class]]) || (input && ![input isKindOfClass:[NSString class]])) {
+            return YES;
         }
-        
-        if ([theLine hasPrefix:@"NOTIFICATION:"]) {
-            NSString *notificationString = [theLine substringFromIndex:13];
-            NSArray *titleAndText = [notificationString componentsSeparatedByString:@"|"];
-            NSString *title = titleAndText[0];
-            NSString *text = ([titleAndText count] >= 2) ? titleAndText[1] : title;
-            [self showNotification:title text:text];
-            continue;
+        for (id arg in args) {
+            if (![arg isKindOfClass:[NSString class]]) {
+                return YES;
+            }
         }
-        
-        if ([theLine hasPrefix:@"ALERT:"]) {
-            NSString *alertString = [theLine substringFromIndex:6];
-            NSArray *components = [alertString componentsSeparatedByString:CMDLINE_ARG_SEPARATOR];
-            [Alerts alert:components[0] subText:[components count] > 1 ? components[1] : components[0]];
-            continue;
+        // Dropped files may be queued in any order
+        SEJob *match = [SEJob jobWithArguments:args andStandardInput:input];
+        SEJob *job = [jobQueue jobWithDeduplicationKey:[match deduplicationKey]];
+        if (job == nil) {
+            [match setUnorderedArguments:YES];
+            job = [jobQueue jobWithDeduplicationKey:[match deduplicationKey]];
+        }
+        if (job) {
+            [self cancelQueuedJobs:@[job]];
         }
+        return YES;
+    }
+    
+    if ([name isEqualToString:@"alert"]) {
+        NSString *title = CommandArgument(command, @"title");
+        NSString *text = command[@"text"] ? CommandArgument(command, @"text") : title;
+        [Alerts alert:title subText:text];
+        return YES;
+    }
+    
+    // Special commands to control progress bar interface
+    if (INTERFACE_TYPE == PlatypusInterfaceType_ProgressBar) {
         
-        // Special commands to control progress bar interface
-        if (interfaceType == PlatypusInterfaceType_ProgressBar) {
-            
-            // Set progress bar status
-            // Lines starting with PROGRESS:\d+ are interpreted as percentage to set progress bar
-            if ([theLine hasPrefix:@"PROGRESS:"]) {
-                NSString *progressPercentString = [theLine substringFromIndex:9];
-                if ([progressPercentString hasSuffix:@"%"]) {
-                    progressPercentString = [progressPercentString substringToIndex:[progressPercentString length]-1];
-                }
-                
-                // Parse percentage using number formatter
-                NSNumberFormatter *numFormatter = [[NSNumberFormatter alloc] init];
-                numFormatter.numberStyle = NSNumberFormatterDecimalStyle;
-                NSNumber *percentageNumber = [numFormatter numberFromString:progressPercentString];
-                
-                if (percentageNumber != nil) {
-                    [progressBarIndicator setIndeterminate:NO];
-                    [progressBarIndicator setDoubleValue:[percentageNumber doubleValue]];
-                }
-                continue;
+        // Set progress bar status
+        if ([name isEqualToString:@"progress"]) {
+            if ([command[@"value"] isKindOfClass:[NSNumber class]]) {
+                [self setProgress:[command[@"value"] doubleValue]];
             }
-            // Toggle visibility of details text field
-            else if ([theLine isEqualToString:@"DETAILS:SHOW"]) {
+            return YES;
+        }
+        // Toggle visibility of details text field
+        if ([name isEqualToString:@"details"]) {
+            if ([command[@"visible"] boolValue]) {
                 [self showDetails];
-                continue;
-            }
-            else if ([theLine isEqualToString:@"DETAILS:HIDE"]) {
+            } else {
                 [self hideDetails];
-                continue;
             }
-        }
-        
-        if (interfaceType == PlatypusInterfaceType_WebView && [theLine hasPrefix:@"LOCATION:"]) {
-            NSString *urlString = [theLine substringFromIndex:9];
-            urlString = [urlString stringByReplacingOccurrencesOfString:@" " withString:@""];
-            locationURL = [NSURL URLWithString:urlString];
-            [webView setToolTip:@"LOCATION"];
-        }
-        
-        [self appendString:theLine];
-        
-        // OK, line wasn't a command understood by the wrapper
-        // Show it in our GUI text field
-        if (interfaceType == PlatypusInterfaceType_Droplet) {
-            [dropletMessageTextField setStringValue:theLine];
-        }
-        if (interfaceType == PlatypusInterfaceType_ProgressBar) {
-            [progressBarMessageTextField setStringValue:theLine];
+            return YES;
         }
     }
     
-    // If web output, we continually re-render to accomodate incoming data
-    if (interfaceType == PlatypusInterfaceType_WebView) {
-        if (locationURL) {
-            // Load the provided URL
-            [[webView mainFrame] loadRequest:[NSURLRequest requestWithURL:locationURL]];
-        } else {
-            // Otherwise, just load script output as HTML string
-            NSURL *resourcePathURL = [NSURL fileURLWithPath:[[NSBundle mainBundle] resourcePath]];
-            [[webView mainFrame] loadHTMLString:[outputTextView string] baseURL:resourcePathURL];
-        }
+    // LOCATION: lines are still shown as output, and the URL
+    // is loaded once the current output has been processed
+    if (INTERFACE_TYPE == PlatypusInterfaceType_WebView && [name isEqualToString:@"location"]) {
+        locationURL = [NSURL URLWithString:CommandArgument(command, @"url")];
+        [webView setToolTip:@"LOCATION"];
+        return NO;
     }
     
-    if (IsTextViewScrollableInterfaceType(interfaceType)) {
-        [outputTextView scrollRangeToVisible:NSMakeRange([[outputTextView textStorage] length], 0)];
+    return NO;
+}
+
+- (void)controlChannelCommandReceived:(NSDictionary *)command {
+    [self performControlCommand:command];
+    if (locationURL) {
+        [self reloadWebView];
+    }
+}
+
+// Progress bar is updated at most once per frame, with the latest value
+- (void)setProgress:(double)value {
+    pendingProgress = value;
+    if (!progressUpdateScheduled) {
+        progressUpdateScheduled = YES;
+        [self performSelector:@selector(applyPendingProgress) withObject:nil afterDelay:1.0 / 60.0];
+    }
+}
+
+- (void)applyPendingProgress {
+    progressUpdateScheduled = NO;
+    [progressBarIndicator setIndeterminate:NO];
+    [progressBarIndicator setDoubleValue:pendingProgress];
+}
+
+- (void)reloadWebView {
+#ifndef SE_WITHOUT_WEBKIT
+    if (locationURL) {
+        // Load the provided URL
+        [[webView mainFrame] loadRequest:[NSURLRequest requestWithURL:locationURL]];
+        locationURL = nil;
+    } else {
+        // Otherwise, just load script output as HTML string
+        NSURL *resourcePathURL = [NSURL fileURLWithPath:[[NSBundle mainBundle] resourcePath]];
+        [[webView mainFrame] loadHTMLString:[outputTextView string] baseURL:resourcePathURL];
     }
+#endif
 }
 
 - (void)clearOutputBuffer {
+    if (outputView) {
+        [outputView clear];
+        return;
+    }
+    
     NSTextStorage *textStorage = [outputTextView textStorage];
     NSRange range = NSMakeRange(0, [textStorage length]-1);
     [textStorage beginEditing];
@@ -1207,9 +1758,20 @@ static const NSInteger detailsHeight = 224;
 
 - (void)appendString:(NSString *)string {
     DLog(@"Appending output: \"%@\"", string);
+    [self appendOutputText:[string stringByAppendingString:@"\n"]];
+}
 
-    if (interfaceType == PlatypusInterfaceType_None) {
-        fprintf(stderr, "%s\n", [string cStringUsingEncoding:DEFAULT_TEXT_ENCODING]);
+- (void)appendOutputText:(NSString *)text {
+    if (INTERFACE_TYPE == PlatypusInterfaceType_None) {
+        const char *str = [text cStringUsingEncoding:DEFAULT_TEXT_ENCODING];
+        if (str) {
+            fputs(str, stderr);
+        }
+        return;
+    }
+    
+    if (outputView) {
+        [outputView appendText:text];
         return;
     }
     
@@ -1218,13 +1780,93 @@ static const NSInteger detailsHeight = 224;
     NSTextStorage *textStorage = [outputTextView textStorage];
     NSRange appendRange = NSMakeRange([textStorage length], 0);
     [textStorage beginEditing];
-    [textStorage replaceCharactersInRange:appendRange withString:string];
-    [textStorage replaceCharactersInRange:NSMakeRange([textStorage length], 0) withString:@"\n"];
-//    NSString *repl = [NSString stringWithFormat:@"%@\n", string];
-//    [textStorage replaceCharactersInRange:appendRange withString:repl];
+    [textStorage replaceCharactersInRange:appendRange withString:text];
     [textStorage endEditing];
 }
 
+// Append text with the style runs from the last ANSI parser feed,
+// in one edit of the text storage however many runs there are
+- (void)appendStyledOutputText:(NSString *)text {
+    NSMutableAttributedString *attrText = [[NSMutableAttributedString alloc] initWithString:text];
+    NSUInteger textLength = [text length];
+    NSUInteger location = 0;
+    const unsigned char *bytes = (const unsigned char *)ansiOutput.text;
+    
+    for (size_t i = 0; i < ansiOutput.runCount && location < textLength; i++) {
+        // Run lengths are in bytes of UTF-8. Characters outside the BMP
+        // take two UTF-16 units.
+        NSUInteger runLength = 0;
+        for (size_t j = 0; j < ansiOutput.runs[i].length; j++) {
+            unsigned char c = bytes[j];
+            runLength += ((c & 0xC0) != 0x80) + (c >= 0xF0);
+        }
+        bytes += ansiOutput.runs[i].length;
+        
+        NSRange range = NSMakeRange(location, MIN(runLength, textLength - location));
+        [attrText setAttributes:[self attributesForANSIStyle:&ansiOutput.runs[i].style] range:range];
+        location += range.length;
+    }
+    
+    NSTextStorage *textStorage = [outputTextView textStorage];
+    NSRange appendRange = NSMakeRange([textStorage length], 0);
+    [textStorage beginEditing];
+    [textStorage replaceCharactersInRange:appendRange withAttributedString:attrText];
+    [textStorage endEditing];
+}
+
+- (NSDictionary *)attributesForANSIStyle:(const SEANSIStyle *)style {
+    NSData *key = [NSData dataWithBytes:style length:sizeof(SEANSIStyle)];
+    NSDictionary *attributes = ansiAttributes[key];
+    if (attributes) {
+        return attributes;
+    }
+    
+    NSFont *font = textFont;
+    NSFontTraitMask traits = 0;
+    if (style->flags & SEANSIStyle_Bold) {
+        traits |= NSBoldFontMask;
+    }
+    if (style->flags & SEANSIStyle_Italic) {
+        traits |= NSItalicFontMask;
+    }
+    if (traits) {
+        font = [[NSFontManager sharedFontManager] convertFont:textFont toHaveTrait:traits];
+    }
+    
+    NSColor *foreground = textForegroundColor;
+    if (style->foreground.type != SEANSIColor_Default) {
+        foreground = ColorForANSIColor(&style->foreground);
+    }
+    NSColor *background = nil;
+    if (style->background.type != SEANSIColor_Default) {
+        background = ColorForANSIColor(&style->background);
+    }
+    if (style->flags & SEANSIStyle_Inverse) {
+        NSColor *inverted = foreground;
+        foreground = background ? background : textBackgroundColor;
+        background = inverted;
+    }
+    if (style->flags & SEANSIStyle_Faint) {
+        foreground = [foreground colorWithAlphaComponent:0.6];
+    }
+    
+    NSMutableDictionary *attrs = [NSMutableDictionary dictionary];
+    attrs[NSFontAttributeName] = font;
+    attrs[NSForegroundColorAttributeName] = foreground;
+    if (background) {
+        attrs[NSBackgroundColorAttributeName] = background;
+    }
+    if (style->flags & SEANSIStyle_Underline) {
+        attrs[NSUnderlineStyleAttributeName] = @(NSUnderlineStyleSingle);
+    }
+    if (style->flags & SEANSIStyle_Strikethrough) {
+        attrs[NSStrikethroughStyleAttributeName] = @(NSUnderlineStyleSingle);
+    }
+    
+    ansiAttributes[key] = attrs;
+    return attrs;
+}
+
 #pragma mark - Interface actions
 
 // Run open panel, made available to apps that accept files
@@ -1307,10 +1949,10 @@ static const NSInteger detailsHeight = 224;
 
 // Save output in text field to file when Save to File menu item is invoked
 - (IBAction)saveToFile:(id)sender {
-    if (IsTextStyledInterfaceType(interfaceType) == NO) {
+    if (IsTextStyledInterfaceType(INTERFACE_TYPE) == NO) {
         return;
     }
-    NSString *outSuffix = (interfaceType == PlatypusInterfaceType_WebView) ? @"html" : @"txt";
+    NSString *outSuffix = (INTERFACE_TYPE == PlatypusInterfaceType_WebView) ? @"html" : @"txt";
     NSString *fileName = [NSString stringWithFormat:@"%@-Output.%@", appName, outSuffix];
     
     NSSavePanel *sPanel = [NSSavePanel savePanel];
@@ -1319,7 +1961,13 @@ static const NSInteger detailsHeight = 224;
     
     if ([sPanel runModal] == NSModalResponseOK) {
         NSError *err;
-        BOOL success = [[outputTextView string] writeToFile:[[sPanel URL] path] atomically:YES encoding:DEFAULT_TEXT_ENCODING error:&err];
+        NSString *path = [[sPanel URL] path];
+        BOOL success;
+        if (outputView) {
+            success = [outputView writeToFile:path error:&err];
+        } else {
+            success = [[outputTextView string] writeToFile:path atomically:YES encoding:DEFAULT_TEXT_ENCODING error:&err];
+        }
         if (!success) {
             [Alerts alert:@"Error writing file" subText:[err localizedDescription]];
         }
@@ -1329,12 +1977,12 @@ static const NSInteger detailsHeight = 224;
 - (BOOL)validateMenuItem:(NSMenuItem *)anItem {
     
     // Status item menus are always enabled
-    if (interfaceType == PlatypusInterfaceType_StatusMenu) {
+    if (INTERFACE_TYPE == PlatypusInterfaceType_StatusMenu) {
         return YES;
     }
     // Save to file
     SEL selector = [anItem action];
-    if (IsTextStyledInterfaceType(interfaceType) && selector == @selector(saveToFile:)) {
+    if (IsTextStyledInterfaceType(INTERFACE_TYPE) && selector == @selector(saveToFile:)) {
         return YES;
     }
     // Open should only work if it's a droppable app that accepts files
@@ -1342,7 +1990,7 @@ static const NSInteger detailsHeight = 224;
         return YES;
     }
     // Change text size
-    if (IsTextSizableInterfaceType(interfaceType) &&
+    if (IsTextSizableInterfaceType(INTERFACE_TYPE) &&
         (selector == @selector(makeTextBigger:) || selector == @selector(makeTextSmaller:))) {
         return YES;
     }
@@ -1354,9 +2002,9 @@ static const NSInteger detailsHeight = 224;
 }
 
 - (IBAction)cancel:(id)sender {
-    if (task != nil && [task isRunning]) {
+    if ((task != nil && [task isRunning]) || [privilegedTask isRunning]) {
         DLog(@"Task cancelled");
-        [task terminate];
+        [self terminateTask];
     }
     
     if ([[sender title] isEqualToString:@"Quit"]) {
@@ -1368,13 +2016,15 @@ static const NSInteger detailsHeight = 224;
 
 - (void)changeFontSize:(CGFloat)delta {
     
-    if (interfaceType == PlatypusInterfaceType_WebView) {
+    if (INTERFACE_TYPE == PlatypusInterfaceType_WebView) {
+#ifndef SE_WITHOUT_WEBKIT
         // Web View
         if (delta > 0) {
             [webView makeTextLarger:self];
         } else {
             [webView makeTextSmaller:self];
         }
+#endif
     } else {
         // Text field
         CGFloat newFontSize = [textFont pointSize] + delta;
@@ -1383,7 +2033,23 @@ static const NSInteger detailsHeight = 224;
         }
 
         textFont = [[NSFontManager sharedFontManager] convertFont:textFont toSize:newFontSize];
-        [outputTextView setFont:textFont];
+        [ansiAttributes removeAllObjects];
+        if (hasStyledOutput) {
+            // Resize each font run so bold and italic text keep their traits
+            NSTextStorage *textStorage = [outputTextView textStorage];
+            [textStorage beginEditing];
+            [textStorage enumerateAttribute:NSFontAttributeName
+                                    inRange:NSMakeRange(0, [textStorage length])
+                                    options:0
+                                 usingBlock:^(id value, NSRange range, BOOL *stop) {
+                NSFont *font = value ? [[NSFontManager sharedFontManager] convertFont:value toSize:newFontSize] : textFont;
+                [textStorage addAttribute:NSFontAttributeName value:font range:range];
+            }];
+            [textStorage endEditing];
+        } else {
+            [outputTextView setFont:textFont];
+        }
+        [outputView setFont:textFont];
         [DEFAULTS setObject:@((float)newFontSize) forKey:ScriptExecDefaultsKey_UserFontSize];
         [outputTextView didChangeText];
     }
@@ -1438,15 +2104,164 @@ static const NSInteger detailsHeight = 224;
     }
 }
 
+#pragma mark - Job journal
+
+// ~/Library/Application Support/<bundle identifier>, created if needed
+- (NSString *)applicationSupportDirectory {
+    NSString *appSupportDir = [NSSearchPathForDirectoriesInDomains(NSApplicationSupportDirectory, NSUserDomainMask, YES) firstObject];
+    NSString *identifier = [[NSBundle mainBundle] bundleIdentifier] ? [[NSBundle mainBundle] bundleIdentifier] : appName;
+    NSString *dir = [appSupportDir stringByAppendingPathComponent:identifier];
+    if (![FILEMGR createDirectoryAtPath:dir withIntermediateDirectories:YES attributes:nil error:nil]) {
+        DLog(@"Unable to create directory %@", dir);
+        return nil;
+    }
+    return dir;
+}
+
+- (void)openJobJournal {
+    NSString *journalDir = [self applicationSupportDirectory];
+    if (journalDir == nil) {
+        return;
+    }
+    NSString *journalPath = [journalDir stringByAppendingPathComponent:@"JobQueue.journal"];
+    
+    int err = 0;
+    jobJournal = SEJobJournalOpen([journalPath fileSystemRepresentation], &err);
+    if (jobJournal == NULL) {
+        DLog(@"Unable to open job journal %@: %s", journalPath, strerror(err));
+        return;
+    }
+    
+    NSMutableArray <NSNumber *> *unreadable = [NSMutableArray array];
+    size_t count = SEJobJournalRecoveredCount(jobJournal);
+    for (size_t i = 0; i < count; i++) {
+        const SEJournaledJob *journaled = SEJobJournalRecoveredJob(jobJournal, i);
+        NSData *payload = [NSData dataWithBytes:journaled->payload length:journaled->length];
+        SEJob *job = [SEJob jobWithJournalPayload:payload];
+        if (job == nil || ![jobQueue addJob:job]) {
+            [unreadable addObject:@(journaled->identifier)];
+            continue;
+        }
+        [job setJournalIdentifier:journaled->identifier];
+        SEMetricsJobQueued(metrics);
+    }
+    // Also drops duplicates, which can't normally be journaled
+    for (NSNumber *identifier in unreadable) {
+        SEJobJournalMarkCompleted(jobJournal, [identifier unsignedLongLongValue]);
+    }
+    SEMetricsSetQueueDepth(metrics, (unsigned int)[jobQueue count]);
+    DLog(@"Recovered %lu jobs from journal", (unsigned long)[jobQueue count]);
+}
+
+// Records are synced in batches. Make sure the last ones in a batch
+// get synced even if no more jobs come along.
+- (void)jobJournalChanged {
+    if (jobJournalSyncScheduled || !SEJobJournalNeedsSync(jobJournal)) {
+        return;
+    }
+    jobJournalSyncScheduled = YES;
+    [self performSelector:@selector(syncJobJournal) withObject:nil afterDelay:1.0];
+}
+
+- (void)syncJobJournal {
+    jobJournalSyncScheduled = NO;
+    if (jobJournal) {
+        SEJobJournalSync(jobJournal);
+    }
+}
+
+#pragma mark - Job server
+
+- (void)startJobServer {
+    NSString *dir = [self applicationSupportDirectory];
+    if (dir == nil) {
+        return;
+    }
+    jobServer = [SEJobServer serverWithPath:[dir stringByAppendingPathComponent:@PLATYPUS_JOB_SOCKET_NAME]];
+    if (jobServer == nil) {
+        DLog(@"Unable to start job server");
+        return;
+    }
+    __weak SEController *weakSelf = self;
+    [jobServer startWithSubmissionHandler:^NSString *(SEJob *job) {
+        SEController *strongSelf = weakSelf;
+        return strongSelf ? [strongSelf submitJob:job] : @"Application is quitting";
+    }];
+}
+
+- (NSString *)submitJob:(SEJob *)job {
+    if (![self addJobToQueue:job]) {
+        return @"An identical job is already queued";
+    }
+    // Started on the next pass through the run loop, after the client has
+    // been told the job was accepted, and once a whole batch of pipelined
+    // submissions has been queued in order of priority
+    if (hasFinishedLaunching) {
+        [self performSelector:@selector(executeQueuedJob) withObject:nil afterDelay:0.0];
+    }
+    return nil;
+}
+
+- (void)executeQueuedJob {
+    if (!isTaskRunning && [jobQueue count] > 0) {
+        [self executeScript];
+    }
+}
+
 #pragma mark - Add job to queue
 
+// Items dropped or opened with the Option key held down are queued ahead
+// of others. Returns NO if the job is identical to a queued job.
+- (BOOL)enqueueJob:(SEJob *)job {
+    if ([NSEvent modifierFlags] & NSEventModifierFlagOption) {
+        [job setPriority:SEJobPriority_High];
+    }
+    return [self addJobToQueue:job];
+}
+
+// Jobs identical to a queued job are dropped. Returns NO if so.
+- (BOOL)addJobToQueue:(SEJob *)job {
+    if (![jobQueue addJob:job]) {
+        DLog(@"Job already queued");
+        return NO;
+    }
+    if (jobJournal) {
+        NSData *payload = [job journalPayload];
+        [job setJournalIdentifier:SEJobJournalAppendQueued(jobJournal, [payload bytes], [payload length])];
+        [self jobJournalChanged];
+    }
+    SEMetricsJobQueued(metrics);
+    SEMetricsSetQueueDepth(metrics, (unsigned int)[jobQueue count]);
+    if (isTaskRunning) {
+        [interpreterPool fillForJobCount:[jobQueue count]];
+    }
+    return YES;
+}
+
+- (void)cancelQueuedJobs:(NSArray <SEJob *> *)jobs {
+    for (SEJob *job in jobs) {
+        [jobQueue removeJob:job];
+        if (jobJournal && [job journalIdentifier]) {
+            SEJobJournalMarkCompleted(jobJournal, [job journalIdentifier]);
+        }
+        if ([job completionHandler]) {
+            [job completionHandler](-1);
+            [job setCompletionHandler:nil];
+            [job setOutputHandler:nil];
+        }
+    }
+    if (jobJournal) {
+        [self jobJournalChanged];
+    }
+    SEMetricsSetQueueDepth(metrics, (unsigned int)[jobQueue count]);
+}
+
 - (BOOL)addDroppedTextJob:(NSString *)text {
     if (!acceptsText) {
         return NO;
     }
     SEJob *job = [SEJob jobWithArguments:nil andStandardInput:text];
-    [jobQueue addObject:job];
-    return YES;
+    return [self enqueueJob:job];
 }
 
 // Processing dropped files
@@ -1468,7 +2283,10 @@ static const NSInteger detailsHeight = 224;
     
     // We create a job and add the files as arguments
     SEJob *job = [SEJob jobWithArguments:acceptedFiles andStandardInput:nil];
-    [jobQueue addObject:job];
+    [job setUnorderedArguments:YES];
+    if (![self enqueueJob:job]) {
+        return NO;
+    }
     
     // Add to Open Recent menu
     for (NSString *path in acceptedFiles) {
@@ -1480,14 +2298,14 @@ static const NSInteger detailsHeight = 224;
 
 - (BOOL)addURLJob:(NSString *)urlStr {
     SEJob *job = [SEJob jobWithArguments:@[urlStr] andStandardInput:nil];
-    [jobQueue addObject:job];
-    return YES;
+    return [self enqueueJob:job];
 }
 
+// Selecting an item twice runs the script twice
 - (BOOL)addMenuItemSelectedJob:(NSString *)menuItemTitle {
     SEJob *job = [SEJob jobWithArguments:@[menuItemTitle] andStandardInput:nil];
-    [jobQueue addObject:job];
-    return YES;
+    [job setDeduplicated:NO];
+    return [self enqueueJob:job];
 }
 
 /*********************************************
@@ -1563,7 +2381,7 @@ static const NSInteger detailsHeight = 224;
     
     if (acceptDrag) {
         // Shade the window if interface type is droplet
-        if (interfaceType == PlatypusInterfaceType_Droplet) {
+        if (INTERFACE_TYPE == PlatypusInterfaceType_Droplet) {
             [dropletShaderView setAlphaValue:0.3];
             [dropletShaderView setHidden:NO];
         }
@@ -1581,7 +2399,7 @@ static const NSInteger detailsHeight = 224;
 
 - (void)draggingExited:(id <NSDraggingInfo>)sender {
     // Hide droplet shading on drag exit
-    if (interfaceType == PlatypusInterfaceType_Droplet) {
+    if (INTERFACE_TYPE == PlatypusInterfaceType_Droplet) {
         [dropletShaderView setHidden:YES];
     }
 }
@@ -1602,7 +2420,7 @@ static const NSInteger detailsHeight = 224;
 // Once the drag is over, we immediately execute w. files as arguments if not already processing
 - (void)concludeDragOperation:(id <NSDraggingInfo>)sender {
     // Shade droplet
-    if (interfaceType == PlatypusInterfaceType_Droplet) {
+    if (INTERFACE_TYPE == PlatypusInterfaceType_Droplet) {
         [dropletShaderView setHidden:YES];
     }
     // Fire off the job queue if nothing is running
@@ -1617,6 +2435,7 @@ static const NSInteger detailsHeight = 224;
     return [self draggingEntered:sender];
 }
 
+#ifndef SE_WITHOUT_WEBKIT
 #pragma mark - Web View
 
 /**************************************************
@@ -1640,7 +2459,9 @@ static const NSInteger detailsHeight = 224;
     NSRect bounds = [[[[webView mainFrame] frameView] documentView] bounds];
     [[scrollView documentView] scrollPoint:NSMakePoint(0, bounds.size.height)];
 }
+#endif
 
+#ifndef SE_WITHOUT_STATUS_ITEM
 #pragma mark - Status Menu
 
 - (NSImage *)imageForMenuItemFromString:(NSString *)str {
@@ -1801,6 +2622,7 @@ static const NSInteger detailsHeight = 224;
         [menu insertItem:menuItem atIndex:0];
     }
 }
+#endif
 
 - (IBAction)menuItemSelected:(id)sender {
     [self addMenuItemSelectedJob:[sender title]];
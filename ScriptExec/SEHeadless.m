@@ -0,0 +1,301 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#import <Cocoa/Cocoa.h>
+#import <fcntl.h>
+#import <poll.h>
+#import <unistd.h>
+#import <sys/wait.h>
+#import <crt_externs.h>
+
+#import "Common.h"
+#import "SEHeadless.h"
+#import "SEAppSettings.h"
+#import "SEController.h"
+#import "SEControlChannel.h"
+#import "PlatypusSpawn.h"
+#import "SEProcessTree.h"
+#import "Alerts.h"
+
+// Platypus warns about exec interpreter mode for apps that fail these checks,
+// see -[PlatypusAppSpec headlessLaunchObstacles]. Keep the two in sync.
+static BOOL IsHeadlessCapable(SEAppSettings *settings, NSDictionary *infoPlist) {
+    return (settings.interfaceType == PlatypusInterfaceType_None &&
+            settings.execStyle == PlatypusExecStyle_Normal &&
+            settings.acceptsFiles == NO &&
+            settings.acceptsText == NO &&
+            settings.promptForFile == NO &&
+            settings.sendsNotifications == NO &&
+            settings.remainRunning == NO &&
+            [settings.jobLimits length] == 0 &&
+            [settings.URISchemes count] == 0 &&
+            infoPlist[@"NSServices"] == nil);
+}
+
+// Exec mode leaves nothing behind to write the output log, so apps that
+// log their output run the script as a child instead. Platypus warns about
+// this too, see -[PlatypusAppSpec execInterpreterObstacles].
+static BOOL CanExecInterpreter(SEAppSettings *settings) {
+    return settings.execInterpreter && !settings.logOutput;
+}
+
+// Replace this process with the interpreter. Only returns on failure.
+static void ExecInterpreter(NSString *interpreterPath, NSArray <NSString *> *arguments, NSString *cwd) {
+    const char *path = [interpreterPath fileSystemRepresentation];
+    const char **argv = calloc([arguments count] + 2, sizeof(char *));
+    if (argv == NULL) {
+        return;
+    }
+    argv[0] = path;
+    for (NSUInteger i = 0; i < [arguments count]; i++) {
+        argv[i + 1] = [arguments[i] UTF8String];
+    }
+    
+    if (chdir([cwd fileSystemRepresentation]) == 0) {
+        fflush(stdout);
+        fflush(stderr);
+        execve(path, (char * const *)argv, *_NSGetEnviron());
+    }
+    free(argv);
+}
+
+static void ShowAlert(NSString *title, NSString *text) {
+    // Only now do we pay for AppKit
+    [NSApplication sharedApplication];
+    [Alerts alert:title subText:text];
+}
+
+// Handle a control channel command. Only quitting and alerts
+// apply to apps without an interface. Returns NO if the app should quit.
+static BOOL HandleCommand(NSDictionary *command) {
+    NSString *name = command[@"command"];
+    if ([name isEqualToString:@"quit"]) {
+        return NO;
+    }
+    if ([name isEqualToString:@"alert"]) {
+        NSString *title = command[@"title"] ? [command[@"title"] description] : @"";
+        ShowAlert(title, command[@"text"] ? [command[@"text"] description] : title);
+    }
+    return YES;
+}
+
+// Handle a complete line of output. Mirrors -[SEController parseOutput:]
+// for interface type None. Returns NO if the app should quit.
+static BOOL HandleLine(const char *line, size_t len) {
+    SEOutputCommand command;
+    switch (SEOutputCommandParse(line, len, &command)) {
+        case SEOutputCommand_Quit:
+            return NO;
+        case SEOutputCommand_Refresh:
+        case SEOutputCommand_Notification:
+            return YES;
+        case SEOutputCommand_Alert:
+            return HandleCommand(SEControlCommandFromOutputCommand(&command));
+        default:
+            break;
+    }
+    fwrite(line, 1, len, stderr);
+    fputc('\n', stderr);
+    return YES;
+}
+
+BOOL SEHeadlessRunIfPossible(int *exitStatus) {
+    NSBundle *bundle = [NSBundle mainBundle];
+    NSString *resourcePath = [bundle resourcePath];
+    
+    NSString *plistPath = [resourcePath stringByAppendingPathComponent:@"AppSettings.plist"];
+    SEAppSettings *settings = [SEAppSettings settingsWithSnapshotAtPath:[resourcePath stringByAppendingPathComponent:APP_SETTINGS_SNAPSHOT_NAME]
+                                                       propertyListPath:plistPath];
+    if (settings == nil) {
+        settings = [SEAppSettings settingsWithPropertyListAtPath:plistPath];
+    }
+    // Leave all error reporting to the regular launch path
+    if (settings == nil || !IsHeadlessCapable(settings, [bundle infoDictionary])) {
+        return NO;
+    }
+    if ([DEFAULTS boolForKey:ScriptExecDefaultsKey_DisableHeadless]) {
+        return NO;
+    }
+    
+    NSString *scriptPath = [resourcePath stringByAppendingPathComponent:@"script"];
+    NSString *interpreterPath = settings.interpreterPath;
+    if (![interpreterPath hasPrefix:@"/"]) {
+        interpreterPath = [resourcePath stringByAppendingPathComponent:interpreterPath];
+    }
+    if (access([scriptPath fileSystemRepresentation], R_OK) != 0 ||
+        access([interpreterPath fileSystemRepresentation], X_OK) != 0) {
+        return NO;
+    }
+    
+    NSMutableArray *arguments = [NSMutableArray array];
+    [arguments addObjectsFromArray:settings.interpreterArgs];
+    [arguments addObject:scriptPath];
+    [arguments addObjectsFromArray:settings.scriptArgs];
+    [arguments addObjectsFromArray:[SEController commandLineArguments]];
+    
+    // Exec mode: the interpreter takes over this process and inherits
+    // stdin/stdout/stderr, so there is no wrapper left to relay output.
+    // Falls through to the regular headless path if execve() fails.
+    if (CanExecInterpreter(settings)) {
+        ExecInterpreter(interpreterPath, arguments, resourcePath);
+    }
+    
+    SEControlChannel *controlChannel = [SEControlChannel channel];
+    [controlChannel exportToEnvironment];
+    
+    int outputPipe[2];
+    if (pipe(outputPipe) == -1) {
+        [controlChannel close];
+        return NO;
+    }
+    fcntl(outputPipe[0], F_SETFD, FD_CLOEXEC);
+    fcntl(outputPipe[1], F_SETFD, FD_CLOEXEC);
+    
+    // Script gets an empty stdin, as with the regular launch path
+    char **argv = PlatypusSpawnArguments([@[interpreterPath] arrayByAddingObjectsFromArray:arguments]);
+    PlatypusSpawnAttributes attributes;
+    PlatypusSpawnAttributesInit(&attributes, argv[0], argv);
+    attributes.directory = [resourcePath fileSystemRepresentation];
+    attributes.fds[1] = outputPipe[1];
+    attributes.fds[2] = outputPipe[1];
+    attributes.processGroup = 1;
+    pid_t pid;
+    int err = PlatypusSpawn(&attributes, &pid);
+    free(argv);
+    // Close our copy of the write end so we get EOF when the script exits
+    close(outputPipe[1]);
+    if (err) {
+        close(outputPipe[0]);
+        [controlChannel close];
+        return NO;
+    }
+    
+    // Read output synchronously on the main thread, split into lines on
+    // \r or \n. No run loop or notifications needed. In pass-through mode
+    // output is copied to stderr as is.
+    struct pollfd fds[2] = {
+        { .fd = outputPipe[0], .events = POLLIN },
+        { .fd = controlChannel ? controlChannel.fileDescriptor : -1, .events = POLLIN }
+    };
+    BOOL passThrough = settings.controlChannelOnly;
+    SEOutputLog *outputLog = NULL;
+    if (settings.logOutput) {
+        NSString *appName = [bundle infoDictionary][@"CFBundleName"];
+        if (appName == nil) {
+            appName = [[bundle executablePath] lastPathComponent];
+        }
+        outputLog = [SEController openOutputLogForAppName:appName];
+    }
+    NSMutableData *pending = [NSMutableData data];
+    char buf[16384];
+    __block BOOL quit = NO;
+    
+    while (!quit) {
+        if (poll(fds, 2, -1) == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        
+        if (fds[1].revents & POLLIN) {
+            [controlChannel readCommandsWithHandler:^(NSDictionary *command) {
+                quit = quit || !HandleCommand(command);
+            }];
+        }
+        if (quit || !(fds[0].revents & (POLLIN | POLLHUP))) {
+            continue;
+        }
+        
+        ssize_t n = read(fds[0].fd, buf, sizeof(buf));
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        if (outputLog) {
+            SEOutputLogWrite(outputLog, buf, n);
+        }
+        if (passThrough) {
+            fwrite(buf, 1, n, stderr);
+            fflush(stderr);
+            continue;
+        }
+        [pending appendBytes:buf length:n];
+        
+        const char *bytes = [pending bytes];
+        size_t len = [pending length];
+        size_t start = 0;
+        for (size_t i = 0; i < len && !quit; i++) {
+            if (bytes[i] == '\n' || bytes[i] == '\r') {
+                quit = !HandleLine(bytes + start, i - start);
+                start = i + 1;
+            }
+        }
+        [pending replaceBytesInRange:NSMakeRange(0, start) withBytes:NULL length:0];
+        fflush(stderr);
+    }
+    
+    if (quit) {
+        // Take down everything the script has started along with it
+        SEProcessTree tree;
+        SEProcessTreeInit(&tree);
+        if (SEProcessTreeCollect(&tree, pid, 1) == 0) {
+            SEProcessTreeTerminate(&tree, SE_PROCESS_TREE_GRACE_PERIOD);
+        } else {
+            kill(pid, SIGTERM);
+        }
+        SEProcessTreeFree(&tree);
+    }
+    else if ([pending length]) {
+        // Script output ended without a trailing newline
+        HandleLine([pending bytes], [pending length]);
+    }
+    fflush(stderr);
+    int status;
+    int waitErr = PlatypusSpawnWait(pid, -1, -1, &status);
+    close(outputPipe[0]);
+    [controlChannel close];
+    SEOutputLogClose(outputLog);
+    
+    // Exit with the script's status, as exec mode does. A script killed by
+    // a signal gets the shell's 128 + signal. If the script asked the app
+    // to quit, it was taken down by us, which is a normal exit.
+    *exitStatus = 0;
+    if (!quit && waitErr == 0) {
+        if (WIFEXITED(status)) {
+            *exitStatus = WEXITSTATUS(status);
+        } else if (WIFSIGNALED(status)) {
+            *exitStatus = 128 + WTERMSIG(status);
+        }
+    }
+    return YES;
+}
@@ -0,0 +1,68 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Interpreters started ahead of time for queued jobs.
+//
+// While a job runs and more are queued, the pool starts spare interpreters
+// that have done their own start-up and wait for a job (see
+// SEWarmInterpreter.h). The next job is handed to a spare, instead of the
+// app launching the interpreter after the previous job exits. Jobs that
+// change environment variables the interpreter only reads when it starts
+// aren't handed to spares. Spares are capped, and let go once the queue is
+// empty.
+
+#import <Foundation/Foundation.h>
+
+#import "SEJobTask.h"
+
+@interface SEInterpreterPool : NSObject
+
+@property (nonatomic) NSUInteger maximumSpareCount;
+@property (nonatomic, readonly) NSUInteger spareCount;
+
+// Returns nil if the interpreter can't be started ahead of time with these
+// arguments. Spares run in the given directory, with the app's environment.
+- (instancetype)initWithInterpreterPath:(NSString *)path
+                              arguments:(NSArray <NSString *> *)args
+                       currentDirectory:(NSString *)directory;
+
+// Starts spares until there is one for each of the given number of jobs,
+// up to the maximum
+- (void)fillForJobCount:(NSUInteger)count;
+// Returns a running task that has been handed the script, with its
+// arguments and additional environment variables, or nil if no spare can
+// run it
+- (SEJobTask *)taskRunningScript:(NSString *)scriptPath
+                       arguments:(NSArray <NSString *> *)args
+                     environment:(NSDictionary <NSString *, NSString *> *)environment;
+// Lets all spares exit, e.g. once the queue is empty
+- (void)drain;
+
+@end
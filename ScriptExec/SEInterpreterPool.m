@@ -0,0 +1,154 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#import "Common.h"
+#import "SEInterpreterPool.h"
+#import "PlatypusSpawn.h"
+#import "SEWarmInterpreter.h"
+
+// Spares beyond this are never useful, since jobs run one at a time
+#define MAX_SPARE_COUNT 8
+
+@interface SEInterpreterPool()
+{
+    NSString *interpreterPath;
+    NSArray <NSString *> *interpreterArgs;
+    NSString *directory;
+    SEWarmInterpreterType type;
+    NSMutableArray <SEJobTask *> *spares;
+    // Spares let go of, kept until they have exited and been reaped
+    NSMutableSet <SEJobTask *> *retired;
+}
+@end
+
+@implementation SEInterpreterPool
+
+- (instancetype)initWithInterpreterPath:(NSString *)path
+                              arguments:(NSArray <NSString *> *)args
+                       currentDirectory:(NSString *)dir {
+    SEWarmInterpreterType interpreterType = SEWarmInterpreterType_None;
+    char **argv = PlatypusSpawnArguments(args);
+    if (argv) {
+        interpreterType = SEWarmInterpreterTypeForInterpreter([path fileSystemRepresentation],
+                                                              (const char *const *)argv, [args count]);
+    }
+    free(argv);
+    if (interpreterType == SEWarmInterpreterType_None) {
+        return nil;
+    }
+    
+    self = [super init];
+    if (self) {
+        interpreterPath = [path copy];
+        interpreterArgs = [args copy];
+        directory = [dir copy];
+        type = interpreterType;
+        spares = [NSMutableArray array];
+        retired = [NSMutableSet set];
+        _maximumSpareCount = 1;
+        [[NSNotificationCenter defaultCenter] addObserver:self
+                                                 selector:@selector(spareExited:)
+                                                     name:SEJobTaskDidTerminateNotification
+                                                   object:nil];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+    [self drain];
+}
+
+- (void)setMaximumSpareCount:(NSUInteger)count {
+    _maximumSpareCount = MIN(count, MAX_SPARE_COUNT);
+}
+
+- (NSUInteger)spareCount {
+    return [spares count];
+}
+
+- (void)fillForJobCount:(NSUInteger)count {
+    while ([spares count] < MIN(count, _maximumSpareCount)) {
+        SEJobTask *spare = [[SEJobTask alloc] init];
+        [spare setLaunchPath:interpreterPath];
+        [spare setArguments:interpreterArgs];
+        [spare setCurrentDirectoryPath:directory];
+        int err = [spare launchWarm];
+        if (err) {
+            DLog(@"Unable to start interpreter ahead of time: %s", strerror(err));
+            return;
+        }
+        [spares addObject:spare];
+    }
+}
+
+- (SEJobTask *)taskRunningScript:(NSString *)scriptPath
+                       arguments:(NSArray <NSString *> *)args
+                     environment:(NSDictionary <NSString *, NSString *> *)environment {
+    for (NSString *name in environment) {
+        if (SEWarmInterpreterReadsAtStartup(type, [name UTF8String])) {
+            return nil;
+        }
+    }
+    while ([spares count]) {
+        SEJobTask *spare = spares[0];
+        [spares removeObjectAtIndex:0];
+        if (![spare isRunning]) {
+            continue;
+        }
+        [spare setEnvironment:environment];
+        int err = [spare runScript:scriptPath arguments:args];
+        if (err == 0) {
+            return spare;
+        }
+        DLog(@"Unable to hand job to interpreter started ahead of time: %s", strerror(err));
+        [spare terminate];
+        [retired addObject:spare];
+    }
+    return nil;
+}
+
+- (void)drain {
+    // The interpreters exit once their standard input is closed
+    for (SEJobTask *spare in spares) {
+        [[spare inputFileHandle] closeFile];
+        [retired addObject:spare];
+    }
+    [spares removeAllObjects];
+}
+
+// Spares that exit before being handed a job are dropped
+- (void)spareExited:(NSNotification *)notification {
+    SEJobTask *exited = [notification object];
+    [spares removeObject:exited];
+    [retired removeObject:exited];
+}
+
+@end
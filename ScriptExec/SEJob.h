@@ -29,13 +29,71 @@
 */
 
 #import <Foundation/Foundation.h>
+#import "SEMetrics.h"
+#import "PlatypusJobLimits.h"
+
+typedef NS_ENUM(NSInteger, SEJobPriority) {
+    SEJobPriority_Low = -1,
+    SEJobPriority_Normal = 0,
+    SEJobPriority_High = 1
+};
 
 @interface SEJob : NSObject
 
 @property (nonatomic, copy) NSArray *arguments;
 @property (nonatomic, copy) NSString *standardInputString;
+@property (nonatomic) SEJobPriority priority;
+// Additional environment variables for the script, e.g. submission metadata.
+// Not applied to scripts run with administrator privileges unless they run
+// through the privileged helper.
+@property (nonatomic, copy) NSDictionary <NSString *, NSString *> *environment;
+// Limits for this job, combined with the app's own. Like the environment,
+// not applied to scripts run with administrator privileges unless they run
+// through the privileged helper.
+@property (nonatomic) PlatypusJobLimits limits;
+
+// Called on the main queue with the script's output while the job runs,
+// and with its exit status once it finishes, or -1 if it's cancelled.
+// Set by the job server for submissions whose client is waiting on them.
+@property (nonatomic, copy) void (^outputHandler)(NSData *data);
+@property (nonatomic, copy) void (^completionHandler)(int status);
+
+// Jobs for dropped files get the files in whatever order they were dropped,
+// so the same files in another order are the same job
+@property (nonatomic) BOOL unorderedArguments;
+// Jobs that are always run, even if an identical job is queued, e.g. for
+// selecting a status menu item twice. YES by default.
+@property (nonatomic) BOOL deduplicated;
+
+// Jobs with the same arguments, standard input, environment and limits have
+// the same key. nil for jobs that aren't deduplicated.
+@property (nonatomic, readonly) NSString *deduplicationKey;
+
+// Maintained by SEJobQueue
+@property (nonatomic) NSUInteger queueIndex;
+@property (nonatomic) uint64_t queueSequence;
+
+// Accounting. Jobs are timed from when they're created, i.e. queued.
+@property (nonatomic, readonly) SEJobRecord record;
+@property (nonatomic) uint64_t outputBytes;
+
+// Identifier in the job journal, 0 if not journaled
+@property (nonatomic) uint64_t journalIdentifier;
 
 - (instancetype)initWithArguments:(NSArray *)args andStandardInput:(NSString *)stdinStr;
 + (instancetype)jobWithArguments:(NSArray *)args andStandardInput:(NSString *)stdinStr;
 
+// Arguments, standard input, priority, environment, limits and deduplication
+// settings, serialized for the job journal
++ (instancetype)jobWithJournalPayload:(NSData *)payload;
+- (NSData *)journalPayload;
+
+// CPU time and memory use are measured as the difference in resource
+// usage of this process's terminated children, so only one job should
+// run at a time, and the task must have been reaped when finishing.
+- (void)markStarted;
+- (void)markFinishedWithStatus:(int)status;
+// Recorded for jobs terminated for exceeding their timeout
+- (void)markTimedOut;
+
 @end
@@ -28,9 +28,15 @@
     POSSIBILITY OF SUCH DAMAGE.
 */
 
+#import <sys/resource.h>
 #import "SEJob.h"
 
 @interface SEJob()
+{
+    SEJobRecord record;
+    struct rusage startUsage;
+    NSString *deduplicationKey;
+}
 @end
 
 @implementation SEJob
@@ -40,6 +46,10 @@
     if (self) {
         _arguments = args;
         _standardInputString = stdinStr;
+        _priority = SEJobPriority_Normal;
+        _deduplicated = YES;
+        _queueIndex = NSNotFound;
+        record.enqueueTime = SEMetricsNow();
     }
     return self;
 }
@@ -48,4 +58,164 @@
     return [[self alloc] initWithArguments:args andStandardInput:stdinStr];
 }
 
++ (instancetype)jobWithJournalPayload:(NSData *)payload {
+    NSDictionary *dict = [NSPropertyListSerialization propertyListWithData:payload
+                                                                   options:NSPropertyListImmutable
+                                                                    format:nil
+                                                                     error:nil];
+    if (![dict isKindOfClass:[NSDictionary class]]) {
+        return nil;
+    }
+    NSArray *args = dict[@"Arguments"];
+    NSString *stdinStr = dict[@"StandardInput"];
+    NSDictionary *env = dict[@"Environment"];
+    NSString *limitsStr = dict[@"Limits"];
+    if ((args && ![args isKindOfClass:[NSArray class]]) ||
+        (stdinStr && ![stdinStr isKindOfClass:[NSString class]]) ||
+        (env && ![env isKindOfClass:[NSDictionary class]]) ||
+        (limitsStr && ![limitsStr isKindOfClass:[NSString class]])) {
+        return nil;
+    }
+    PlatypusJobLimits limits = { 0 };
+    if (limitsStr && PlatypusJobLimitsParse([limitsStr UTF8String], &limits) != 0) {
+        return nil;
+    }
+    SEJob *job = [self jobWithArguments:args andStandardInput:stdinStr];
+    job.priority = [dict[@"Priority"] integerValue];
+    job.environment = env;
+    job.limits = limits;
+    job.unorderedArguments = [dict[@"UnorderedArguments"] boolValue];
+    job.deduplicated = dict[@"Deduplicated"] ? [dict[@"Deduplicated"] boolValue] : YES;
+    return job;
+}
+
+- (NSData *)journalPayload {
+    NSMutableDictionary *dict = [NSMutableDictionary dictionary];
+    if (_arguments) {
+        dict[@"Arguments"] = _arguments;
+    }
+    if (_standardInputString) {
+        dict[@"StandardInput"] = _standardInputString;
+    }
+    if (_priority != SEJobPriority_Normal) {
+        dict[@"Priority"] = @(_priority);
+    }
+    if ([_environment count]) {
+        dict[@"Environment"] = _environment;
+    }
+    if (PlatypusJobLimitsAny(&_limits)) {
+        char limitsStr[PLATYPUS_JOB_LIMITS_MAX_LENGTH];
+        PlatypusJobLimitsFormat(&_limits, limitsStr, sizeof(limitsStr));
+        dict[@"Limits"] = @(limitsStr);
+    }
+    if (_unorderedArguments) {
+        dict[@"UnorderedArguments"] = @YES;
+    }
+    if (!_deduplicated) {
+        dict[@"Deduplicated"] = @NO;
+    }
+    return [NSPropertyListSerialization dataWithPropertyList:dict
+                                                      format:NSPropertyListBinaryFormat_v1_0
+                                                     options:0
+                                                       error:nil];
+}
+
+- (void)setArguments:(NSArray *)arguments {
+    _arguments = [arguments copy];
+    deduplicationKey = nil;
+}
+
+- (void)setStandardInputString:(NSString *)standardInputString {
+    _standardInputString = [standardInputString copy];
+    deduplicationKey = nil;
+}
+
+- (void)setEnvironment:(NSDictionary<NSString *,NSString *> *)environment {
+    _environment = [environment copy];
+    deduplicationKey = nil;
+}
+
+- (void)setLimits:(PlatypusJobLimits)limits {
+    _limits = limits;
+    deduplicationKey = nil;
+}
+
+- (void)setUnorderedArguments:(BOOL)unorderedArguments {
+    _unorderedArguments = unorderedArguments;
+    deduplicationKey = nil;
+}
+
+// Computed once, since queues look it up on every change
+- (NSString *)deduplicationKey {
+    if (!_deduplicated) {
+        return nil;
+    }
+    if (deduplicationKey) {
+        return deduplicationKey;
+    }
+    // NUL can't appear in arguments, environment variables or limits, so it
+    // separates them unambiguously. Each part ends with two NULs. Standard
+    // input, which may contain anything, comes last.
+    NSString *separator = [NSString stringWithFormat:@"%C", (unichar)0];
+    NSMutableString *key = [NSMutableString string];
+    NSArray *args = _arguments;
+    if (_unorderedArguments) {
+        args = [args sortedArrayUsingSelector:@selector(compare:)];
+    }
+    for (NSString *arg in args) {
+        [key appendString:arg];
+        [key appendString:separator];
+    }
+    [key appendString:separator];
+    for (NSString *name in [[_environment allKeys] sortedArrayUsingSelector:@selector(compare:)]) {
+        [key appendFormat:@"%@=%@%@", name, _environment[name], separator];
+    }
+    [key appendString:separator];
+    if (PlatypusJobLimitsAny(&_limits)) {
+        char limitsStr[PLATYPUS_JOB_LIMITS_MAX_LENGTH];
+        PlatypusJobLimitsFormat(&_limits, limitsStr, sizeof(limitsStr));
+        [key appendString:@(limitsStr)];
+    }
+    [key appendString:separator];
+    [key appendString:separator];
+    if (_standardInputString) {
+        [key appendString:_standardInputString];
+    }
+    deduplicationKey = [key copy];
+    return deduplicationKey;
+}
+
+- (SEJobRecord)record {
+    SEJobRecord r = record;
+    r.outputBytes = _outputBytes;
+    return r;
+}
+
+- (void)markStarted {
+    record.startTime = SEMetricsNow();
+    record.startDate = [[NSDate date] timeIntervalSince1970];
+    getrusage(RUSAGE_CHILDREN, &startUsage);
+}
+
+- (void)markFinishedWithStatus:(int)status {
+    record.endTime = SEMetricsNow();
+    record.exitStatus = status;
+    
+    struct rusage usage;
+    getrusage(RUSAGE_CHILDREN, &usage);
+    record.userTime = (usage.ru_utime.tv_sec - startUsage.ru_utime.tv_sec) +
+                      (usage.ru_utime.tv_usec - startUsage.ru_utime.tv_usec) / 1e6;
+    record.systemTime = (usage.ru_stime.tv_sec - startUsage.ru_stime.tv_sec) +
+                        (usage.ru_stime.tv_usec - startUsage.ru_stime.tv_usec) / 1e6;
+    // ru_maxrss is the largest of any child so far, in bytes on macOS.
+    // Only attributable to this job if it grew while the job ran.
+    if (usage.ru_maxrss > startUsage.ru_maxrss) {
+        record.maxResidentSize = (uint64_t)usage.ru_maxrss;
+    }
+}
+
+- (void)markTimedOut {
+    record.timedOut = 1;
+}
+
 @end
@@ -0,0 +1,493 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include "SEJobJournal.h"
+#include "PlatypusClock.h"
+
+#define MAGIC               "PJQJ"
+#define VERSION             1
+#define FILE_HEADER_SIZE    8
+#define RECORD_HEADER_SIZE  20
+#define MAX_PAYLOAD         (64 * 1024 * 1024)
+
+#define SYNC_RECORDS        256
+#define SYNC_INTERVAL       1.0
+
+// Compact once the journal has this many records, most for completed jobs
+#define COMPACT_RECORDS     1024
+#define COMPACT_RATIO       4
+
+typedef enum RecordType {
+    RecordType_Queued = 1,
+    RecordType_Started,
+    RecordType_Completed
+} RecordType;
+
+typedef struct Entry {
+    SEJournaledJob job;
+    int live;
+} Entry;
+
+struct SEJobJournal {
+    char *path;
+    int fd;
+    
+    // Pending jobs, ordered by identifier, i.e. the order they were queued
+    Entry *entries;
+    size_t count;
+    size_t capacity;
+    size_t liveCount;
+    
+    uint64_t nextIdentifier;
+    size_t fileRecords;
+    size_t unsyncedRecords;
+    double lastSync;
+};
+
+static int WriteAll(int fd, const void *bytes, size_t length) {
+    const char *p = bytes;
+    while (length) {
+        ssize_t n = write(fd, p, length);
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return (n == 0) ? EIO : errno;
+        }
+        p += n;
+        length -= (size_t)n;
+    }
+    return 0;
+}
+
+#pragma mark - Records
+
+// Record header: payload length, checksum of the rest of the record, type,
+// three bytes of padding and job identifier. Native byte order.
+static uint32_t Checksum(const unsigned char *header, const void *payload, uint32_t length) {
+    uLong crc = crc32(0L, Z_NULL, 0);
+    crc = crc32(crc, header + 8, RECORD_HEADER_SIZE - 8);
+    if (length) {
+        crc = crc32(crc, payload, length);
+    }
+    return (uint32_t)crc;
+}
+
+static int WriteRecord(int fd, RecordType type, uint64_t identifier, const void *payload, size_t length) {
+    unsigned char stackBuf[256];
+    size_t size = RECORD_HEADER_SIZE + length;
+    unsigned char *buf = (size <= sizeof(stackBuf)) ? stackBuf : malloc(size);
+    if (buf == NULL) {
+        return ENOMEM;
+    }
+    
+    uint32_t length32 = (uint32_t)length;
+    memset(buf, 0, RECORD_HEADER_SIZE);
+    memcpy(buf, &length32, 4);
+    buf[8] = (unsigned char)type;
+    memcpy(buf + 12, &identifier, 8);
+    uint32_t crc = Checksum(buf, payload, length32);
+    memcpy(buf + 4, &crc, 4);
+    if (length) {
+        memcpy(buf + RECORD_HEADER_SIZE, payload, length);
+    }
+    
+    // A single write, so a crash leaves at most one partial record
+    int err = WriteAll(fd, buf, size);
+    if (buf != stackBuf) {
+        free(buf);
+    }
+    return err;
+}
+
+static Entry *FindEntry(SEJobJournal *journal, uint64_t identifier) {
+    size_t low = 0;
+    size_t high = journal->count;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        uint64_t midIdentifier = journal->entries[mid].job.identifier;
+        if (midIdentifier == identifier) {
+            return &journal->entries[mid];
+        }
+        if (midIdentifier < identifier) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return NULL;
+}
+
+static int AddEntry(SEJobJournal *journal, uint64_t identifier, const void *payload, size_t length) {
+    if (journal->count == journal->capacity) {
+        size_t capacity = journal->capacity ? journal->capacity * 2 : 64;
+        Entry *entries = realloc(journal->entries, capacity * sizeof(Entry));
+        if (entries == NULL) {
+            return ENOMEM;
+        }
+        journal->entries = entries;
+        journal->capacity = capacity;
+    }
+    void *copy = malloc(length ? length : 1);
+    if (copy == NULL) {
+        return ENOMEM;
+    }
+    memcpy(copy, payload, length);
+    
+    Entry *entry = &journal->entries[journal->count++];
+    entry->job.identifier = identifier;
+    entry->job.attempts = 0;
+    entry->job.payload = copy;
+    entry->job.length = length;
+    entry->live = 1;
+    journal->liveCount++;
+    return 0;
+}
+
+static void RemoveEntry(SEJobJournal *journal, Entry *entry) {
+    free((void *)entry->job.payload);
+    entry->job.payload = NULL;
+    entry->live = 0;
+    journal->liveCount--;
+}
+
+// Drops completed jobs from the entries array
+static void Squeeze(SEJobJournal *journal) {
+    size_t j = 0;
+    for (size_t i = 0; i < journal->count; i++) {
+        if (journal->entries[i].live) {
+            journal->entries[j++] = journal->entries[i];
+        }
+    }
+    journal->count = j;
+}
+
+#pragma mark - Recovery
+
+static int ReadFile(int fd, unsigned char **bytes, size_t *length) {
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        return errno;
+    }
+    size_t size = (size_t)st.st_size;
+    unsigned char *buf = malloc(size ? size : 1);
+    if (buf == NULL) {
+        return ENOMEM;
+    }
+    size_t total = 0;
+    while (total < size) {
+        ssize_t n = pread(fd, buf + total, size - total, (off_t)total);
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        total += (size_t)n;
+    }
+    *bytes = buf;
+    *length = total;
+    return 0;
+}
+
+// Replays records up to the first one that is incomplete or damaged
+static int Recover(SEJobJournal *journal, const unsigned char *bytes, size_t length) {
+    if (length < FILE_HEADER_SIZE || memcmp(bytes, MAGIC, 4) != 0) {
+        return 0;
+    }
+    size_t offset = FILE_HEADER_SIZE;
+    while (length - offset >= RECORD_HEADER_SIZE) {
+        const unsigned char *header = bytes + offset;
+        uint32_t payloadLength;
+        uint32_t crc;
+        uint64_t identifier;
+        memcpy(&payloadLength, header, 4);
+        memcpy(&crc, header + 4, 4);
+        memcpy(&identifier, header + 12, 8);
+        RecordType type = header[8];
+        
+        if (payloadLength > MAX_PAYLOAD || length - offset - RECORD_HEADER_SIZE < payloadLength) {
+            break;
+        }
+        const unsigned char *payload = header + RECORD_HEADER_SIZE;
+        if (Checksum(header, payload, payloadLength) != crc) {
+            break;
+        }
+        offset += RECORD_HEADER_SIZE + payloadLength;
+        
+        if (identifier >= journal->nextIdentifier) {
+            journal->nextIdentifier = identifier + 1;
+        }
+        Entry *entry = (type == RecordType_Queued) ? NULL : FindEntry(journal, identifier);
+        switch (type) {
+            case RecordType_Queued:
+                // Identifiers only increase, so entries stay ordered
+                if (journal->count && journal->entries[journal->count - 1].job.identifier >= identifier) {
+                    break;
+                }
+                if (AddEntry(journal, identifier, payload, payloadLength)) {
+                    return ENOMEM;
+                }
+                break;
+            case RecordType_Started:
+                if (entry && entry->live) {
+                    entry->job.attempts++;
+                }
+                break;
+            case RecordType_Completed:
+                if (entry && entry->live) {
+                    RemoveEntry(journal, entry);
+                }
+                break;
+            default:
+                break;
+        }
+    }
+    
+    // Jobs that were started too many times without completing
+    for (size_t i = 0; i < journal->count; i++) {
+        Entry *entry = &journal->entries[i];
+        if (entry->live && entry->job.attempts >= SE_JOB_JOURNAL_MAX_ATTEMPTS) {
+            RemoveEntry(journal, entry);
+        }
+    }
+    Squeeze(journal);
+    return 0;
+}
+
+#pragma mark - Public
+
+SEJobJournal *SEJobJournalOpen(const char *path, int *error) {
+    SEJobJournal *journal = calloc(1, sizeof(SEJobJournal));
+    if (journal == NULL || (journal->path = strdup(path)) == NULL) {
+        free(journal);
+        *error = ENOMEM;
+        return NULL;
+    }
+    journal->nextIdentifier = 1;
+    
+    int err = 0;
+    journal->fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (journal->fd != -1) {
+        unsigned char *bytes = NULL;
+        size_t length = 0;
+        err = ReadFile(journal->fd, &bytes, &length);
+        if (!err) {
+            err = Recover(journal, bytes, length);
+        }
+        free(bytes);
+        close(journal->fd);
+    } else if (errno != ENOENT) {
+        err = errno;
+    }
+    journal->fd = -1;
+    
+    // Start from a compacted journal, which also drops any damaged records
+    if (!err) {
+        err = SEJobJournalCompact(journal);
+    }
+    if (err) {
+        journal->liveCount = 0;
+        SEJobJournalClose(journal);
+        *error = err;
+        return NULL;
+    }
+    return journal;
+}
+
+void SEJobJournalClose(SEJobJournal *journal) {
+    if (journal == NULL) {
+        return;
+    }
+    if (journal->fd != -1) {
+        SEJobJournalSync(journal);
+        close(journal->fd);
+    }
+    for (size_t i = 0; i < journal->count; i++) {
+        free((void *)journal->entries[i].job.payload);
+    }
+    free(journal->entries);
+    free(journal->path);
+    free(journal);
+}
+
+size_t SEJobJournalRecoveredCount(const SEJobJournal *journal) {
+    return journal->count;
+}
+
+const SEJournaledJob *SEJobJournalRecoveredJob(const SEJobJournal *journal, size_t index) {
+    return &journal->entries[index].job;
+}
+
+static int RecordWritten(SEJobJournal *journal) {
+    journal->fileRecords++;
+    journal->unsyncedRecords++;
+    if (journal->unsyncedRecords >= SYNC_RECORDS || PlatypusClockNow() - journal->lastSync >= SYNC_INTERVAL) {
+        return SEJobJournalSync(journal);
+    }
+    return 0;
+}
+
+uint64_t SEJobJournalAppendQueued(SEJobJournal *journal, const void *payload, size_t length) {
+    if (length > MAX_PAYLOAD) {
+        return 0;
+    }
+    uint64_t identifier = journal->nextIdentifier;
+    if (WriteRecord(journal->fd, RecordType_Queued, identifier, payload, length) != 0) {
+        return 0;
+    }
+    // The job is journaled even if we fail to keep track of it here, so
+    // it will at worst be run again on next launch
+    journal->nextIdentifier++;
+    AddEntry(journal, identifier, payload, length);
+    RecordWritten(journal);
+    return identifier;
+}
+
+int SEJobJournalMarkStarted(SEJobJournal *journal, uint64_t identifier) {
+    Entry *entry = FindEntry(journal, identifier);
+    if (entry == NULL || !entry->live) {
+        return ENOENT;
+    }
+    int err = WriteRecord(journal->fd, RecordType_Started, identifier, NULL, 0);
+    if (err) {
+        return err;
+    }
+    entry->job.attempts++;
+    return RecordWritten(journal);
+}
+
+int SEJobJournalMarkCompleted(SEJobJournal *journal, uint64_t identifier) {
+    Entry *entry = FindEntry(journal, identifier);
+    if (entry == NULL || !entry->live) {
+        return ENOENT;
+    }
+    int err = WriteRecord(journal->fd, RecordType_Completed, identifier, NULL, 0);
+    if (err) {
+        return err;
+    }
+    RemoveEntry(journal, entry);
+    err = RecordWritten(journal);
+    
+    if (journal->fileRecords >= COMPACT_RECORDS && journal->liveCount * COMPACT_RATIO < journal->fileRecords) {
+        err = SEJobJournalCompact(journal);
+    }
+    return err;
+}
+
+int SEJobJournalNeedsSync(const SEJobJournal *journal) {
+    return journal->unsyncedRecords > 0;
+}
+
+int SEJobJournalSync(SEJobJournal *journal) {
+    journal->lastSync = PlatypusClockNow();
+    journal->unsyncedRecords = 0;
+    return (fsync(journal->fd) == 0) ? 0 : errno;
+}
+
+static void SyncDirectory(const char *path) {
+    char dir[PATH_MAX];
+    snprintf(dir, sizeof(dir), "%s", path);
+    char *slash = strrchr(dir, '/');
+    if (slash == NULL) {
+        snprintf(dir, sizeof(dir), ".");
+    } else if (slash == dir) {
+        dir[1] = '\0';
+    } else {
+        *slash = '\0';
+    }
+    int fd = open(dir, O_RDONLY | O_CLOEXEC);
+    if (fd != -1) {
+        fsync(fd);
+        close(fd);
+    }
+}
+
+int SEJobJournalCompact(SEJobJournal *journal) {
+    Squeeze(journal);
+    
+    char tmpPath[PATH_MAX];
+    if ((size_t)snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", journal->path) >= sizeof(tmpPath)) {
+        return ENAMETOOLONG;
+    }
+    int fd = open(tmpPath, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0600);
+    if (fd == -1) {
+        return errno;
+    }
+    
+    unsigned char header[FILE_HEADER_SIZE] = MAGIC;
+    uint32_t version = VERSION;
+    memcpy(header + 4, &version, 4);
+    int err = WriteAll(fd, header, FILE_HEADER_SIZE);
+    
+    size_t records = 0;
+    for (size_t i = 0; i < journal->count && !err; i++) {
+        const SEJournaledJob *job = &journal->entries[i].job;
+        err = WriteRecord(fd, RecordType_Queued, job->identifier, job->payload, job->length);
+        records++;
+        for (unsigned int a = 0; a < job->attempts && !err; a++) {
+            err = WriteRecord(fd, RecordType_Started, job->identifier, NULL, 0);
+            records++;
+        }
+    }
+    
+    // The compacted journal must be on disk before it replaces the old one
+    if (!err && fsync(fd) == -1) {
+        err = errno;
+    }
+    if (!err && rename(tmpPath, journal->path) == -1) {
+        err = errno;
+    }
+    if (err) {
+        close(fd);
+        unlink(tmpPath);
+        return err;
+    }
+    SyncDirectory(journal->path);
+    
+    if (journal->fd != -1) {
+        close(journal->fd);
+    }
+    journal->fd = fd;
+    journal->fileRecords = records;
+    journal->unsyncedRecords = 0;
+    journal->lastSync = PlatypusClockNow();
+    return 0;
+}
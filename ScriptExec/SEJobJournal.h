@@ -0,0 +1,98 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Append-only journal of queued jobs, so that jobs survive the app quitting
+// or crashing before they are run.
+//
+// Each job is journaled when it is queued, with an opaque payload describing
+// it, and again when it starts and completes. When a journal is opened, the
+// jobs that never completed are recovered, in the order they were queued.
+// Jobs that were started but didn't complete are recovered too, unless they
+// have been started SE_JOB_JOURNAL_MAX_ATTEMPTS times, in which case they
+// are assumed to make the app crash and are dropped.
+//
+// Records are written as they happen, so they survive the app crashing.
+// To survive a system crash they must also be synced to disk, which is done
+// at most once a second or every 256 records, or on SEJobJournalSync.
+// Each record has a checksum, and a partially written record at the end of
+// the journal is ignored. The journal is compacted, keeping only records of
+// pending jobs, when opened and when completed jobs make up most of it.
+// Portable C, needs zlib.
+
+#ifndef SE_JOB_JOURNAL_H
+#define SE_JOB_JOURNAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SE_JOB_JOURNAL_MAX_ATTEMPTS     3
+
+typedef struct SEJournaledJob {
+    uint64_t identifier;
+    unsigned int attempts;      // Number of times the job was started
+    const void *payload;
+    size_t length;
+} SEJournaledJob;
+
+typedef struct SEJobJournal SEJobJournal;
+
+// Opens a journal, creating it if it doesn't exist, and recovers pending
+// jobs. Returns NULL and sets *error to an errno value on failure.
+SEJobJournal *SEJobJournalOpen(const char *path, int *error);
+// Syncs and closes the journal
+void SEJobJournalClose(SEJobJournal *journal);
+
+// Jobs recovered when the journal was opened, in the order they were
+// queued. Only valid until the journal is next changed.
+size_t SEJobJournalRecoveredCount(const SEJobJournal *journal);
+const SEJournaledJob *SEJobJournalRecoveredJob(const SEJobJournal *journal, size_t index);
+
+// Returns an identifier for the job, or 0 on failure
+uint64_t SEJobJournalAppendQueued(SEJobJournal *journal, const void *payload, size_t length);
+// These return 0 on success, otherwise an errno value. Completing a job
+// removes it from the journal, whether it was started or not.
+int SEJobJournalMarkStarted(SEJobJournal *journal, uint64_t identifier);
+int SEJobJournalMarkCompleted(SEJobJournal *journal, uint64_t identifier);
+
+// Whether records have been written since the last sync
+int SEJobJournalNeedsSync(const SEJobJournal *journal);
+int SEJobJournalSync(SEJobJournal *journal);
+// Rewrites the journal with only the records of pending jobs
+int SEJobJournalCompact(SEJobJournal *journal);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,57 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Queue of jobs waiting to run, ordered by priority and then by the order
+// they were added. Jobs are kept in a binary heap, so adding a job,
+// removing the first one and cancelling any queued job take O(log n) time.
+//
+// Jobs are deduplicated by their deduplication key. Adding a job that is
+// already queued only raises the queued job's priority, if the new job's
+// priority is higher. Jobs without a key are always queued.
+
+#import <Foundation/Foundation.h>
+#import "SEJob.h"
+
+@interface SEJobQueue : NSObject
+
+@property (nonatomic, readonly) NSUInteger count;
+
+// Returns NO if the job is a duplicate of a queued job
+- (BOOL)addJob:(SEJob *)job;
+- (SEJob *)firstJob;
+- (SEJob *)removeFirstJob;
+
+- (SEJob *)jobWithDeduplicationKey:(NSString *)key;
+// Returns NO if the job isn't queued
+- (BOOL)removeJob:(SEJob *)job;
+// Returns the removed jobs, in no particular order
+- (NSArray <SEJob *> *)removeAllJobs;
+
+@end
@@ -0,0 +1,176 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#import "SEJobQueue.h"
+
+@interface SEJobQueue()
+{
+    NSMutableArray <SEJob *> *heap;
+    NSMutableDictionary <NSString *, SEJob *> *jobsByKey;
+    uint64_t nextSequence;
+}
+@end
+
+static inline BOOL RunsBefore(SEJob *a, SEJob *b) {
+    if (a.priority != b.priority) {
+        return a.priority > b.priority;
+    }
+    return a.queueSequence < b.queueSequence;
+}
+
+@implementation SEJobQueue
+
+- (instancetype)init {
+    self = [super init];
+    if (self) {
+        heap = [NSMutableArray array];
+        jobsByKey = [NSMutableDictionary dictionary];
+    }
+    return self;
+}
+
+- (NSUInteger)count {
+    return [heap count];
+}
+
+#pragma mark - Heap
+
+- (void)swapJobAtIndex:(NSUInteger)i withJobAtIndex:(NSUInteger)j {
+    SEJob *a = heap[i];
+    SEJob *b = heap[j];
+    heap[i] = b;
+    heap[j] = a;
+    b.queueIndex = i;
+    a.queueIndex = j;
+}
+
+- (void)siftUp:(NSUInteger)i {
+    while (i > 0) {
+        NSUInteger parent = (i - 1) / 2;
+        if (!RunsBefore(heap[i], heap[parent])) {
+            break;
+        }
+        [self swapJobAtIndex:i withJobAtIndex:parent];
+        i = parent;
+    }
+}
+
+- (void)siftDown:(NSUInteger)i {
+    NSUInteger count = [heap count];
+    for (;;) {
+        NSUInteger left = 2 * i + 1;
+        NSUInteger right = left + 1;
+        NSUInteger first = i;
+        if (left < count && RunsBefore(heap[left], heap[first])) {
+            first = left;
+        }
+        if (right < count && RunsBefore(heap[right], heap[first])) {
+            first = right;
+        }
+        if (first == i) {
+            break;
+        }
+        [self swapJobAtIndex:i withJobAtIndex:first];
+        i = first;
+    }
+}
+
+#pragma mark - Queue
+
+- (BOOL)addJob:(SEJob *)job {
+    NSString *key = [job deduplicationKey];
+    SEJob *queuedJob = key ? jobsByKey[key] : nil;
+    if (queuedJob) {
+        if (job.priority > queuedJob.priority) {
+            queuedJob.priority = job.priority;
+            [self siftUp:queuedJob.queueIndex];
+        }
+        return NO;
+    }
+    
+    job.queueSequence = nextSequence++;
+    job.queueIndex = [heap count];
+    [heap addObject:job];
+    if (key) {
+        jobsByKey[key] = job;
+    }
+    [self siftUp:job.queueIndex];
+    return YES;
+}
+
+- (SEJob *)firstJob {
+    return [heap firstObject];
+}
+
+- (SEJob *)removeFirstJob {
+    SEJob *job = [heap firstObject];
+    if (job) {
+        [self removeJob:job];
+    }
+    return job;
+}
+
+- (SEJob *)jobWithDeduplicationKey:(NSString *)key {
+    return key ? jobsByKey[key] : nil;
+}
+
+- (BOOL)removeJob:(SEJob *)job {
+    NSUInteger i = job.queueIndex;
+    if (i >= [heap count] || heap[i] != job) {
+        return NO;
+    }
+    // Move the last job into the hole and restore heap order from there
+    NSUInteger last = [heap count] - 1;
+    if (i != last) {
+        [self swapJobAtIndex:i withJobAtIndex:last];
+    }
+    [heap removeLastObject];
+    if ([job deduplicationKey]) {
+        [jobsByKey removeObjectForKey:[job deduplicationKey]];
+    }
+    job.queueIndex = NSNotFound;
+    if (i < [heap count]) {
+        [self siftDown:i];
+        [self siftUp:i];
+    }
+    return YES;
+}
+
+- (NSArray <SEJob *> *)removeAllJobs {
+    NSArray *jobs = [heap copy];
+    for (SEJob *job in jobs) {
+        job.queueIndex = NSNotFound;
+    }
+    [heap removeAllObjects];
+    [jobsByKey removeAllObjects];
+    return jobs;
+}
+
+@end
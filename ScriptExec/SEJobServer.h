@@ -0,0 +1,66 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Unix domain socket for submitting jobs to a running app.
+//
+// Clients connect, send any number of framed submissions (see
+// PlatypusJobProtocol.h) and receive a reply to each, optionally followed by
+// the job's output as it runs and its exit status when it finishes. This is
+// much cheaper per job than sending Apple Events, so batch tools such as
+// platypus_submit can pipeline thousands of submissions into one instance.
+//
+// Metadata in a submission is passed to the script as environment variables
+// prefixed with PLATYPUS_JOB_, e.g. "ID=42" sets PLATYPUS_JOB_ID=42. A
+// connection stays open until the client closes its end and all of its
+// accepted jobs have finished. Jobs carry on regardless if the client goes
+// away. The socket is only accessible to the user running the app.
+
+#import <Foundation/Foundation.h>
+#import "SEJob.h"
+
+// Called on the main queue for each submission. Returns nil if the job was
+// queued, otherwise the reason it was rejected. The job must not start
+// running before the handler returns, so that it is acknowledged first.
+typedef NSString * (^SEJobSubmissionHandler)(SEJob *job);
+
+@interface SEJobServer : NSObject
+
+@property (nonatomic, readonly, copy) NSString *path;
+
+// Listens on a socket at path, replacing one left behind by an instance that
+// quit unexpectedly. Returns nil on failure, e.g. if another instance of the
+// app is already listening there.
++ (instancetype)serverWithPath:(NSString *)path;
+
+- (void)startWithSubmissionHandler:(SEJobSubmissionHandler)handler;
+// Disconnects all clients, stops listening and deletes the socket
+- (void)close;
+
+@end
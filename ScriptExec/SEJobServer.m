@@ -0,0 +1,471 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#import <fcntl.h>
+#import <sys/socket.h>
+#import <sys/stat.h>
+#import <sys/un.h>
+#import <unistd.h>
+
+#import "Common.h"
+#import "SEJobServer.h"
+#import "PlatypusJobProtocol.h"
+#import "PlatypusJobLimits.h"
+
+// Clients that fall this far behind reading replies are disconnected
+#define MAX_PENDING_REPLY_BYTES     (64 * 1024 * 1024)
+// Output is forwarded in frames of at most this size
+#define MAX_OUTPUT_FRAME_DATA       (1024 * 1024)
+
+#define METADATA_ENV_PREFIX         @"PLATYPUS_JOB_"
+
+@class SEJobServerConnection;
+
+@interface SEJobServer()
+{
+    int listenFd;
+    dispatch_source_t source;
+    NSMutableSet <SEJobServerConnection *> *connections;
+}
+@property (nonatomic, copy) SEJobSubmissionHandler handler;
+- (void)connectionDidClose:(SEJobServerConnection *)connection;
+@end
+
+#pragma mark - Connection
+
+@interface SEJobServerConnection : NSObject
+{
+    dispatch_io_t channel;
+    PlatypusJobReader reader;
+    PlatypusJobBuffer replies;
+    size_t pendingReplyBytes;
+    uint32_t lastSequence;
+    NSUInteger outstandingJobs;
+    BOOL readClosed;
+    BOOL closed;
+}
+@property (nonatomic, weak) SEJobServer *server;
+- (instancetype)initWithFileDescriptor:(int)fd server:(SEJobServer *)server;
+- (void)start;
+- (void)closeImmediately:(BOOL)stop;
+@end
+
+@implementation SEJobServerConnection
+
+- (instancetype)initWithFileDescriptor:(int)fd server:(SEJobServer *)server {
+    self = [super init];
+    if (self) {
+        _server = server;
+        PlatypusJobReaderInit(&reader);
+        PlatypusJobBufferInit(&replies);
+        channel = dispatch_io_create(DISPATCH_IO_STREAM, fd, dispatch_get_main_queue(), ^(int error) {
+            close(fd);
+        });
+        if (channel == nil) {
+            close(fd);
+            return nil;
+        }
+        dispatch_io_set_low_water(channel, 1);
+    }
+    return self;
+}
+
+- (void)dealloc {
+    PlatypusJobReaderFree(&reader);
+    PlatypusJobBufferFree(&replies);
+}
+
+- (void)start {
+    // Blocks hold on to the connection until the channel is done with it
+    dispatch_io_read(channel, 0, SIZE_MAX, dispatch_get_main_queue(), ^(bool done, dispatch_data_t data, int error) {
+        if (data && dispatch_data_get_size(data)) {
+            [self readData:data];
+        }
+        if (done) {
+            self->readClosed = YES;
+            if (error) {
+                [self closeImmediately:YES];
+            } else {
+                [self closeIfIdle];
+            }
+        }
+    });
+}
+
+- (void)readData:(dispatch_data_t)data {
+    if (closed) {
+        return;
+    }
+    __block int err = 0;
+    dispatch_data_apply(data, ^bool(dispatch_data_t region, size_t offset, const void *bytes, size_t size) {
+        err = PlatypusJobReaderAppend(&self->reader, bytes, size);
+        return err == 0;
+    });
+    
+    PlatypusJobFrame frame;
+    int result = 0;
+    while (err == 0 && !closed && (result = PlatypusJobReaderNext(&reader, &frame)) == 1) {
+        // Frames not meant for the server are ignored
+        if (frame.type == PlatypusJobFrame_Submit) {
+            [self submitJobFromFrame:&frame];
+        }
+    }
+    if (err || result == -1) {
+        DLog(@"Dropping job server client sending malformed data");
+        [self closeImmediately:YES];
+    }
+}
+
+- (void)submitJobFromFrame:(const PlatypusJobFrame *)frame {
+    uint32_t sequence = ++lastSequence;
+    
+    NSMutableArray <NSString *> *args = [NSMutableArray array];
+    NSMutableDictionary <NSString *, NSString *> *env = [NSMutableDictionary dictionary];
+    NSString *input = nil;
+    SEJobPriority priority = SEJobPriority_Normal;
+    PlatypusJobLimits limits = { 0 };
+    BOOL streamOutput = NO;
+    NSString *reason = nil;
+    
+    size_t offset = 0;
+    PlatypusJobField field;
+    const uint8_t *value;
+    size_t length;
+    int result;
+    while (reason == nil && (result = PlatypusJobFrameNextField(frame, &offset, &field, &value, &length)) == 1) {
+        switch (field) {
+            case PlatypusJobField_Argument:
+            {
+                NSString *arg = [[NSString alloc] initWithBytes:value length:length encoding:NSUTF8StringEncoding];
+                if (arg == nil || memchr(value, 0, length)) {
+                    reason = @"Arguments must be UTF-8 text";
+                    break;
+                }
+                [args addObject:arg];
+            }
+                break;
+                
+            case PlatypusJobField_Input:
+                input = [[NSString alloc] initWithBytes:value length:length encoding:NSUTF8StringEncoding];
+                if (input == nil) {
+                    reason = @"Input must be UTF-8 text";
+                }
+                break;
+                
+            case PlatypusJobField_Priority:
+            {
+                int32_t p = (int32_t)PlatypusJobFieldUInt32(value, length);
+                priority = p < 0 ? SEJobPriority_Low : (p > 0 ? SEJobPriority_High : SEJobPriority_Normal);
+            }
+                break;
+                
+            case PlatypusJobField_Metadata:
+            {
+                NSString *pair = [[NSString alloc] initWithBytes:value length:length encoding:NSUTF8StringEncoding];
+                NSRange sep = [pair rangeOfString:@"="];
+                NSString *key = sep.location != NSNotFound ? [pair substringToIndex:sep.location] : nil;
+                if (![self isValidMetadataKey:key] || memchr(value, 0, length)) {
+                    reason = @"Metadata must be KEY=value, with a key of letters, digits and underscores";
+                    break;
+                }
+                env[[METADATA_ENV_PREFIX stringByAppendingString:key]] = [pair substringFromIndex:sep.location + 1];
+            }
+                break;
+                
+            case PlatypusJobField_StreamOutput:
+                streamOutput = (PlatypusJobFieldUInt32(value, length) != 0);
+                break;
+                
+            case PlatypusJobField_Limits:
+            {
+                NSString *str = [[NSString alloc] initWithBytes:value length:length encoding:NSUTF8StringEncoding];
+                if (str == nil || memchr(value, 0, length) || PlatypusJobLimitsParse([str UTF8String], &limits) != 0) {
+                    reason = @"Invalid job limits";
+                }
+            }
+                break;
+                
+            default:
+                break;
+        }
+    }
+    if (reason == nil && result == -1) {
+        reason = @"Malformed submission";
+    }
+    
+    SEJob *job = nil;
+    if (reason == nil) {
+        job = [SEJob jobWithArguments:[args count] ? args : nil andStandardInput:input];
+        [job setPriority:priority];
+        [job setEnvironment:[env count] ? env : nil];
+        [job setLimits:limits];
+        
+        // The job keeps the connection alive until it finishes
+        [job setCompletionHandler:^(int status) {
+            [self jobFinished:sequence status:status];
+        }];
+        if (streamOutput) {
+            [job setOutputHandler:^(NSData *data) {
+                [self sendOutput:data sequence:sequence];
+            }];
+        }
+        
+        SEJobSubmissionHandler handler = [[self server] handler];
+        reason = handler ? handler(job) : @"Not accepting jobs";
+    }
+    
+    if (reason) {
+        [job setCompletionHandler:nil];
+        [job setOutputHandler:nil];
+        PlatypusJobFrameBegin(&replies, PlatypusJobFrame_Rejected);
+        PlatypusJobFrameAddUInt32(&replies, PlatypusJobField_Sequence, sequence);
+        PlatypusJobFrameAddString(&replies, PlatypusJobField_Message, [reason UTF8String]);
+        [self sendFrame];
+        return;
+    }
+    
+    outstandingJobs++;
+    PlatypusJobFrameBegin(&replies, PlatypusJobFrame_Accepted);
+    PlatypusJobFrameAddUInt32(&replies, PlatypusJobField_Sequence, sequence);
+    [self sendFrame];
+}
+
+- (BOOL)isValidMetadataKey:(NSString *)key {
+    if ([key length] == 0) {
+        return NO;
+    }
+    for (NSUInteger i = 0; i < [key length]; i++) {
+        unichar c = [key characterAtIndex:i];
+        BOOL valid = (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || c == '_' || (i > 0 && c >= '0' && c <= '9');
+        if (!valid) {
+            return NO;
+        }
+    }
+    return YES;
+}
+
+#pragma mark - Replies
+
+- (void)sendOutput:(NSData *)data sequence:(uint32_t)sequence {
+    const uint8_t *bytes = [data bytes];
+    size_t length = [data length];
+    for (size_t offset = 0; offset < length && !closed; offset += MAX_OUTPUT_FRAME_DATA) {
+        size_t chunk = MIN(length - offset, MAX_OUTPUT_FRAME_DATA);
+        PlatypusJobFrameBegin(&replies, PlatypusJobFrame_Output);
+        PlatypusJobFrameAddUInt32(&replies, PlatypusJobField_Sequence, sequence);
+        PlatypusJobFrameAddField(&replies, PlatypusJobField_Data, bytes + offset, chunk);
+        [self sendFrame];
+    }
+}
+
+- (void)jobFinished:(uint32_t)sequence status:(int)status {
+    outstandingJobs--;
+    PlatypusJobFrameBegin(&replies, PlatypusJobFrame_Finished);
+    PlatypusJobFrameAddUInt32(&replies, PlatypusJobField_Sequence, sequence);
+    PlatypusJobFrameAddUInt32(&replies, PlatypusJobField_Status, (uint32_t)status);
+    [self sendFrame];
+    [self closeIfIdle];
+}
+
+// Sends the frame just built in the replies buffer
+- (void)sendFrame {
+    if (PlatypusJobFrameEnd(&replies) != 0 || closed) {
+        PlatypusJobBufferConsume(&replies, replies.length);
+        return;
+    }
+    size_t length = replies.length;
+    dispatch_data_t data = dispatch_data_create(replies.bytes, length, dispatch_get_main_queue(), DISPATCH_DATA_DESTRUCTOR_DEFAULT);
+    PlatypusJobBufferConsume(&replies, length);
+    
+    pendingReplyBytes += length;
+    if (pendingReplyBytes > MAX_PENDING_REPLY_BYTES) {
+        DLog(@"Dropping job server client that isn't reading replies");
+        [self closeImmediately:YES];
+        return;
+    }
+    dispatch_io_write(channel, 0, data, dispatch_get_main_queue(), ^(bool done, dispatch_data_t remaining, int error) {
+        if (done) {
+            self->pendingReplyBytes -= length;
+            if (error) {
+                // Client went away. Its jobs still run.
+                [self closeImmediately:YES];
+            }
+        }
+    });
+}
+
+#pragma mark - Closing
+
+- (void)closeIfIdle {
+    if (readClosed && outstandingJobs == 0) {
+        [self closeImmediately:NO];
+    }
+}
+
+// Replies already sent are delivered unless the connection is stopped
+- (void)closeImmediately:(BOOL)stop {
+    if (closed) {
+        return;
+    }
+    closed = YES;
+    dispatch_io_close(channel, stop ? DISPATCH_IO_STOP : 0);
+    [[self server] connectionDidClose:self];
+}
+
+@end
+
+#pragma mark - Server
+
+@implementation SEJobServer
+
++ (instancetype)serverWithPath:(NSString *)path {
+    SEJobServer *server = [[self alloc] initWithPath:path];
+    return [server listen] ? server : nil;
+}
+
+- (instancetype)initWithPath:(NSString *)path {
+    self = [super init];
+    if (self) {
+        _path = [path copy];
+        listenFd = -1;
+        connections = [NSMutableSet set];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [self close];
+}
+
+- (BOOL)listen {
+    const char *fsPath = [_path fileSystemRepresentation];
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(fsPath) >= sizeof(addr.sun_path)) {
+        DLog(@"Job server socket path too long: %@", _path);
+        return NO;
+    }
+    strcpy(addr.sun_path, fsPath);
+    
+    // A socket that nobody is listening on was left behind by an
+    // instance that didn't get to clean up, and can be replaced
+    int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (probe != -1) {
+        BOOL inUse = (connect(probe, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+        close(probe);
+        if (inUse) {
+            DLog(@"Job server socket %@ is in use", _path);
+            return NO;
+        }
+    }
+    unlink(fsPath);
+    
+    listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenFd == -1) {
+        return NO;
+    }
+    fcntl(listenFd, F_SETFD, FD_CLOEXEC);
+    fcntl(listenFd, F_SETFL, O_NONBLOCK);
+    
+    mode_t mask = umask(077);
+    int err = bind(listenFd, (struct sockaddr *)&addr, sizeof(addr));
+    umask(mask);
+    if (err != 0 || listen(listenFd, SOMAXCONN) != 0) {
+        DLog(@"Unable to listen on job server socket %@: %s", _path, strerror(errno));
+        close(listenFd);
+        listenFd = -1;
+        return NO;
+    }
+    return YES;
+}
+
+- (void)startWithSubmissionHandler:(SEJobSubmissionHandler)handler {
+    [self setHandler:handler];
+    if (listenFd == -1 || source) {
+        return;
+    }
+    int fd = listenFd;
+    source = dispatch_source_create(DISPATCH_SOURCE_TYPE_READ, fd, 0, dispatch_get_main_queue());
+    __weak SEJobServer *weakSelf = self;
+    dispatch_source_set_event_handler(source, ^{
+        [weakSelf acceptConnections];
+    });
+    dispatch_source_set_cancel_handler(source, ^{
+        close(fd);
+    });
+    dispatch_resume(source);
+}
+
+- (void)acceptConnections {
+    int fd;
+    while ((fd = accept(listenFd, NULL, NULL)) != -1) {
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+        int on = 1;
+        setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+        
+        // The socket's permissions should see to this, but make sure
+        uid_t uid;
+        gid_t gid;
+        if (getpeereid(fd, &uid, &gid) != 0 || uid != getuid()) {
+            close(fd);
+            continue;
+        }
+        
+        SEJobServerConnection *connection = [[SEJobServerConnection alloc] initWithFileDescriptor:fd server:self];
+        if (connection) {
+            [connections addObject:connection];
+            [connection start];
+        }
+    }
+}
+
+- (void)connectionDidClose:(SEJobServerConnection *)connection {
+    [connections removeObject:connection];
+}
+
+- (void)close {
+    if (source) {
+        dispatch_source_cancel(source);
+        source = nil;
+    } else if (listenFd != -1) {
+        close(listenFd);
+    }
+    if (listenFd != -1) {
+        listenFd = -1;
+        unlink([_path fileSystemRepresentation]);
+    }
+    for (SEJobServerConnection *connection in [connections copy]) {
+        [connection closeImmediately:YES];
+    }
+    [self setHandler:nil];
+}
+
+@end
@@ -0,0 +1,85 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Job process run without privileges.
+//
+// Stands in for NSTask, launching the interpreter with PlatypusSpawn() as
+// the leader of a new process group, so the job and anything it starts can
+// be signalled together (see SEProcessTree.h). Jobs with resource limits are
+// launched through the trampoline instead (see SETrampoline.h), which sets
+// them in the job's own process before it becomes the interpreter. Every
+// other job takes a single exec.
+//
+// The interpreter can also be started before there is a job for it, and
+// handed the job once it arrives (see SEWarmInterpreter.h).
+//
+// Standard output and error both arrive on outputFileHandle. Exit is watched
+// for on the main queue, after which the task is reaped and
+// SEJobTaskDidTerminateNotification posted.
+
+#import <Foundation/Foundation.h>
+
+#import "PlatypusJobLimits.h"
+
+#define SEJobTaskDidTerminateNotification @"SEJobTaskDidTerminateNotification"
+
+@interface SEJobTask : NSObject
+
+@property (copy) NSString *launchPath;
+@property (copy) NSArray <NSString *> *arguments;
+@property (copy) NSString *currentDirectoryPath;
+// Additional environment variables
+@property (copy) NSDictionary <NSString *, NSString *> *environment;
+// The timeout is left to the caller
+@property (nonatomic) PlatypusJobLimits limits;
+
+@property (readonly) NSFileHandle *inputFileHandle;
+@property (readonly) NSFileHandle *outputFileHandle;
+@property (readonly) BOOL isRunning;
+@property (readonly) pid_t processIdentifier;
+// As NSTask reports it: the exit status, or the number of the signal that
+// terminated the task
+@property (readonly) int terminationStatus;
+
+// Returns 0 on success or an errno value
+- (int)launch;
+// Starts the interpreter at launchPath, with arguments as its own
+// arguments, before there is a job for it. Returns 0 on success, ENOTSUP if
+// the interpreter can't be started ahead of time, or another errno value.
+- (int)launchWarm;
+// Hands a job to a task started with -launchWarm, to run in the current
+// directory with the additional environment variables, as if the task had
+// been launched for it. Standard input can then be written as usual.
+// Returns 0 on success or an errno value, e.g. EPIPE if the interpreter has
+// exited.
+- (int)runScript:(NSString *)scriptPath arguments:(NSArray <NSString *> *)args;
+- (void)terminate;
+
+@end
@@ -0,0 +1,289 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#import <errno.h>
+#import <fcntl.h>
+#import <signal.h>
+#import <sys/wait.h>
+#import <unistd.h>
+
+#import "Common.h"
+#import "SEJobTask.h"
+#import "SETrampoline.h"
+#import "SEWarmInterpreter.h"
+#import "PlatypusSpawn.h"
+
+@interface SEJobTask()
+{
+    dispatch_source_t exitSource;
+}
+@property (readwrite) NSFileHandle *inputFileHandle;
+@property (readwrite) NSFileHandle *outputFileHandle;
+@property (readwrite) BOOL isRunning;
+@property (readwrite) pid_t processIdentifier;
+@property (readwrite) int terminationStatus;
+@end
+
+static int ClosedOnExecPipe(int fds[2]) {
+    if (pipe(fds) == -1) {
+        return errno;
+    }
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+    return 0;
+}
+
+// NULL-terminated list of "NAME=value" strings, to be free()d, but the
+// strings themselves belong to the current autorelease pool
+static char **EnvironmentStrings(NSArray <NSString *> *strings) {
+    char **env = calloc([strings count] + 1, sizeof(char *));
+    for (NSUInteger i = 0; env && i < [strings count]; i++) {
+        env[i] = (char *)[strings[i] UTF8String];
+    }
+    return env;
+}
+
+static BOOL WriteFully(int fd, const char *buf, size_t length) {
+    size_t written = 0;
+    while (written < length) {
+        ssize_t n = write(fd, buf + written, length - written);
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return NO;
+        }
+        written += (size_t)n;
+    }
+    return YES;
+}
+
+@implementation SEJobTask
+
+- (void)dealloc {
+    if (exitSource) {
+        dispatch_source_cancel(exitSource);
+    }
+}
+
+- (NSString *)description {
+    return [NSString stringWithFormat:@"%@ %@", _launchPath, [_arguments componentsJoinedByString:@" "]];
+}
+
+// Additional environment variables as "NAME=value" strings
+- (NSArray <NSString *> *)environmentStrings {
+    NSMutableArray <NSString *> *strings = [NSMutableArray array];
+    for (NSString *name in _environment) {
+        [strings addObject:[NSString stringWithFormat:@"%@=%@", name, _environment[name]]];
+    }
+    return strings;
+}
+
+- (int)launch {
+    NSArray <NSString *> *env = [self environmentStrings];
+    // Resource limits have to be set in the job's own process
+    BOOL trampoline = PlatypusJobLimitsAnyResource(&_limits);
+    
+    char **argv = NULL;
+    char **envp = NULL;
+    char *request = NULL;
+    size_t length = 0;
+    int err = 0;
+    if (trampoline) {
+        // The trampoline is sent the job's arguments and additional
+        // environment, and inherits the rest of the environment
+        argv = PlatypusSpawnArguments(@[[[NSBundle mainBundle] executablePath], @SE_TRAMPOLINE_ARG]);
+        char **jobArgv = PlatypusSpawnArguments([@[_launchPath] arrayByAddingObjectsFromArray:_arguments]);
+        char **jobEnvp = EnvironmentStrings(env);
+        if (jobArgv && jobEnvp) {
+            request = SETrampolineCreateRequest((const char *const *)jobArgv, [_arguments count] + 1,
+                                                (const char *const *)jobEnvp, [env count], &_limits, &length);
+        }
+        free(jobArgv);
+        free(jobEnvp);
+        err = request ? 0 : E2BIG;
+    } else {
+        argv = PlatypusSpawnArguments([@[_launchPath] arrayByAddingObjectsFromArray:_arguments]);
+        if ([env count]) {
+            NSMutableArray <NSString *> *fullEnv = [NSMutableArray array];
+            NSDictionary *inherited = [[NSProcessInfo processInfo] environment];
+            for (NSString *name in inherited) {
+                if (_environment[name] == nil) {
+                    [fullEnv addObject:[NSString stringWithFormat:@"%@=%@", name, inherited[name]]];
+                }
+            }
+            [fullEnv addObjectsFromArray:env];
+            envp = EnvironmentStrings(fullEnv);
+            err = envp ? 0 : ENOMEM;
+        }
+    }
+    if (argv == NULL && err == 0) {
+        err = ENOMEM;
+    }
+    if (err == 0) {
+        err = [self spawnWithArguments:argv environment:envp request:request length:length];
+    }
+    free(argv);
+    free(envp);
+    free(request);
+    return err;
+}
+
+- (int)launchWarm {
+    char **interpreterArgs = PlatypusSpawnArguments(_arguments);
+    if (interpreterArgs == NULL) {
+        return ENOMEM;
+    }
+    char **argv = SEWarmInterpreterCreateArguments([_launchPath fileSystemRepresentation],
+                                                   (const char *const *)interpreterArgs, [_arguments count]);
+    free(interpreterArgs);
+    if (argv == NULL) {
+        return ENOTSUP;
+    }
+    int err = [self spawnWithArguments:argv environment:NULL request:NULL length:0];
+    free(argv);
+    return err;
+}
+
+- (int)runScript:(NSString *)scriptPath arguments:(NSArray <NSString *> *)args {
+    NSArray <NSString *> *env = [self environmentStrings];
+    char **argv = PlatypusSpawnArguments(args);
+    char **envp = EnvironmentStrings(env);
+    char *request = NULL;
+    size_t length = 0;
+    if (argv && envp) {
+        request = SEWarmInterpreterCreateRequest([_currentDirectoryPath fileSystemRepresentation],
+                                                 [scriptPath fileSystemRepresentation],
+                                                 (const char *const *)argv, [args count],
+                                                 (const char *const *)envp, [env count], &length);
+    }
+    free(argv);
+    free(envp);
+    if (request == NULL) {
+        return E2BIG;
+    }
+    
+    // Blocks at most until the interpreter has read the request. If it
+    // can't, it has exited.
+    int err = WriteFully([_inputFileHandle fileDescriptor], request, length) ? 0 : errno;
+    free(request);
+    if (err == 0) {
+        self.arguments = [[_arguments arrayByAddingObject:scriptPath] arrayByAddingObjectsFromArray:args];
+    }
+    return err;
+}
+
+- (int)spawnWithArguments:(char **)argv environment:(char **)envp request:(const char *)request length:(size_t)length {
+    int in[2], out[2];
+    int err = ClosedOnExecPipe(in);
+    if (err) {
+        return err;
+    }
+    err = ClosedOnExecPipe(out);
+    if (err) {
+        close(in[0]);
+        close(in[1]);
+        return err;
+    }
+    // Writing to a job that has exited is reported as an error
+    fcntl(in[1], F_SETNOSIGPIPE, 1);
+    
+    pid_t pid = -1;
+    PlatypusSpawnAttributes attributes;
+    PlatypusSpawnAttributesInit(&attributes, argv[0], argv);
+    attributes.environment = envp;
+    attributes.directory = [_currentDirectoryPath fileSystemRepresentation];
+    attributes.fds[0] = in[0];
+    attributes.fds[1] = out[1];
+    attributes.fds[2] = out[1];
+    attributes.processGroup = 1;
+    err = PlatypusSpawn(&attributes, &pid);
+    close(in[0]);
+    close(out[1]);
+    
+    // Blocks at most until the trampoline has read the request. If it
+    // can't, it has exited, and is reaped like any job.
+    if (err == 0 && request) {
+        WriteFully(in[1], request, length);
+    }
+    if (err) {
+        close(in[1]);
+        close(out[0]);
+        return err;
+    }
+    
+    self.inputFileHandle = [[NSFileHandle alloc] initWithFileDescriptor:in[1] closeOnDealloc:YES];
+    self.outputFileHandle = [[NSFileHandle alloc] initWithFileDescriptor:out[0] closeOnDealloc:YES];
+    self.processIdentifier = pid;
+    self.isRunning = YES;
+    [self watchForExit];
+    return 0;
+}
+
+// Reaps the task once it exits. Registering for the exit of a process that
+// has exited already may not deliver an event, so the task is also checked
+// for once it is being watched.
+- (void)watchForExit {
+    exitSource = dispatch_source_create(DISPATCH_SOURCE_TYPE_PROC, (uintptr_t)_processIdentifier,
+                                        DISPATCH_PROC_EXIT, dispatch_get_main_queue());
+    __weak SEJobTask *weakSelf = self;
+    dispatch_source_set_event_handler(exitSource, ^{
+        [weakSelf reap];
+    });
+    dispatch_resume(exitSource);
+    dispatch_async(dispatch_get_main_queue(), ^{
+        [weakSelf reap];
+    });
+}
+
+- (void)reap {
+    if (!_isRunning) {
+        return;
+    }
+    int status;
+    pid_t pid;
+    while ((pid = waitpid(_processIdentifier, &status, WNOHANG)) == -1 && errno == EINTR);
+    if (pid == 0) {
+        return;
+    }
+    dispatch_source_cancel(exitSource);
+    exitSource = nil;
+    self.terminationStatus = (pid == -1) ? -1 : PlatypusSpawnExitStatus(status);
+    self.isRunning = NO;
+    [[NSNotificationCenter defaultCenter] postNotificationName:SEJobTaskDidTerminateNotification object:self];
+}
+
+- (void)terminate {
+    if (_isRunning) {
+        kill(_processIdentifier, SIGTERM);
+    }
+}
+
+@end
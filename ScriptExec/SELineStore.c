@@ -0,0 +1,602 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "SELineStore.h"
+
+// Lines are grouped in blocks, each with a Bloom filter of the trigrams
+// in its lines. Searches skip blocks whose filter rules out a match.
+#define BLOCK_LINES         512
+#define FILTER_BITS_LOG2    15
+#define FILTER_BYTES        ((1 << FILTER_BITS_LOG2) / 8)
+
+struct SELineStore {
+    // Offset of the start of each line. The last entry is the start
+    // of the line currently being appended to, which may be empty.
+    uint64_t *lineStarts;
+    uint64_t lineCount;
+    uint64_t lineCapacity;
+    uint64_t byteCount;
+    uint64_t maxLineLength;
+    
+    // Output is held in memory until it exceeds memoryLimit
+    char *memory;
+    size_t memoryCapacity;
+    size_t memoryLimit;
+    
+    // After that, in an unlinked temporary file
+    int spillFd;
+    
+    // Holds lines read back from the spill file
+    char *scratch;
+    size_t scratchCapacity;
+    
+    // Trigram filter for each block, NULL for blocks without trigrams
+    uint8_t **filters;
+    size_t filterCapacity;
+    uint64_t indexedLine;
+    uint32_t trigram;
+    unsigned trigramLength;
+};
+
+static inline unsigned char Lower(unsigned char c) {
+    return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+static int Reserve(void **buffer, size_t *capacity, size_t needed, size_t elementSize) {
+    if (needed <= *capacity) {
+        return 0;
+    }
+    size_t newCapacity = *capacity ? *capacity : 1024;
+    while (newCapacity < needed) {
+        newCapacity *= 2;
+    }
+    void *newBuffer = realloc(*buffer, newCapacity * elementSize);
+    if (newBuffer == NULL) {
+        return ENOMEM;
+    }
+    *buffer = newBuffer;
+    *capacity = newCapacity;
+    return 0;
+}
+
+SELineStore *SELineStoreCreate(size_t memoryLimit) {
+    SELineStore *store = calloc(1, sizeof(SELineStore));
+    if (store == NULL) {
+        return NULL;
+    }
+    store->memoryLimit = memoryLimit;
+    store->spillFd = -1;
+    SELineStoreClear(store);
+    if (store->lineStarts == NULL) {
+        SELineStoreFree(store);
+        return NULL;
+    }
+    return store;
+}
+
+void SELineStoreFree(SELineStore *store) {
+    if (store == NULL) {
+        return;
+    }
+    if (store->spillFd != -1) {
+        close(store->spillFd);
+    }
+    for (size_t i = 0; i < store->filterCapacity; i++) {
+        free(store->filters[i]);
+    }
+    free(store->filters);
+    free(store->lineStarts);
+    free(store->memory);
+    free(store->scratch);
+    free(store);
+}
+
+void SELineStoreClear(SELineStore *store) {
+    if (store->spillFd != -1) {
+        close(store->spillFd);
+        store->spillFd = -1;
+    }
+    size_t capacity = (size_t)store->lineCapacity;
+    if (Reserve((void **)&store->lineStarts, &capacity, 1, sizeof(uint64_t)) == 0) {
+        store->lineCapacity = capacity;
+        store->lineStarts[0] = 0;
+    }
+    store->lineCount = 1;
+    store->byteCount = 0;
+    store->maxLineLength = 0;
+    
+    for (size_t i = 0; i < store->filterCapacity; i++) {
+        free(store->filters[i]);
+        store->filters[i] = NULL;
+    }
+    store->indexedLine = 0;
+    store->trigram = 0;
+    store->trigramLength = 0;
+}
+
+#pragma mark - Storage
+
+static int Spill(SELineStore *store) {
+    const char *tmpdir = getenv("TMPDIR");
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/PlatypusOutput.XXXXXX", (tmpdir && *tmpdir) ? tmpdir : "/tmp");
+    
+    int fd = mkstemp(path);
+    if (fd == -1) {
+        return errno;
+    }
+    // The file goes away once closed
+    unlink(path);
+    
+    size_t written = 0;
+    while (written < store->byteCount) {
+        ssize_t n = write(fd, store->memory + written, (size_t)store->byteCount - written);
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            int err = (n == 0) ? EIO : errno;
+            close(fd);
+            return err;
+        }
+        written += (size_t)n;
+    }
+    
+    free(store->memory);
+    store->memory = NULL;
+    store->memoryCapacity = 0;
+    store->spillFd = fd;
+    return 0;
+}
+
+static int AppendBytes(SELineStore *store, const char *bytes, size_t length) {
+    if (store->spillFd == -1 && store->byteCount + length > store->memoryLimit) {
+        int err = Spill(store);
+        if (err) {
+            return err;
+        }
+    }
+    
+    if (store->spillFd == -1) {
+        int err = Reserve((void **)&store->memory, &store->memoryCapacity, (size_t)store->byteCount + length, 1);
+        if (err) {
+            return err;
+        }
+        memcpy(store->memory + store->byteCount, bytes, length);
+        return 0;
+    }
+    
+    size_t written = 0;
+    while (written < length) {
+        ssize_t n = pwrite(store->spillFd, bytes + written, length - written, (off_t)(store->byteCount + written));
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return (n == 0) ? EIO : errno;
+        }
+        written += (size_t)n;
+    }
+    return 0;
+}
+
+#pragma mark - Trigram index
+
+// Two bits per trigram, from two multiplicative hashes
+static inline uint32_t FilterBit(uint32_t trigram, int which) {
+    uint32_t hash = trigram * (which ? 0x85EBCA6Bu : 0x9E3779B1u);
+    return hash >> (32 - FILTER_BITS_LOG2);
+}
+
+static int IndexTrigrams(SELineStore *store, const unsigned char *bytes, size_t length) {
+    uint8_t *filter = NULL;
+    for (size_t i = 0; i < length; i++) {
+        if (bytes[i] == '\n') {
+            // Trigrams don't span lines
+            store->indexedLine++;
+            store->trigram = 0;
+            store->trigramLength = 0;
+            filter = NULL;
+            continue;
+        }
+        store->trigram = ((store->trigram << 8) | Lower(bytes[i])) & 0xFFFFFF;
+        if (++store->trigramLength < 3) {
+            continue;
+        }
+        
+        if (filter == NULL) {
+            size_t block = (size_t)(store->indexedLine / BLOCK_LINES);
+            size_t capacity = store->filterCapacity;
+            if (Reserve((void **)&store->filters, &capacity, block + 1, sizeof(uint8_t *))) {
+                return ENOMEM;
+            }
+            memset(store->filters + store->filterCapacity, 0, (capacity - store->filterCapacity) * sizeof(uint8_t *));
+            store->filterCapacity = capacity;
+            if (store->filters[block] == NULL && (store->filters[block] = calloc(1, FILTER_BYTES)) == NULL) {
+                return ENOMEM;
+            }
+            filter = store->filters[block];
+        }
+        uint32_t bit1 = FilterBit(store->trigram, 0);
+        uint32_t bit2 = FilterBit(store->trigram, 1);
+        filter[bit1 >> 3] |= (uint8_t)(1 << (bit1 & 7));
+        filter[bit2 >> 3] |= (uint8_t)(1 << (bit2 & 7));
+    }
+    return 0;
+}
+
+static int FilterMayContain(const uint8_t *filter, const uint32_t *bits, size_t bitCount) {
+    for (size_t i = 0; i < bitCount; i++) {
+        if ((filter[bits[i] >> 3] & (1 << (bits[i] & 7))) == 0) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+#pragma mark - Appending
+
+int SELineStoreAppend(SELineStore *store, const char *bytes, size_t length) {
+    if (length == 0) {
+        return 0;
+    }
+    
+    int err = AppendBytes(store, bytes, length);
+    if (err) {
+        return err;
+    }
+    
+    err = IndexTrigrams(store, (const unsigned char *)bytes, length);
+    if (err) {
+        return err;
+    }
+    
+    // Index the lines that start within the new bytes
+    const char *p = bytes;
+    const char *end = bytes + length;
+    while ((p = memchr(p, '\n', (size_t)(end - p))) != NULL) {
+        uint64_t lineEnd = store->byteCount + (uint64_t)(p - bytes);
+        uint64_t lineLength = lineEnd - store->lineStarts[store->lineCount - 1];
+        if (lineLength > store->maxLineLength) {
+            store->maxLineLength = lineLength;
+        }
+        
+        size_t capacity = (size_t)store->lineCapacity;
+        err = Reserve((void **)&store->lineStarts, &capacity, (size_t)store->lineCount + 1, sizeof(uint64_t));
+        if (err) {
+            return err;
+        }
+        store->lineCapacity = capacity;
+        store->lineStarts[store->lineCount++] = lineEnd + 1;
+        p++;
+    }
+    store->byteCount += length;
+    
+    uint64_t openLength = store->byteCount - store->lineStarts[store->lineCount - 1];
+    if (openLength > store->maxLineLength) {
+        store->maxLineLength = openLength;
+    }
+    
+    return 0;
+}
+
+#pragma mark - Reading
+
+uint64_t SELineStoreLineCount(const SELineStore *store) {
+    // Don't count the empty line following a final '\n'
+    uint64_t lastStart = store->lineStarts[store->lineCount - 1];
+    return (lastStart == store->byteCount) ? store->lineCount - 1 : store->lineCount;
+}
+
+uint64_t SELineStoreByteCount(const SELineStore *store) {
+    return store->byteCount;
+}
+
+uint64_t SELineStoreMaxLineLength(const SELineStore *store) {
+    return store->maxLineLength;
+}
+
+uint64_t SELineStoreLineLength(const SELineStore *store, uint64_t index) {
+    if (index >= store->lineCount) {
+        return 0;
+    }
+    uint64_t start = store->lineStarts[index];
+    uint64_t end = (index + 1 < store->lineCount) ? store->lineStarts[index + 1] - 1 : store->byteCount;
+    return end - start;
+}
+
+// Returns bytes from the buffer, or read back from the spill file
+static const char *ReadRange(SELineStore *store, uint64_t start, size_t length) {
+    if (store->spillFd == -1) {
+        return store->memory + start;
+    }
+    
+    if (Reserve((void **)&store->scratch, &store->scratchCapacity, length + 1, 1)) {
+        return NULL;
+    }
+    size_t got = 0;
+    while (got < length) {
+        ssize_t n = pread(store->spillFd, store->scratch + got, length - got, (off_t)(start + got));
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return NULL;
+        }
+        got += (size_t)n;
+    }
+    return store->scratch;
+}
+
+const char *SELineStoreGetLine(SELineStore *store, uint64_t index, size_t maxLength, size_t *length) {
+    if (index >= SELineStoreLineCount(store)) {
+        return NULL;
+    }
+    uint64_t start = store->lineStarts[index];
+    uint64_t len = SELineStoreLineLength(store, index);
+    if (len > maxLength) {
+        len = maxLength;
+    }
+    *length = (size_t)len;
+    return ReadRange(store, start, (size_t)len);
+}
+
+int SELineStoreWriteToFile(SELineStore *store, int fd) {
+    char buf[65536];
+    uint64_t offset = 0;
+    while (offset < store->byteCount) {
+        size_t chunk = (store->byteCount - offset < sizeof(buf)) ? (size_t)(store->byteCount - offset) : sizeof(buf);
+        const char *src = store->memory + offset;
+        if (store->spillFd != -1) {
+            ssize_t n = pread(store->spillFd, buf, chunk, (off_t)offset);
+            if (n == -1 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return (n == 0) ? EIO : errno;
+            }
+            chunk = (size_t)n;
+            src = buf;
+        }
+        
+        size_t written = 0;
+        while (written < chunk) {
+            ssize_t n = write(fd, src + written, chunk - written);
+            if (n == -1 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return (n == 0) ? EIO : errno;
+            }
+            written += (size_t)n;
+        }
+        offset += chunk;
+    }
+    return 0;
+}
+
+#pragma mark - Searching
+
+void SELineMatchesInit(SELineMatches *matches) {
+    memset(matches, 0, sizeof(SELineMatches));
+}
+
+void SELineMatchesFree(SELineMatches *matches) {
+    free(matches->lines);
+    SELineMatchesInit(matches);
+}
+
+static int AddMatch(SELineMatches *matches, uint64_t line) {
+    if (Reserve((void **)&matches->lines, &matches->capacity, matches->count + 1, sizeof(uint64_t))) {
+        return ENOMEM;
+    }
+    matches->lines[matches->count++] = line;
+    return 0;
+}
+
+static int CaselessEqual(const unsigned char *a, const unsigned char *lowerB, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        if (Lower(a[i]) != lowerB[i]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Finds a lowercase needle, ignoring ASCII case. Candidates for the first
+// character are found with memchr, searching separately for its upper case.
+static const unsigned char *FindCaseless(const unsigned char *haystack, size_t length,
+                                         const unsigned char *needle, size_t needleLength) {
+    if (needleLength > length) {
+        return NULL;
+    }
+    unsigned char lower = needle[0];
+    unsigned char upper = (lower >= 'a' && lower <= 'z') ? lower - ('a' - 'A') : lower;
+    const unsigned char *last = haystack + (length - needleLength);
+    const unsigned char *nextLower = NULL;
+    const unsigned char *nextUpper = NULL;
+    int lowerDone = 0;
+    int upperDone = (upper == lower);
+    
+    const unsigned char *p = haystack;
+    while (p <= last) {
+        size_t remaining = (size_t)(last - p) + 1;
+        if (!lowerDone && (nextLower == NULL || nextLower < p)) {
+            nextLower = memchr(p, lower, remaining);
+            lowerDone = (nextLower == NULL);
+        }
+        if (!upperDone && (nextUpper == NULL || nextUpper < p)) {
+            nextUpper = memchr(p, upper, remaining);
+            upperDone = (nextUpper == NULL);
+        }
+        
+        const unsigned char *candidate;
+        if (lowerDone && upperDone) {
+            return NULL;
+        } else if (lowerDone) {
+            candidate = nextUpper;
+        } else if (upperDone) {
+            candidate = nextLower;
+        } else {
+            candidate = (nextLower < nextUpper) ? nextLower : nextUpper;
+        }
+        
+        if (CaselessEqual(candidate + 1, needle + 1, needleLength - 1)) {
+            return candidate;
+        }
+        p = candidate + 1;
+    }
+    return NULL;
+}
+
+typedef struct Query {
+    unsigned char *needle;
+    size_t length;
+    uint32_t bits[2 * 256];
+    size_t bitCount;
+} Query;
+
+static int MakeQuery(Query *query, const char *needle, size_t length) {
+    query->needle = malloc(length + 1);
+    if (query->needle == NULL) {
+        return ENOMEM;
+    }
+    query->length = length;
+    query->bitCount = 0;
+    
+    uint32_t trigram = 0;
+    for (size_t i = 0; i < length; i++) {
+        query->needle[i] = Lower((unsigned char)needle[i]);
+        trigram = ((trigram << 8) | query->needle[i]) & 0xFFFFFF;
+        // A few hundred trigrams are plenty to rule out blocks
+        if (i >= 2 && query->bitCount < sizeof(query->bits) / sizeof(query->bits[0])) {
+            query->bits[query->bitCount++] = FilterBit(trigram, 0);
+            query->bits[query->bitCount++] = FilterBit(trigram, 1);
+        }
+    }
+    return 0;
+}
+
+int SELineStoreSearch(SELineStore *store, const char *needle, size_t needleLength,
+                      uint64_t fromLine, SELineMatches *matches) {
+    uint64_t lineCount = SELineStoreLineCount(store);
+    if (needleLength == 0) {
+        for (uint64_t line = fromLine; line < lineCount; line++) {
+            if (AddMatch(matches, line)) {
+                return ENOMEM;
+            }
+        }
+        return 0;
+    }
+    
+    Query query;
+    if (MakeQuery(&query, needle, needleLength)) {
+        return ENOMEM;
+    }
+    
+    int err = 0;
+    uint64_t line = fromLine;
+    while (line < lineCount && !err) {
+        size_t block = (size_t)(line / BLOCK_LINES);
+        uint64_t blockEnd = (uint64_t)(block + 1) * BLOCK_LINES;
+        if (blockEnd > lineCount) {
+            blockEnd = lineCount;
+        }
+        
+        // Needles shorter than a trigram can't use the filters
+        if (query.bitCount) {
+            const uint8_t *filter = (block < store->filterCapacity) ? store->filters[block] : NULL;
+            if (filter == NULL || !FilterMayContain(filter, query.bits, query.bitCount)) {
+                line = blockEnd;
+                continue;
+            }
+        }
+        
+        // Search the rest of the block in one go. A match can't span lines
+        // since the needle is on a single line.
+        uint64_t start = store->lineStarts[line];
+        uint64_t end = store->lineStarts[blockEnd - 1] + SELineStoreLineLength(store, blockEnd - 1);
+        const unsigned char *bytes = (const unsigned char *)ReadRange(store, start, (size_t)(end - start));
+        if (bytes == NULL) {
+            err = EIO;
+            break;
+        }
+        
+        const unsigned char *p = bytes;
+        const unsigned char *found;
+        while ((found = FindCaseless(p, (size_t)(bytes + (end - start) - p), query.needle, query.length))) {
+            uint64_t offset = start + (uint64_t)(found - bytes);
+            while (line + 1 < blockEnd && store->lineStarts[line + 1] <= offset) {
+                line++;
+            }
+            if ((err = AddMatch(matches, line))) {
+                break;
+            }
+            // Carry on from the next line
+            if (++line >= blockEnd) {
+                break;
+            }
+            p = bytes + (store->lineStarts[line] - start);
+        }
+        line = blockEnd;
+    }
+    
+    free(query.needle);
+    return err;
+}
+
+int SELineStoreSearchLines(SELineStore *store, const char *needle, size_t needleLength,
+                           const uint64_t *lines, size_t count, SELineMatches *matches) {
+    Query query;
+    if (MakeQuery(&query, needle, needleLength)) {
+        return ENOMEM;
+    }
+    
+    int err = 0;
+    for (size_t i = 0; i < count && !err; i++) {
+        size_t length;
+        const char *bytes = SELineStoreGetLine(store, lines[i], SIZE_MAX, &length);
+        if (bytes == NULL) {
+            continue;
+        }
+        if (query.length == 0 || FindCaseless((const unsigned char *)bytes, length, query.needle, query.length)) {
+            err = AddMatch(matches, lines[i]);
+        }
+    }
+    
+    free(query.needle);
+    return err;
+}
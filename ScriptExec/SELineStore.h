@@ -0,0 +1,105 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Append-only store for lines of script output.
+//
+// Output bytes are kept in a single buffer with an index of line start
+// offsets, so any line can be found in constant time no matter how much
+// output there is. Once the buffer exceeds a memory limit, its contents
+// move to an unlinked temporary file and further output is appended there,
+// so memory use is bounded by the line index (8 bytes per line). Lines are
+// separated by '\n'. Portable C.
+//
+// Lines can be searched for a string, ignoring ASCII case. As output is
+// appended, the trigrams in each block of 512 lines are added to a Bloom
+// filter for the block (about 8 bytes per line), so a search only reads
+// blocks that may contain all of the search string's trigrams.
+
+#ifndef SE_LINE_STORE_H
+#define SE_LINE_STORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SE_LINE_STORE_DEFAULT_MEMORY_LIMIT  (64 * 1024 * 1024)
+
+typedef struct SELineStore SELineStore;
+
+SELineStore *SELineStoreCreate(size_t memoryLimit);
+void SELineStoreFree(SELineStore *store);
+void SELineStoreClear(SELineStore *store);
+
+// Returns 0 on success, otherwise an errno value
+int SELineStoreAppend(SELineStore *store, const char *bytes, size_t length);
+
+// Number of lines, counting a final line without a terminating '\n'
+uint64_t SELineStoreLineCount(const SELineStore *store);
+uint64_t SELineStoreByteCount(const SELineStore *store);
+// Length in bytes of the longest line seen
+uint64_t SELineStoreMaxLineLength(const SELineStore *store);
+// Length in bytes of a line, excluding the terminating '\n'
+uint64_t SELineStoreLineLength(const SELineStore *store, uint64_t index);
+
+// Returns the first maxLength bytes of a line, excluding the terminating '\n'.
+// The pointer is valid until the store is next used. Returns NULL on error.
+const char *SELineStoreGetLine(SELineStore *store, uint64_t index, size_t maxLength, size_t *length);
+
+// Line indexes found by a search, in ascending order
+typedef struct SELineMatches {
+    uint64_t *lines;
+    size_t count;
+    size_t capacity;
+} SELineMatches;
+
+void SELineMatchesInit(SELineMatches *matches);
+void SELineMatchesFree(SELineMatches *matches);
+
+// Appends the indexes of lines from fromLine onwards that contain needle.
+// Returns 0 on success, otherwise an errno value.
+int SELineStoreSearch(SELineStore *store, const char *needle, size_t needleLength,
+                      uint64_t fromLine, SELineMatches *matches);
+
+// Appends the indexes of those of the given lines that contain needle, e.g.
+// to narrow down the matches of a search as the search string gets longer
+int SELineStoreSearchLines(SELineStore *store, const char *needle, size_t needleLength,
+                           const uint64_t *lines, size_t count, SELineMatches *matches);
+
+// Writes all output to a file descriptor. Returns 0 on success, otherwise an errno value.
+int SELineStoreWriteToFile(SELineStore *store, int fd);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,523 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "SEMetrics.h"
+#include "PlatypusClock.h"
+
+// Upper bounds of histogram buckets, in seconds. Last bucket is +Inf.
+static const double kBucketBounds[] = {
+    0.001, 0.005, 0.01, 0.05, 0.1, 0.5, 1, 5, 10, 30, 60, 300, 1800
+};
+#define NUM_BUCKETS         (sizeof(kBucketBounds) / sizeof(kBucketBounds[0]) + 1)
+
+// Throughput is counted in one-second slots over this many seconds
+#define THROUGHPUT_WINDOW   60
+
+// How long the server waits for a client to send a request
+#define REQUEST_TIMEOUT_MS  100
+
+typedef struct Histogram {
+    uint64_t buckets[NUM_BUCKETS];
+    uint64_t count;
+    double sum;
+    double max;
+} Histogram;
+
+struct SEMetrics {
+    pthread_mutex_t lock;
+    
+    uint64_t jobsQueued;
+    uint64_t jobsStarted;
+    uint64_t jobsFinished;
+    uint64_t jobsFailed;
+    uint64_t jobsTimedOut;
+    unsigned int running;
+    unsigned int queueDepth;
+    unsigned int maxQueueDepth;
+    
+    uint64_t outputBytes;
+    double userTime;
+    double systemTime;
+    uint64_t maxResidentSize;
+    
+    Histogram histograms[SEMetricsHistogram_Count];
+    
+    int64_t throughputSeconds[THROUGHPUT_WINDOW];
+    uint32_t throughputCounts[THROUGHPUT_WINDOW];
+    
+    int jsonFD;
+    
+    int serverFD;
+    int stopPipe[2];
+    char *socketPath;
+    pthread_t serverThread;
+};
+
+static const char *kHistogramNames[SEMetricsHistogram_Count] = {
+    "platypus_job_queue_wait_seconds",
+    "platypus_job_duration_seconds"
+};
+
+static const char *kHistogramHelp[SEMetricsHistogram_Count] = {
+    "Time jobs spent waiting in the queue.",
+    "Time from starting jobs until they finished."
+};
+
+double SEMetricsNow(void) {
+    return PlatypusClockNow();
+}
+
+#pragma mark - Aggregation
+
+static void HistogramObserve(Histogram *h, double value) {
+    if (value < 0) {
+        value = 0;
+    }
+    size_t i = 0;
+    while (i < NUM_BUCKETS - 1 && value > kBucketBounds[i]) {
+        i++;
+    }
+    h->buckets[i]++;
+    h->count++;
+    h->sum += value;
+    if (value > h->max) {
+        h->max = value;
+    }
+}
+
+// Linear interpolation within the bucket holding the percentile. The
+// +Inf bucket is bounded by the largest value seen.
+static double HistogramPercentile(const Histogram *h, double percentile) {
+    if (h->count == 0) {
+        return 0;
+    }
+    double rank = percentile / 100.0 * h->count;
+    uint64_t below = 0;
+    for (size_t i = 0; i < NUM_BUCKETS; i++) {
+        if (h->buckets[i] == 0 || below + h->buckets[i] < rank) {
+            below += h->buckets[i];
+            continue;
+        }
+        double lower = (i == 0) ? 0 : kBucketBounds[i - 1];
+        double upper = (i < NUM_BUCKETS - 1) ? kBucketBounds[i] : h->max;
+        if (upper > h->max) {
+            upper = h->max;
+        }
+        if (upper < lower) {
+            return upper;
+        }
+        return lower + (upper - lower) * ((rank - below) / h->buckets[i]);
+    }
+    return h->max;
+}
+
+SEMetrics *SEMetricsCreate(void) {
+    SEMetrics *metrics = calloc(1, sizeof(SEMetrics));
+    if (metrics == NULL) {
+        return NULL;
+    }
+    pthread_mutex_init(&metrics->lock, NULL);
+    metrics->jsonFD = -1;
+    metrics->serverFD = -1;
+    metrics->stopPipe[0] = metrics->stopPipe[1] = -1;
+    return metrics;
+}
+
+void SEMetricsSetQueueDepth(SEMetrics *metrics, unsigned int depth) {
+    pthread_mutex_lock(&metrics->lock);
+    metrics->queueDepth = depth;
+    if (depth > metrics->maxQueueDepth) {
+        metrics->maxQueueDepth = depth;
+    }
+    pthread_mutex_unlock(&metrics->lock);
+}
+
+void SEMetricsJobQueued(SEMetrics *metrics) {
+    pthread_mutex_lock(&metrics->lock);
+    metrics->jobsQueued++;
+    pthread_mutex_unlock(&metrics->lock);
+}
+
+void SEMetricsJobStarted(SEMetrics *metrics) {
+    pthread_mutex_lock(&metrics->lock);
+    metrics->jobsStarted++;
+    metrics->running++;
+    pthread_mutex_unlock(&metrics->lock);
+}
+
+void SEMetricsJobFinished(SEMetrics *metrics, const SEJobRecord *record) {
+    pthread_mutex_lock(&metrics->lock);
+    metrics->jobsFinished++;
+    if (record->exitStatus != 0) {
+        metrics->jobsFailed++;
+    }
+    if (record->timedOut) {
+        metrics->jobsTimedOut++;
+    }
+    if (metrics->running) {
+        metrics->running--;
+    }
+    metrics->outputBytes += record->outputBytes;
+    metrics->userTime += record->userTime;
+    metrics->systemTime += record->systemTime;
+    if (record->maxResidentSize > metrics->maxResidentSize) {
+        metrics->maxResidentSize = record->maxResidentSize;
+    }
+    HistogramObserve(&metrics->histograms[SEMetricsHistogram_QueueWait], record->startTime - record->enqueueTime);
+    HistogramObserve(&metrics->histograms[SEMetricsHistogram_Duration], record->endTime - record->startTime);
+    
+    int64_t second = (int64_t)record->endTime;
+    size_t slot = (size_t)(second % THROUGHPUT_WINDOW);
+    if (metrics->throughputSeconds[slot] != second) {
+        metrics->throughputSeconds[slot] = second;
+        metrics->throughputCounts[slot] = 0;
+    }
+    metrics->throughputCounts[slot]++;
+    pthread_mutex_unlock(&metrics->lock);
+    
+    // One write per line, so lines from several apps sharing a file
+    // don't interleave
+    if (metrics->jsonFD != -1) {
+        char line[512];
+        int length = SEJobRecordFormatJSON(record, line, sizeof(line));
+        if (length > 0 && (size_t)length < sizeof(line)) {
+            ssize_t n;
+            do {
+                n = write(metrics->jsonFD, line, (size_t)length);
+            } while (n == -1 && errno == EINTR);
+        }
+    }
+}
+
+double SEMetricsPercentile(SEMetrics *metrics, SEMetricsHistogram histogram, double percentile) {
+    pthread_mutex_lock(&metrics->lock);
+    double value = HistogramPercentile(&metrics->histograms[histogram], percentile);
+    pthread_mutex_unlock(&metrics->lock);
+    return value;
+}
+
+static double Throughput(const SEMetrics *metrics) {
+    int64_t now = (int64_t)SEMetricsNow();
+    uint64_t count = 0;
+    for (size_t i = 0; i < THROUGHPUT_WINDOW; i++) {
+        if (metrics->throughputSeconds[i] > now - THROUGHPUT_WINDOW) {
+            count += metrics->throughputCounts[i];
+        }
+    }
+    return (double)count / THROUGHPUT_WINDOW;
+}
+
+double SEMetricsThroughput(SEMetrics *metrics) {
+    pthread_mutex_lock(&metrics->lock);
+    double value = Throughput(metrics);
+    pthread_mutex_unlock(&metrics->lock);
+    return value;
+}
+
+#pragma mark - Formatting
+
+int SEJobRecordFormatJSON(const SEJobRecord *record, char *buf, size_t size) {
+    return snprintf(buf, size,
+                    "{\"start\":%.3f,\"queue_wait\":%.6f,\"duration\":%.6f,"
+                    "\"user_time\":%.6f,\"system_time\":%.6f,\"max_rss\":%llu,"
+                    "\"output_bytes\":%llu,\"exit_status\":%d,\"timed_out\":%s}\n",
+                    record->startDate,
+                    record->startTime - record->enqueueTime,
+                    record->endTime - record->startTime,
+                    record->userTime,
+                    record->systemTime,
+                    (unsigned long long)record->maxResidentSize,
+                    (unsigned long long)record->outputBytes,
+                    record->exitStatus,
+                    record->timedOut ? "true" : "false");
+}
+
+typedef struct TextBuffer {
+    char *bytes;
+    size_t length;
+    size_t capacity;
+    int failed;
+} TextBuffer;
+
+static void Appendf(TextBuffer *b, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+static void Appendf(TextBuffer *b, const char *format, ...) {
+    for (;;) {
+        if (b->failed) {
+            return;
+        }
+        va_list args;
+        va_start(args, format);
+        int n = vsnprintf(b->bytes + b->length, b->capacity - b->length, format, args);
+        va_end(args);
+        if (n < 0) {
+            b->failed = 1;
+            return;
+        }
+        if ((size_t)n < b->capacity - b->length) {
+            b->length += (size_t)n;
+            return;
+        }
+        size_t capacity = b->capacity * 2 + (size_t)n;
+        char *bytes = realloc(b->bytes, capacity);
+        if (bytes == NULL) {
+            b->failed = 1;
+            return;
+        }
+        b->bytes = bytes;
+        b->capacity = capacity;
+    }
+}
+
+static void AppendMetric(TextBuffer *b, const char *name, const char *type, const char *help, double value) {
+    Appendf(b, "# HELP %s %s\n# TYPE %s %s\n%s %.17g\n", name, help, name, type, name, value);
+}
+
+char *SEMetricsCopyPrometheusText(SEMetrics *metrics, size_t *length) {
+    TextBuffer b = { malloc(4096), 0, 4096, 0 };
+    if (b.bytes == NULL) {
+        return NULL;
+    }
+    
+    pthread_mutex_lock(&metrics->lock);
+    
+    AppendMetric(&b, "platypus_jobs_queued_total", "counter", "Jobs added to the queue.", (double)metrics->jobsQueued);
+    AppendMetric(&b, "platypus_jobs_started_total", "counter", "Jobs started.", (double)metrics->jobsStarted);
+    AppendMetric(&b, "platypus_jobs_finished_total", "counter", "Jobs finished.", (double)metrics->jobsFinished);
+    AppendMetric(&b, "platypus_jobs_failed_total", "counter", "Jobs that exited with a non-zero status.", (double)metrics->jobsFailed);
+    AppendMetric(&b, "platypus_jobs_timed_out_total", "counter", "Jobs terminated for exceeding their timeout.", (double)metrics->jobsTimedOut);
+    AppendMetric(&b, "platypus_jobs_running", "gauge", "Jobs currently running.", metrics->running);
+    AppendMetric(&b, "platypus_job_queue_depth", "gauge", "Jobs waiting in the queue.", metrics->queueDepth);
+    AppendMetric(&b, "platypus_job_queue_depth_max", "gauge", "Most jobs waiting in the queue at once.", metrics->maxQueueDepth);
+    AppendMetric(&b, "platypus_job_output_bytes_total", "counter", "Bytes of output from jobs.", (double)metrics->outputBytes);
+    AppendMetric(&b, "platypus_job_user_cpu_seconds_total", "counter", "User CPU time used by jobs.", metrics->userTime);
+    AppendMetric(&b, "platypus_job_system_cpu_seconds_total", "counter", "System CPU time used by jobs.", metrics->systemTime);
+    AppendMetric(&b, "platypus_job_max_resident_bytes", "gauge", "Largest resident set size of any job.", (double)metrics->maxResidentSize);
+    AppendMetric(&b, "platypus_job_throughput", "gauge", "Jobs finished per second over the last minute.", Throughput(metrics));
+    
+    for (int i = 0; i < SEMetricsHistogram_Count; i++) {
+        const Histogram *h = &metrics->histograms[i];
+        const char *name = kHistogramNames[i];
+        Appendf(&b, "# HELP %s %s\n# TYPE %s histogram\n", name, kHistogramHelp[i], name);
+        uint64_t cumulative = 0;
+        for (size_t j = 0; j < NUM_BUCKETS; j++) {
+            cumulative += h->buckets[j];
+            if (j < NUM_BUCKETS - 1) {
+                Appendf(&b, "%s_bucket{le=\"%g\"} %llu\n", name, kBucketBounds[j], (unsigned long long)cumulative);
+            } else {
+                Appendf(&b, "%s_bucket{le=\"+Inf\"} %llu\n", name, (unsigned long long)cumulative);
+            }
+        }
+        Appendf(&b, "%s_sum %.17g\n%s_count %llu\n", name, h->sum, name, (unsigned long long)h->count);
+        
+        // Percentiles for readers without a Prometheus server
+        Appendf(&b, "# HELP %s_estimate Percentiles estimated from %s.\n# TYPE %s_estimate gauge\n", name, name, name);
+        static const double percentiles[] = { 50, 90, 99 };
+        for (size_t j = 0; j < sizeof(percentiles) / sizeof(percentiles[0]); j++) {
+            Appendf(&b, "%s_estimate{quantile=\"%g\"} %.17g\n", name, percentiles[j] / 100, HistogramPercentile(h, percentiles[j]));
+        }
+    }
+    
+    pthread_mutex_unlock(&metrics->lock);
+    
+    if (b.failed) {
+        free(b.bytes);
+        return NULL;
+    }
+    *length = b.length;
+    return b.bytes;
+}
+
+#pragma mark - Export
+
+int SEMetricsOpenJSONLinesFile(SEMetrics *metrics, const char *path) {
+    int fd = open(path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    if (fd == -1) {
+        return errno;
+    }
+    if (metrics->jsonFD != -1) {
+        close(metrics->jsonFD);
+    }
+    metrics->jsonFD = fd;
+    return 0;
+}
+
+static void WriteAll(int fd, const char *bytes, size_t length) {
+    while (length) {
+        ssize_t n = write(fd, bytes, length);
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return;
+        }
+        bytes += n;
+        length -= (size_t)n;
+    }
+}
+
+// Answers one client. If it sends an HTTP request within a short time,
+// the metrics are wrapped in an HTTP response.
+static void ServeClient(SEMetrics *metrics, int fd) {
+    char request[1024];
+    ssize_t n = 0;
+    struct pollfd pfd = { fd, POLLIN, 0 };
+    if (poll(&pfd, 1, REQUEST_TIMEOUT_MS) == 1) {
+        n = read(fd, request, sizeof(request));
+    }
+    int http = (n >= 4 && memcmp(request, "GET ", 4) == 0);
+    
+    size_t length = 0;
+    char *text = SEMetricsCopyPrometheusText(metrics, &length);
+    if (text == NULL) {
+        return;
+    }
+    if (http) {
+        char header[256];
+        int headerLength = snprintf(header, sizeof(header),
+                                    "HTTP/1.0 200 OK\r\n"
+                                    "Content-Type: text/plain; version=0.0.4\r\n"
+                                    "Content-Length: %zu\r\n"
+                                    "Connection: close\r\n\r\n", length);
+        WriteAll(fd, header, (size_t)headerLength);
+    }
+    WriteAll(fd, text, length);
+    free(text);
+}
+
+static void *ServerThread(void *arg) {
+    SEMetrics *metrics = arg;
+    struct pollfd fds[2] = {
+        { metrics->serverFD, POLLIN, 0 },
+        { metrics->stopPipe[0], POLLIN, 0 }
+    };
+    for (;;) {
+        if (poll(fds, 2, -1) == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (fds[1].revents) {
+            break;
+        }
+        int client = accept(metrics->serverFD, NULL, NULL);
+        if (client == -1) {
+            continue;
+        }
+        ServeClient(metrics, client);
+        close(client);
+    }
+    return NULL;
+}
+
+int SEMetricsStartServer(SEMetrics *metrics, const char *socketPath) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(socketPath) >= sizeof(addr.sun_path)) {
+        return ENAMETOOLONG;
+    }
+    strcpy(addr.sun_path, socketPath);
+    
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1) {
+        return errno;
+    }
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    
+    // Replace a socket left behind by an earlier run. Create it with no
+    // access for others, rather than changing permissions after bind().
+    unlink(socketPath);
+    mode_t mask = umask(077);
+    int err = bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0 ? 0 : errno;
+    umask(mask);
+    if (!err && listen(fd, 8) == -1) {
+        err = errno;
+    }
+    if (!err && pipe(metrics->stopPipe) == -1) {
+        err = errno;
+    }
+    if (err) {
+        close(fd);
+        unlink(socketPath);
+        return err;
+    }
+    fcntl(metrics->stopPipe[0], F_SETFD, FD_CLOEXEC);
+    fcntl(metrics->stopPipe[1], F_SETFD, FD_CLOEXEC);
+    
+    metrics->serverFD = fd;
+    metrics->socketPath = strdup(socketPath);
+    err = pthread_create(&metrics->serverThread, NULL, ServerThread, metrics);
+    if (err) {
+        close(fd);
+        close(metrics->stopPipe[0]);
+        close(metrics->stopPipe[1]);
+        metrics->serverFD = metrics->stopPipe[0] = metrics->stopPipe[1] = -1;
+        unlink(socketPath);
+        free(metrics->socketPath);
+        metrics->socketPath = NULL;
+    }
+    return err;
+}
+
+void SEMetricsFree(SEMetrics *metrics) {
+    if (metrics == NULL) {
+        return;
+    }
+    if (metrics->serverFD != -1) {
+        WriteAll(metrics->stopPipe[1], "x", 1);
+        pthread_join(metrics->serverThread, NULL);
+        close(metrics->serverFD);
+        close(metrics->stopPipe[0]);
+        close(metrics->stopPipe[1]);
+        unlink(metrics->socketPath);
+        free(metrics->socketPath);
+    }
+    if (metrics->jsonFD != -1) {
+        close(metrics->jsonFD);
+    }
+    pthread_mutex_destroy(&metrics->lock);
+    free(metrics);
+}
@@ -0,0 +1,113 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Resource accounting and metrics for jobs run by an app.
+//
+// Each finished job is recorded with its queue wait, run time, CPU time,
+// memory use, output size and exit status. Records are aggregated into
+// counters, gauges and histograms of queue wait and run time, from which
+// percentiles and recent throughput are estimated. Portable C.
+//
+// Metrics can be exported in two ways: each record can be appended as a
+// JSON line to a file, and a Unix domain socket can serve all metrics in
+// the Prometheus text format. The socket answers plain connections as well
+// as HTTP requests, e.g.
+//
+//     curl --unix-socket /path/to/socket http://localhost/metrics
+
+#ifndef SE_METRICS_H
+#define SE_METRICS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct SEJobRecord {
+    double enqueueTime;         // SEMetricsNow() when queued
+    double startTime;           // SEMetricsNow() when started
+    double endTime;             // SEMetricsNow() when finished
+    double startDate;           // Seconds since 1970 when started
+    double userTime;            // CPU time, seconds
+    double systemTime;
+    uint64_t maxResidentSize;   // Bytes
+    uint64_t outputBytes;
+    int exitStatus;
+    int timedOut;               // Terminated for exceeding its timeout
+} SEJobRecord;
+
+typedef enum SEMetricsHistogram {
+    SEMetricsHistogram_QueueWait = 0,
+    SEMetricsHistogram_Duration,
+    SEMetricsHistogram_Count
+} SEMetricsHistogram;
+
+typedef struct SEMetrics SEMetrics;
+
+// Monotonic clock, seconds
+double SEMetricsNow(void);
+
+SEMetrics *SEMetricsCreate(void);
+// Stops the socket server and closes the JSON lines file
+void SEMetricsFree(SEMetrics *metrics);
+
+// Updating metrics. Safe to call from any thread.
+void SEMetricsSetQueueDepth(SEMetrics *metrics, unsigned int depth);
+void SEMetricsJobQueued(SEMetrics *metrics);
+void SEMetricsJobStarted(SEMetrics *metrics);
+void SEMetricsJobFinished(SEMetrics *metrics, const SEJobRecord *record);
+
+// Percentile (0-100) estimated from histogram buckets, 0 if no jobs have
+// finished
+double SEMetricsPercentile(SEMetrics *metrics, SEMetricsHistogram histogram, double percentile);
+// Jobs finished per second over the last minute
+double SEMetricsThroughput(SEMetrics *metrics);
+
+// Formats a record as a single line of JSON, with a terminating '\n'.
+// Returns the length, as snprintf.
+int SEJobRecordFormatJSON(const SEJobRecord *record, char *buf, size_t size);
+// Returns all metrics in Prometheus text format. Free with free().
+char *SEMetricsCopyPrometheusText(SEMetrics *metrics, size_t *length);
+
+// Appends each finished job's record to a file as a line of JSON.
+// Returns 0 on success, otherwise an errno value.
+int SEMetricsOpenJSONLinesFile(SEMetrics *metrics, const char *path);
+// Serves metrics on a Unix domain socket, from a background thread.
+// The socket is only accessible by the current user. Returns 0 on success,
+// otherwise an errno value.
+int SEMetricsStartServer(SEMetrics *metrics, const char *socketPath);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,166 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <stdint.h>
+#include <string.h>
+
+#include "SEOutputCommands.h"
+
+typedef struct CommandSyntax {
+    const char *prefix;
+    size_t length;
+    int exact;      // Whole line must match, otherwise prefix is followed by an argument
+    SEOutputCommandType type;
+} CommandSyntax;
+
+// Grouped by first byte
+static const CommandSyntax syntaxTable[] = {
+    { "ALERT:",         6,  0, SEOutputCommand_Alert },
+    { "DETAILS:SHOW",   12, 1, SEOutputCommand_DetailsShow },
+    { "DETAILS:HIDE",   12, 1, SEOutputCommand_DetailsHide },
+    { "LOCATION:",      9,  0, SEOutputCommand_Location },
+    { "NOTIFICATION:",  13, 0, SEOutputCommand_Notification },
+    { "PROGRESS:",      9,  0, SEOutputCommand_Progress },
+    { "QUITAPP",        7,  1, SEOutputCommand_Quit },
+    { "REFRESH",        7,  1, SEOutputCommand_Refresh },
+};
+
+// Range of syntax table entries for each first byte. Lines starting
+// with any other byte are output, which is decided by this lookup alone.
+static const struct { uint8_t first; uint8_t count; } syntaxByFirstByte[256] = {
+    ['A'] = { 0, 1 },
+    ['D'] = { 1, 2 },
+    ['L'] = { 3, 1 },
+    ['N'] = { 4, 1 },
+    ['P'] = { 5, 1 },
+    ['Q'] = { 6, 1 },
+    ['R'] = { 7, 1 },
+};
+
+// Shortest command prefix
+#define MIN_COMMAND_LENGTH 6
+
+SEOutputCommandType SEOutputCommandParse(const char *line, size_t length, SEOutputCommand *command) {
+    command->type = SEOutputCommand_None;
+    command->argument = NULL;
+    command->argumentLength = 0;
+    command->hasProgress = 0;
+    command->progress = 0;
+    
+    if (length < MIN_COMMAND_LENGTH) {
+        return SEOutputCommand_None;
+    }
+    
+    uint8_t first = syntaxByFirstByte[(uint8_t)line[0]].first;
+    uint8_t count = syntaxByFirstByte[(uint8_t)line[0]].count;
+    for (uint8_t i = first; i < first + count; i++) {
+        const CommandSyntax *syntax = &syntaxTable[i];
+        if (length < syntax->length || (syntax->exact && length != syntax->length)) {
+            continue;
+        }
+        if (memcmp(line, syntax->prefix, syntax->length) != 0) {
+            continue;
+        }
+        command->type = syntax->type;
+        command->argument = line + syntax->length;
+        command->argumentLength = length - syntax->length;
+        break;
+    }
+    
+    if (command->type == SEOutputCommand_Progress) {
+        command->hasProgress = SEOutputCommandParsePercentage(command->argument, command->argumentLength, &command->progress);
+    }
+    
+    return command->type;
+}
+
+static int IsBlank(char c) {
+    return c == ' ' || c == '\t';
+}
+
+int SEOutputCommandParsePercentage(const char *str, size_t length, double *value) {
+    const char *p = str;
+    const char *end = str + length;
+    
+    while (p < end && IsBlank(*p)) {
+        p++;
+    }
+    while (end > p && IsBlank(end[-1])) {
+        end--;
+    }
+    if (end > p && end[-1] == '%') {
+        end--;
+        while (end > p && IsBlank(end[-1])) {
+            end--;
+        }
+    }
+    
+    int negative = 0;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = (*p == '-');
+        p++;
+    }
+    
+    // Mantissa digits beyond what a 64-bit integer holds are ignored
+    // after adjusting the exponent, which is plenty for a percentage
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    int seenSeparator = 0;
+    for (; p < end; p++) {
+        char c = *p;
+        if (c >= '0' && c <= '9') {
+            if (mantissa < UINT64_MAX / 10 - 9) {
+                mantissa = mantissa * 10 + (uint64_t)(c - '0');
+                exponent -= seenSeparator;
+            } else {
+                exponent += !seenSeparator;
+            }
+            digits++;
+        } else if ((c == '.' || c == ',') && !seenSeparator) {
+            seenSeparator = 1;
+        } else {
+            return 0;
+        }
+    }
+    if (digits == 0) {
+        return 0;
+    }
+    
+    double result = (double)mantissa;
+    for (; exponent < 0; exponent++) {
+        result /= 10;
+    }
+    for (; exponent > 0; exponent--) {
+        result *= 10;
+    }
+    *value = negative ? -result : result;
+    return 1;
+}
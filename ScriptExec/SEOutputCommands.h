@@ -0,0 +1,78 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Parser for the commands scripts can embed in their output, e.g. PROGRESS:50
+// or QUITAPP. Lines are classified in a single pass by dispatching on their
+// first byte into a table of command prefixes, so a data line typically costs
+// one table lookup. Works on raw bytes and never allocates. Portable C.
+
+#ifndef SE_OUTPUT_COMMANDS_H
+#define SE_OUTPUT_COMMANDS_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum SEOutputCommandType {
+    SEOutputCommand_None = 0,   // Regular line of output
+    SEOutputCommand_Quit,
+    SEOutputCommand_Refresh,
+    SEOutputCommand_Notification,
+    SEOutputCommand_Alert,
+    SEOutputCommand_Progress,
+    SEOutputCommand_DetailsShow,
+    SEOutputCommand_DetailsHide,
+    SEOutputCommand_Location
+} SEOutputCommandType;
+
+typedef struct SEOutputCommand {
+    SEOutputCommandType type;
+    // Text following the command prefix. Points into the line, not NUL-terminated.
+    const char *argument;
+    size_t argumentLength;
+    // For SEOutputCommand_Progress. Not set if the percentage is malformed.
+    int hasProgress;
+    double progress;
+} SEOutputCommand;
+
+// Classify line, which excludes the line terminator
+SEOutputCommandType SEOutputCommandParse(const char *line, size_t length, SEOutputCommand *command);
+
+// Parse a percentage such as "42", "42.5", "42,5" or "42%", allowing surrounding
+// blanks. Accepts either '.' or ',' as decimal separator. Returns 0 if malformed.
+int SEOutputCommandParsePercentage(const char *str, size_t length, double *value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,385 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include "SEOutputLog.h"
+
+#define BATCH_SIZE          (64 * 1024)
+#define MAX_PENDING         (4 * 1024 * 1024)
+#define FLUSH_INTERVAL      1
+
+struct SEOutputLog {
+    SEOutputLogConfig config;
+    char *path;
+    
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wakeWriter;
+    pthread_cond_t wakeClients;
+    
+    // Filled by clients, swapped with writing by the writer thread
+    char *pending;
+    size_t pendingLength;
+    size_t pendingCapacity;
+    char *writing;
+    size_t writingCapacity;
+    
+    uint64_t flushRequested;
+    uint64_t flushCompleted;
+    int closing;
+    int failed;
+    
+    // Only used by the writer thread
+    int fd;
+    uint64_t size;
+    time_t segmentStart;
+};
+
+#pragma mark - Files
+
+static int OpenLogFile(SEOutputLog *log) {
+    log->fd = open(log->path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    if (log->fd == -1) {
+        return errno;
+    }
+    struct stat st;
+    log->size = (fstat(log->fd, &st) == 0) ? (uint64_t)st.st_size : 0;
+    log->segmentStart = time(NULL);
+    return 0;
+}
+
+static int WriteAll(int fd, const char *bytes, size_t length) {
+    while (length) {
+        ssize_t n = write(fd, bytes, length);
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return (n == 0) ? EIO : errno;
+        }
+        bytes += n;
+        length -= (size_t)n;
+    }
+    return 0;
+}
+
+// Returns ENAMETOOLONG rather than a truncated path, which would name another file
+static int FormatPath(char *buf, size_t size, const char *format, const char *path, unsigned int segment, const char *suffix) {
+    int n = snprintf(buf, size, format, path, segment, suffix);
+    return (n < 0 || (size_t)n >= size) ? ENAMETOOLONG : 0;
+}
+
+static int SegmentPath(const SEOutputLog *log, unsigned int segment, int compressed, char *buf, size_t size) {
+    return FormatPath(buf, size, "%s.%u%s", log->path, segment, compressed ? ".gz" : "");
+}
+
+// Compresses a file to <path>.gz and deletes the original
+static int CompressFile(const char *path) {
+    char gzPath[PATH_MAX];
+    char tmpPath[PATH_MAX];
+    int gzLength = snprintf(gzPath, sizeof(gzPath), "%s.gz", path);
+    int tmpLength = snprintf(tmpPath, sizeof(tmpPath), "%s.gz.tmp", path);
+    if (gzLength < 0 || (size_t)gzLength >= sizeof(gzPath) ||
+        tmpLength < 0 || (size_t)tmpLength >= sizeof(tmpPath)) {
+        return ENAMETOOLONG;
+    }
+    
+    int in = open(path, O_RDONLY | O_CLOEXEC);
+    if (in == -1) {
+        return errno;
+    }
+    gzFile out = gzopen(tmpPath, "wb6");
+    if (out == NULL) {
+        close(in);
+        return errno ? errno : ENOMEM;
+    }
+    
+    int err = 0;
+    char buf[65536];
+    ssize_t n;
+    while ((n = read(in, buf, sizeof(buf))) != 0) {
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n == -1) {
+            err = errno;
+            break;
+        }
+        if (gzwrite(out, buf, (unsigned int)n) != n) {
+            err = EIO;
+            break;
+        }
+    }
+    close(in);
+    if (gzclose(out) != Z_OK && !err) {
+        err = EIO;
+    }
+    
+    if (!err && rename(tmpPath, gzPath) == -1) {
+        err = errno;
+    }
+    if (err) {
+        unlink(tmpPath);
+        return err;
+    }
+    unlink(path);
+    return 0;
+}
+
+static int Rotate(SEOutputLog *log) {
+    close(log->fd);
+    log->fd = -1;
+    
+    char from[PATH_MAX];
+    char to[PATH_MAX];
+    unsigned int segments = log->config.segments;
+    if (segments == 0) {
+        unlink(log->path);
+        return OpenLogFile(log);
+    }
+    
+    // Drop the oldest segment and shift the others along. Segment paths
+    // were checked to fit when the log was opened.
+    for (int compressed = 0; compressed < 2; compressed++) {
+        if (SegmentPath(log, segments, compressed, to, sizeof(to)) == 0) {
+            unlink(to);
+        }
+        for (unsigned int i = segments - 1; i >= 1; i--) {
+            if (SegmentPath(log, i, compressed, from, sizeof(from)) == 0 &&
+                SegmentPath(log, i + 1, compressed, to, sizeof(to)) == 0) {
+                rename(from, to);
+            }
+        }
+    }
+    int err = SegmentPath(log, 1, 0, to, sizeof(to));
+    if (err) {
+        return err;
+    }
+    rename(log->path, to);
+    
+    err = OpenLogFile(log);
+    if (log->config.compress) {
+        // Leave the segment uncompressed if compression fails
+        CompressFile(to);
+    }
+    return err;
+}
+
+static int NeedsRotation(const SEOutputLog *log) {
+    if (log->size == 0) {
+        return 0;
+    }
+    if (log->config.maxSize && log->size >= log->config.maxSize) {
+        return 1;
+    }
+    if (log->config.rotationInterval && (uint64_t)(time(NULL) - log->segmentStart) >= log->config.rotationInterval) {
+        return 1;
+    }
+    return 0;
+}
+
+#pragma mark - Writer thread
+
+static void *WriterThread(void *arg) {
+    SEOutputLog *log = arg;
+    
+    pthread_mutex_lock(&log->lock);
+    for (;;) {
+        // Wait for a batch, a flush, closing or the flush interval
+        if (log->pendingLength < BATCH_SIZE && log->flushRequested == log->flushCompleted && !log->closing) {
+            struct timeval now;
+            gettimeofday(&now, NULL);
+            struct timespec deadline = { now.tv_sec + FLUSH_INTERVAL, now.tv_usec * 1000 };
+            pthread_cond_timedwait(&log->wakeWriter, &log->lock, &deadline);
+        }
+        
+        // Take the pending output, leaving clients an empty buffer
+        char *bytes = log->pending;
+        size_t length = log->pendingLength;
+        size_t capacity = log->pendingCapacity;
+        log->pending = log->writing;
+        log->pendingCapacity = log->writingCapacity;
+        log->pendingLength = 0;
+        log->writing = bytes;
+        log->writingCapacity = capacity;
+        uint64_t flushGeneration = log->flushRequested;
+        pthread_cond_broadcast(&log->wakeClients);
+        pthread_mutex_unlock(&log->lock);
+        
+        int err = 0;
+        if (length && !log->failed) {
+            err = WriteAll(log->fd, bytes, length);
+            log->size += length;
+            if (!err && NeedsRotation(log)) {
+                err = Rotate(log);
+            }
+        }
+        
+        pthread_mutex_lock(&log->lock);
+        if (err) {
+            // Stop logging rather than blocking the app
+            log->failed = err;
+        }
+        log->flushCompleted = flushGeneration;
+        pthread_cond_broadcast(&log->wakeClients);
+        if (log->closing && log->pendingLength == 0) {
+            break;
+        }
+    }
+    pthread_mutex_unlock(&log->lock);
+    
+    return NULL;
+}
+
+#pragma mark - Public
+
+SEOutputLog *SEOutputLogOpen(const SEOutputLogConfig *config, int *error) {
+    SEOutputLog *log = calloc(1, sizeof(SEOutputLog));
+    if (log == NULL || (log->path = strdup(config->path)) == NULL) {
+        free(log);
+        *error = ENOMEM;
+        return NULL;
+    }
+    log->config = *config;
+    log->config.path = log->path;
+    
+    // Fail now if the names of rotated segments, including the temporary
+    // file compression writes, would be too long
+    char longest[PATH_MAX];
+    int err = FormatPath(longest, sizeof(longest), "%s.%u%s", log->path, log->config.segments, ".gz.tmp");
+    if (!err) {
+        err = OpenLogFile(log);
+    }
+    if (err) {
+        free(log->path);
+        free(log);
+        *error = err;
+        return NULL;
+    }
+    
+    pthread_mutex_init(&log->lock, NULL);
+    pthread_cond_init(&log->wakeWriter, NULL);
+    pthread_cond_init(&log->wakeClients, NULL);
+    
+    err = pthread_create(&log->thread, NULL, WriterThread, log);
+    if (err) {
+        close(log->fd);
+        pthread_mutex_destroy(&log->lock);
+        pthread_cond_destroy(&log->wakeWriter);
+        pthread_cond_destroy(&log->wakeClients);
+        free(log->path);
+        free(log);
+        *error = err;
+        return NULL;
+    }
+    return log;
+}
+
+void SEOutputLogWrite(SEOutputLog *log, const void *bytes, size_t length) {
+    if (length == 0) {
+        return;
+    }
+    pthread_mutex_lock(&log->lock);
+    
+    // Wait for the writer to catch up if it has fallen far behind
+    while (log->pendingLength && log->pendingLength + length > MAX_PENDING && !log->failed) {
+        pthread_cond_signal(&log->wakeWriter);
+        pthread_cond_wait(&log->wakeClients, &log->lock);
+    }
+    
+    if (!log->failed && log->pendingLength + length > log->pendingCapacity) {
+        size_t capacity = log->pendingCapacity ? log->pendingCapacity : BATCH_SIZE;
+        while (capacity < log->pendingLength + length) {
+            capacity *= 2;
+        }
+        char *buffer = realloc(log->pending, capacity);
+        if (buffer == NULL) {
+            pthread_mutex_unlock(&log->lock);
+            return;
+        }
+        log->pending = buffer;
+        log->pendingCapacity = capacity;
+    }
+    
+    if (!log->failed) {
+        memcpy(log->pending + log->pendingLength, bytes, length);
+        log->pendingLength += length;
+        // Only wake the writer once per batch
+        if (log->pendingLength >= BATCH_SIZE && log->pendingLength - length < BATCH_SIZE) {
+            pthread_cond_signal(&log->wakeWriter);
+        }
+    }
+    
+    pthread_mutex_unlock(&log->lock);
+}
+
+void SEOutputLogFlush(SEOutputLog *log) {
+    pthread_mutex_lock(&log->lock);
+    uint64_t generation = ++log->flushRequested;
+    pthread_cond_signal(&log->wakeWriter);
+    while (log->flushCompleted < generation) {
+        pthread_cond_wait(&log->wakeClients, &log->lock);
+    }
+    pthread_mutex_unlock(&log->lock);
+}
+
+void SEOutputLogClose(SEOutputLog *log) {
+    if (log == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&log->lock);
+    log->closing = 1;
+    pthread_cond_signal(&log->wakeWriter);
+    pthread_mutex_unlock(&log->lock);
+    pthread_join(log->thread, NULL);
+    
+    if (log->fd != -1) {
+        close(log->fd);
+    }
+    pthread_mutex_destroy(&log->lock);
+    pthread_cond_destroy(&log->wakeWriter);
+    pthread_cond_destroy(&log->wakeClients);
+    free(log->pending);
+    free(log->writing);
+    free(log->path);
+    free(log);
+}
@@ -0,0 +1,85 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Append-only log of script output, written in the background.
+//
+// Output passed to SEOutputLogWrite is copied to a buffer and returns
+// immediately. A writer thread takes the buffer whenever 64 KB have
+// accumulated, or once a second, and writes it with a single write(), so
+// the cost of logging doesn't grow with the number of reads from the
+// script. Writers only block if more than 4 MB are waiting to be written.
+//
+// The log is rotated when it reaches a maximum size or has been written to
+// for longer than the rotation interval. The current log is renamed to
+// "<path>.1", older segments are renamed "<path>.2" and so on, and
+// segments beyond the limit are deleted. Rotated segments can be
+// compressed with gzip, by the writer thread. Portable C, needs zlib.
+
+#ifndef SE_OUTPUT_LOG_H
+#define SE_OUTPUT_LOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SE_OUTPUT_LOG_DEFAULT_MAX_SIZE          (10 * 1024 * 1024)
+#define SE_OUTPUT_LOG_DEFAULT_ROTATION_INTERVAL (24 * 60 * 60)
+#define SE_OUTPUT_LOG_DEFAULT_SEGMENTS          5
+
+typedef struct SEOutputLogConfig {
+    const char *path;
+    uint64_t maxSize;           // Bytes, 0 for no limit
+    uint64_t rotationInterval;  // Seconds, 0 for no limit
+    unsigned int segments;      // Number of rotated segments kept
+    int compress;               // Compress rotated segments
+} SEOutputLogConfig;
+
+typedef struct SEOutputLog SEOutputLog;
+
+// Opens a log for appending and starts its writer thread.
+// Returns NULL and sets *error to an errno value on failure.
+SEOutputLog *SEOutputLogOpen(const SEOutputLogConfig *config, int *error);
+
+void SEOutputLogWrite(SEOutputLog *log, const void *bytes, size_t length);
+
+// Waits until everything written so far is on disk
+void SEOutputLogFlush(SEOutputLog *log);
+
+// Flushes the log and stops its writer thread
+void SEOutputLogClose(SEOutputLog *log);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
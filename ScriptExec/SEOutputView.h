@@ -0,0 +1,63 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Output view for scripts that print very large amounts of text.
+//
+// NSTextView lays out its entire contents, so appending becomes slower and
+// memory use grows as output accumulates. This view keeps output in an
+// SELineStore and only lays out and draws the lines that are visible, so
+// the cost of appending and drawing doesn't depend on how much output
+// there is. Text is drawn in a single font and color. Supports selection,
+// copying, and Select All.
+//
+// The Find menu items show a find bar above the view. Searches use the
+// line store's search index and are updated as output arrives. Matches
+// are highlighted, and the view can show only lines that match.
+
+#import <Cocoa/Cocoa.h>
+
+@interface SEOutputView : NSView <NSSearchFieldDelegate>
+
+@property (nonatomic, strong) NSFont *font;
+@property (nonatomic, strong) NSColor *textColor;
+@property (nonatomic, strong) NSColor *backgroundColor;
+@property (nonatomic, readonly) NSUInteger numberOfLines;
+
+// Creates an output view and puts it in place of a text view in its scroll view
++ (instancetype)outputViewReplacingTextView:(NSTextView *)textView;
+
+- (void)appendText:(NSString *)text;
+- (void)clear;
+- (void)scrollToEnd;
+- (BOOL)writeToFile:(NSString *)path error:(NSError **)error;
+
+- (IBAction)performFindPanelAction:(id)sender;
+
+@end
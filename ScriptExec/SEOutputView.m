@@ -0,0 +1,679 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#import <CoreText/CoreText.h>
+#import <sys/stat.h>
+#import "SEOutputView.h"
+#import "SELineStore.h"
+
+// Only the start of very long lines is laid out and drawn
+#define MAX_DRAWN_LINE_LENGTH   4096
+#define TEXT_INSET              4.0
+
+// Positions are in rows, which are lines of output unless only
+// lines matching a search are shown
+typedef struct SEOutputPosition {
+    uint64_t row;
+    NSUInteger column; // UTF-16 index in the line
+} SEOutputPosition;
+
+static inline BOOL PositionPrecedes(SEOutputPosition a, SEOutputPosition b) {
+    return a.row < b.row || (a.row == b.row && a.column < b.column);
+}
+
+@interface SEOutputView()
+{
+    SELineStore *store;
+    CGFloat lineHeight;
+    CGFloat charWidth;
+    SEOutputPosition selectionAnchor;
+    SEOutputPosition selectionHead;
+    
+    // Search
+    NSString *searchString;
+    SELineMatches matches;
+    uint64_t searchedLineCount;
+    NSInteger currentMatch;
+    BOOL showsOnlyMatches;
+    
+    NSStackView *findBar;
+    NSSearchField *searchField;
+    NSButton *filterCheckbox;
+    NSTextField *matchCountField;
+}
+@end
+
+@implementation SEOutputView
+
++ (instancetype)outputViewReplacingTextView:(NSTextView *)textView {
+    NSScrollView *scrollView = [textView enclosingScrollView];
+    SEOutputView *outputView = [[self alloc] initWithFrame:[[scrollView contentView] bounds]];
+    [scrollView setDocumentView:outputView];
+    [scrollView setHasHorizontalScroller:YES];
+    [[scrollView window] makeFirstResponder:outputView];
+    return outputView;
+}
+
+- (instancetype)initWithFrame:(NSRect)frameRect {
+    self = [super initWithFrame:frameRect];
+    if (self) {
+        store = SELineStoreCreate(SE_LINE_STORE_DEFAULT_MEMORY_LIMIT);
+        SELineMatchesInit(&matches);
+        searchString = @"";
+        currentMatch = -1;
+        _textColor = [NSColor textColor];
+        _backgroundColor = [NSColor textBackgroundColor];
+        [self setFont:[NSFont userFixedPitchFontOfSize:0]];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+    SELineMatchesFree(&matches);
+    SELineStoreFree(store);
+}
+
+- (BOOL)isFlipped {
+    return YES;
+}
+
+- (BOOL)isOpaque {
+    return YES;
+}
+
+- (BOOL)acceptsFirstResponder {
+    return YES;
+}
+
+- (void)viewDidMoveToSuperview {
+    NSNotificationCenter *center = [NSNotificationCenter defaultCenter];
+    [center removeObserver:self name:NSViewFrameDidChangeNotification object:nil];
+    
+    // Keep filling the clip view as the window is resized
+    NSView *superview = [self superview];
+    if (superview) {
+        [superview setPostsFrameChangedNotifications:YES];
+        [center addObserver:self
+                   selector:@selector(updateFrameSize)
+                       name:NSViewFrameDidChangeNotification
+                     object:superview];
+        [self updateFrameSize];
+    }
+}
+
+#pragma mark - Attributes
+
+- (void)setFont:(NSFont *)font {
+    _font = font;
+    lineHeight = ceil([[[NSLayoutManager alloc] init] defaultLineHeightForFont:font]);
+    charWidth = [@"m" sizeWithAttributes:@{NSFontAttributeName: font}].width;
+    [self updateFrameSize];
+    [self setNeedsDisplay:YES];
+}
+
+- (void)setTextColor:(NSColor *)textColor {
+    _textColor = textColor;
+    [self setNeedsDisplay:YES];
+}
+
+- (void)setBackgroundColor:(NSColor *)backgroundColor {
+    _backgroundColor = backgroundColor;
+    [self setNeedsDisplay:YES];
+}
+
+- (NSUInteger)numberOfLines {
+    return (NSUInteger)SELineStoreLineCount(store);
+}
+
+#pragma mark - Output
+
+- (void)appendText:(NSString *)text {
+    const char *bytes = [text UTF8String];
+    if (bytes == NULL || *bytes == '\0') {
+        return;
+    }
+    
+    BOOL wasAtEnd = NSMaxY([self visibleRect]) >= NSHeight([self bounds]) - lineHeight;
+    uint64_t rowCount = [self rowCount];
+    uint64_t firstChangedRow = rowCount ? rowCount - 1 : 0;
+    
+    int err = SELineStoreAppend(store, bytes, strlen(bytes));
+    if (err) {
+        NSLog(@"Unable to store output: %s", strerror(err));
+    }
+    if ([searchString length]) {
+        [self searchNewOutput];
+    }
+    
+    // Only the last row and new ones need to be drawn
+    [self updateFrameSize];
+    rowCount = [self rowCount];
+    if (rowCount > firstChangedRow) {
+        NSRect changedRect = NSMakeRect(0, [self yForRow:firstChangedRow],
+                                        NSWidth([self bounds]), (rowCount - firstChangedRow) * lineHeight);
+        [self setNeedsDisplayInRect:changedRect];
+    }
+    
+    // Follow output unless the user has scrolled up
+    if (wasAtEnd) {
+        [self scrollToEnd];
+    }
+}
+
+- (void)clear {
+    SELineStoreClear(store);
+    matches.count = 0;
+    searchedLineCount = 0;
+    currentMatch = -1;
+    [self updateMatchCount];
+    selectionAnchor = selectionHead = (SEOutputPosition){ 0, 0 };
+    [self updateFrameSize];
+    [self setNeedsDisplay:YES];
+}
+
+- (void)scrollToEnd {
+    NSRect visibleRect = [self visibleRect];
+    CGFloat y = MAX(0, NSHeight([self bounds]) - NSHeight(visibleRect));
+    [self scrollPoint:NSMakePoint(NSMinX(visibleRect), y)];
+}
+
+- (BOOL)writeToFile:(NSString *)path error:(NSError **)error {
+    // Write to a temporary file and rename it so the file is replaced atomically
+    char *tmpPath = strdup([[path stringByAppendingString:@".XXXXXX"] fileSystemRepresentation]);
+    int fd = mkstemp(tmpPath);
+    int err = (fd == -1) ? errno : 0;
+    if (fd != -1) {
+        if (fchmod(fd, 0644) == -1) {
+            err = errno;
+        }
+        if (!err) {
+            err = SELineStoreWriteToFile(store, fd);
+        }
+        if (close(fd) == -1 && !err) {
+            err = errno;
+        }
+        if (!err && rename(tmpPath, [path fileSystemRepresentation]) == -1) {
+            err = errno;
+        }
+        if (err) {
+            unlink(tmpPath);
+        }
+    }
+    free(tmpPath);
+    
+    if (err) {
+        if (error) {
+            *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:err userInfo:nil];
+        }
+        return NO;
+    }
+    return YES;
+}
+
+#pragma mark - Layout
+
+- (uint64_t)rowCount {
+    return showsOnlyMatches ? matches.count : SELineStoreLineCount(store);
+}
+
+- (uint64_t)lineForRow:(uint64_t)row {
+    return showsOnlyMatches ? matches.lines[row] : row;
+}
+
+- (void)updateFrameSize {
+    NSSize clipSize = [self superview] ? [[self superview] bounds].size : [self frame].size;
+    uint64_t maxLineLength = MIN(SELineStoreMaxLineLength(store), MAX_DRAWN_LINE_LENGTH);
+    
+    NSSize size;
+    size.width = MAX(clipSize.width, ceil(maxLineLength * charWidth) + (2 * TEXT_INSET));
+    size.height = MAX(clipSize.height, ([self rowCount] * lineHeight) + (2 * TEXT_INSET));
+    if (!NSEqualSizes(size, [self frame].size)) {
+        [self setFrameSize:size];
+    }
+}
+
+- (CGFloat)yForRow:(uint64_t)row {
+    return TEXT_INSET + (row * lineHeight);
+}
+
+// Index of the row at a vertical position, clamped to existing rows
+- (uint64_t)rowAtY:(CGFloat)y {
+    uint64_t count = [self rowCount];
+    if (count == 0 || y < TEXT_INSET) {
+        return 0;
+    }
+    uint64_t row = (uint64_t)((y - TEXT_INSET) / lineHeight);
+    return MIN(row, count - 1);
+}
+
+- (NSString *)stringForLine:(uint64_t)index maxLength:(size_t)maxLength {
+    size_t length;
+    const char *bytes = SELineStoreGetLine(store, index, maxLength, &length);
+    if (bytes == NULL || length == 0) {
+        return @"";
+    }
+    // Don't cut a truncated line in the middle of a UTF-8 sequence
+    if (length < SELineStoreLineLength(store, index)) {
+        while (length > 0 && (bytes[length] & 0xC0) == 0x80) {
+            length--;
+        }
+    }
+    NSString *string = [[NSString alloc] initWithBytes:bytes length:length encoding:NSUTF8StringEncoding];
+    if (string == nil) {
+        // Not all scripts print valid UTF-8
+        string = [[NSString alloc] initWithBytes:bytes length:length encoding:NSISOLatin1StringEncoding];
+    }
+    return string;
+}
+
+- (NSString *)stringForRow:(uint64_t)row maxLength:(size_t)maxLength {
+    return [self stringForLine:[self lineForRow:row] maxLength:maxLength];
+}
+
+- (CTLineRef)newTextLineForString:(NSString *)string {
+    NSDictionary *attributes = @{ NSFontAttributeName: _font,
+                                  (NSString *)kCTForegroundColorFromContextAttributeName: @YES };
+    NSAttributedString *attrString = [[NSAttributedString alloc] initWithString:string attributes:attributes];
+    return CTLineCreateWithAttributedString((__bridge CFAttributedStringRef)attrString);
+}
+
+#pragma mark - Drawing
+
+- (void)fillRangeOfLine:(CTLineRef)line from:(NSUInteger)start to:(NSUInteger)end y:(CGFloat)y {
+    CGFloat x1 = CTLineGetOffsetForStringIndex(line, start, NULL);
+    CGFloat x2 = (end == NSUIntegerMax) ? NSWidth([self bounds]) - TEXT_INSET : CTLineGetOffsetForStringIndex(line, end, NULL);
+    NSRectFill(NSMakeRect(TEXT_INSET + x1, y, x2 - x1, lineHeight));
+}
+
+- (void)drawRect:(NSRect)dirtyRect {
+    [_backgroundColor setFill];
+    NSRectFill(dirtyRect);
+    
+    if ([self rowCount] == 0) {
+        return;
+    }
+    
+    SEOutputPosition selStart, selEnd;
+    BOOL hasSelection = [self getSelectionStart:&selStart end:&selEnd];
+    CGContextRef context = [[NSGraphicsContext currentContext] CGContext];
+    CGFloat ascender = ceil([_font ascender]);
+    
+    uint64_t lastRow = [self rowAtY:NSMaxY(dirtyRect)];
+    for (uint64_t row = [self rowAtY:NSMinY(dirtyRect)]; row <= lastRow; row++) {
+        CGFloat y = [self yForRow:row];
+        NSString *string = [self stringForRow:row maxLength:MAX_DRAWN_LINE_LENGTH];
+        CTLineRef line = [self newTextLineForString:string];
+        NSUInteger length = [string length];
+        
+        // Search matches
+        if ([searchString length]) {
+            [[NSColor findHighlightColor] setFill];
+            NSRange searchRange = NSMakeRange(0, length);
+            NSRange found;
+            while ((found = [string rangeOfString:searchString options:NSCaseInsensitiveSearch range:searchRange]).location != NSNotFound) {
+                [self fillRangeOfLine:line from:found.location to:NSMaxRange(found) y:y];
+                searchRange = NSMakeRange(NSMaxRange(found), length - NSMaxRange(found));
+            }
+        }
+        
+        // Selection, extending to the edge of the view for all but its last row
+        if (hasSelection && row >= selStart.row && row <= selEnd.row) {
+            NSUInteger from = (row == selStart.row) ? MIN(selStart.column, length) : 0;
+            NSUInteger to = (row == selEnd.row) ? MIN(selEnd.column, length) : NSUIntegerMax;
+            [[NSColor selectedTextBackgroundColor] setFill];
+            [self fillRangeOfLine:line from:from to:to y:y];
+        }
+        
+        // Core Text draws upside down in flipped views unless the text matrix is flipped too
+        CGContextSaveGState(context);
+        [_textColor setFill];
+        CGContextSetTextMatrix(context, CGAffineTransformMakeScale(1.0, -1.0));
+        CGContextSetTextPosition(context, TEXT_INSET, y + ascender);
+        CTLineDraw(line, context);
+        CGContextRestoreGState(context);
+        
+        CFRelease(line);
+    }
+}
+
+#pragma mark - Selection
+
+- (BOOL)getSelectionStart:(SEOutputPosition *)start end:(SEOutputPosition *)end {
+    BOOL reversed = PositionPrecedes(selectionHead, selectionAnchor);
+    *start = reversed ? selectionHead : selectionAnchor;
+    *end = reversed ? selectionAnchor : selectionHead;
+    return PositionPrecedes(*start, *end);
+}
+
+- (SEOutputPosition)positionForPoint:(NSPoint)point {
+    SEOutputPosition position = { 0, 0 };
+    uint64_t count = [self rowCount];
+    if (count == 0 || point.y < TEXT_INSET) {
+        return position;
+    }
+    
+    position.row = [self rowAtY:point.y];
+    CTLineRef line = [self newTextLineForString:[self stringForRow:position.row maxLength:MAX_DRAWN_LINE_LENGTH]];
+    if (point.y >= [self yForRow:count]) {
+        // Below the last row
+        position.column = CTLineGetStringRange(line).length;
+    } else {
+        CFIndex index = CTLineGetStringIndexForPosition(line, CGPointMake(point.x - TEXT_INSET, 0));
+        position.column = (index == kCFNotFound) ? 0 : index;
+    }
+    CFRelease(line);
+    
+    return position;
+}
+
+- (void)mouseDown:(NSEvent *)event {
+    [[self window] makeFirstResponder:self];
+    
+    NSPoint point = [self convertPoint:[event locationInWindow] fromView:nil];
+    selectionHead = [self positionForPoint:point];
+    if (([event modifierFlags] & NSEventModifierFlagShift) == 0) {
+        selectionAnchor = selectionHead;
+    }
+    [self setNeedsDisplay:YES];
+}
+
+- (void)mouseDragged:(NSEvent *)event {
+    [self autoscroll:event];
+    NSPoint point = [self convertPoint:[event locationInWindow] fromView:nil];
+    selectionHead = [self positionForPoint:point];
+    [self setNeedsDisplay:YES];
+}
+
+- (NSString *)selectedString {
+    SEOutputPosition start, end;
+    if (![self getSelectionStart:&start end:&end]) {
+        return nil;
+    }
+    
+    NSMutableString *selection = [NSMutableString string];
+    for (uint64_t row = start.row; row <= end.row; row++) {
+        NSString *line = [self stringForRow:row maxLength:SIZE_MAX];
+        NSUInteger from = (row == start.row) ? MIN(start.column, [line length]) : 0;
+        NSUInteger to = (row == end.row) ? MIN(end.column, [line length]) : [line length];
+        [selection appendString:[line substringWithRange:NSMakeRange(from, to - from)]];
+        if (row < end.row) {
+            [selection appendString:@"\n"];
+        }
+    }
+    return selection;
+}
+
+- (IBAction)copy:(id)sender {
+    NSString *selection = [self selectedString];
+    if (selection) {
+        NSPasteboard *pasteboard = [NSPasteboard generalPasteboard];
+        [pasteboard clearContents];
+        [pasteboard writeObjects:@[selection]];
+    }
+}
+
+- (IBAction)selectAll:(id)sender {
+    uint64_t count = [self rowCount];
+    if (count == 0) {
+        return;
+    }
+    selectionAnchor = (SEOutputPosition){ 0, 0 };
+    selectionHead = (SEOutputPosition){ count - 1, NSUIntegerMax };
+    [self setNeedsDisplay:YES];
+}
+
+- (BOOL)validateMenuItem:(NSMenuItem *)menuItem {
+    SEL action = [menuItem action];
+    SEOutputPosition start, end;
+    if (action == @selector(copy:)) {
+        return [self getSelectionStart:&start end:&end];
+    }
+    if (action == @selector(selectAll:)) {
+        return [self rowCount] > 0;
+    }
+    if (action == @selector(performFindPanelAction:)) {
+        switch ([menuItem tag]) {
+            case NSFindPanelActionShowFindPanel:
+                return YES;
+            case NSFindPanelActionNext:
+            case NSFindPanelActionPrevious:
+                return matches.count > 0;
+            case NSFindPanelActionSetFindString:
+                return [self getSelectionStart:&start end:&end];
+        }
+    }
+    return NO;
+}
+
+#pragma mark - Search
+
+- (IBAction)performFindPanelAction:(id)sender {
+    switch ([sender tag]) {
+        case NSFindPanelActionShowFindPanel:
+            [self showFindBar];
+            break;
+            
+        case NSFindPanelActionNext:
+            [self selectMatch:1];
+            break;
+            
+        case NSFindPanelActionPrevious:
+            [self selectMatch:-1];
+            break;
+            
+        case NSFindPanelActionSetFindString:
+        {
+            NSString *selection = [[[self selectedString] componentsSeparatedByString:@"\n"] firstObject];
+            if ([selection length]) {
+                [self showFindBar];
+                [searchField setStringValue:selection];
+                [self setSearchString:selection];
+            }
+        }
+            break;
+    }
+}
+
+- (void)setSearchString:(NSString *)string {
+    NSString *previous = searchString;
+    searchString = [string copy];
+    const char *needle = [searchString UTF8String];
+    size_t needleLength = strlen(needle);
+    
+    if (needleLength == 0) {
+        matches.count = 0;
+    } else if ([previous length] && searchedLineCount == SELineStoreLineCount(store) &&
+               strcasestr(needle, [previous UTF8String])) {
+        // Typing more of the search string. Only lines that matched before can match.
+        SELineMatches narrowed;
+        SELineMatchesInit(&narrowed);
+        SELineStoreSearchLines(store, needle, needleLength, matches.lines, matches.count, &narrowed);
+        SELineMatchesFree(&matches);
+        matches = narrowed;
+    } else {
+        matches.count = 0;
+        SELineStoreSearch(store, needle, needleLength, 0, &matches);
+    }
+    searchedLineCount = SELineStoreLineCount(store);
+    currentMatch = -1;
+    
+    [self updateMatchCount];
+    if (showsOnlyMatches) {
+        [self rowsChanged];
+    }
+    [self setNeedsDisplay:YES];
+}
+
+// Searches lines that have arrived since the last search
+- (void)searchNewOutput {
+    // The last line searched may have been incomplete
+    uint64_t fromLine = searchedLineCount ? searchedLineCount - 1 : 0;
+    if (matches.count && matches.lines[matches.count - 1] >= fromLine) {
+        matches.count--;
+    }
+    const char *needle = [searchString UTF8String];
+    SELineStoreSearch(store, needle, strlen(needle), fromLine, &matches);
+    searchedLineCount = SELineStoreLineCount(store);
+    [self updateMatchCount];
+}
+
+- (void)updateMatchCount {
+    NSString *countString = @"";
+    if ([searchString length]) {
+        countString = (matches.count == 1) ? @"1 line" : [NSString stringWithFormat:@"%lu lines", (unsigned long)matches.count];
+    }
+    [matchCountField setStringValue:countString];
+}
+
+// Index of the first match in a line at or after a line
+- (NSInteger)matchAtOrAfterLine:(uint64_t)line {
+    size_t low = 0;
+    size_t high = matches.count;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (matches.lines[mid] < line) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return (NSInteger)low;
+}
+
+- (void)selectMatch:(NSInteger)direction {
+    NSInteger count = (NSInteger)matches.count;
+    if (count == 0) {
+        NSBeep();
+        return;
+    }
+    
+    if (currentMatch < 0) {
+        // Start from the top of the visible area
+        uint64_t topLine = [self rowCount] ? [self lineForRow:[self rowAtY:NSMinY([self visibleRect])]] : 0;
+        currentMatch = [self matchAtOrAfterLine:topLine];
+        if (direction < 0) {
+            currentMatch--;
+        }
+    } else {
+        currentMatch += direction;
+    }
+    currentMatch = (currentMatch % count + count) % count;
+    
+    // Select the first occurrence in the line
+    uint64_t row = showsOnlyMatches ? (uint64_t)currentMatch : matches.lines[currentMatch];
+    NSString *string = [self stringForRow:row maxLength:MAX_DRAWN_LINE_LENGTH];
+    NSRange found = [string rangeOfString:searchString options:NSCaseInsensitiveSearch];
+    if (found.location == NSNotFound) {
+        found = NSMakeRange(0, 0);
+    }
+    selectionAnchor = (SEOutputPosition){ row, found.location };
+    selectionHead = (SEOutputPosition){ row, NSMaxRange(found) };
+    
+    CTLineRef line = [self newTextLineForString:string];
+    CGFloat x = CTLineGetOffsetForStringIndex(line, found.location, NULL);
+    CFRelease(line);
+    [self scrollRectToVisible:NSMakeRect(x, [self yForRow:row], (2 * TEXT_INSET) + 1, lineHeight)];
+    [self setNeedsDisplay:YES];
+}
+
+- (void)rowsChanged {
+    selectionAnchor = selectionHead = (SEOutputPosition){ 0, 0 };
+    [self updateFrameSize];
+    [self setNeedsDisplay:YES];
+    [self scrollToEnd];
+}
+
+#pragma mark - Find bar
+
+- (void)showFindBar {
+    NSScrollView *scrollView = [self enclosingScrollView];
+    if (findBar == nil) {
+        searchField = [[NSSearchField alloc] initWithFrame:NSMakeRect(0, 0, 240, 22)];
+        [searchField setSendsSearchStringImmediately:YES];
+        [searchField setTarget:self];
+        [searchField setAction:@selector(searchFieldChanged:)];
+        [searchField setDelegate:self];
+        [[searchField widthAnchor] constraintGreaterThanOrEqualToConstant:200].active = YES;
+        
+        filterCheckbox = [NSButton checkboxWithTitle:@"Show only matching lines"
+                                              target:self
+                                              action:@selector(toggleShowsOnlyMatches:)];
+        matchCountField = [NSTextField labelWithString:@""];
+        [matchCountField setTextColor:[NSColor secondaryLabelColor]];
+        NSButton *doneButton = [NSButton buttonWithTitle:@"Done" target:self action:@selector(hideFindBar:)];
+        
+        findBar = [NSStackView stackViewWithViews:@[searchField, matchCountField, filterCheckbox, doneButton]];
+        [findBar setEdgeInsets:NSEdgeInsetsMake(4, 8, 4, 8)];
+        [findBar setFrameSize:NSMakeSize(NSWidth([scrollView frame]), 30)];
+        [self updateMatchCount];
+    }
+    [scrollView setFindBarView:findBar];
+    [scrollView setFindBarVisible:YES];
+    [[self window] makeFirstResponder:searchField];
+}
+
+- (IBAction)hideFindBar:(id)sender {
+    [[self enclosingScrollView] setFindBarVisible:NO];
+    [searchField setStringValue:@""];
+    [self setSearchString:@""];
+    if (showsOnlyMatches) {
+        showsOnlyMatches = NO;
+        [filterCheckbox setState:NSControlStateValueOff];
+        [self rowsChanged];
+    }
+    [[self window] makeFirstResponder:self];
+}
+
+- (IBAction)searchFieldChanged:(id)sender {
+    if (![[sender stringValue] isEqualToString:searchString]) {
+        [self setSearchString:[sender stringValue]];
+    }
+}
+
+- (IBAction)toggleShowsOnlyMatches:(id)sender {
+    showsOnlyMatches = ([sender state] == NSControlStateValueOn);
+    currentMatch = -1;
+    [self rowsChanged];
+}
+
+- (BOOL)control:(NSControl *)control textView:(NSTextView *)textView doCommandBySelector:(SEL)commandSelector {
+    if (commandSelector == @selector(insertNewline:)) {
+        [self selectMatch:1];
+        return YES;
+    }
+    if (commandSelector == @selector(cancelOperation:)) {
+        [self hideFindBar:self];
+        return YES;
+    }
+    return NO;
+}
+
+@end
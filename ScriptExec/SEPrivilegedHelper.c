@@ -0,0 +1,615 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "SEPrivilegedHelper.h"
+#include "SEProcessTree.h"
+#include "SETrampoline.h"
+#include "PlatypusClock.h"
+#include "PlatypusJobLimits.h"
+#include "PlatypusJobProtocol.h"
+#include "PlatypusSpawn.h"
+
+#ifdef __APPLE__
+#include <crt_externs.h>
+#define ENVIRONMENT (*_NSGetEnviron())
+#else
+extern char **environ;
+#define ENVIRONMENT environ
+#endif
+
+// Output and error are forwarded in frames of at most this size
+#define READ_SIZE           (64 * 1024)
+// Seconds between checks for jobs having exited, where that can't be watched
+#define EXIT_POLL_INTERVAL  0.1
+
+typedef struct HelperJob {
+    uint32_t sequence;
+    pid_t pid;
+    int output;                 // -1 once closed
+    int error;
+    int watch;                  // -1 if exit can't be watched for
+    int running;
+    int timedOut;
+    double deadline;            // When the job times out, 0 for never
+    double killTime;            // When terminated processes are killed, 0 if not terminating
+    SEProcessTree tree;
+} HelperJob;
+
+typedef struct Helper {
+    int outFd;
+    const char *trampolinePath;
+    HelperJob *jobs;
+    size_t count;
+    size_t capacity;
+    PlatypusJobBuffer replies;
+    int writeError;             // Set once replies can't be written
+} Helper;
+
+// Launch request, with strings copied out of the frame
+typedef struct LaunchRequest {
+    uint32_t sequence;
+    char **args;
+    size_t argCount;
+    char **env;
+    size_t envCount;
+    char *directory;
+    char *limits;
+} LaunchRequest;
+
+static int WriteFully(int fd, const void *buf, size_t length) {
+    size_t total = 0;
+    while (total < length) {
+        ssize_t n = write(fd, (const char *)buf + total, length - total);
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno;
+        }
+        total += (size_t)n;
+    }
+    return 0;
+}
+
+static char *CopyString(const uint8_t *value, size_t length) {
+    char *str = malloc(length + 1);
+    if (str) {
+        memcpy(str, value, length);
+        str[length] = '\0';
+    }
+    return str;
+}
+
+static int AppendString(char ***list, size_t *count, const uint8_t *value, size_t length) {
+    char **grown = realloc(*list, (*count + 2) * sizeof(char *));
+    if (grown == NULL) {
+        return ENOMEM;
+    }
+    *list = grown;
+    grown[*count] = CopyString(value, length);
+    if (grown[*count] == NULL) {
+        return ENOMEM;
+    }
+    grown[++(*count)] = NULL;
+    return 0;
+}
+
+static void FreeStrings(char **list, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        free(list[i]);
+    }
+    free(list);
+}
+
+// The helper's environment with the job's variables added, replacing any of
+// the same name. The strings aren't copied.
+static char **MergeEnvironment(char **env, size_t envCount) {
+    char **inherited = ENVIRONMENT;
+    size_t inheritedCount = 0;
+    while (inherited[inheritedCount]) {
+        inheritedCount++;
+    }
+    char **merged = calloc(inheritedCount + envCount + 1, sizeof(char *));
+    if (merged == NULL) {
+        return NULL;
+    }
+    size_t count = 0;
+    for (size_t i = 0; i < inheritedCount; i++) {
+        size_t nameLength = strcspn(inherited[i], "=");
+        int replaced = 0;
+        for (size_t j = 0; j < envCount && !replaced; j++) {
+            replaced = strncmp(env[j], inherited[i], nameLength + 1) == 0;
+        }
+        if (!replaced) {
+            merged[count++] = inherited[i];
+        }
+    }
+    memcpy(merged + count, env, envCount * sizeof(char *));
+    return merged;
+}
+
+#pragma mark - Replies
+
+static void Begin(Helper *helper, SEHelperFrameType type, uint32_t sequence) {
+    PlatypusJobFrameBegin(&helper->replies, (PlatypusJobFrameType)type);
+    PlatypusJobFrameAddUInt32(&helper->replies, (PlatypusJobField)SEHelperField_Sequence, sequence);
+}
+
+// Sends the frame just built. Once the app can't be written to, replies
+// are discarded, and the helper shuts down.
+static void Send(Helper *helper) {
+    if (PlatypusJobFrameEnd(&helper->replies) == 0 && !helper->writeError) {
+        helper->writeError = WriteFully(helper->outFd, helper->replies.bytes, helper->replies.length);
+    }
+    PlatypusJobBufferConsume(&helper->replies, helper->replies.length);
+}
+
+static void SendFailed(Helper *helper, uint32_t sequence, int err, const char *message) {
+    Begin(helper, SEHelperFrame_Failed, sequence);
+    PlatypusJobFrameAddUInt32(&helper->replies, (PlatypusJobField)SEHelperField_Status, (uint32_t)err);
+    PlatypusJobFrameAddString(&helper->replies, (PlatypusJobField)SEHelperField_Message, message);
+    Send(helper);
+}
+
+// Forwards what can be read from one of a job's pipes without blocking, or
+// just a single read unless draining. Closes the pipe at end of file.
+static void Forward(Helper *helper, HelperJob *job, int *fd, SEHelperFrameType type, int drain) {
+    char buf[READ_SIZE];
+    while (*fd != -1) {
+        ssize_t n = read(*fd, buf, sizeof(buf));
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n == -1 && errno == EAGAIN) {
+            return;
+        }
+        if (n <= 0) {
+            close(*fd);
+            *fd = -1;
+            return;
+        }
+        Begin(helper, type, job->sequence);
+        PlatypusJobFrameAddField(&helper->replies, (PlatypusJobField)SEHelperField_Data, buf, (size_t)n);
+        Send(helper);
+        if (!drain) {
+            return;
+        }
+    }
+}
+
+#pragma mark - Jobs
+
+static HelperJob *FindJob(Helper *helper, uint32_t sequence) {
+    for (size_t i = 0; i < helper->count; i++) {
+        if (helper->jobs[i].sequence == sequence && helper->jobs[i].running) {
+            return &helper->jobs[i];
+        }
+    }
+    return NULL;
+}
+
+// Output still in the pipes is forwarded, but reading stops once the job
+// has exited, even if processes it left behind hold them open
+static void JobExited(Helper *helper, HelperJob *job, int status) {
+    job->running = 0;
+    Forward(helper, job, &job->output, SEHelperFrame_Output, 1);
+    Forward(helper, job, &job->error, SEHelperFrame_Error, 1);
+    if (job->output != -1) {
+        close(job->output);
+        job->output = -1;
+    }
+    if (job->error != -1) {
+        close(job->error);
+        job->error = -1;
+    }
+    if (job->watch != -1) {
+        close(job->watch);
+        job->watch = -1;
+    }
+    Begin(helper, SEHelperFrame_Exited, job->sequence);
+    PlatypusJobFrameAddUInt32(&helper->replies, (PlatypusJobField)SEHelperField_Status, (uint32_t)status);
+    PlatypusJobFrameAddUInt32(&helper->replies, (PlatypusJobField)SEHelperField_TimedOut, (uint32_t)job->timedOut);
+    Send(helper);
+}
+
+static void CheckExited(Helper *helper, HelperJob *job) {
+    int status;
+    pid_t pid;
+    while ((pid = waitpid(job->pid, &status, WNOHANG)) == -1 && errno == EINTR);
+    if (pid == job->pid) {
+        JobExited(helper, job, PlatypusSpawnExitStatus(status));
+    } else if (pid == -1) {
+        JobExited(helper, job, -1);
+    }
+}
+
+// Asks the job and every process it has started to exit. Any still running
+// after the grace period are killed.
+static void TerminateJob(HelperJob *job) {
+    if (!job->running || job->killTime) {
+        return;
+    }
+    if (SEProcessTreeCollect(&job->tree, job->pid, 1) != 0) {
+        kill(-job->pid, SIGTERM);
+        kill(job->pid, SIGTERM);
+    }
+    SEProcessTreeSignal(&job->tree, SIGTERM);
+    SEProcessTreeSignal(&job->tree, SIGCONT);
+    job->killTime = PlatypusClockNow() + SE_PROCESS_TREE_GRACE_PERIOD;
+}
+
+static int ParseLaunch(const PlatypusJobFrame *frame, LaunchRequest *request) {
+    size_t offset = 0;
+    PlatypusJobField field;
+    const uint8_t *value;
+    size_t length;
+    int result;
+    int err = 0;
+    while (err == 0 && (result = PlatypusJobFrameNextField(frame, &offset, &field, &value, &length)) == 1) {
+        switch ((int)field) {
+            case SEHelperField_Sequence:
+                request->sequence = PlatypusJobFieldUInt32(value, length);
+                break;
+            case SEHelperField_Argument:
+                err = AppendString(&request->args, &request->argCount, value, length);
+                break;
+            case SEHelperField_Environment:
+                err = AppendString(&request->env, &request->envCount, value, length);
+                break;
+            case SEHelperField_Directory:
+                free(request->directory);
+                request->directory = CopyString(value, length);
+                err = request->directory ? 0 : ENOMEM;
+                break;
+            case SEHelperField_Limits:
+                free(request->limits);
+                request->limits = CopyString(value, length);
+                err = request->limits ? 0 : ENOMEM;
+                break;
+        }
+    }
+    return err ? err : (result == -1 ? EINVAL : 0);
+}
+
+static void Launch(Helper *helper, const PlatypusJobFrame *frame) {
+    LaunchRequest request = { 0 };
+    int err = ParseLaunch(frame, &request);
+    PlatypusJobLimits limits = { 0 };
+    const char *message = NULL;
+    if (err == 0 && request.argCount == 0) {
+        err = EINVAL;
+        message = "Missing executable path";
+    }
+    if (err == 0 && request.limits && PlatypusJobLimitsParse(request.limits, &limits) != 0) {
+        err = EINVAL;
+        message = "Invalid job limits";
+    }
+    
+    // Resource limits have to be set in the job's own process, so only jobs
+    // with any go through the trampoline. It reads the job from its standard
+    // input and then becomes the interpreter, so the script itself gets no
+    // input. Other jobs are spawned directly, saving an exec.
+    int trampoline = PlatypusJobLimitsAnyResource(&limits);
+    size_t length = 0;
+    char *trampolineRequest = NULL;
+    char **environment = NULL;
+    if (err == 0 && trampoline) {
+        trampolineRequest = SETrampolineCreateRequest((const char *const *)request.args, request.argCount,
+                                                      (const char *const *)request.env, request.envCount,
+                                                      &limits, &length);
+        err = trampolineRequest ? 0 : E2BIG;
+    } else if (err == 0 && request.envCount) {
+        environment = MergeEnvironment(request.env, request.envCount);
+        err = environment ? 0 : ENOMEM;
+    }
+    if (err == 0 && helper->count == helper->capacity) {
+        size_t capacity = helper->capacity ? helper->capacity * 2 : 8;
+        HelperJob *jobs = realloc(helper->jobs, capacity * sizeof(HelperJob));
+        if (jobs) {
+            helper->jobs = jobs;
+            helper->capacity = capacity;
+        } else {
+            err = ENOMEM;
+        }
+    }
+    int in[2] = { -1, -1 }, out[2] = { -1, -1 }, errPipe[2] = { -1, -1 };
+    if (err == 0 && ((trampoline && pipe(in) == -1) || pipe(out) == -1 || pipe(errPipe) == -1)) {
+        err = errno;
+    }
+    pid_t pid = -1;
+    if (err == 0) {
+        char *argv[] = { (char *)helper->trampolinePath, SE_TRAMPOLINE_ARG, NULL };
+        PlatypusSpawnAttributes attributes;
+        if (trampoline) {
+            PlatypusSpawnAttributesInit(&attributes, helper->trampolinePath, argv);
+            attributes.fds[0] = in[0];
+        } else {
+            PlatypusSpawnAttributesInit(&attributes, request.args[0], request.args);
+            attributes.environment = environment;
+            attributes.processGroup = 1;
+        }
+        attributes.directory = request.directory;
+        attributes.fds[1] = out[1];
+        attributes.fds[2] = errPipe[1];
+        err = PlatypusSpawn(&attributes, &pid);
+    }
+    int fds[] = { in[0], out[1], errPipe[1] };
+    for (int i = 0; i < 3; i++) {
+        if (fds[i] != -1) {
+            close(fds[i]);
+        }
+    }
+    if (err) {
+        int unused[] = { in[1], out[0], errPipe[0] };
+        for (int i = 0; i < 3; i++) {
+            if (unused[i] != -1) {
+                close(unused[i]);
+            }
+        }
+        SendFailed(helper, request.sequence, err, message ? message : strerror(err));
+    } else {
+        // A trampoline that fails to run the job exits with an error of its
+        // own, so a request it didn't read in full shows up as that
+        if (trampoline) {
+            WriteFully(in[1], trampolineRequest, length);
+            close(in[1]);
+        }
+        fcntl(out[0], F_SETFL, O_NONBLOCK);
+        fcntl(errPipe[0], F_SETFL, O_NONBLOCK);
+        
+        HelperJob *job = &helper->jobs[helper->count++];
+        memset(job, 0, sizeof(*job));
+        job->sequence = request.sequence;
+        job->pid = pid;
+        job->output = out[0];
+        job->error = errPipe[0];
+        job->running = 1;
+        job->deadline = (limits.timeout > 0) ? PlatypusClockNow() + limits.timeout : 0;
+        SEProcessTreeInit(&job->tree);
+        // Exit is checked for periodically instead if it can't be watched
+        job->watch = PlatypusSpawnWatch(pid);
+        
+        Begin(helper, SEHelperFrame_Launched, request.sequence);
+        PlatypusJobFrameAddUInt32(&helper->replies, (PlatypusJobField)SEHelperField_PID, (uint32_t)pid);
+        Send(helper);
+    }
+    free(trampolineRequest);
+    free(environment);
+    FreeStrings(request.args, request.argCount);
+    FreeStrings(request.env, request.envCount);
+    free(request.directory);
+    free(request.limits);
+}
+
+static void HandleFrame(Helper *helper, const PlatypusJobFrame *frame) {
+    if ((int)frame->type == SEHelperFrame_Launch) {
+        Launch(helper, frame);
+    }
+    else if ((int)frame->type == SEHelperFrame_Terminate) {
+        size_t offset = 0;
+        PlatypusJobField field;
+        const uint8_t *value;
+        size_t length;
+        while (PlatypusJobFrameNextField(frame, &offset, &field, &value, &length) == 1) {
+            if ((int)field == SEHelperField_Sequence) {
+                HelperJob *job = FindJob(helper, PlatypusJobFieldUInt32(value, length));
+                if (job) {
+                    TerminateJob(job);
+                }
+            }
+        }
+    }
+    // Anything else isn't meant for the helper
+}
+
+// Kills processes that were given their grace period, and forgets jobs
+// that are done with
+static void UpdateJobs(Helper *helper, double now) {
+    size_t kept = 0;
+    for (size_t i = 0; i < helper->count; i++) {
+        HelperJob *job = &helper->jobs[i];
+        if (job->running && job->deadline && now >= job->deadline && !job->killTime) {
+            job->timedOut = 1;
+            TerminateJob(job);
+        }
+        if (job->killTime && now >= job->killTime) {
+            SEProcessTreeSignal(&job->tree, SIGKILL);
+            SEProcessTreeClear(&job->tree);
+            job->killTime = 0;
+        }
+        if (job->running || job->killTime) {
+            helper->jobs[kept++] = *job;
+        } else {
+            SEProcessTreeFree(&job->tree);
+        }
+    }
+    helper->count = kept;
+}
+
+// Terminates every job still running, and whatever is left of those
+// terminated earlier, waiting for them to exit
+static void TerminateAll(Helper *helper) {
+    SEProcessTree tree;
+    SEProcessTreeInit(&tree);
+    for (size_t i = 0; i < helper->count; i++) {
+        HelperJob *job = &helper->jobs[i];
+        if (job->running && SEProcessTreeCollect(&tree, job->pid, 1) != 0) {
+            kill(-job->pid, SIGKILL);
+            kill(job->pid, SIGKILL);
+        }
+        if (job->killTime) {
+            SEProcessTreeSignal(&job->tree, SIGKILL);
+        }
+    }
+    SEProcessTreeTerminate(&tree, SE_PROCESS_TREE_GRACE_PERIOD);
+    SEProcessTreeFree(&tree);
+    for (size_t i = 0; i < helper->count; i++) {
+        HelperJob *job = &helper->jobs[i];
+        if (job->running) {
+            while (waitpid(job->pid, NULL, 0) == -1 && errno == EINTR);
+            job->running = 0;
+        }
+        int fds[] = { job->output, job->error, job->watch };
+        for (int j = 0; j < 3; j++) {
+            if (fds[j] != -1) {
+                close(fds[j]);
+            }
+        }
+        SEProcessTreeFree(&job->tree);
+    }
+    helper->count = 0;
+}
+
+#pragma mark - Serving
+
+// Milliseconds until the next job times out or is due to be killed, for poll()
+static int PollTimeout(Helper *helper, double now) {
+    double next = -1;
+    for (size_t i = 0; i < helper->count; i++) {
+        HelperJob *job = &helper->jobs[i];
+        double times[] = { job->running ? job->deadline : 0, job->killTime,
+                           (job->running && job->watch == -1) ? now + EXIT_POLL_INTERVAL : 0 };
+        for (int j = 0; j < 3; j++) {
+            if (times[j] && (next < 0 || times[j] < next)) {
+                next = times[j];
+            }
+        }
+    }
+    if (next < 0) {
+        return -1;
+    }
+    return next > now ? (int)((next - now) * 1000) + 1 : 0;
+}
+
+int SEPrivilegedHelperRun(int inFd, int outFd, const char *trampolinePath) {
+    // A job exiting before it has read its request, or the app going away,
+    // mustn't kill the helper
+    signal(SIGPIPE, SIG_IGN);
+    
+    Helper helper = { .outFd = outFd, .trampolinePath = trampolinePath };
+    PlatypusJobBufferInit(&helper.replies);
+    PlatypusJobReader reader;
+    PlatypusJobReaderInit(&reader);
+    struct pollfd *pfds = NULL;
+    size_t *pfdJobs = NULL;
+    int err = 0;
+    int inOpen = 1;
+    
+    while (inOpen && !helper.writeError && err == 0) {
+        // The app's socket comes first, then each job's output, error and watch
+        size_t maxFds = 1 + helper.count * 3;
+        struct pollfd *grownFds = realloc(pfds, maxFds * sizeof(struct pollfd));
+        if (grownFds) {
+            pfds = grownFds;
+        }
+        size_t *grownJobs = realloc(pfdJobs, maxFds * sizeof(size_t));
+        if (grownJobs) {
+            pfdJobs = grownJobs;
+        }
+        if (grownFds == NULL || grownJobs == NULL) {
+            err = ENOMEM;
+            break;
+        }
+        size_t nfds = 0;
+        pfds[nfds++] = (struct pollfd){ .fd = inFd, .events = POLLIN };
+        for (size_t i = 0; i < helper.count; i++) {
+            HelperJob *job = &helper.jobs[i];
+            int fds[] = { job->output, job->error, job->watch };
+            for (int j = 0; j < 3; j++) {
+                if (fds[j] != -1) {
+                    pfdJobs[nfds] = i;
+                    pfds[nfds++] = (struct pollfd){ .fd = fds[j], .events = POLLIN };
+                }
+            }
+        }
+        
+        int n = poll(pfds, (nfds_t)nfds, PollTimeout(&helper, PlatypusClockNow()));
+        if (n == -1 && errno != EINTR) {
+            err = errno;
+            break;
+        }
+        
+        for (size_t i = 1; n > 0 && i < nfds; i++) {
+            if (pfds[i].revents == 0) {
+                continue;
+            }
+            HelperJob *job = &helper.jobs[pfdJobs[i]];
+            if (pfds[i].fd == job->output) {
+                Forward(&helper, job, &job->output, SEHelperFrame_Output, 0);
+            } else if (pfds[i].fd == job->error) {
+                Forward(&helper, job, &job->error, SEHelperFrame_Error, 0);
+            } else if (pfds[i].fd == job->watch && job->running) {
+                CheckExited(&helper, job);
+            }
+        }
+        for (size_t i = 0; i < helper.count; i++) {
+            if (helper.jobs[i].running && helper.jobs[i].watch == -1) {
+                CheckExited(&helper, &helper.jobs[i]);
+            }
+        }
+        UpdateJobs(&helper, PlatypusClockNow());
+        
+        if (n > 0 && pfds[0].revents) {
+            char buf[READ_SIZE];
+            ssize_t length = read(inFd, buf, sizeof(buf));
+            if (length == 0 || (length == -1 && errno != EINTR && errno != EAGAIN)) {
+                inOpen = 0;
+            } else if (length > 0) {
+                err = PlatypusJobReaderAppend(&reader, buf, (size_t)length);
+                PlatypusJobFrame frame;
+                int result = 0;
+                while (err == 0 && (result = PlatypusJobReaderNext(&reader, &frame)) == 1) {
+                    HandleFrame(&helper, &frame);
+                }
+                if (result == -1) {
+                    err = EINVAL;
+                }
+            }
+        }
+    }
+    
+    TerminateAll(&helper);
+    free(helper.jobs);
+    free(pfds);
+    free(pfdJobs);
+    PlatypusJobReaderFree(&reader);
+    PlatypusJobBufferFree(&helper.replies);
+    return err;
+}
@@ -0,0 +1,99 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Long-lived helper for running privileged jobs.
+//
+// Launching every privileged job through AuthorizationExecuteWithPrivileges()
+// forks a new setuid trampoline per job. Instead, ScriptExec can launch a
+// copy of its own executable with the SE_PRIVILEGED_HELPER_ARG argument once,
+// with administrator privileges, and hand it any number of jobs. The helper
+// talks to the app over the socket it was started with, using the frame and
+// field encoding of PlatypusJobProtocol.h with the frame types and fields
+// below. Only the app holds the other end of the socket, so no other process
+// can submit jobs to it.
+//
+// The app numbers its jobs. Every Launch gets either Launched, with the job's
+// process ID, or Failed. A launched job's standard output and error are sent
+// separately in Output and Error frames as they arrive, followed by Exited.
+// Each job leads its own process group. Jobs with resource limits run through
+// the trampoline (see SETrampoline.h), which sets them, and all others are
+// spawned directly. The helper enforces timeouts itself, since processes
+// running as root can't be signalled by the app, and tears down a job's
+// process tree when asked to terminate it. When the app closes the socket,
+// e.g. on quitting, the helper terminates whatever is still running and exits.
+// Portable C, and runs unprivileged just the same, which is how it's tested.
+
+#ifndef SE_PRIVILEGED_HELPER_H
+#define SE_PRIVILEGED_HELPER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SE_PRIVILEGED_HELPER_ARG    "--platypus-privileged-helper"
+
+typedef enum SEHelperFrameType {
+    // App to helper
+    SEHelperFrame_Launch = 1,       // Sequence, Argument+, Directory, Environment*, Limits
+    SEHelperFrame_Terminate,        // Sequence
+    // Helper to app
+    SEHelperFrame_Launched,         // Sequence, PID
+    SEHelperFrame_Failed,           // Sequence, Status, Message
+    SEHelperFrame_Output,           // Sequence, Data
+    SEHelperFrame_Error,            // Sequence, Data
+    SEHelperFrame_Exited            // Sequence, Status, TimedOut
+} SEHelperFrameType;
+
+typedef enum SEHelperField {
+    SEHelperField_Sequence = 1,     // uint32, chosen by the app
+    SEHelperField_Argument,         // string, repeatable, the first being the executable path
+    SEHelperField_Directory,        // string
+    SEHelperField_Environment,      // "NAME=value" string, repeatable
+    SEHelperField_Limits,           // string, see PlatypusJobLimits.h
+    SEHelperField_PID,              // uint32
+    SEHelperField_Status,           // int32 exit status as NSTask reports it, or an errno value for Failed
+    SEHelperField_TimedOut,         // uint32: nonzero if the job ran past its timeout
+    SEHelperField_Message,          // string
+    SEHelperField_Data              // bytes
+} SEHelperField;
+
+// Serves jobs, reading requests from inFd and writing replies to outFd, which
+// may be the same socket, until the app closes its end. Jobs with resource
+// limits are launched by running the executable at trampolinePath with
+// SE_TRAMPOLINE_ARG. Returns 0 once the app has gone away and all jobs have
+// been terminated, or an errno value, e.g. EINVAL if the app sent a malformed
+// stream.
+int SEPrivilegedHelperRun(int inFd, int outFd, const char *trampolinePath);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,73 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Connection to the long-lived helper that runs privileged jobs (see
+// SEPrivilegedHelper.h). The helper is the app's own executable, launched
+// once with the authorization kept for privileged jobs, and given jobs over
+// the socket that AuthorizationExecuteWithPrivileges() connects it to.
+//
+// Jobs are SEPrivilegedHelperTasks, which stand in for STPrivilegedTask:
+// they are launched, monitored and finish the same way, posting
+// STPrivilegedTaskDidTerminateNotification once done. Standard output and
+// error, which the helper keeps apart, both arrive on outputFileHandle, as
+// for jobs run without privileges. Unlike tasks launched directly, they can
+// be terminated, get resource limits and a timeout, and their own environment.
+
+#import <Foundation/Foundation.h>
+#import <Security/Authorization.h>
+
+#import "STPrivilegedTask.h"
+#import "PlatypusJobLimits.h"
+
+@interface SEPrivilegedHelperTask : STPrivilegedTask
+
+// Additional environment variables
+@property (copy) NSDictionary <NSString *, NSString *> *environment;
+@property (nonatomic) PlatypusJobLimits limits;
+@property (nonatomic, readonly) BOOL timedOut;
+
+@end
+
+@interface SEPrivilegedHelperConnection : NSObject
+
+// NO once the helper has exited, or the connection has been closed
+@property (nonatomic, readonly) BOOL isConnected;
+
+// Launches the helper with the authorization, which must have the right to
+// execute the app's executable, or returns nil with the error in *status
++ (instancetype)connectionWithAuthorization:(AuthorizationRef)authorization status:(OSStatus *)status;
+
+- (SEPrivilegedHelperTask *)taskWithLaunchPath:(NSString *)path
+                                     arguments:(NSArray <NSString *> *)arguments
+                              currentDirectory:(NSString *)directory;
+// Lets the helper exit. It terminates any jobs still running first.
+- (void)close;
+
+@end
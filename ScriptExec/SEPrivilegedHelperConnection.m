@@ -0,0 +1,411 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#import <fcntl.h>
+#import <unistd.h>
+
+#import "Common.h"
+#import "SEPrivilegedHelperConnection.h"
+#import "SEPrivilegedHelper.h"
+#import "PlatypusJobProtocol.h"
+
+// Exit status reported for jobs the helper couldn't launch, as for a
+// trampoline that can't run the interpreter
+#define LAUNCH_FAILED_STATUS    127
+
+@interface SEPrivilegedHelperConnection()
+- (OSStatus)launchTask:(SEPrivilegedHelperTask *)task;
+- (void)terminateTask:(SEPrivilegedHelperTask *)task;
+@end
+
+#pragma mark - Task
+
+@interface SEPrivilegedHelperTask()
+{
+    dispatch_io_t outputChannel;
+    NSFileHandle *outputReadHandle;
+    BOOL running;
+    pid_t pid;
+    int status;
+}
+@property (nonatomic, weak) SEPrivilegedHelperConnection *connection;
+@property (nonatomic) uint32_t sequence;
+@property (nonatomic, readwrite) BOOL timedOut;
+- (BOOL)startWithSequence:(uint32_t)sequence;
+- (void)helperLaunchedWithProcessIdentifier:(pid_t)processIdentifier;
+- (void)helperSentData:(const void *)bytes length:(size_t)length;
+- (void)helperExitedWithStatus:(int)exitStatus timedOut:(BOOL)didTimeOut;
+@end
+
+@implementation SEPrivilegedHelperTask
+
+- (NSFileHandle *)outputFileHandle {
+    return outputReadHandle;
+}
+
+- (BOOL)isRunning {
+    return running;
+}
+
+- (pid_t)processIdentifier {
+    return pid;
+}
+
+- (int)terminationStatus {
+    return status;
+}
+
+- (OSStatus)launch {
+    if (running || [self connection] == nil) {
+        return errAuthorizationInternal;
+    }
+    return [[self connection] launchTask:self];
+}
+
+// The helper has its privileges already
+- (OSStatus)launchWithAuthorization:(AuthorizationRef)authorization {
+    return [self launch];
+}
+
+- (void)terminate {
+    if (running) {
+        [[self connection] terminateTask:self];
+    }
+}
+
+- (void)waitUntilExit {
+    while (running) {
+        [[NSRunLoop currentRunLoop] runMode:NSDefaultRunLoopMode beforeDate:[NSDate dateWithTimeIntervalSinceNow:0.1]];
+    }
+}
+
+// Output from the helper is written into a pipe, so the task's output can
+// be read like any other task's
+- (BOOL)startWithSequence:(uint32_t)sequence {
+    int fds[2];
+    if (pipe(fds) == -1) {
+        return NO;
+    }
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+    // Whoever reads the output may stop before the job is done
+    fcntl(fds[1], F_SETNOSIGPIPE, 1);
+    
+    // The job is done once everything it wrote has been passed on
+    int writeFd = fds[1];
+    outputChannel = dispatch_io_create(DISPATCH_IO_STREAM, writeFd, dispatch_get_main_queue(), ^(int error) {
+        close(writeFd);
+        self->running = NO;
+        [[NSNotificationCenter defaultCenter] postNotificationName:STPrivilegedTaskDidTerminateNotification object:self];
+        if ([self terminationHandler]) {
+            [self terminationHandler](self);
+        }
+    });
+    if (outputChannel == nil) {
+        close(fds[0]);
+        close(fds[1]);
+        return NO;
+    }
+    outputReadHandle = [[NSFileHandle alloc] initWithFileDescriptor:fds[0] closeOnDealloc:YES];
+    _sequence = sequence;
+    running = YES;
+    return YES;
+}
+
+- (void)helperLaunchedWithProcessIdentifier:(pid_t)processIdentifier {
+    pid = processIdentifier;
+}
+
+- (void)helperSentData:(const void *)bytes length:(size_t)length {
+    if (outputChannel == nil || length == 0) {
+        return;
+    }
+    dispatch_data_t data = dispatch_data_create(bytes, length, dispatch_get_main_queue(), DISPATCH_DATA_DESTRUCTOR_DEFAULT);
+    dispatch_io_write(outputChannel, 0, data, dispatch_get_main_queue(), ^(bool done, dispatch_data_t remaining, int error) {});
+}
+
+- (void)helperExitedWithStatus:(int)exitStatus timedOut:(BOOL)didTimeOut {
+    if (outputChannel == nil) {
+        return;
+    }
+    status = exitStatus;
+    _timedOut = didTimeOut;
+    dispatch_io_close(outputChannel, 0);
+    outputChannel = nil;
+}
+
+@end
+
+#pragma mark - Connection
+
+@interface SEPrivilegedHelperConnection()
+{
+    STPrivilegedTask *helperTask;
+    dispatch_io_t channel;
+    PlatypusJobReader reader;
+    PlatypusJobBuffer requests;
+    uint32_t lastSequence;
+    NSMutableDictionary <NSNumber *, SEPrivilegedHelperTask *> *tasks;
+}
+@end
+
+@implementation SEPrivilegedHelperConnection
+
++ (instancetype)connectionWithAuthorization:(AuthorizationRef)authorization status:(OSStatus *)status {
+    SEPrivilegedHelperConnection *connection = [[self alloc] init];
+    *status = [connection startWithAuthorization:authorization];
+    return (*status == errAuthorizationSuccess) ? connection : nil;
+}
+
+- (instancetype)init {
+    self = [super init];
+    if (self) {
+        PlatypusJobReaderInit(&reader);
+        PlatypusJobBufferInit(&requests);
+        tasks = [NSMutableDictionary dictionary];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [self close];
+    PlatypusJobReaderFree(&reader);
+    PlatypusJobBufferFree(&requests);
+}
+
+- (OSStatus)startWithAuthorization:(AuthorizationRef)authorization {
+    NSString *executablePath = [[NSBundle mainBundle] executablePath];
+    helperTask = [[STPrivilegedTask alloc] initWithLaunchPath:executablePath arguments:@[@SE_PRIVILEGED_HELPER_ARG]];
+    OSStatus err = [helperTask launchWithAuthorization:authorization];
+    if (err != errAuthorizationSuccess) {
+        helperTask = nil;
+        return err;
+    }
+    
+    // The helper's standard input and output are both this socket
+    int fd = dup([[helperTask outputFileHandle] fileDescriptor]);
+    if (fd == -1) {
+        [self close];
+        return errAuthorizationInternal;
+    }
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    fcntl(fd, F_SETNOSIGPIPE, 1);
+    channel = dispatch_io_create(DISPATCH_IO_STREAM, fd, dispatch_get_main_queue(), ^(int error) {
+        close(fd);
+    });
+    if (channel == nil) {
+        close(fd);
+        [self close];
+        return errAuthorizationInternal;
+    }
+    dispatch_io_set_low_water(channel, 1);
+    _isConnected = YES;
+    
+    // Blocks hold on to the connection until the channel is done with it
+    dispatch_io_read(channel, 0, SIZE_MAX, dispatch_get_main_queue(), ^(bool done, dispatch_data_t data, int error) {
+        if (data && dispatch_data_get_size(data)) {
+            [self readData:data];
+        }
+        if (done) {
+            DLog(@"Privileged helper went away");
+            [self close];
+        }
+    });
+    DLog(@"Launched privileged helper");
+    return errAuthorizationSuccess;
+}
+
+- (SEPrivilegedHelperTask *)taskWithLaunchPath:(NSString *)path
+                                     arguments:(NSArray <NSString *> *)arguments
+                              currentDirectory:(NSString *)directory {
+    SEPrivilegedHelperTask *task = [[SEPrivilegedHelperTask alloc] initWithLaunchPath:path
+                                                                            arguments:arguments
+                                                                     currentDirectory:directory];
+    [task setConnection:self];
+    return task;
+}
+
+#pragma mark - Requests
+
+- (OSStatus)launchTask:(SEPrivilegedHelperTask *)task {
+    if (!_isConnected || ![task startWithSequence:++lastSequence]) {
+        return errAuthorizationInternal;
+    }
+    tasks[@([task sequence])] = task;
+    
+    PlatypusJobFrameBegin(&requests, (PlatypusJobFrameType)SEHelperFrame_Launch);
+    PlatypusJobFrameAddUInt32(&requests, (PlatypusJobField)SEHelperField_Sequence, [task sequence]);
+    PlatypusJobFrameAddString(&requests, (PlatypusJobField)SEHelperField_Argument, [[task launchPath] fileSystemRepresentation]);
+    for (NSString *arg in [task arguments]) {
+        PlatypusJobFrameAddString(&requests, (PlatypusJobField)SEHelperField_Argument, [arg fileSystemRepresentation]);
+    }
+    if ([task currentDirectoryPath]) {
+        PlatypusJobFrameAddString(&requests, (PlatypusJobField)SEHelperField_Directory, [[task currentDirectoryPath] fileSystemRepresentation]);
+    }
+    for (NSString *name in [task environment]) {
+        NSString *variable = [NSString stringWithFormat:@"%@=%@", name, [task environment][name]];
+        PlatypusJobFrameAddString(&requests, (PlatypusJobField)SEHelperField_Environment, [variable UTF8String]);
+    }
+    PlatypusJobLimits limits = [task limits];
+    if (PlatypusJobLimitsAny(&limits)) {
+        char buf[PLATYPUS_JOB_LIMITS_MAX_LENGTH];
+        PlatypusJobLimitsFormat(&limits, buf, sizeof(buf));
+        PlatypusJobFrameAddString(&requests, (PlatypusJobField)SEHelperField_Limits, buf);
+    }
+    [self sendFrame];
+    return errAuthorizationSuccess;
+}
+
+- (void)terminateTask:(SEPrivilegedHelperTask *)task {
+    PlatypusJobFrameBegin(&requests, (PlatypusJobFrameType)SEHelperFrame_Terminate);
+    PlatypusJobFrameAddUInt32(&requests, (PlatypusJobField)SEHelperField_Sequence, [task sequence]);
+    [self sendFrame];
+}
+
+// Sends the frame just built in the requests buffer
+- (void)sendFrame {
+    if (PlatypusJobFrameEnd(&requests) != 0 || !_isConnected) {
+        PlatypusJobBufferConsume(&requests, requests.length);
+        return;
+    }
+    size_t length = requests.length;
+    dispatch_data_t data = dispatch_data_create(requests.bytes, length, dispatch_get_main_queue(), DISPATCH_DATA_DESTRUCTOR_DEFAULT);
+    PlatypusJobBufferConsume(&requests, length);
+    dispatch_io_write(channel, 0, data, dispatch_get_main_queue(), ^(bool done, dispatch_data_t remaining, int error) {
+        if (done && error) {
+            [self close];
+        }
+    });
+}
+
+#pragma mark - Replies
+
+- (void)readData:(dispatch_data_t)data {
+    __block int err = 0;
+    dispatch_data_apply(data, ^bool(dispatch_data_t region, size_t offset, const void *bytes, size_t size) {
+        err = PlatypusJobReaderAppend(&self->reader, bytes, size);
+        return err == 0;
+    });
+    
+    PlatypusJobFrame frame;
+    int result = 0;
+    while (err == 0 && _isConnected && (result = PlatypusJobReaderNext(&reader, &frame)) == 1) {
+        [self handleFrame:&frame];
+    }
+    if (err || result == -1) {
+        DLog(@"Malformed reply from privileged helper");
+        [self close];
+    }
+}
+
+- (void)handleFrame:(const PlatypusJobFrame *)frame {
+    SEPrivilegedHelperTask *task = nil;
+    uint32_t processIdentifier = 0;
+    int exitStatus = -1;
+    BOOL timedOut = NO;
+    NSMutableData *message = [NSMutableData data];
+    const uint8_t *data = NULL;
+    size_t dataLength = 0;
+    
+    size_t offset = 0;
+    PlatypusJobField field;
+    const uint8_t *value;
+    size_t length;
+    while (PlatypusJobFrameNextField(frame, &offset, &field, &value, &length) == 1) {
+        switch ((int)field) {
+            case SEHelperField_Sequence:
+                task = tasks[@(PlatypusJobFieldUInt32(value, length))];
+                break;
+            case SEHelperField_PID:
+                processIdentifier = PlatypusJobFieldUInt32(value, length);
+                break;
+            case SEHelperField_Status:
+                exitStatus = (int32_t)PlatypusJobFieldUInt32(value, length);
+                break;
+            case SEHelperField_TimedOut:
+                timedOut = PlatypusJobFieldUInt32(value, length) != 0;
+                break;
+            case SEHelperField_Message:
+                [message appendBytes:value length:length];
+                break;
+            case SEHelperField_Data:
+                data = value;
+                dataLength = length;
+                break;
+        }
+    }
+    if (task == nil) {
+        return;
+    }
+    
+    switch ((int)frame->type) {
+        case SEHelperFrame_Launched:
+            [task helperLaunchedWithProcessIdentifier:(pid_t)processIdentifier];
+            break;
+        case SEHelperFrame_Output:
+        case SEHelperFrame_Error:
+            [task helperSentData:data length:dataLength];
+            break;
+        case SEHelperFrame_Failed:
+            DLog(@"Privileged helper couldn't launch %@: %s", [task launchPath], strerror(exitStatus));
+            [message appendBytes:"\n" length:1];
+            [task helperSentData:[message bytes] length:[message length]];
+            [task helperExitedWithStatus:LAUNCH_FAILED_STATUS timedOut:NO];
+            [tasks removeObjectForKey:@([task sequence])];
+            break;
+        case SEHelperFrame_Exited:
+            [task helperExitedWithStatus:exitStatus timedOut:timedOut];
+            [tasks removeObjectForKey:@([task sequence])];
+            break;
+    }
+}
+
+#pragma mark - Closing
+
+- (void)close {
+    if (!_isConnected && helperTask == nil) {
+        return;
+    }
+    _isConnected = NO;
+    if (channel) {
+        dispatch_io_close(channel, DISPATCH_IO_STOP);
+        channel = nil;
+    }
+    [[helperTask outputFileHandle] closeFile];
+    helperTask = nil;
+    
+    // The helper terminates jobs still running once it sees the socket close
+    for (SEPrivilegedHelperTask *task in [tasks allValues]) {
+        [task helperExitedWithStatus:-1 timedOut:NO];
+    }
+    [tasks removeAllObjects];
+}
+
+@end
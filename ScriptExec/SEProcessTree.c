@@ -0,0 +1,349 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <errno.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __APPLE__
+#include <sys/proc.h>
+#include <sys/sysctl.h>
+#else
+#include <dirent.h>
+#include <stdio.h>
+#endif
+
+#include "SEProcessTree.h"
+#include "PlatypusClock.h"
+
+// Process table reads when collecting with SIGSTOP, in case processes keep
+// forking faster than they're stopped
+#define MAX_COLLECT_PASSES  16
+// How often termination checks whether processes have exited
+#define EXIT_POLL_INTERVAL  0.01
+
+typedef struct ProcessInfo {
+    pid_t pid;
+    pid_t ppid;
+    pid_t pgid;
+    uint64_t startTime;
+    int zombie;
+} ProcessInfo;
+
+#pragma mark - Process table
+
+#ifdef __APPLE__
+
+static int ReadProcessTable(ProcessInfo **table, size_t *count) {
+    int mib[4] = { CTL_KERN, KERN_PROC, KERN_PROC_ALL, 0 };
+    struct kinfo_proc *procs = NULL;
+    size_t size = 0;
+    // The table can grow between sizing and reading it
+    while (1) {
+        if (sysctl(mib, 4, NULL, &size, NULL, 0) == -1) {
+            return errno;
+        }
+        size += size / 8;
+        procs = malloc(size);
+        if (procs == NULL) {
+            return ENOMEM;
+        }
+        if (sysctl(mib, 4, procs, &size, NULL, 0) == 0) {
+            break;
+        }
+        free(procs);
+        if (errno != ENOMEM) {
+            return errno;
+        }
+    }
+    
+    size_t n = size / sizeof(struct kinfo_proc);
+    ProcessInfo *info = calloc(n ? n : 1, sizeof(ProcessInfo));
+    if (info == NULL) {
+        free(procs);
+        return ENOMEM;
+    }
+    for (size_t i = 0; i < n; i++) {
+        info[i].pid = procs[i].kp_proc.p_pid;
+        info[i].ppid = procs[i].kp_eproc.e_ppid;
+        info[i].pgid = procs[i].kp_eproc.e_pgid;
+        info[i].startTime = (uint64_t)procs[i].kp_proc.p_starttime.tv_sec * 1000000 +
+                            (uint64_t)procs[i].kp_proc.p_starttime.tv_usec;
+        info[i].zombie = (procs[i].kp_proc.p_stat == SZOMB);
+    }
+    free(procs);
+    *table = info;
+    *count = n;
+    return 0;
+}
+
+#else
+
+// Parses /proc/[pid]/stat. The command name may contain spaces and
+// parentheses, so fields are counted from the last ')'.
+static int ReadProcessInfo(const char *pid, ProcessInfo *info) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%s/stat", pid);
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        return 0;
+    }
+    char buf[1024];
+    size_t len = fread(buf, 1, sizeof(buf) - 1, file);
+    fclose(file);
+    buf[len] = '\0';
+    
+    char *p = strrchr(buf, ')');
+    char state;
+    int ppid, pgid;
+    unsigned long long startTime;
+    if (p == NULL ||
+        sscanf(p + 1, " %c %d %d %*d %*d %*d %*u %*u %*u %*u %*u %*u %*u %*d %*d %*d %*d %*d %*d %llu",
+               &state, &ppid, &pgid, &startTime) != 4) {
+        return 0;
+    }
+    info->pid = atoi(pid);
+    info->ppid = ppid;
+    info->pgid = pgid;
+    info->startTime = startTime;
+    info->zombie = (state == 'Z' || state == 'X');
+    return 1;
+}
+
+static int ReadProcessTable(ProcessInfo **table, size_t *count) {
+    DIR *dir = opendir("/proc");
+    if (dir == NULL) {
+        return errno;
+    }
+    size_t n = 0, capacity = 256;
+    ProcessInfo *info = malloc(capacity * sizeof(ProcessInfo));
+    struct dirent *entry;
+    while (info && (entry = readdir(dir))) {
+        if (entry->d_name[0] < '1' || entry->d_name[0] > '9') {
+            continue;
+        }
+        if (n == capacity) {
+            capacity *= 2;
+            ProcessInfo *grown = realloc(info, capacity * sizeof(ProcessInfo));
+            if (grown == NULL) {
+                free(info);
+            }
+            info = grown;
+            if (info == NULL) {
+                break;
+            }
+        }
+        n += ReadProcessInfo(entry->d_name, &info[n]);
+    }
+    closedir(dir);
+    if (info == NULL) {
+        return ENOMEM;
+    }
+    *table = info;
+    *count = n;
+    return 0;
+}
+
+#endif
+
+static const ProcessInfo *FindProcess(const ProcessInfo *table, size_t count, pid_t pid) {
+    for (size_t i = 0; i < count; i++) {
+        if (table[i].pid == pid) {
+            return &table[i];
+        }
+    }
+    return NULL;
+}
+
+#pragma mark - Tree
+
+void SEProcessTreeInit(SEProcessTree *tree) {
+    memset(tree, 0, sizeof(SEProcessTree));
+}
+
+void SEProcessTreeFree(SEProcessTree *tree) {
+    free(tree->processes);
+    SEProcessTreeInit(tree);
+}
+
+void SEProcessTreeClear(SEProcessTree *tree) {
+    tree->count = 0;
+}
+
+static int Contains(const SEProcessTree *tree, const ProcessInfo *info) {
+    for (size_t i = 0; i < tree->count; i++) {
+        if (tree->processes[i].pid == info->pid && tree->processes[i].startTime == info->startTime) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int Belongs(const SEProcessTree *tree, const ProcessInfo *info) {
+    for (size_t i = 0; i < tree->count; i++) {
+        const SEProcess *process = &tree->processes[i];
+        if (info->ppid == process->pid || (process->leader && info->pgid == process->pid)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int Add(SEProcessTree *tree, const ProcessInfo *info) {
+    if (tree->count == tree->capacity) {
+        size_t capacity = tree->capacity ? tree->capacity * 2 : 16;
+        SEProcess *processes = realloc(tree->processes, capacity * sizeof(SEProcess));
+        if (processes == NULL) {
+            return ENOMEM;
+        }
+        tree->processes = processes;
+        tree->capacity = capacity;
+    }
+    SEProcess *process = &tree->processes[tree->count++];
+    process->pid = info->pid;
+    process->leader = (info->pgid == info->pid);
+    process->startTime = info->startTime;
+    return 0;
+}
+
+// Adds every process in the table that belongs to the tree, including those
+// belonging through others just added. Sets *added to the number added.
+static int AddMembers(SEProcessTree *tree, const ProcessInfo *table, size_t count, int stop, size_t *added) {
+    pid_t self = getpid();
+    *added = 0;
+    size_t found;
+    do {
+        found = 0;
+        for (size_t i = 0; i < count; i++) {
+            const ProcessInfo *info = &table[i];
+            if (info->pid <= 1 || info->pid == self || Contains(tree, info) || !Belongs(tree, info)) {
+                continue;
+            }
+            if (Add(tree, info) != 0) {
+                return ENOMEM;
+            }
+            if (stop && !info->zombie) {
+                kill(info->pid, SIGSTOP);
+            }
+            found++;
+        }
+        *added += found;
+    } while (found);
+    return 0;
+}
+
+static int Update(SEProcessTree *tree, pid_t root, int stop) {
+    int err = 0;
+    for (int pass = 0; pass < MAX_COLLECT_PASSES; pass++) {
+        ProcessInfo *table;
+        size_t count;
+        err = ReadProcessTable(&table, &count);
+        if (err) {
+            return err;
+        }
+        size_t added = 0;
+        if (root) {
+            const ProcessInfo *info = FindProcess(table, count, root);
+            if (info == NULL || root == getpid()) {
+                free(table);
+                return ESRCH;
+            }
+            if (!Contains(tree, info)) {
+                err = Add(tree, info);
+                if (err == 0 && stop && !info->zombie) {
+                    kill(root, SIGSTOP);
+                }
+            }
+            root = 0;
+        }
+        if (err == 0) {
+            err = AddMembers(tree, table, count, stop, &added);
+        }
+        free(table);
+        // Stopped processes may have forked before they stopped
+        if (err || !stop || added == 0) {
+            break;
+        }
+    }
+    return err;
+}
+
+int SEProcessTreeCollect(SEProcessTree *tree, pid_t pid, int stop) {
+    if (pid <= 1) {
+        return ESRCH;
+    }
+    return Update(tree, pid, stop);
+}
+
+// Signals running processes in the tree, or only counts them if sig is 0
+static size_t SignalRunning(SEProcessTree *tree, int sig) {
+    Update(tree, 0, 0);
+    ProcessInfo *table;
+    size_t count;
+    if (ReadProcessTable(&table, &count) != 0) {
+        return 0;
+    }
+    size_t running = 0;
+    for (size_t i = 0; i < tree->count; i++) {
+        const SEProcess *process = &tree->processes[i];
+        const ProcessInfo *info = FindProcess(table, count, process->pid);
+        if (info == NULL || info->zombie || info->startTime != process->startTime) {
+            continue;
+        }
+        if (sig) {
+            kill(process->pid, sig);
+        }
+        running++;
+    }
+    free(table);
+    return running;
+}
+
+size_t SEProcessTreeSignal(SEProcessTree *tree, int sig) {
+    return sig ? SignalRunning(tree, sig) : 0;
+}
+
+size_t SEProcessTreeCountRunning(SEProcessTree *tree) {
+    return SignalRunning(tree, 0);
+}
+
+size_t SEProcessTreeTerminate(SEProcessTree *tree, double grace) {
+    SEProcessTreeSignal(tree, SIGTERM);
+    SEProcessTreeSignal(tree, SIGCONT);
+    double deadline = PlatypusClockNow() + grace;
+    while (SEProcessTreeCountRunning(tree) && PlatypusClockNow() < deadline) {
+        struct timespec interval = { 0, (long)(EXIT_POLL_INTERVAL * 1e9) };
+        nanosleep(&interval, NULL);
+    }
+    return SEProcessTreeSignal(tree, SIGKILL);
+}
@@ -0,0 +1,97 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Tracking and tearing down the processes a job has started.
+//
+// Jobs lead their own process group, but a script's children can leave it,
+// e.g. by starting a new session, and processes left behind by a child that
+// has exited are reparented to launchd, so neither the group nor the
+// parent-child relationships alone cover everything a job has started. A
+// process tree is the set of processes descended from the job's process,
+// along with every member of any process group led by one of them, and is
+// brought up to date from the process table whenever it is signalled.
+// Processes are identified by their ID and start time, so IDs reused by
+// unrelated processes are never signalled. Portable C, reading the process
+// table with sysctl() on macOS and from /proc on Linux.
+
+#ifndef SE_PROCESS_TREE_H
+#define SE_PROCESS_TREE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Seconds processes are given to exit after SIGTERM before they're killed
+#define SE_PROCESS_TREE_GRACE_PERIOD    5
+
+typedef struct SEProcess {
+    pid_t pid;
+    int leader;                 // Leads its process group
+    uint64_t startTime;
+} SEProcess;
+
+typedef struct SEProcessTree {
+    SEProcess *processes;
+    size_t count;
+    size_t capacity;
+} SEProcessTree;
+
+void SEProcessTreeInit(SEProcessTree *tree);
+void SEProcessTreeFree(SEProcessTree *tree);
+// Forgets all processes, e.g. once they have been killed
+void SEProcessTreeClear(SEProcessTree *tree);
+
+// Adds the process and everything it has started to the tree. With 'stop',
+// each process is sent SIGSTOP as it is found, and the process table read
+// again until no new ones turn up, so the tree can't grow while it's being
+// torn down. Returns 0 on success, ESRCH if the process doesn't exist, or
+// another errno value.
+int SEProcessTreeCollect(SEProcessTree *tree, pid_t pid, int stop);
+// Sends a signal to every process in the tree that is still running, after
+// adding any it has started since. Returns the number of processes signalled.
+size_t SEProcessTreeSignal(SEProcessTree *tree, int sig);
+// Number of processes in the tree still running. Zombies don't count.
+size_t SEProcessTreeCountRunning(SEProcessTree *tree);
+
+// Sends SIGTERM to every process in the tree, and SIGCONT to resume any
+// that were stopped when collected, waits up to 'grace' seconds for them to
+// exit and then sends SIGKILL to any that haven't. Returns the number of
+// processes killed.
+size_t SEProcessTreeTerminate(SEProcessTree *tree, double grace);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,183 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "SETrampoline.h"
+
+#define COUNTS_SIZE (2 * sizeof(uint32_t))
+#define HEADER_SIZE (sizeof(uint32_t) + COUNTS_SIZE + sizeof(PlatypusJobLimits))
+
+void *SETrampolineCreateRequest(const char *const *args, size_t argCount,
+                                const char *const *env, size_t envCount,
+                                const PlatypusJobLimits *limits, size_t *length) {
+    if (argCount == 0) {
+        return NULL;
+    }
+    size_t size = HEADER_SIZE;
+    for (size_t i = 0; i < argCount; i++) {
+        size += strlen(args[i]) + 1;
+    }
+    for (size_t i = 0; i < envCount; i++) {
+        size += strlen(env[i]) + 1;
+    }
+    if (size > SE_TRAMPOLINE_MAX_REQUEST) {
+        return NULL;
+    }
+    
+    char *request = malloc(size);
+    if (request == NULL) {
+        return NULL;
+    }
+    uint32_t header[3] = { (uint32_t)(size - sizeof(uint32_t)), (uint32_t)argCount, (uint32_t)envCount };
+    memcpy(request, header, sizeof(header));
+    PlatypusJobLimits noLimits;
+    memset(&noLimits, 0, sizeof(noLimits));
+    memcpy(request + sizeof(header), limits ? limits : &noLimits, sizeof(PlatypusJobLimits));
+    char *p = request + HEADER_SIZE;
+    for (size_t i = 0; i < argCount; i++) {
+        size_t len = strlen(args[i]) + 1;
+        memcpy(p, args[i], len);
+        p += len;
+    }
+    for (size_t i = 0; i < envCount; i++) {
+        size_t len = strlen(env[i]) + 1;
+        memcpy(p, env[i], len);
+        p += len;
+    }
+    *length = size;
+    return request;
+}
+
+// Reads exactly length bytes. Returns bytes read, less than length at EOF, or -1.
+static ssize_t ReadFully(int fd, void *buf, size_t length) {
+    size_t total = 0;
+    while (total < length) {
+        ssize_t n = read(fd, (char *)buf + total, length - total);
+        if (n == 0) {
+            break;
+        }
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        total += (size_t)n;
+    }
+    return (ssize_t)total;
+}
+
+int SETrampolineRun(int fd) {
+    uint32_t length;
+    ssize_t n = ReadFully(fd, &length, sizeof(length));
+    if (n == 0) {
+        return 0;
+    }
+    if (n != sizeof(length)) {
+        return n == -1 ? errno : EINVAL;
+    }
+    if (length < HEADER_SIZE - sizeof(uint32_t) || length > SE_TRAMPOLINE_MAX_REQUEST) {
+        return EINVAL;
+    }
+    
+    char *request = malloc(length + 1);
+    if (request == NULL) {
+        return ENOMEM;
+    }
+    n = ReadFully(fd, request, length);
+    if (n != (ssize_t)length) {
+        free(request);
+        return n == -1 ? errno : EINVAL;
+    }
+    request[length] = '\0';
+    
+    uint32_t counts[2];
+    memcpy(counts, request, COUNTS_SIZE);
+    uint32_t argCount = counts[0];
+    uint32_t envCount = counts[1];
+    PlatypusJobLimits limits;
+    memcpy(&limits, request + COUNTS_SIZE, sizeof(limits));
+    // Every string takes at least one byte
+    size_t stringsLength = length - (HEADER_SIZE - sizeof(uint32_t));
+    if (argCount == 0 || (uint64_t)argCount + envCount > stringsLength) {
+        free(request);
+        return EINVAL;
+    }
+    
+    char **argv = calloc((size_t)argCount + 1, sizeof(char *));
+    if (argv == NULL) {
+        free(request);
+        return ENOMEM;
+    }
+    char *p = request + HEADER_SIZE - sizeof(uint32_t);
+    char *end = request + length;
+    for (uint32_t i = 0; i < argCount + envCount; i++) {
+        char *nul = memchr(p, '\0', (size_t)(end - p));
+        if (nul == NULL) {
+            free(argv);
+            free(request);
+            return EINVAL;
+        }
+        if (i < argCount) {
+            argv[i] = p;
+        } else {
+            char *sep = strchr(p, '=');
+            if (sep == NULL || sep == p) {
+                free(argv);
+                free(request);
+                return EINVAL;
+            }
+            *sep = '\0';
+            setenv(p, sep + 1, 1);
+        }
+        p = nul + 1;
+    }
+    
+    // Fails with EPERM for a session leader, which leads its group already
+    int err = 0;
+    if (setpgid(0, 0) == -1 && errno != EPERM) {
+        err = errno;
+    }
+    if (err == 0) {
+        err = PlatypusJobLimitsApply(&limits);
+    }
+    if (err == 0) {
+        execv(argv[0], argv);
+        err = errno;
+    }
+    free(argv);
+    free(request);
+    return err;
+}
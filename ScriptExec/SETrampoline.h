@@ -0,0 +1,85 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Trampoline that sets up a job's process before it becomes the interpreter.
+//
+// ScriptExec launches a copy of its own executable with the
+// SE_TRAMPOLINE_ARG argument to run a job with resource limits, which
+// posix_spawn() can't set, and the privileged helper runs all its jobs this
+// way. Other jobs are spawned directly (see SEJobTask.h). The process does
+// nothing but wait on standard input for a request naming the interpreter,
+// its arguments and any extra environment variables, and then replaces
+// itself with the interpreter. Since the request is read from standard input
+// without reading past its end, whatever follows it on the pipe becomes the
+// script's standard input. The process is the one the app is already
+// monitoring, so it exits with the script's exit status.
+//
+// Before replacing itself, the process makes itself the leader of a new
+// process group, so the job and anything it launches can be signalled
+// together, and applies the job's resource limits.
+//
+// The request is in host byte order, since both ends are on the same machine:
+//
+//     uint32  length of the rest of the request
+//     uint32  number of arguments, the first being the executable path
+//     uint32  number of environment variables
+//     ...     PlatypusJobLimits
+//     ...     arguments, then "NAME=value" variables, NUL-terminated
+
+#ifndef SE_TRAMPOLINE_H
+#define SE_TRAMPOLINE_H
+
+#include <stddef.h>
+
+#include "PlatypusJobLimits.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SE_TRAMPOLINE_ARG           "--platypus-trampoline"
+#define SE_TRAMPOLINE_MAX_REQUEST   (8 * 1024 * 1024)
+
+// Returns a malloc'd request, or NULL if it would be too large or allocation
+// fails. Limits may be NULL.
+void *SETrampolineCreateRequest(const char *const *args, size_t argCount,
+                                const char *const *env, size_t envCount,
+                                const PlatypusJobLimits *limits, size_t *length);
+
+// Reads a request from fd and executes it. Only returns on failure: 0 if
+// the pipe was closed without a request, i.e. the process wasn't needed,
+// otherwise an errno value.
+int SETrampolineRun(int fd);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,58 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Interface type variants of ScriptExec.
+//
+// ScriptExec is built once with support for every interface type, and
+// release builds also build it once per interface type with
+// "make scriptexec_variants". PlatypusAppSpec copies the variant matching an
+// app's interface type into the app, if there is one, in place of the generic
+// binary. A variant is built with these preprocessor definitions:
+//
+//     SE_INTERFACE_TYPE        the PlatypusInterfaceType it runs
+//     SE_WITHOUT_WEBKIT        unless it's the Web View variant
+//     SE_WITHOUT_STATUS_ITEM   unless it's the Status Menu variant
+//
+// In a variant the interface type is a compile-time constant, so the compiler
+// drops every branch for the other interface types. Variants without WebKit
+// have no code referencing it, and are linked with -dead_strip_dylibs so the
+// framework isn't loaded at all. The web view in the nib is then loaded as a
+// plain view (see STDragWebView.h).
+
+#ifndef SE_VARIANT_H
+#define SE_VARIANT_H
+
+#ifdef SE_INTERFACE_TYPE
+#define SEVariantInterfaceType(X)   ((PlatypusInterfaceType)(SE_INTERFACE_TYPE))
+#else
+#define SEVariantInterfaceType(X)   (X)
+#endif
+
+#endif
@@ -0,0 +1,208 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "SEWarmInterpreter.h"
+
+#define LENGTH_DIGITS 8
+
+typedef struct Interpreter {
+    const char *name;
+    const char *const *safeArgs;
+    const char *codeArg;
+    const char *bootstrap;
+    const char *const *startupVariables;
+} Interpreter;
+
+// Each bootstrap reads the request with unbuffered reads, applies it and
+// runs the script as the interpreter would have, as the main program.
+// Nothing it defines is visible to the script. Anything they would load
+// only once the job arrives, e.g. Python's runpy, which imports pkgutil,
+// adds to the job's start-up, so they stick to what the interpreter has
+// loaded anyway.
+
+static const char *const pythonArgs[] = { "-u", "-B", "-O", "-OO", "-s", "-S", "-E", "-I", NULL };
+static const char *const pythonVariables[] = { "PYTHON", NULL };
+static const char pythonBootstrap[] =
+    "import os,sys,types\n"
+    "def r(n):\n"
+    "    b=b''\n"
+    "    while len(b)<n:\n"
+    "        c=os.read(0,n-len(b))\n"
+    "        if not c:os._exit(0)\n"
+    "        b+=c\n"
+    "    return b\n"
+    "d=getattr(os,'fsdecode',lambda b:b)\n"
+    "f=[d(e) for e in r(int(r(8),16)).split(b'\\0')[:-1]]\n"
+    "n=int(f[2])\n"
+    "os.chdir(f[0])\n"
+    "sys.argv=f[1:2]+f[3:3+n]\n"
+    "for e in f[3+n:]:\n"
+    "    k,v=e.split('=',1);os.environ[k]=v\n"
+    "if sys.path[:1]==['']:sys.path[0]=os.path.dirname(f[1])\n"
+    "m=types.ModuleType('__main__')\n"
+    "m.__file__=sys.argv[0]\n"
+    "sys.modules['__main__']=m\n"
+    "with open(m.__file__,'rb') as s:c=compile(s.read(),m.__file__,'exec')\n"
+    "exec(c,m.__dict__)\n";
+
+static const char *const perlArgs[] = { "-w", "-W", "-X", NULL };
+static const char *const perlVariables[] = { "PERL", NULL };
+static const char perlBootstrap[] =
+    "sub r{my($n,$b)=(shift,'');while(length($b)<$n){my$c=sysread(STDIN,$b,$n-length($b),length($b));"
+    "next if!defined($c)&&$!{EINTR};exit(0)unless$c}$b}\n"
+    "my@f=split(/\\0/,r(hex(r(8))),-1);pop@f;\n"
+    "chdir(shift@f);$0=shift@f;my$n=shift@f;@ARGV=splice(@f,0,$n);\n"
+    "for(@f){my($k,$v)=split(/=/,$_,2);$ENV{$k}=$v}\n"
+    "undef&r;do$0;if($@){print STDERR $@;exit(255)}\n";
+
+static const char *const rubyArgs[] = { "-w", "-W", NULL };
+static const char *const rubyVariables[] = { "RUBY", NULL };
+static const char rubyBootstrap[] =
+    "r=lambda{|n|b=''.b;begin;b<<STDIN.sysread(n-b.bytesize)while b.bytesize<n;rescue EOFError;exit(0);end;b}\n"
+    "f=r.(r.(8).to_i(16)).split(\"\\0\",-1).each{|e|e.force_encoding(Encoding.default_external)};f.pop\n"
+    "Dir.chdir(f.shift);$0=f.shift;ARGV.replace(f.shift(f.shift.to_i))\n"
+    "f.each{|e|k,v=e.split('=',2);ENV[k]=v}\n"
+    "load($0)\n";
+
+// Indexed by SEWarmInterpreterType
+static const Interpreter interpreters[] = {
+    { NULL, NULL, NULL, NULL, NULL },
+    { "python", pythonArgs, "-c", pythonBootstrap, pythonVariables },
+    { "perl", perlArgs, "-e", perlBootstrap, perlVariables },
+    { "ruby", rubyArgs, "-e", rubyBootstrap, rubyVariables }
+};
+
+// Locale variables are read at start-up by every one of them
+static const char *const localeVariables[] = { "LANG", "LC_", NULL };
+
+static int HasPrefix(const char *str, const char *const *prefixes) {
+    for (size_t i = 0; prefixes[i]; i++) {
+        if (strncmp(str, prefixes[i], strlen(prefixes[i])) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int IsListed(const char *str, const char *const *list) {
+    for (size_t i = 0; list[i]; i++) {
+        if (strcmp(str, list[i]) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+SEWarmInterpreterType SEWarmInterpreterTypeForInterpreter(const char *path, const char *const *args, size_t argCount) {
+    const char *name = strrchr(path, '/');
+    name = name ? name + 1 : path;
+    
+    // Versioned names, e.g. python3.12, are the same interpreter
+    SEWarmInterpreterType type = SEWarmInterpreterType_None;
+    for (size_t i = 1; i < sizeof(interpreters) / sizeof(interpreters[0]); i++) {
+        size_t len = strlen(interpreters[i].name);
+        if (strncmp(name, interpreters[i].name, len) == 0 && strspn(name + len, "0123456789.") == strlen(name + len)) {
+            type = (SEWarmInterpreterType)i;
+            break;
+        }
+    }
+    if (type == SEWarmInterpreterType_None) {
+        return type;
+    }
+    for (size_t i = 0; i < argCount; i++) {
+        if (!IsListed(args[i], interpreters[type].safeArgs)) {
+            return SEWarmInterpreterType_None;
+        }
+    }
+    return type;
+}
+
+char **SEWarmInterpreterCreateArguments(const char *path, const char *const *args, size_t argCount) {
+    SEWarmInterpreterType type = SEWarmInterpreterTypeForInterpreter(path, args, argCount);
+    if (type == SEWarmInterpreterType_None) {
+        return NULL;
+    }
+    char **argv = calloc(argCount + 4, sizeof(char *));
+    if (argv == NULL) {
+        return NULL;
+    }
+    argv[0] = (char *)path;
+    for (size_t i = 0; i < argCount; i++) {
+        argv[i + 1] = (char *)args[i];
+    }
+    argv[argCount + 1] = (char *)interpreters[type].codeArg;
+    argv[argCount + 2] = (char *)interpreters[type].bootstrap;
+    return argv;
+}
+
+int SEWarmInterpreterReadsAtStartup(SEWarmInterpreterType type, const char *name) {
+    if (type == SEWarmInterpreterType_None) {
+        return 0;
+    }
+    return HasPrefix(name, interpreters[type].startupVariables) || HasPrefix(name, localeVariables);
+}
+
+char *SEWarmInterpreterCreateRequest(const char *directory, const char *script,
+                                     const char *const *args, size_t argCount,
+                                     const char *const *env, size_t envCount, size_t *length) {
+    char count[24];
+    snprintf(count, sizeof(count), "%zu", argCount);
+    size_t size = LENGTH_DIGITS + strlen(directory) + 1 + strlen(script) + 1 + strlen(count) + 1;
+    for (size_t i = 0; i < argCount; i++) {
+        size += strlen(args[i]) + 1;
+    }
+    for (size_t i = 0; i < envCount; i++) {
+        size += strlen(env[i]) + 1;
+    }
+    if (size > SE_WARM_INTERPRETER_MAX_REQUEST) {
+        return NULL;
+    }
+    
+    // One more for the NUL snprintf() writes after the length
+    char *request = malloc(size + 1);
+    if (request == NULL) {
+        return NULL;
+    }
+    snprintf(request, LENGTH_DIGITS + 1, "%08zx", size - LENGTH_DIGITS);
+    char *p = request + LENGTH_DIGITS;
+    const char *fields[] = { directory, script, count };
+    for (size_t i = 0; i < 3 + argCount + envCount; i++) {
+        const char *field = (i < 3) ? fields[i] : (i < 3 + argCount) ? args[i - 3] : env[i - 3 - argCount];
+        size_t len = strlen(field) + 1;
+        memcpy(p, field, len);
+        p += len;
+    }
+    *length = size;
+    return request;
+}
@@ -0,0 +1,97 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Interpreters started before the job they are to run.
+//
+// Apps with the prespawn option start the interpreter for the next queued
+// job while the current one runs (see SEInterpreterPool.h). The interpreter
+// is given a small bootstrap program in place of the script. It starts up,
+// loads what the bootstrap needs and then blocks reading standard input.
+// Once the job arrives, the app writes a request naming the working
+// directory, the script, its arguments and any extra environment variables,
+// and the bootstrap runs the script in the same process. Like the
+// trampoline's (see SETrampoline.h), the request is read without reading
+// past its end, so whatever follows it on the pipe becomes the script's
+// standard input. The bootstrap exits quietly if the pipe is closed without
+// a request, i.e. the interpreter wasn't needed.
+//
+// Only Python, Perl and Ruby can be started this way, and only with
+// interpreter arguments that make no difference to which script is run.
+// Environment variables the interpreter reads when it starts, e.g.
+// PYTHONPATH, can't be changed for a job that is handed to it.
+//
+// The request is text, so the bootstraps can parse it easily:
+//
+//     8 hex digits  length of the rest of the request
+//     ...           directory, script, decimal argument count, arguments,
+//                   then "NAME=value" variables, NUL-terminated
+
+#ifndef SE_WARM_INTERPRETER_H
+#define SE_WARM_INTERPRETER_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SE_WARM_INTERPRETER_MAX_REQUEST (8 * 1024 * 1024)
+
+typedef enum SEWarmInterpreterType {
+    SEWarmInterpreterType_None = 0,
+    SEWarmInterpreterType_Python,
+    SEWarmInterpreterType_Perl,
+    SEWarmInterpreterType_Ruby
+} SEWarmInterpreterType;
+
+// Type of the interpreter at path, judging by its name, or None if it can't
+// be started ahead of time with the given interpreter arguments
+SEWarmInterpreterType SEWarmInterpreterTypeForInterpreter(const char *path, const char *const *args, size_t argCount);
+
+// Returns a malloc'd, NULL-terminated argument list that starts the
+// interpreter with its bootstrap, or NULL if it can't be started ahead of
+// time or allocation fails. The strings belong to the caller.
+char **SEWarmInterpreterCreateArguments(const char *path, const char *const *args, size_t argCount);
+
+// Whether the interpreter only reads the environment variable when it
+// starts, so setting it for a job needs a fresh interpreter
+int SEWarmInterpreterReadsAtStartup(SEWarmInterpreterType type, const char *name);
+
+// Returns a malloc'd request, or NULL if it would be too large or allocation
+// fails. Variables are "NAME=value" strings.
+char *SEWarmInterpreterCreateRequest(const char *directory, const char *script,
+                                     const char *const *args, size_t argCount,
+                                     const char *const *env, size_t envCount, size_t *length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
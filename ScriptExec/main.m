@@ -29,6 +29,9 @@
 */
 
 #import <Cocoa/Cocoa.h>
+#import "SEHeadless.h"
+#import "SETrampoline.h"
+#import "SEPrivilegedHelper.h"
 
 #ifdef DEBUG
     void exceptionHandler(NSException *exception);
@@ -42,8 +45,44 @@
 #endif
 
 int main(int argc, char *argv[]) {
+    // Job process waiting to become the interpreter
+    if (argc == 2 && strcmp(argv[1], SE_TRAMPOLINE_ARG) == 0) {
+        int err = SETrampolineRun(STDIN_FILENO);
+        if (err == 0) {
+            return EXIT_SUCCESS;
+        }
+        fprintf(stderr, "Unable to run interpreter: %s\n", strerror(err));
+        return 127;
+    }
+    
+    // Helper running privileged jobs, given to it over the socket that is
+    // its standard input and output
+    if (argc == 2 && strcmp(argv[1], SE_PRIVILEGED_HELPER_ARG) == 0) {
+        // Authorization only sets the effective user, and jobs should run
+        // as root throughout
+        if (geteuid() == 0) {
+            setuid(0);
+        }
+        int err;
+        @autoreleasepool {
+            err = SEPrivilegedHelperRun(STDIN_FILENO, STDOUT_FILENO, [[[NSBundle mainBundle] executablePath] fileSystemRepresentation]);
+        }
+        if (err == 0) {
+            return EXIT_SUCCESS;
+        }
+        fprintf(stderr, "Privileged helper failed: %s\n", strerror(err));
+        return EXIT_FAILURE;
+    }
+    
 #ifdef DEBUG
     NSSetUncaughtExceptionHandler(&exceptionHandler);
 #endif
+    // Apps with no interface can skip AppKit entirely
+    @autoreleasepool {
+        int exitStatus;
+        if (SEHeadlessRunIfPossible(&exitStatus)) {
+            return exitStatus;
+        }
+    }
     return NSApplicationMain(argc,  (const char **)argv);
 }
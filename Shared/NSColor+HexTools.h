@@ -33,6 +33,7 @@
 @interface NSColor (HexTools)
 
 + (NSColor *)colorFromHexString:(NSString *)inColorString;
++ (NSColor *)colorFromRGBValue:(uint32_t)rgb;
 - (NSString *)hexString;
 
 @end
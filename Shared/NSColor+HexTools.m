@@ -34,26 +34,26 @@
 
 + (NSColor *)colorFromHexString:(NSString *)inColorString {
     NSString *charStr = [inColorString substringFromIndex:1];
-    NSColor *result = NULL;
     unsigned int colorCode = 0;
-    unsigned char redByte = 0;
-    unsigned char greenByte = 0;
-    unsigned char blueByte = 0;
     
     if (charStr != NULL) {
         NSScanner *scanner = [NSScanner scannerWithString:charStr];
         (void)[scanner scanHexInt:&colorCode]; // Ignore error
     }
     
-    redByte = (unsigned char)(colorCode >> 16);
-    greenByte = (unsigned char)(colorCode >> 8);
-    blueByte = (unsigned char)(colorCode); // Masks off high bits
+    return [NSColor colorFromRGBValue:colorCode];
+}
+
+// 0xRRGGBB
++ (NSColor *)colorFromRGBValue:(uint32_t)rgb {
+    unsigned char redByte = (unsigned char)(rgb >> 16);
+    unsigned char greenByte = (unsigned char)(rgb >> 8);
+    unsigned char blueByte = (unsigned char)(rgb); // Masks off high bits
     
-    result = [NSColor colorWithCalibratedRed:(float)redByte / 0xff
-                                       green:(float)greenByte / 0xff
-                                        blue:(float)blueByte / 0xff
-                                       alpha:1.0];
-    return result;
+    return [NSColor colorWithCalibratedRed:(float)redByte / 0xff
+                                     green:(float)greenByte / 0xff
+                                      blue:(float)blueByte / 0xff
+                                     alpha:1.0];
 }
 
 - (NSString *)hexString {
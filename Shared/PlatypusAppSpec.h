@@ -62,5 +62,6 @@
 + (NSString *)bundleIdentifierForAppName:(NSString *)name
                               authorName:(NSString *)authorName
                            usingDefaults:(BOOL)def;
++ (NSString *)executablePath:(NSString *)execPath forInterfaceType:(NSString *)interfaceType;
 
 @end
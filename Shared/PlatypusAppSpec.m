@@ -31,9 +31,16 @@
 // PlatypusAppSpec is a wrapper class around an NSDictionary containing all
 // the information / specifications needed to create a Platypus application.
 
+#import <fcntl.h>
+
 #import "Common.h"
 #import "PlatypusAppSpec.h"
 #import "PlatypusScriptUtils.h"
+#import "PlatypusSettingsSnapshot.h"
+#import "PlatypusSpawn.h"
+#import "PlatypusStaging.h"
+#import "PlatypusMachO.h"
+#import "PlatypusJobLimits.h"
 #import "NSWorkspace+Additions.h"
 #import "NSFileManager+TempFiles.h"
 
@@ -140,6 +147,8 @@
     self[AppSpecKey_Overwrite] = @NO;
     self[AppSpecKey_SymlinkFiles] = @NO;
     self[AppSpecKey_StripNib] = @NO;
+    self[AppSpecKey_Architectures] = @[];
+    self[AppSpecKey_PrecompileBytecode] = @NO;
     
     self[AppSpecKey_Name] = DEFAULT_APP_NAME;
     self[AppSpecKey_ScriptPath] = @"";
@@ -162,6 +171,15 @@
     self[AppSpecKey_RemainRunning] = @YES;
     self[AppSpecKey_RunInBackground] = @NO;
     self[AppSpecKey_SendNotifications] = @NO;
+    self[AppSpecKey_ExecInterpreter] = @NO;
+    self[AppSpecKey_ControlChannelOnly] = @NO;
+    self[AppSpecKey_LargeOutputView] = @NO;
+    self[AppSpecKey_LogOutput] = @NO;
+    self[AppSpecKey_PersistentJobQueue] = @NO;
+    self[AppSpecKey_JobServer] = @NO;
+    self[AppSpecKey_JobLimits] = @"";
+    self[AppSpecKey_PrivilegedHelper] = @NO;
+    self[AppSpecKey_PrespawnInterpreter] = @NO;
     
     self[AppSpecKey_BundledFiles] = [NSMutableArray array];
     
@@ -247,6 +265,8 @@
         [self report:@"Executable %@ does not exist. Aborting.", execSrcPath];
         return NO;
     }
+    // Use the ScriptExec variant built for the app's interface type, if there is one
+    execSrcPath = [PlatypusAppSpec executablePath:execSrcPath forInterfaceType:self[AppSpecKey_InterfaceType]];
     
     // Check if source nib exists
     NSString *nibPath = self[AppSpecKey_NibPath];
@@ -258,21 +278,32 @@
     [self report:@"Creating application bundle folder hierarchy"];
     
     // .app bundle
-    // Get temporary directory, make sure it's kosher. Apparently NSTemporaryDirectory() can return nil
-    // See http://www.cocoadev.com/index.pl?NSTemporaryDirectory
-    NSString *tmpPath = NSTemporaryDirectory();
-    if (tmpPath == nil) {
-        tmpPath = @"/tmp/"; // Fallback, just in case
+    // Build it in a hidden staging directory next to the destination, so the
+    // finished app is moved into place with a single rename on the same volume
+    NSString *tmpPath = nil;
+    char stagedPath[PATH_MAX];
+    if (PlatypusStagingCreate([self[AppSpecKey_DestinationPath] fileSystemRepresentation], stagedPath, sizeof(stagedPath)) == 0) {
+        tmpPath = [FILEMGR stringWithFileSystemRepresentation:stagedPath length:strlen(stagedPath)];
     }
-    
-    // Make sure we can write to temp path
-    if ([FILEMGR isWritableFileAtPath:tmpPath] == NO) {
-        _error = [NSString stringWithFormat:@"Could not write to the temp directory '%@'.", tmpPath];
-        return FALSE;
+    BOOL staged = (tmpPath != nil);
+    
+    if (!staged) {
+        // Get temporary directory, make sure it's kosher. Apparently NSTemporaryDirectory() can return nil
+        // See http://www.cocoadev.com/index.pl?NSTemporaryDirectory
+        tmpPath = NSTemporaryDirectory();
+        if (tmpPath == nil) {
+            tmpPath = @"/tmp/"; // Fallback, just in case
+        }
+        
+        // Make sure we can write to temp path
+        if ([FILEMGR isWritableFileAtPath:tmpPath] == NO) {
+            _error = [NSString stringWithFormat:@"Could not write to the temp directory '%@'.", tmpPath];
+            return FALSE;
+        }
+        tmpPath = [tmpPath stringByAppendingString:[self[AppSpecKey_DestinationPath] lastPathComponent]];
     }
     
     // .app
-    tmpPath = [tmpPath stringByAppendingString:[self[AppSpecKey_DestinationPath] lastPathComponent]];
     [FILEMGR createDirectoryAtPath:tmpPath withIntermediateDirectories:NO attributes:nil error:nil];
     
     // .app/Contents
@@ -294,23 +325,54 @@
     NSString *outFolder = [macosPath stringByAppendingString:@"/"];
     NSString *execDestPath = [outFolder stringByAppendingString:self[AppSpecKey_Name]];
     if ([execSrcPath hasSuffix:GZIP_SUFFIX]) {
-        // Create empty file
-        [FILEMGR createFileAtPath:execDestPath contents:nil attributes:nil];
-        NSFileHandle *outFile = [NSFileHandle fileHandleForWritingAtPath:execDestPath];
         // Extract gzip destination folder
-        // gunzip -c ScriptExec.gz > filehandle
-        NSTask *gunzipTask = [[NSTask alloc] init];
-        [gunzipTask setLaunchPath:@"/usr/bin/gunzip"];
-        [gunzipTask setArguments:@[@"-c", execSrcPath]];
-        [gunzipTask setStandardOutput:outFile];
-        [gunzipTask launch];
-        [gunzipTask waitUntilExit];
+        // gunzip -c ScriptExec.gz > execDestPath
+        int outFile = open([execDestPath fileSystemRepresentation], O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (outFile != -1) {
+            char *const args[] = { "gunzip", "-c", (char *)[execSrcPath fileSystemRepresentation], NULL };
+            PlatypusSpawnAttributes attributes;
+            PlatypusSpawnAttributesInit(&attributes, "/usr/bin/gunzip", args);
+            attributes.fds[1] = outFile;
+            pid_t pid;
+            int status;
+            if (PlatypusSpawn(&attributes, &pid) == 0) {
+                PlatypusSpawnWait(pid, -1, -1, &status);
+            }
+            close(outFile);
+        }
     } else {
         [FILEMGR copyItemAtPath:execSrcPath toPath:execDestPath error:nil];
     }
     NSDictionary *execAttrDict = @{ NSFilePosixPermissions:[NSNumber numberWithShort:0777] };
     [FILEMGR setAttributes:execAttrDict ofItemAtPath:execDestPath error:nil];
     
+    // Remove the executable's slices for architectures other than those requested
+    NSArray *archs = self[AppSpecKey_Architectures];
+    if ([archs count]) {
+        [self report:@"Thinning executable to %@", [archs componentsJoinedByString:@", "]];
+        const char *archNames[PLATYPUS_MACHO_MAX_SLICES];
+        NSUInteger archCount = MIN([archs count], PLATYPUS_MACHO_MAX_SLICES);
+        for (NSUInteger i = 0; i < archCount; i++) {
+            archNames[i] = [archs[i] UTF8String];
+        }
+        size_t removed;
+        int err = PlatypusMachOThinFile([execDestPath fileSystemRepresentation], archNames, archCount, &removed);
+        if (err) {
+            if (err == ENOENT) {
+                _error = [NSString stringWithFormat:@"Executable has no code for architectures %@", [archs componentsJoinedByString:@", "]];
+            } else {
+                _error = [NSString stringWithFormat:@"Error thinning executable: %s", strerror(err)];
+            }
+            if (staged) {
+                PlatypusStagingRemove(stagedPath);
+            } else {
+                [FILEMGR removeItemAtPath:tmpPath error:nil];
+            }
+            return FALSE;
+        }
+        [self report:@"Removed %@ from executable", [WORKSPACE fileSizeAsHumanReadableString:removed]];
+    }
+    
     // Copy nib file to app bundle
     // .app/Contents/Resources/MainMenu.nib
     [self report:@"Copying nib file to bundle"];
@@ -351,6 +413,15 @@
                                                                     error:nil];
     [plistData writeToFile:appSettingsPlistPath atomically:YES];
     
+    // Create precompiled settings snapshot, which ScriptExec
+    // loads in preference to AppSettings.plist on launch
+    // .app/Contents/Resources/AppSettings.bin
+    [self report:@"Writing AppSettings.bin"];
+    NSString *snapshotPath = [resourcesPath stringByAppendingPathComponent:APP_SETTINGS_SNAPSHOT_NAME];
+    if ([self writeSettingsSnapshot:appSettingsPlist madeFrom:appSettingsPlistPath toFile:snapshotPath] == NO) {
+        [self report:@"Unable to write settings snapshot, app will use AppSettings.plist"];
+    }
+    
     // Create icon
     // .app/Contents/Resources/appIcon.icns
     if (self[AppSpecKey_IconPath]) {
@@ -382,6 +453,11 @@
                                                                    error:nil];
     if (!infoData || ![infoData writeToFile:infoPlistPath atomically:YES]) {
         _error = @"Error writing Info.plist";
+        if (staged) {
+            PlatypusStagingRemove(stagedPath);
+        } else {
+            [FILEMGR removeItemAtPath:tmpPath error:nil];
+        }
         return FALSE;
     }
     
@@ -445,6 +521,13 @@
         }
     }
     
+    // Compile bundled sources to bytecode, cached next to them in Resources.
+    // Symlinked sources are left alone, since they change during development
+    // and the cache would be written into the source folder.
+    if ([self[AppSpecKey_PrecompileBytecode] boolValue] && ![self[AppSpecKey_SymlinkFiles] boolValue]) {
+        [self precompileSourcesInFolder:resourcesPath];
+    }
+    
     // Sign app if signing identity has been provided
 //    if (self[AppSpecKey_SigningIdentity]) {
 //        [self report:@"Signing '%@'", [tmpPath lastPathComponent]];
@@ -461,6 +544,10 @@
     
     NSString *destPath = self[AppSpecKey_DestinationPath];
     
+    if (staged) {
+        return [self commitStagedApp:stagedPath toPath:destPath];
+    }
+    
     // First, let's see if there's anything there.  If we have overwrite set, we just delete that stuff
     if ([FILEMGR fileExistsAtPath:destPath]) {
         if ([self[AppSpecKey_Overwrite] boolValue]) {
@@ -494,6 +581,84 @@
     return TRUE;
 }
 
+// Rename the app from its staging directory into place. An app being
+// overwritten is swapped into the staging directory and deleted by a
+// separate process, so its removal doesn't hold up the build.
+- (BOOL)commitStagedApp:(const char *)stagedPath toPath:(NSString *)destPath {
+    int replaced = 0;
+    int err = PlatypusStagingCommit(stagedPath, [destPath fileSystemRepresentation],
+                                    [self[AppSpecKey_Overwrite] boolValue], &replaced);
+    if (err) {
+        PlatypusStagingRemove(stagedPath);
+        if (err == EEXIST) {
+            _error = [NSString stringWithFormat:@"File already exists at path '%@'", destPath];
+        } else {
+            _error = [NSString stringWithFormat:@"Failed to create application at the specified destination: %s", strerror(err)];
+        }
+        return FALSE;
+    }
+    
+    pid_t pid;
+    if (replaced && PlatypusStagingRemoveInBackground(stagedPath, &pid) == 0) {
+        [self report:@"Removing previous app in the background"];
+        dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_BACKGROUND, 0), ^{
+            int status;
+            PlatypusSpawnWait(pid, -1, -1, &status);
+        });
+    } else {
+        PlatypusStagingRemove(stagedPath);
+    }
+    
+    // Register app with macOS Launch Services to update its database
+    [self report:@"Registering app with Launch Services"];
+    [WORKSPACE registerAppWithLaunchServices:destPath];
+    
+    [self report:@"Done"];
+    
+    return TRUE;
+}
+
+// Have the app's interpreter compile the sources in a folder to the bytecode
+// it loads at runtime. The cache is checked against each source's hash rather
+// than its modification date, so it stays valid when the app is copied and is
+// ignored if a source is edited. Failure only costs startup time, so it is
+// reported but doesn't stop the app from being created.
+- (void)precompileSourcesInFolder:(NSString *)folderPath {
+    NSString *interpreterPath = self[AppSpecKey_InterpreterPath];
+    NSArray *precompileArgs = [PlatypusScriptUtils precompileArgsForInterpreterPath:interpreterPath];
+    if (precompileArgs == nil) {
+        [self report:@"Warning: No bytecode compiler for interpreter %@", interpreterPath];
+        return;
+    }
+    [self report:@"Compiling bundled sources to bytecode"];
+    
+    NSMutableArray *args = [NSMutableArray arrayWithObject:interpreterPath];
+    [args addObjectsFromArray:precompileArgs];
+    [args addObject:folderPath];
+    
+    // Run in its own process group so a compiler that hangs is killed
+    // along with any workers it started
+    char **argv = PlatypusSpawnArguments(args);
+    PlatypusSpawnAttributes attributes;
+    PlatypusSpawnAttributesInit(&attributes, argv[0], argv);
+    attributes.processGroup = 1;
+    char *output = NULL;
+    size_t length = 0;
+    int status = 0;
+    int err = PlatypusSpawnRun(&attributes, PRECOMPILE_TIMEOUT, &output, &length, &status);
+    free(argv);
+    
+    if (err) {
+        [self report:@"Warning: Unable to compile bundled sources to bytecode: %s", strerror(err)];
+        return;
+    }
+    int exitStatus = PlatypusSpawnExitStatus(status);
+    if (exitStatus != 0) {
+        [self report:@"Warning: Compiling bundled sources to bytecode failed (%d): %s", exitStatus, output];
+    }
+    free(output);
+}
+
 // Generate AppSettings.plist dictionary
 - (NSMutableDictionary *)appSettingsPlist {
     
@@ -512,6 +677,15 @@
                               AppSpecKey_TextBackgroundColor,
                               AppSpecKey_Droppable,
                               AppSpecKey_SendNotifications,
+                              AppSpecKey_ExecInterpreter,
+                              AppSpecKey_ControlChannelOnly,
+                              AppSpecKey_LargeOutputView,
+                              AppSpecKey_LogOutput,
+                              AppSpecKey_PersistentJobQueue,
+                              AppSpecKey_JobServer,
+                              AppSpecKey_JobLimits,
+                              AppSpecKey_PrivilegedHelper,
+                              AppSpecKey_PrespawnInterpreter,
                               AppSpecKey_AcceptFiles,
                               AppSpecKey_AcceptText,
                               AppSpecKey_PromptForFile,
@@ -539,6 +713,97 @@
     return appSettingsPlist;
 }
 
+// Write precompiled binary version of AppSettings.plist dictionary
+- (BOOL)writeSettingsSnapshot:(NSDictionary *)appSettings madeFrom:(NSString *)plistPath toFile:(NSString *)path {
+    
+    // ScriptExec reports invalid interface types when reading AppSettings.plist
+    NSString *interfaceTypeStr = appSettings[AppSpecKey_InterfaceType];
+    if (IsValidInterfaceTypeString(interfaceTypeStr) == NO) {
+        return NO;
+    }
+    
+    PlatypusSnapshotWriter *writer = PlatypusSnapshotWriterCreate();
+    if (writer == NULL) {
+        return NO;
+    }
+    
+    // Lets ScriptExec tell if the property list has been edited since
+    if (PlatypusSnapshotWriterSetSource(writer, [plistPath fileSystemRepresentation]) != 0) {
+        PlatypusSnapshotWriterFree(writer);
+        return NO;
+    }
+    
+    PlatypusSnapshotHeader *header = PlatypusSnapshotWriterHeader(writer);
+    header->interfaceType = InterfaceTypeForString(interfaceTypeStr);
+    header->execStyle = [appSettings[AppSpecKey_Authenticate] intValue];
+    header->textSize = [appSettings[AppSpecKey_TextSize] floatValue];
+    
+    NSString *fg = appSettings[AppSpecKey_TextColor] ? appSettings[AppSpecKey_TextColor] : DEFAULT_TEXT_FG_COLOR;
+    NSString *bg = appSettings[AppSpecKey_TextBackgroundColor] ? appSettings[AppSpecKey_TextBackgroundColor] : DEFAULT_TEXT_BG_COLOR;
+    header->textColor = PlatypusSnapshotRGBFromHexString([fg UTF8String]);
+    header->textBackgroundColor = PlatypusSnapshotRGBFromHexString([bg UTF8String]);
+    
+    NSDictionary *flags = @{ AppSpecKey_RemainRunning: @(PlatypusSnapshotFlag_RemainRunning),
+                             AppSpecKey_Droppable: @(PlatypusSnapshotFlag_Droppable),
+                             AppSpecKey_SendNotifications: @(PlatypusSnapshotFlag_SendNotifications),
+                             AppSpecKey_AcceptFiles: @(PlatypusSnapshotFlag_AcceptFiles),
+                             AppSpecKey_AcceptText: @(PlatypusSnapshotFlag_AcceptText),
+                             AppSpecKey_PromptForFile: @(PlatypusSnapshotFlag_PromptForFile),
+                             AppSpecKey_StatusItemUseSysfont: @(PlatypusSnapshotFlag_StatusItemUseSysfont),
+                             AppSpecKey_StatusItemIconIsTemplate: @(PlatypusSnapshotFlag_StatusItemIconIsTemplate),
+                             AppSpecKey_ExecInterpreter: @(PlatypusSnapshotFlag_ExecInterpreter),
+                             AppSpecKey_ControlChannelOnly: @(PlatypusSnapshotFlag_ControlChannelOnly),
+                             AppSpecKey_LargeOutputView: @(PlatypusSnapshotFlag_LargeOutputView),
+                             AppSpecKey_LogOutput: @(PlatypusSnapshotFlag_LogOutput),
+                             AppSpecKey_PersistentJobQueue: @(PlatypusSnapshotFlag_PersistentJobQueue),
+                             AppSpecKey_JobServer: @(PlatypusSnapshotFlag_JobServer),
+                             AppSpecKey_PrivilegedHelper: @(PlatypusSnapshotFlag_PrivilegedHelper),
+                             AppSpecKey_PrespawnInterpreter: @(PlatypusSnapshotFlag_PrespawnInterpreter) };
+    for (NSString *k in flags) {
+        if ([appSettings[k] boolValue]) {
+            header->flags |= [flags[k] unsignedIntValue];
+        }
+    }
+    
+    int err = 0;
+    
+    NSDictionary *strings = @{ AppSpecKey_InterpreterPath: @(PlatypusSnapshotString_InterpreterPath),
+                               AppSpecKey_TextFont: @(PlatypusSnapshotString_TextFont),
+                               AppSpecKey_StatusItemDisplayType: @(PlatypusSnapshotString_StatusItemDisplayType),
+                               AppSpecKey_StatusItemTitle: @(PlatypusSnapshotString_StatusItemTitle),
+                               AppSpecKey_JobLimits: @(PlatypusSnapshotString_JobLimits) };
+    for (NSString *k in strings) {
+        if (appSettings[k] && !err) {
+            err = PlatypusSnapshotWriterSetString(writer, [strings[k] intValue], [appSettings[k] UTF8String]);
+        }
+    }
+    
+    NSDictionary *lists = @{ AppSpecKey_InterpreterArgs: @(PlatypusSnapshotList_InterpreterArgs),
+                             AppSpecKey_ScriptArgs: @(PlatypusSnapshotList_ScriptArgs),
+                             AppSpecKey_Suffixes: @(PlatypusSnapshotList_Suffixes),
+                             AppSpecKey_Utis: @(PlatypusSnapshotList_Utis),
+                             AppSpecKey_URISchemes: @(PlatypusSnapshotList_URISchemes) };
+    for (NSString *k in lists) {
+        for (NSString *item in appSettings[k]) {
+            if (!err) {
+                err = PlatypusSnapshotWriterAddListItem(writer, [lists[k] intValue], [item UTF8String]);
+            }
+        }
+    }
+    
+    NSData *icon = appSettings[AppSpecKey_StatusItemIcon];
+    if (icon && !err) {
+        err = PlatypusSnapshotWriterSetBlob(writer, PlatypusSnapshotBlob_StatusItemIcon, [icon bytes], [icon length]);
+    }
+    
+    if (!err) {
+        err = PlatypusSnapshotWriterWriteToFile(writer, [path fileSystemRepresentation]);
+    }
+    PlatypusSnapshotWriterFree(writer);
+    
+    return (err == 0);
+}
+
 // Generate Info.plist dictionary
 - (NSDictionary *)infoPlist {
     
@@ -697,9 +962,88 @@
         }
     }
     
+    if ([self[AppSpecKey_ExecInterpreter] boolValue]) {
+        NSArray *reasons = [self execInterpreterObstacles];
+        if ([reasons count]) {
+            [self report:@"Warning: Exec interpreter mode doesn't apply to this app, since it %@.",
+             [reasons componentsJoinedByString:@", "]];
+        }
+    }
+    
+    for (NSString *arch in self[AppSpecKey_Architectures]) {
+        if (!PlatypusMachOArchitectureIsKnown([arch UTF8String])) {
+            _error = [NSString stringWithFormat:@"Unknown architecture '%@'", arch];
+            return NO;
+        }
+    }
+    if ([self[AppSpecKey_Architectures] count] > PLATYPUS_MACHO_MAX_SLICES) {
+        _error = @"Too many architectures";
+        return NO;
+    }
+    
+    if ([self[AppSpecKey_PrecompileBytecode] boolValue] &&
+        [PlatypusScriptUtils precompileArgsForInterpreterPath:self[AppSpecKey_InterpreterPath]] == nil) {
+        [self report:@"Warning: Bytecode precompilation is not supported for interpreter %@", self[AppSpecKey_InterpreterPath]];
+    }
+    
+    if ([self[AppSpecKey_JobLimits] length]) {
+        PlatypusJobLimits limits;
+        if (PlatypusJobLimitsParse([self[AppSpecKey_JobLimits] UTF8String], &limits) != 0) {
+            _error = [NSString stringWithFormat:@"Invalid job limits '%@'", self[AppSpecKey_JobLimits]];
+            return NO;
+        }
+        if ([self[AppSpecKey_Authenticate] boolValue]) {
+            [self report:@"Warning: Job limits don't apply to scripts run with admin privileges."];
+        }
+    }
+    
     return YES;
 }
 
+// Reasons the app won't launch headless. Must match the conditions
+// checked by IsHeadlessCapable() in ScriptExec/SEHeadless.m
+- (NSArray <NSString *> *)headlessLaunchObstacles {
+    NSMutableArray *reasons = [NSMutableArray array];
+    if (InterfaceTypeForString(self[AppSpecKey_InterfaceType]) != PlatypusInterfaceType_None) {
+        [reasons addObject:@"has an interface"];
+    }
+    if ([self[AppSpecKey_Authenticate] boolValue]) {
+        [reasons addObject:@"runs with admin privileges"];
+    }
+    if ([self[AppSpecKey_AcceptFiles] boolValue] || [self[AppSpecKey_AcceptText] boolValue]) {
+        [reasons addObject:@"accepts dropped items"];
+    }
+    if ([self[AppSpecKey_PromptForFile] boolValue]) {
+        [reasons addObject:@"prompts for a file on launch"];
+    }
+    if ([self[AppSpecKey_SendNotifications] boolValue]) {
+        [reasons addObject:@"sends notifications"];
+    }
+    if ([self[AppSpecKey_RemainRunning] boolValue]) {
+        [reasons addObject:@"remains running after execution"];
+    }
+    if ([self[AppSpecKey_JobLimits] length]) {
+        [reasons addObject:@"has job limits"];
+    }
+    if ([self[AppSpecKey_URISchemes] count]) {
+        [reasons addObject:@"handles URI schemes"];
+    }
+    if ([self[AppSpecKey_Droppable] boolValue] && [self[AppSpecKey_Service] boolValue]) {
+        [reasons addObject:@"is a service"];
+    }
+    return reasons;
+}
+
+// Reasons the app won't replace itself with the interpreter. Must match
+// CanExecInterpreter() in ScriptExec/SEHeadless.m
+- (NSArray <NSString *> *)execInterpreterObstacles {
+    NSMutableArray *reasons = [[self headlessLaunchObstacles] mutableCopy];
+    if ([self[AppSpecKey_LogOutput] boolValue]) {
+        [reasons addObject:@"logs its output"];
+    }
+    return reasons;
+}
+
 #pragma mark -
 
 - (void)writeToFile:(NSString *)filePath {
@@ -759,6 +1103,51 @@
         checkboxParamStr = [checkboxParamStr stringByAppendingString:str];
     }
     
+    if ([self[AppSpecKey_ExecInterpreter] boolValue]) {
+        NSString *str = shortOpts ? @"-E " : @"--exec-interpreter ";
+        checkboxParamStr = [checkboxParamStr stringByAppendingString:str];
+    }
+    
+    if ([self[AppSpecKey_ControlChannelOnly] boolValue]) {
+        NSString *str = shortOpts ? @"-j " : @"--control-channel-only ";
+        checkboxParamStr = [checkboxParamStr stringByAppendingString:str];
+    }
+    
+    if ([self[AppSpecKey_LargeOutputView] boolValue]) {
+        NSString *str = shortOpts ? @"-J " : @"--large-output-view ";
+        checkboxParamStr = [checkboxParamStr stringByAppendingString:str];
+    }
+    
+    if ([self[AppSpecKey_LogOutput] boolValue]) {
+        NSString *str = shortOpts ? @"-w " : @"--log-output ";
+        checkboxParamStr = [checkboxParamStr stringByAppendingString:str];
+    }
+    
+    if ([self[AppSpecKey_PersistentJobQueue] boolValue]) {
+        NSString *str = shortOpts ? @"-r " : @"--persistent-queue ";
+        checkboxParamStr = [checkboxParamStr stringByAppendingString:str];
+    }
+    
+    if ([self[AppSpecKey_JobServer] boolValue]) {
+        NSString *str = shortOpts ? @"-M " : @"--job-server ";
+        checkboxParamStr = [checkboxParamStr stringByAppendingString:str];
+    }
+    
+    if ([self[AppSpecKey_PrivilegedHelper] boolValue]) {
+        NSString *str = shortOpts ? @"-S " : @"--privileged-helper ";
+        checkboxParamStr = [checkboxParamStr stringByAppendingString:str];
+    }
+    
+    if ([self[AppSpecKey_PrespawnInterpreter] boolValue]) {
+        NSString *str = shortOpts ? @"-H " : @"--prespawn-interpreter ";
+        checkboxParamStr = [checkboxParamStr stringByAppendingString:str];
+    }
+    
+    if ([self[AppSpecKey_PrecompileBytecode] boolValue]) {
+        NSString *str = shortOpts ? @"-z " : @"--precompile-bytecode ";
+        checkboxParamStr = [checkboxParamStr stringByAppendingString:str];
+    }
+    
     if ([self[AppSpecKey_Version] isEqualToString:DEFAULT_VERSION] == FALSE) {
         NSString *str = shortOpts ? @"-V" : @"--app-version";
         versionString = [NSString stringWithFormat:@" %@ '%@' ", str, self[AppSpecKey_Version]];
@@ -817,6 +1206,19 @@
         parametersString = [parametersString stringByAppendingString:[NSString stringWithFormat:@"%@ '%@' ", str, arg]];
     }
     
+    // Job limits
+    if ([self[AppSpecKey_JobLimits] length]) {
+        NSString *str = shortOpts ? @"-e" : @"--job-limits";
+        parametersString = [parametersString stringByAppendingString:[NSString stringWithFormat:@"%@ '%@' ", str, self[AppSpecKey_JobLimits]]];
+    }
+    
+    // Architectures to thin executable to
+    if ([self[AppSpecKey_Architectures] count]) {
+        NSString *str = shortOpts ? @"-t" : @"--architectures";
+        NSString *arg = [self[AppSpecKey_Architectures] componentsJoinedByString:CMDLINE_ARG_SEPARATOR];
+        parametersString = [parametersString stringByAppendingString:[NSString stringWithFormat:@"%@ '%@' ", str, arg]];
+    }
+    
     // Create args for text settings
     if (IsTextStyledInterfaceTypeString(self[AppSpecKey_InterfaceType])) {
         
@@ -950,6 +1352,24 @@
     return identifierString;
 }
 
+// ScriptExec variants built for a single interface type sit next to the
+// generic binary, e.g. ScriptExec-ProgressBar.gz next to ScriptExec.gz.
+// Returns the generic binary's path if there's no such variant.
++ (NSString *)executablePath:(NSString *)execPath forInterfaceType:(NSString *)interfaceType {
+    if (execPath == nil || IsValidInterfaceTypeString(interfaceType) == NO) {
+        return execPath;
+    }
+    NSString *variantName = [interfaceType stringByReplacingOccurrencesOfString:@" " withString:@""];
+    NSString *variantPath;
+    if ([execPath hasSuffix:GZIP_SUFFIX]) {
+        NSString *basePath = [execPath substringToIndex:[execPath length] - [GZIP_SUFFIX length]];
+        variantPath = [NSString stringWithFormat:@"%@-%@%@", basePath, variantName, GZIP_SUFFIX];
+    } else {
+        variantPath = [NSString stringWithFormat:@"%@-%@", execPath, variantName];
+    }
+    return [FILEMGR isReadableFileAtPath:variantPath] ? variantPath : execPath;
+}
+
 // Use ibtool to strip a given nib file.
 // This makes the file uneditable in Interface Builder.
 + (void)optimizeNibFile:(NSString *)nibPath {
@@ -957,11 +1377,15 @@
         DLog(@"Unable to strip nib file, ibtool not found at path %@", IBTOOL_PATH);
         return;
     }
-    NSTask *ibToolTask = [[NSTask alloc] init];
-    [ibToolTask setLaunchPath:IBTOOL_PATH];
-    [ibToolTask setArguments:@[@"--strip", nibPath, nibPath]];
-    [ibToolTask launch];
-    [ibToolTask waitUntilExit];
+    char **args = PlatypusSpawnArguments(@[IBTOOL_PATH, @"--strip", nibPath, nibPath]);
+    PlatypusSpawnAttributes attributes;
+    PlatypusSpawnAttributesInit(&attributes, args[0], args);
+    pid_t pid;
+    int status;
+    if (PlatypusSpawn(&attributes, &pid) == 0) {
+        PlatypusSpawnWait(pid, -1, -1, &status);
+    }
+    free(args);
 }
 
 // Run code signing tool on an app or binary
@@ -0,0 +1,206 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#include "PlatypusJobLimits.h"
+
+#define BYTES_PER_MEGABYTE  (1024 * 1024)
+
+static int ParseInteger(const char *str, size_t len, uint64_t *value) {
+    if (len == 0 || len > 19) {
+        return EINVAL;
+    }
+    uint64_t v = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (str[i] < '0' || str[i] > '9') {
+            return EINVAL;
+        }
+        v = v * 10 + (uint64_t)(str[i] - '0');
+    }
+    *value = v;
+    return 0;
+}
+
+static int ParseSeconds(const char *str, size_t len, double *value) {
+    char buf[32];
+    if (len == 0 || len >= sizeof(buf) || str[0] == '-' || str[0] == '+') {
+        return EINVAL;
+    }
+    memcpy(buf, str, len);
+    buf[len] = '\0';
+    char *end;
+    double v = strtod(buf, &end);
+    if (*end != '\0' || !(v >= 0 && v < 1e9)) {
+        return EINVAL;
+    }
+    *value = v;
+    return 0;
+}
+
+int PlatypusJobLimitsParse(const char *str, PlatypusJobLimits *limits) {
+    PlatypusJobLimits parsed;
+    memset(&parsed, 0, sizeof(parsed));
+    
+    const char *p = str;
+    while (*p) {
+        const char *end = strchr(p, ',');
+        if (end == NULL) {
+            end = p + strlen(p);
+        }
+        const char *sep = memchr(p, '=', (size_t)(end - p));
+        if (sep == NULL) {
+            return EINVAL;
+        }
+        size_t nameLen = (size_t)(sep - p);
+        const char *value = sep + 1;
+        size_t valueLen = (size_t)(end - value);
+        
+        int err;
+        if (nameLen == 7 && strncmp(p, "timeout", 7) == 0) {
+            err = ParseSeconds(value, valueLen, &parsed.timeout);
+        }
+        else if (nameLen == 3 && strncmp(p, "cpu", 3) == 0) {
+            err = ParseInteger(value, valueLen, &parsed.cpuTime);
+        }
+        else if (nameLen == 6 && strncmp(p, "memory", 6) == 0) {
+            uint64_t megabytes = 0;
+            err = ParseInteger(value, valueLen, &megabytes);
+            if (err == 0 && megabytes > UINT64_MAX / BYTES_PER_MEGABYTE) {
+                err = EINVAL;
+            }
+            parsed.memory = megabytes * BYTES_PER_MEGABYTE;
+        }
+        else if (nameLen == 5 && strncmp(p, "files", 5) == 0) {
+            err = ParseInteger(value, valueLen, &parsed.openFiles);
+        }
+        else {
+            err = EINVAL;
+        }
+        if (err) {
+            return err;
+        }
+        
+        // No empty items, e.g. a trailing comma
+        if (*end == ',' && end[1] == '\0') {
+            return EINVAL;
+        }
+        p = (*end == ',') ? end + 1 : end;
+    }
+    
+    *limits = parsed;
+    return 0;
+}
+
+int PlatypusJobLimitsFormat(const PlatypusJobLimits *limits, char *buf, size_t size) {
+    char items[4][40];
+    int count = 0;
+    if (limits->timeout > 0) {
+        snprintf(items[count++], sizeof(items[0]), "timeout=%g", limits->timeout);
+    }
+    if (limits->cpuTime) {
+        snprintf(items[count++], sizeof(items[0]), "cpu=%llu", (unsigned long long)limits->cpuTime);
+    }
+    if (limits->memory) {
+        snprintf(items[count++], sizeof(items[0]), "memory=%llu", (unsigned long long)(limits->memory / BYTES_PER_MEGABYTE));
+    }
+    if (limits->openFiles) {
+        snprintf(items[count++], sizeof(items[0]), "files=%llu", (unsigned long long)limits->openFiles);
+    }
+    switch (count) {
+        case 0:
+            return snprintf(buf, size, "%s", "");
+        case 1:
+            return snprintf(buf, size, "%s", items[0]);
+        case 2:
+            return snprintf(buf, size, "%s,%s", items[0], items[1]);
+        case 3:
+            return snprintf(buf, size, "%s,%s,%s", items[0], items[1], items[2]);
+        default:
+            return snprintf(buf, size, "%s,%s,%s,%s", items[0], items[1], items[2], items[3]);
+    }
+}
+
+int PlatypusJobLimitsAny(const PlatypusJobLimits *limits) {
+    return limits->timeout > 0 || PlatypusJobLimitsAnyResource(limits);
+}
+
+int PlatypusJobLimitsAnyResource(const PlatypusJobLimits *limits) {
+    return limits->cpuTime || limits->memory || limits->openFiles;
+}
+
+static uint64_t Stricter(uint64_t a, uint64_t b) {
+    if (a == 0 || (b != 0 && b < a)) {
+        return b;
+    }
+    return a;
+}
+
+void PlatypusJobLimitsCombine(PlatypusJobLimits *limits, const PlatypusJobLimits *other) {
+    if (limits->timeout <= 0 || (other->timeout > 0 && other->timeout < limits->timeout)) {
+        limits->timeout = other->timeout;
+    }
+    limits->cpuTime = Stricter(limits->cpuTime, other->cpuTime);
+    limits->memory = Stricter(limits->memory, other->memory);
+    limits->openFiles = Stricter(limits->openFiles, other->openFiles);
+}
+
+static int Limit(int resource, uint64_t soft, uint64_t hard) {
+    struct rlimit rl;
+    if (getrlimit(resource, &rl) == -1) {
+        return errno;
+    }
+    if (rl.rlim_max != RLIM_INFINITY && hard > (uint64_t)rl.rlim_max) {
+        hard = rl.rlim_max;
+    }
+    rl.rlim_max = (rlim_t)hard;
+    rl.rlim_cur = (rlim_t)(soft < hard ? soft : hard);
+    return (setrlimit(resource, &rl) == -1) ? errno : 0;
+}
+
+int PlatypusJobLimitsApply(const PlatypusJobLimits *limits) {
+    int err = 0;
+    // Exceeding the soft limit sends SIGXCPU, which terminates the process
+    // unless handled, and the hard limit SIGKILL
+    if (limits->cpuTime && !err) {
+        err = Limit(RLIMIT_CPU, limits->cpuTime, limits->cpuTime + PLATYPUS_JOB_LIMITS_CPU_GRACE);
+    }
+    if (limits->memory && !err) {
+        err = Limit(RLIMIT_AS, limits->memory, limits->memory);
+    }
+    if (limits->openFiles && !err) {
+        err = Limit(RLIMIT_NOFILE, limits->openFiles, limits->openFiles);
+    }
+    return err;
+}
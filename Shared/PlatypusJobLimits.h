@@ -0,0 +1,89 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Limits on the resources a job's script may use.
+//
+// Limits are written as a comma-separated list of name=value pairs, e.g.
+//
+//     timeout=600,cpu=300,memory=2048,files=256
+//
+// for a wall-clock timeout and CPU time in seconds, address space in
+// megabytes and a number of open files. Limits left out, or set to 0, don't
+// apply. The timeout is enforced by ScriptExec, which terminates jobs that
+// run for too long. The others are resource limits (see setrlimit(2)), set
+// in the job's process before the interpreter starts, so they are inherited
+// by any processes the script launches.
+
+#ifndef PLATYPUS_JOB_LIMITS_H
+#define PLATYPUS_JOB_LIMITS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Seconds between a process reaching its CPU time limit, when it is sent
+// SIGXCPU, and being killed
+#define PLATYPUS_JOB_LIMITS_CPU_GRACE   5
+
+// Large enough for any string written by PlatypusJobLimitsFormat
+#define PLATYPUS_JOB_LIMITS_MAX_LENGTH  160
+
+typedef struct PlatypusJobLimits {
+    double timeout;         // Seconds
+    uint64_t cpuTime;       // Seconds
+    uint64_t memory;        // Bytes of address space
+    uint64_t openFiles;
+} PlatypusJobLimits;
+
+// Returns 0 on success or EINVAL if the string is malformed, in which case
+// limits is left unchanged. An empty string sets no limits.
+int PlatypusJobLimitsParse(const char *str, PlatypusJobLimits *limits);
+// Writes limits in the form parsed, as snprintf
+int PlatypusJobLimitsFormat(const PlatypusJobLimits *limits, char *buf, size_t size);
+// Nonzero if any limit is set
+int PlatypusJobLimitsAny(const PlatypusJobLimits *limits);
+// Nonzero if any resource limit is set, i.e. any limit but the timeout
+int PlatypusJobLimitsAnyResource(const PlatypusJobLimits *limits);
+// Tightens limits to the stricter of each limit in the two
+void PlatypusJobLimitsCombine(PlatypusJobLimits *limits, const PlatypusJobLimits *other);
+
+// Sets the resource limits for the current process. Limits can only be
+// lowered, never raised above the current hard limit. Returns 0 on success
+// or an errno value.
+int PlatypusJobLimitsApply(const PlatypusJobLimits *limits);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,221 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "PlatypusJobProtocol.h"
+
+#define FIELD_HEADER_SIZE 5
+
+static void WriteUInt32(uint8_t *p, uint32_t value) {
+    p[0] = (uint8_t)(value >> 24);
+    p[1] = (uint8_t)(value >> 16);
+    p[2] = (uint8_t)(value >> 8);
+    p[3] = (uint8_t)value;
+}
+
+static uint32_t ReadUInt32(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+#pragma mark - Buffer
+
+void PlatypusJobBufferInit(PlatypusJobBuffer *buffer) {
+    memset(buffer, 0, sizeof(PlatypusJobBuffer));
+}
+
+void PlatypusJobBufferFree(PlatypusJobBuffer *buffer) {
+    free(buffer->bytes);
+    memset(buffer, 0, sizeof(PlatypusJobBuffer));
+}
+
+static int Reserve(PlatypusJobBuffer *buffer, size_t length) {
+    if (buffer->failed) {
+        return 0;
+    }
+    if (buffer->capacity - buffer->length >= length) {
+        return 1;
+    }
+    size_t capacity = buffer->capacity ? buffer->capacity : 4096;
+    while (capacity - buffer->length < length) {
+        if (capacity > SIZE_MAX / 2) {
+            buffer->failed = 1;
+            return 0;
+        }
+        capacity *= 2;
+    }
+    uint8_t *bytes = realloc(buffer->bytes, capacity);
+    if (bytes == NULL) {
+        buffer->failed = 1;
+        return 0;
+    }
+    buffer->bytes = bytes;
+    buffer->capacity = capacity;
+    return 1;
+}
+
+static void Append(PlatypusJobBuffer *buffer, const void *bytes, size_t length) {
+    if (length && Reserve(buffer, length)) {
+        memcpy(buffer->bytes + buffer->length, bytes, length);
+        buffer->length += length;
+    }
+}
+
+void PlatypusJobBufferConsume(PlatypusJobBuffer *buffer, size_t length) {
+    if (length >= buffer->length) {
+        buffer->length = 0;
+    } else {
+        memmove(buffer->bytes, buffer->bytes + length, buffer->length - length);
+        buffer->length -= length;
+    }
+    buffer->frameStart = buffer->length;
+}
+
+#pragma mark - Writing
+
+void PlatypusJobFrameBegin(PlatypusJobBuffer *buffer, PlatypusJobFrameType type) {
+    uint8_t header[PLATYPUS_JOB_FRAME_HEADER_SIZE] = { 0, 0, 0, 0, (uint8_t)type };
+    buffer->failed = 0;
+    buffer->frameStart = buffer->length;
+    Append(buffer, header, sizeof(header));
+}
+
+void PlatypusJobFrameAddField(PlatypusJobBuffer *buffer, PlatypusJobField field, const void *bytes, size_t length) {
+    if (length > PLATYPUS_JOB_FRAME_MAX_SIZE) {
+        buffer->failed = 1;
+        return;
+    }
+    uint8_t header[FIELD_HEADER_SIZE];
+    header[0] = (uint8_t)field;
+    WriteUInt32(header + 1, (uint32_t)length);
+    Append(buffer, header, sizeof(header));
+    Append(buffer, bytes, length);
+}
+
+void PlatypusJobFrameAddString(PlatypusJobBuffer *buffer, PlatypusJobField field, const char *str) {
+    PlatypusJobFrameAddField(buffer, field, str, strlen(str));
+}
+
+void PlatypusJobFrameAddUInt32(PlatypusJobBuffer *buffer, PlatypusJobField field, uint32_t value) {
+    uint8_t bytes[4];
+    WriteUInt32(bytes, value);
+    PlatypusJobFrameAddField(buffer, field, bytes, sizeof(bytes));
+}
+
+int PlatypusJobFrameEnd(PlatypusJobBuffer *buffer) {
+    int err = 0;
+    size_t length = buffer->length - buffer->frameStart;
+    if (buffer->failed) {
+        err = ENOMEM;
+    } else if (length - 4 > PLATYPUS_JOB_FRAME_MAX_SIZE) {
+        err = EMSGSIZE;
+    }
+    if (err) {
+        buffer->length = buffer->frameStart;
+        buffer->failed = 0;
+        return err;
+    }
+    WriteUInt32(buffer->bytes + buffer->frameStart, (uint32_t)(length - 4));
+    buffer->frameStart = buffer->length;
+    return 0;
+}
+
+#pragma mark - Reading
+
+void PlatypusJobReaderInit(PlatypusJobReader *reader) {
+    PlatypusJobBufferInit(&reader->buffer);
+    reader->offset = 0;
+}
+
+void PlatypusJobReaderFree(PlatypusJobReader *reader) {
+    PlatypusJobBufferFree(&reader->buffer);
+    reader->offset = 0;
+}
+
+int PlatypusJobReaderAppend(PlatypusJobReader *reader, const void *bytes, size_t length) {
+    // Frames already returned are dropped here, rather than in
+    // PlatypusJobReaderNext(), so that they stay valid until now
+    if (reader->offset) {
+        PlatypusJobBufferConsume(&reader->buffer, reader->offset);
+        reader->offset = 0;
+    }
+    Append(&reader->buffer, bytes, length);
+    if (reader->buffer.failed) {
+        reader->buffer.failed = 0;
+        return ENOMEM;
+    }
+    return 0;
+}
+
+int PlatypusJobReaderNext(PlatypusJobReader *reader, PlatypusJobFrame *frame) {
+    const uint8_t *bytes = reader->buffer.bytes + reader->offset;
+    size_t available = reader->buffer.length - reader->offset;
+    if (available < 4) {
+        return 0;
+    }
+    uint32_t length = ReadUInt32(bytes);
+    if (length == 0 || length > PLATYPUS_JOB_FRAME_MAX_SIZE) {
+        return -1;
+    }
+    if (available - 4 < length) {
+        return 0;
+    }
+    frame->type = (PlatypusJobFrameType)bytes[4];
+    frame->payload = bytes + PLATYPUS_JOB_FRAME_HEADER_SIZE;
+    frame->length = length - 1;
+    reader->offset += 4 + (size_t)length;
+    return 1;
+}
+
+int PlatypusJobFrameNextField(const PlatypusJobFrame *frame, size_t *offset,
+                              PlatypusJobField *field, const uint8_t **value, size_t *length) {
+    if (*offset == frame->length) {
+        return 0;
+    }
+    if (frame->length - *offset < FIELD_HEADER_SIZE) {
+        return -1;
+    }
+    const uint8_t *p = frame->payload + *offset;
+    uint32_t fieldLength = ReadUInt32(p + 1);
+    if (frame->length - *offset - FIELD_HEADER_SIZE < fieldLength) {
+        return -1;
+    }
+    *field = (PlatypusJobField)p[0];
+    *value = p + FIELD_HEADER_SIZE;
+    *length = fieldLength;
+    *offset += FIELD_HEADER_SIZE + (size_t)fieldLength;
+    return 1;
+}
+
+uint32_t PlatypusJobFieldUInt32(const uint8_t *value, size_t length) {
+    return length == 4 ? ReadUInt32(value) : 0;
+}
@@ -0,0 +1,147 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Wire format for submitting jobs to a running app over its job server socket.
+//
+// Both directions are a stream of frames:
+//
+//     uint32  length      big-endian, of type and payload
+//     uint8   type
+//     ...     payload     a sequence of fields
+//
+// and each field is
+//
+//     uint8   tag
+//     uint32  length      big-endian
+//     ...     value
+//
+// Unknown fields are skipped, so fields can be added without breaking older
+// peers. A client may send any number of Submit frames without waiting for
+// replies. The server numbers submissions on a connection from 1, in the
+// order it receives them, and tags each reply with that sequence number.
+// Every submission gets either Accepted or Rejected, and accepted jobs get a
+// Finished frame once they have run, preceded by Output frames if the client
+// asked for output to be streamed.
+
+#ifndef PLATYPUS_JOB_PROTOCOL_H
+#define PLATYPUS_JOB_PROTOCOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PLATYPUS_JOB_SOCKET_NAME        "Jobs.sock"
+#define PLATYPUS_JOB_FRAME_HEADER_SIZE  5
+#define PLATYPUS_JOB_FRAME_MAX_SIZE     (16 * 1024 * 1024)
+
+typedef enum PlatypusJobFrameType {
+    // Client to server
+    PlatypusJobFrame_Submit = 1,    // Argument*, Input, Priority, Metadata*, StreamOutput, Limits
+    // Server to client
+    PlatypusJobFrame_Accepted,      // Sequence
+    PlatypusJobFrame_Rejected,      // Sequence, Message
+    PlatypusJobFrame_Output,        // Sequence, Data
+    PlatypusJobFrame_Finished       // Sequence, Status
+} PlatypusJobFrameType;
+
+typedef enum PlatypusJobField {
+    PlatypusJobField_Argument = 1,  // string, repeatable
+    PlatypusJobField_Input,         // bytes for the script's standard input
+    PlatypusJobField_Priority,      // int32: -1 low, 0 normal, 1 high
+    PlatypusJobField_Metadata,      // "KEY=value" string, repeatable
+    PlatypusJobField_StreamOutput,  // uint32: nonzero to receive Output frames
+    PlatypusJobField_Sequence,      // uint32
+    PlatypusJobField_Message,       // string
+    PlatypusJobField_Data,          // bytes
+    PlatypusJobField_Status,        // int32 exit status, -1 if the job didn't run to completion
+    PlatypusJobField_Limits         // string, see PlatypusJobLimits.h
+} PlatypusJobField;
+
+// Growable buffer that frames are appended to. Any number of frames can be
+// built into the same buffer, e.g. to send a batch with a single write().
+// Allocation failure is sticky, and reported by PlatypusJobFrameEnd().
+typedef struct PlatypusJobBuffer {
+    uint8_t *bytes;
+    size_t length;
+    size_t capacity;
+    size_t frameStart;
+    int failed;
+} PlatypusJobBuffer;
+
+void PlatypusJobBufferInit(PlatypusJobBuffer *buffer);
+void PlatypusJobBufferFree(PlatypusJobBuffer *buffer);
+// Discards the first 'length' bytes, e.g. once they have been written
+void PlatypusJobBufferConsume(PlatypusJobBuffer *buffer, size_t length);
+
+void PlatypusJobFrameBegin(PlatypusJobBuffer *buffer, PlatypusJobFrameType type);
+void PlatypusJobFrameAddField(PlatypusJobBuffer *buffer, PlatypusJobField field, const void *bytes, size_t length);
+void PlatypusJobFrameAddString(PlatypusJobBuffer *buffer, PlatypusJobField field, const char *str);
+void PlatypusJobFrameAddUInt32(PlatypusJobBuffer *buffer, PlatypusJobField field, uint32_t value);
+// Returns 0 on success, ENOMEM if an allocation failed or EMSGSIZE if the
+// frame exceeds PLATYPUS_JOB_FRAME_MAX_SIZE. The frame is discarded on failure.
+int PlatypusJobFrameEnd(PlatypusJobBuffer *buffer);
+
+// Frame in a reader's buffer. Valid until the reader is next appended to.
+typedef struct PlatypusJobFrame {
+    PlatypusJobFrameType type;
+    const uint8_t *payload;
+    size_t length;
+} PlatypusJobFrame;
+
+// Splits a byte stream into frames, however it arrives
+typedef struct PlatypusJobReader {
+    PlatypusJobBuffer buffer;
+    size_t offset;
+} PlatypusJobReader;
+
+void PlatypusJobReaderInit(PlatypusJobReader *reader);
+void PlatypusJobReaderFree(PlatypusJobReader *reader);
+// Returns 0 on success or ENOMEM
+int PlatypusJobReaderAppend(PlatypusJobReader *reader, const void *bytes, size_t length);
+// Returns 1 and fills in frame if a complete frame is available, 0 if more
+// data is needed, or -1 if the stream is malformed (an oversized or empty
+// frame), in which case the connection should be dropped.
+int PlatypusJobReaderNext(PlatypusJobReader *reader, PlatypusJobFrame *frame);
+
+// Iterates over the fields of a frame. Start with *offset set to 0.
+// Returns 1 for each field, 0 at the end, or -1 if the payload is malformed.
+int PlatypusJobFrameNextField(const PlatypusJobFrame *frame, size_t *offset,
+                              PlatypusJobField *field, const uint8_t **value, size_t *length);
+// Values of the wrong size read as 0
+uint32_t PlatypusJobFieldUInt32(const uint8_t *value, size_t length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,410 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "PlatypusMachO.h"
+
+#define FAT_MAGIC           0xcafebabeU
+#define FAT_MAGIC_64        0xcafebabfU
+#define MH_MAGIC            0xfeedfaceU
+#define MH_MAGIC_64         0xfeedfacfU
+#define MH_CIGAM            0xcefaedfeU
+#define MH_CIGAM_64         0xcffaedfeU
+
+#define FAT_HEADER_SIZE     8
+#define FAT_ARCH_SIZE       20
+#define FAT_ARCH_64_SIZE    32
+
+// Capability bits in the high byte of a CPU subtype, e.g. the pointer
+// authentication ABI version of arm64e, don't change the architecture
+#define CPU_SUBTYPE_MASK    0xff000000U
+
+// Largest slice alignment lipo produces
+#define MAX_ALIGN           15
+
+static const struct {
+    const char *name;
+    int32_t cpuType;
+    int32_t cpuSubtype;
+} architectures[] = {
+    { "i386",       7,              3 },
+    { "x86_64",     0x01000007,     3 },
+    { "x86_64h",    0x01000007,     8 },
+    { "arm64",      0x0100000c,     0 },
+    { "arm64e",     0x0100000c,     2 },
+    { "arm64_32",   0x0200000c,     1 },
+    { "armv7",      12,             9 },
+    { "armv7s",     12,             11 },
+    { "ppc",        18,             0 },
+    { "ppc64",      0x01000012,     0 },
+};
+
+#define ARCHITECTURE_COUNT  (sizeof(architectures) / sizeof(architectures[0]))
+
+static uint32_t ReadBig32(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static uint64_t ReadBig64(const uint8_t *p) {
+    return ((uint64_t)ReadBig32(p) << 32) | ReadBig32(p + 4);
+}
+
+static uint32_t ReadLittle32(const uint8_t *p) {
+    return ((uint32_t)p[3] << 24) | ((uint32_t)p[2] << 16) | ((uint32_t)p[1] << 8) | p[0];
+}
+
+static void WriteBig32(uint8_t *p, uint32_t v) {
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+static void WriteBig64(uint8_t *p, uint64_t v) {
+    WriteBig32(p, (uint32_t)(v >> 32));
+    WriteBig32(p + 4, (uint32_t)v);
+}
+
+const char *PlatypusMachOArchitectureName(int32_t cpuType, int32_t cpuSubtype) {
+    int32_t subtype = (int32_t)((uint32_t)cpuSubtype & ~CPU_SUBTYPE_MASK);
+    for (size_t i = 0; i < ARCHITECTURE_COUNT; i++) {
+        if (architectures[i].cpuType == cpuType && architectures[i].cpuSubtype == subtype) {
+            return architectures[i].name;
+        }
+    }
+    return NULL;
+}
+
+int PlatypusMachOArchitectureIsKnown(const char *name) {
+    for (size_t i = 0; name && i < ARCHITECTURE_COUNT; i++) {
+        if (strcmp(architectures[i].name, name) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Reads the CPU type of a plain Mach-O binary, whichever its byte order
+static int ReadMachOHeader(const uint8_t *p, size_t size, PlatypusMachOSlice *slice) {
+    if (size < 12) {
+        return EINVAL;
+    }
+    uint32_t magic = ReadBig32(p);
+    if (magic == MH_MAGIC || magic == MH_MAGIC_64) {
+        slice->cpuType = (int32_t)ReadBig32(p + 4);
+        slice->cpuSubtype = (int32_t)ReadBig32(p + 8);
+    } else if (magic == MH_CIGAM || magic == MH_CIGAM_64) {
+        slice->cpuType = (int32_t)ReadLittle32(p + 4);
+        slice->cpuSubtype = (int32_t)ReadLittle32(p + 8);
+    } else {
+        return EINVAL;
+    }
+    slice->offset = 0;
+    slice->size = size;
+    slice->align = 0;
+    return 0;
+}
+
+int PlatypusMachOSlices(const void *data, size_t size,
+                        PlatypusMachOSlice *slices, size_t max, size_t *count, int *isFat) {
+    const uint8_t *p = data;
+    *count = 0;
+    *isFat = 0;
+    if (size < FAT_HEADER_SIZE) {
+        return EINVAL;
+    }
+    
+    uint32_t magic = ReadBig32(p);
+    if (magic != FAT_MAGIC && magic != FAT_MAGIC_64) {
+        if (max < 1) {
+            return E2BIG;
+        }
+        int err = ReadMachOHeader(p, size, &slices[0]);
+        if (err == 0) {
+            *count = 1;
+        }
+        return err;
+    }
+    
+    // Java class files share the fat magic, but their version number in
+    // place of the slice count is always larger than any real slice count
+    uint32_t n = ReadBig32(p + 4);
+    size_t archSize = (magic == FAT_MAGIC_64) ? FAT_ARCH_64_SIZE : FAT_ARCH_SIZE;
+    if (n == 0 || n > PLATYPUS_MACHO_MAX_SLICES) {
+        return EINVAL;
+    }
+    size_t headerSize = FAT_HEADER_SIZE + n * archSize;
+    if (headerSize > size) {
+        return EINVAL;
+    }
+    if (n > max) {
+        return E2BIG;
+    }
+    
+    for (uint32_t i = 0; i < n; i++) {
+        const uint8_t *a = p + FAT_HEADER_SIZE + i * archSize;
+        PlatypusMachOSlice *slice = &slices[i];
+        slice->cpuType = (int32_t)ReadBig32(a);
+        slice->cpuSubtype = (int32_t)ReadBig32(a + 4);
+        if (magic == FAT_MAGIC_64) {
+            slice->offset = ReadBig64(a + 8);
+            slice->size = ReadBig64(a + 16);
+            slice->align = ReadBig32(a + 24);
+        } else {
+            slice->offset = ReadBig32(a + 8);
+            slice->size = ReadBig32(a + 12);
+            slice->align = ReadBig32(a + 16);
+        }
+        if (slice->align > MAX_ALIGN ||
+            slice->offset < headerSize || slice->offset > size ||
+            slice->size == 0 || slice->size > size - slice->offset) {
+            return EINVAL;
+        }
+        // Slices must not overlap
+        for (uint32_t j = 0; j < i; j++) {
+            if (slice->offset < slices[j].offset + slices[j].size &&
+                slices[j].offset < slice->offset + slice->size) {
+                return EINVAL;
+            }
+        }
+    }
+    *count = n;
+    *isFat = 1;
+    return 0;
+}
+
+int PlatypusMachOThin(const void *data, size_t size,
+                      const char *const *archs, size_t archCount,
+                      void **thinned, size_t *thinnedSize) {
+    *thinned = NULL;
+    *thinnedSize = 0;
+    if (archCount == 0 || archCount > PLATYPUS_MACHO_MAX_SLICES) {
+        return EINVAL;
+    }
+    for (size_t i = 0; i < archCount; i++) {
+        if (!PlatypusMachOArchitectureIsKnown(archs[i])) {
+            return EINVAL;
+        }
+    }
+    
+    PlatypusMachOSlice slices[PLATYPUS_MACHO_MAX_SLICES];
+    size_t count;
+    int isFat;
+    int err = PlatypusMachOSlices(data, size, slices, PLATYPUS_MACHO_MAX_SLICES, &count, &isFat);
+    if (err) {
+        return err;
+    }
+    
+    // Pick the slices to keep, in the order they're in now
+    PlatypusMachOSlice kept[PLATYPUS_MACHO_MAX_SLICES];
+    size_t keptCount = 0;
+    for (size_t i = 0; i < count; i++) {
+        const char *name = PlatypusMachOArchitectureName(slices[i].cpuType, slices[i].cpuSubtype);
+        for (size_t j = 0; name && j < archCount; j++) {
+            if (strcmp(name, archs[j]) == 0) {
+                kept[keptCount++] = slices[i];
+                break;
+            }
+        }
+    }
+    // Every architecture asked for must be there
+    for (size_t j = 0; j < archCount; j++) {
+        int found = 0;
+        for (size_t i = 0; i < keptCount && !found; i++) {
+            const char *name = PlatypusMachOArchitectureName(kept[i].cpuType, kept[i].cpuSubtype);
+            found = (strcmp(name, archs[j]) == 0);
+        }
+        if (!found) {
+            return ENOENT;
+        }
+    }
+    
+    // A single architecture is just its slice
+    if (keptCount == 1) {
+        *thinned = malloc(kept[0].size ? kept[0].size : 1);
+        if (*thinned == NULL) {
+            return ENOMEM;
+        }
+        memcpy(*thinned, (const uint8_t *)data + kept[0].offset, kept[0].size);
+        *thinnedSize = kept[0].size;
+        return 0;
+    }
+    
+    // Otherwise, lay the slices out again after a new header, each at its
+    // alignment
+    uint32_t magic = ReadBig32(data);
+    size_t archSize = (magic == FAT_MAGIC_64) ? FAT_ARCH_64_SIZE : FAT_ARCH_SIZE;
+    uint64_t offsets[PLATYPUS_MACHO_MAX_SLICES];
+    uint64_t end = FAT_HEADER_SIZE + keptCount * archSize;
+    for (size_t i = 0; i < keptCount; i++) {
+        uint64_t alignment = (uint64_t)1 << kept[i].align;
+        offsets[i] = (end + alignment - 1) & ~(alignment - 1);
+        end = offsets[i] + kept[i].size;
+    }
+    if (magic == FAT_MAGIC && end > UINT32_MAX) {
+        return EFBIG;
+    }
+    if (end > SIZE_MAX) {
+        return ENOMEM;
+    }
+    
+    uint8_t *out = calloc(1, (size_t)end);
+    if (out == NULL) {
+        return ENOMEM;
+    }
+    WriteBig32(out, magic);
+    WriteBig32(out + 4, (uint32_t)keptCount);
+    for (size_t i = 0; i < keptCount; i++) {
+        uint8_t *a = out + FAT_HEADER_SIZE + i * archSize;
+        WriteBig32(a, (uint32_t)kept[i].cpuType);
+        WriteBig32(a + 4, (uint32_t)kept[i].cpuSubtype);
+        if (magic == FAT_MAGIC_64) {
+            WriteBig64(a + 8, offsets[i]);
+            WriteBig64(a + 16, kept[i].size);
+            WriteBig32(a + 24, kept[i].align);
+        } else {
+            WriteBig32(a + 8, (uint32_t)offsets[i]);
+            WriteBig32(a + 12, (uint32_t)kept[i].size);
+            WriteBig32(a + 16, kept[i].align);
+        }
+        memcpy(out + offsets[i], (const uint8_t *)data + kept[i].offset, kept[i].size);
+    }
+    *thinned = out;
+    *thinnedSize = (size_t)end;
+    return 0;
+}
+
+static int ReadFile(const char *path, uint8_t **data, size_t *size, mode_t *mode) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return errno;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        int err = errno;
+        close(fd);
+        return err;
+    }
+    *mode = st.st_mode & 07777;
+    *size = (size_t)st.st_size;
+    *data = malloc(*size ? *size : 1);
+    if (*data == NULL) {
+        close(fd);
+        return ENOMEM;
+    }
+    size_t done = 0;
+    while (done < *size) {
+        ssize_t n = read(fd, *data + done, *size - done);
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            int err = (n == 0) ? EIO : errno;
+            free(*data);
+            *data = NULL;
+            close(fd);
+            return err;
+        }
+        done += (size_t)n;
+    }
+    close(fd);
+    return 0;
+}
+
+// Writes to a temporary file next to path, then renames it over path
+static int ReplaceFile(const char *path, const uint8_t *data, size_t size, mode_t mode) {
+    char tmpPath[PATH_MAX];
+    if (snprintf(tmpPath, sizeof(tmpPath), "%s.thinning-XXXXXX", path) >= (int)sizeof(tmpPath)) {
+        return ENAMETOOLONG;
+    }
+    int fd = mkstemp(tmpPath);
+    if (fd == -1) {
+        return errno;
+    }
+    int err = 0;
+    size_t done = 0;
+    while (done < size && err == 0) {
+        ssize_t n = write(fd, data + done, size - done);
+        if (n == -1) {
+            if (errno != EINTR) {
+                err = errno;
+            }
+            continue;
+        }
+        done += (size_t)n;
+    }
+    if (err == 0 && fchmod(fd, mode) == -1) {
+        err = errno;
+    }
+    if (close(fd) == -1 && err == 0) {
+        err = errno;
+    }
+    if (err == 0 && rename(tmpPath, path) == -1) {
+        err = errno;
+    }
+    if (err) {
+        unlink(tmpPath);
+    }
+    return err;
+}
+
+int PlatypusMachOThinFile(const char *path, const char *const *archs, size_t archCount, size_t *removed) {
+    if (removed) {
+        *removed = 0;
+    }
+    uint8_t *data = NULL;
+    size_t size = 0;
+    mode_t mode = 0;
+    int err = ReadFile(path, &data, &size, &mode);
+    if (err) {
+        return err;
+    }
+    
+    void *thinned;
+    size_t thinnedSize;
+    err = PlatypusMachOThin(data, size, archs, archCount, &thinned, &thinnedSize);
+    if (err == 0 && (thinnedSize != size || memcmp(thinned, data, size) != 0)) {
+        err = ReplaceFile(path, thinned, thinnedSize, mode);
+        if (err == 0 && removed && thinnedSize < size) {
+            *removed = size - thinnedSize;
+        }
+    }
+    free(thinned);
+    free(data);
+    return err;
+}
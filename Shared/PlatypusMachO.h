@@ -0,0 +1,95 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Thinning Mach-O universal ("fat") binaries.
+//
+// The ScriptExec binary copied into every app contains code for each
+// architecture it was built for. Apps that only need to run on some of them
+// can have the other architecture slices removed, as "lipo -extract" and
+// "lipo -thin" do. Keeping a single architecture leaves a plain Mach-O
+// binary, keeping several leaves a fat binary with just those slices. Each
+// slice carries its own code signature, so signatures stay valid.
+//
+// A fat binary starts with a big-endian header, followed by one entry per
+// slice giving its CPU type and subtype, offset, size and alignment (a power
+// of two). Slices are copied as-is. This parser doesn't depend on the
+// <mach-o/*.h> headers. Portable C, runs on macOS and Linux.
+
+#ifndef PLATYPUS_MACHO_H
+#define PLATYPUS_MACHO_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PLATYPUS_MACHO_MAX_SLICES   16
+
+typedef struct PlatypusMachOSlice {
+    int32_t cpuType;
+    int32_t cpuSubtype;
+    uint64_t offset;
+    uint64_t size;
+    uint32_t align;     // log2 of the alignment
+} PlatypusMachOSlice;
+
+// Name of an architecture as used by lipo and clang's -arch option, e.g.
+// "arm64", or NULL if it's not one this parser knows about.
+const char *PlatypusMachOArchitectureName(int32_t cpuType, int32_t cpuSubtype);
+// Non-zero if an architecture name is known.
+int PlatypusMachOArchitectureIsKnown(const char *name);
+
+// Lists the architecture slices of a binary. A plain Mach-O binary has a
+// single slice spanning all of it, and *isFat unset. Returns 0 on success,
+// EINVAL if the data isn't a Mach-O binary or is malformed, or E2BIG if it
+// has more than max slices.
+int PlatypusMachOSlices(const void *data, size_t size,
+                        PlatypusMachOSlice *slices, size_t max, size_t *count, int *isFat);
+
+// Extracts the slices for the named architectures into a newly allocated
+// binary, to be freed by the caller. Returns 0 on success, ENOENT if any of
+// the architectures is missing, EINVAL if an architecture name is unknown
+// or the data malformed, or another errno value.
+int PlatypusMachOThin(const void *data, size_t size,
+                      const char *const *archs, size_t archCount,
+                      void **thinned, size_t *thinnedSize);
+
+// As above, replacing the binary at path with the thinned one. The file is
+// left untouched if nothing would be removed. *removed, if not NULL, is set
+// to the number of bytes saved.
+int PlatypusMachOThinFile(const char *path, const char *const *archs, size_t archCount, size_t *removed);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,381 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "PlatypusScriptSniffer.h"
+
+#pragma mark - Encoding and binary detection
+
+static PlatypusScriptEncoding DetectByteOrderMark(const uint8_t *b, size_t len, size_t *bomLength) {
+    // UTF-32LE must be checked before UTF-16LE, since they share a prefix
+    if (len >= 4 && b[0] == 0xFF && b[1] == 0xFE && b[2] == 0x00 && b[3] == 0x00) {
+        *bomLength = 4;
+        return PlatypusScriptEncoding_UTF32LE;
+    }
+    if (len >= 4 && b[0] == 0x00 && b[1] == 0x00 && b[2] == 0xFE && b[3] == 0xFF) {
+        *bomLength = 4;
+        return PlatypusScriptEncoding_UTF32BE;
+    }
+    if (len >= 3 && b[0] == 0xEF && b[1] == 0xBB && b[2] == 0xBF) {
+        *bomLength = 3;
+        return PlatypusScriptEncoding_UTF8;
+    }
+    if (len >= 2 && b[0] == 0xFF && b[1] == 0xFE) {
+        *bomLength = 2;
+        return PlatypusScriptEncoding_UTF16LE;
+    }
+    if (len >= 2 && b[0] == 0xFE && b[1] == 0xFF) {
+        *bomLength = 2;
+        return PlatypusScriptEncoding_UTF16BE;
+    }
+    *bomLength = 0;
+    return PlatypusScriptEncoding_Unknown;
+}
+
+// Narrow UTF-16/32 text to bytes so it can be inspected like the other
+// encodings. Characters outside ASCII become '?', which is good enough
+// for finding the shebang line and control characters.
+static size_t NarrowWideText(const uint8_t *src, size_t len, PlatypusScriptEncoding enc, uint8_t *dst) {
+    size_t unit = (enc == PlatypusScriptEncoding_UTF16LE || enc == PlatypusScriptEncoding_UTF16BE) ? 2 : 4;
+    int bigEndian = (enc == PlatypusScriptEncoding_UTF16BE || enc == PlatypusScriptEncoding_UTF32BE);
+    size_t n = 0;
+    
+    for (size_t i = 0; i + unit <= len; i += unit) {
+        uint32_t c = 0;
+        for (size_t j = 0; j < unit; j++) {
+            size_t k = bigEndian ? j : unit - 1 - j;
+            c = (c << 8) | src[i + k];
+        }
+        dst[n++] = (c < 0x80) ? (uint8_t)c : '?';
+    }
+    return n;
+}
+
+// Text files don't contain NUL bytes and only a few kinds of control characters
+static int LooksBinary(const uint8_t *b, size_t len) {
+    size_t suspicious = 0;
+    for (size_t i = 0; i < len; i++) {
+        uint8_t c = b[i];
+        if (c == 0) {
+            return 1;
+        }
+        if ((c < 0x20 && c != '\t' && c != '\n' && c != '\r' && c != '\f' &&
+             c != '\v' && c != '\b' && c != 0x1B) || c == 0x7F) {
+            suspicious++;
+        }
+    }
+    return suspicious * 10 > len;
+}
+
+#pragma mark - Shebang parsing
+
+static int IsBlank(char c) {
+    return c == ' ' || c == '\t';
+}
+
+static const char *BaseName(const char *path) {
+    const char *slash = strrchr(path, '/');
+    return slash ? slash + 1 : path;
+}
+
+typedef struct Tokenizer {
+    const char *r;      // Read position in shebang line
+    const char *end;
+    char *w;            // Write position in result storage
+    char *wend;
+    PlatypusScriptSniffResult *result;
+} Tokenizer;
+
+static int BeginToken(Tokenizer *t) {
+    if (t->result->argc >= PLATYPUS_SNIFF_MAX_ARGS || t->w >= t->wend) {
+        return 0;
+    }
+    t->result->argv[t->result->argc++] = t->w;
+    return 1;
+}
+
+static void Put(Tokenizer *t, char c) {
+    if (t->w < t->wend) {
+        *t->w++ = c;
+    }
+}
+
+static void EndToken(Tokenizer *t) {
+    // Storage holds one byte more than wend allows for, so there's always room
+    *t->w++ = '\0';
+}
+
+// Empty tokens only result from quotes, so drop any others
+static void EndSplitToken(Tokenizer *t, int quoted) {
+    if (!quoted && t->w == t->result->argv[t->result->argc - 1]) {
+        t->result->argc--;
+        return;
+    }
+    EndToken(t);
+}
+
+static char EscapedChar(char c) {
+    switch (c) {
+        case 'f': return '\f';
+        case 'n': return '\n';
+        case 'r': return '\r';
+        case 't': return '\t';
+        case 'v': return '\v';
+        default: return c;
+    }
+}
+
+// Split a string the way env -S does, honouring single and double quotes,
+// backslash escapes and # comments. Variable substitution isn't performed.
+static void SplitEnvString(Tokenizer *t) {
+    while (t->r < t->end) {
+        while (t->r < t->end && IsBlank(*t->r)) {
+            t->r++;
+        }
+        if (t->r >= t->end || *t->r == '#') {
+            return;
+        }
+        if (!BeginToken(t)) {
+            return;
+        }
+        
+        char quote = 0;
+        int quoted = 0;
+        while (t->r < t->end) {
+            char c = *t->r++;
+            if (quote == 0 && IsBlank(c)) {
+                break;
+            }
+            if (quote == 0 && (c == '\'' || c == '"')) {
+                quote = c;
+                quoted = 1;
+                continue;
+            }
+            if (quote && c == quote) {
+                quote = 0;
+                continue;
+            }
+            if (c != '\\' || t->r >= t->end) {
+                Put(t, c);
+                continue;
+            }
+            
+            char e = *t->r++;
+            if (quote == '\'') {
+                // Only \\ and \' are escapes within single quotes
+                if (e != '\\' && e != '\'') {
+                    Put(t, '\\');
+                }
+                Put(t, e);
+            } else if (e == 'c') {
+                // \c ends the string
+                EndSplitToken(t, quoted);
+                t->r = t->end;
+                return;
+            } else if (e == '_') {
+                // \_ is a blank within double quotes and a separator outside them
+                if (quote) {
+                    Put(t, ' ');
+                } else {
+                    break;
+                }
+            } else {
+                Put(t, EscapedChar(e));
+            }
+        }
+        EndSplitToken(t, quoted);
+    }
+}
+
+static int IsSplitStringOption(const char *arg, size_t len) {
+    return (len >= 2 && arg[0] == '-' && arg[1] == 'S') ||
+           (len >= 14 && strncmp(arg, "--split-string", 14) == 0);
+}
+
+static void TokenizeShebang(const char *line, size_t len, PlatypusScriptSniffResult *result) {
+    Tokenizer t = { line, line + len, result->storage, result->storage + PLATYPUS_SNIFF_MAX_BYTES, result };
+    
+    while (t.r < t.end) {
+        while (t.r < t.end && IsBlank(*t.r)) {
+            t.r++;
+        }
+        if (t.r >= t.end) {
+            break;
+        }
+        
+        const char *start = t.r;
+        while (t.r < t.end && !IsBlank(*t.r)) {
+            t.r++;
+        }
+        size_t tokenLen = (size_t)(t.r - start);
+        
+        // env's split string option, either as "-S string" or "-Sstring"
+        if (result->argc > 0 && strcmp(BaseName(result->argv[0]), "env") == 0 &&
+            IsSplitStringOption(start, tokenLen)) {
+            const char *rest = start + 2;
+            if (start[1] == '-') {
+                rest = start + 14;
+                if (rest < t.r && *rest == '=') {
+                    rest++;
+                }
+            }
+            if (!BeginToken(&t)) {
+                return;
+            }
+            for (const char *p = start; p < start + tokenLen && p < rest && *p != '='; p++) {
+                Put(&t, *p);
+            }
+            EndToken(&t);
+            t.r = rest;
+            SplitEnvString(&t);
+            return;
+        }
+        
+        if (!BeginToken(&t)) {
+            return;
+        }
+        for (const char *p = start; p < start + tokenLen; p++) {
+            Put(&t, *p);
+        }
+        EndToken(&t);
+    }
+}
+
+// Find the command that env runs, skipping its options and NAME=VALUE assignments
+static int EnvCommandIndex(const PlatypusScriptSniffResult *result) {
+    int i = 1;
+    while (i < result->argc) {
+        const char *arg = result->argv[i];
+        if (strcmp(arg, "--") == 0) {
+            i++;
+            break;
+        }
+        if (arg[0] == '-') {
+            // Options that take a separate argument
+            if (strcmp(arg, "-u") == 0 || strcmp(arg, "-P") == 0 || strcmp(arg, "-C") == 0 ||
+                strcmp(arg, "--unset") == 0 || strcmp(arg, "--chdir") == 0) {
+                i++;
+            }
+            i++;
+            continue;
+        }
+        if (arg[0] != '=' && strchr(arg, '=') != NULL) {
+            i++;
+            continue;
+        }
+        break;
+    }
+    return (i < result->argc) ? i : -1;
+}
+
+#pragma mark - Sniffing
+
+void PlatypusScriptSniffBuffer(const void *bytes, size_t length, PlatypusScriptSniffResult *result) {
+    memset(result, 0, offsetof(PlatypusScriptSniffResult, storage));
+    result->storage[0] = '\0';
+    result->commandIndex = -1;
+    
+    if (length > PLATYPUS_SNIFF_MAX_BYTES) {
+        length = PLATYPUS_SNIFF_MAX_BYTES;
+    }
+    result->bytesRead = length;
+    
+    const uint8_t *b = bytes;
+    size_t bomLength;
+    result->encoding = DetectByteOrderMark(b, length, &bomLength);
+    b += bomLength;
+    length -= bomLength;
+    
+    uint8_t narrowed[PLATYPUS_SNIFF_MAX_BYTES];
+    if (result->encoding != PlatypusScriptEncoding_Unknown && result->encoding != PlatypusScriptEncoding_UTF8) {
+        length = NarrowWideText(b, length, result->encoding, narrowed);
+        b = narrowed;
+    }
+    
+    result->isBinary = LooksBinary(b, length);
+    if (result->isBinary || length < 2 || b[0] != '#' || b[1] != '!') {
+        return;
+    }
+    result->hasShebang = 1;
+    
+    const char *line = (const char *)b + 2;
+    const char *newline = memchr(line, '\n', length - 2);
+    size_t lineLen;
+    if (newline) {
+        lineLen = (size_t)(newline - line);
+    } else {
+        lineLen = length - 2;
+        result->shebangTruncated = (result->bytesRead == PLATYPUS_SNIFF_MAX_BYTES);
+    }
+    if (lineLen && line[lineLen - 1] == '\r') {
+        lineLen--;
+    }
+    
+    TokenizeShebang(line, lineLen, result);
+    
+    if (result->argc > 0) {
+        int isEnv = (strcmp(BaseName(result->argv[0]), "env") == 0);
+        result->commandIndex = isEnv ? EnvCommandIndex(result) : 0;
+    }
+}
+
+int PlatypusScriptSniffFile(const char *path, PlatypusScriptSniffResult *result) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return errno;
+    }
+    
+    uint8_t buf[PLATYPUS_SNIFF_MAX_BYTES];
+    size_t total = 0;
+    while (total < sizeof(buf)) {
+        ssize_t n = read(fd, buf + total, sizeof(buf) - total);
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n == -1) {
+            int err = errno;
+            close(fd);
+            return err;
+        }
+        if (n == 0) {
+            break;
+        }
+        total += (size_t)n;
+    }
+    close(fd);
+    
+    PlatypusScriptSniffBuffer(buf, total, result);
+    return 0;
+}
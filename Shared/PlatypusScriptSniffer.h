@@ -0,0 +1,88 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Script sniffer.
+//
+// Inspects at most the first PLATYPUS_SNIFF_MAX_BYTES of a file to determine whether
+// it looks like a script: whether it is text or binary, which text encoding it uses
+// (going by its byte order mark) and what interpreter and arguments its shebang line
+// specifies. Only a single bounded read is done, so sniffing is cheap regardless of
+// file size. Portable C with no Cocoa dependencies.
+
+#ifndef PLATYPUS_SCRIPT_SNIFFER_H
+#define PLATYPUS_SCRIPT_SNIFFER_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PLATYPUS_SNIFF_MAX_BYTES    4096
+#define PLATYPUS_SNIFF_MAX_ARGS     64
+
+typedef enum PlatypusScriptEncoding {
+    PlatypusScriptEncoding_Unknown = 0, // No byte order mark
+    PlatypusScriptEncoding_UTF8,
+    PlatypusScriptEncoding_UTF16LE,
+    PlatypusScriptEncoding_UTF16BE,
+    PlatypusScriptEncoding_UTF32LE,
+    PlatypusScriptEncoding_UTF32BE
+} PlatypusScriptEncoding;
+
+typedef struct PlatypusScriptSniffResult {
+    size_t bytesRead;
+    PlatypusScriptEncoding encoding;
+    int isBinary;
+    int hasShebang;
+    // Set if the shebang line didn't end within the bytes read
+    int shebangTruncated;
+    // Shebang line split into interpreter and arguments. For /usr/bin/env
+    // shebangs the interpreter remains env and the command it runs is
+    // argv[commandIndex], following any env options and NAME=VALUE
+    // assignments. The -S option's string is split as env does it, honouring
+    // quotes and backslash escapes. commandIndex is 0 for other interpreters
+    // and -1 if there is no shebang line or env is given no command.
+    int argc;
+    const char *argv[PLATYPUS_SNIFF_MAX_ARGS];
+    int commandIndex;
+    // Backing storage for argv
+    char storage[PLATYPUS_SNIFF_MAX_BYTES + 1];
+} PlatypusScriptSniffResult;
+
+// Returns 0 on success, otherwise an errno value
+int PlatypusScriptSniffFile(const char *path, PlatypusScriptSniffResult *result);
+void PlatypusScriptSniffBuffer(const void *bytes, size_t length, PlatypusScriptSniffResult *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -36,6 +36,8 @@
 + (NSArray <NSDictionary *> *)interpreters;
 + (NSArray <NSString *> *)interpreterDisplayNames;
 + (NSArray <NSString *> *)interpreterPaths;
++ (NSDictionary *)interpreterInfoForPath:(NSString *)path;
++ (NSDictionary *)interpreterInfoForDisplayName:(NSString *)displayName;
 
 + (NSString *)helloWorldProgramForDisplayName:(NSString *)displayName;
 
@@ -44,6 +46,7 @@
 
 + (NSArray <NSString *> *)interpreterArgsForInterpreterPath:(NSString *)path;
 + (NSArray <NSString *> *)scriptArgsForInterpreterPath:(NSString *)path;
++ (NSArray <NSString *> *)precompileArgsForInterpreterPath:(NSString *)path;
 
 + (NSString *)interpreterPathForFilenameSuffix:(NSString *)fileName;
 + (NSString *)standardFilenameSuffixForInterpreterPath:(NSString *)interpreter;
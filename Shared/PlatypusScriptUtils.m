@@ -32,10 +32,21 @@
 //  for the script file types handled by Platypus.
 
 #import "PlatypusScriptUtils.h"
+#import "PlatypusSyntaxChecker.h"
+#import "PlatypusScriptSniffer.h"
 
 @implementation PlatypusScriptUtils
 
 + (NSArray <NSDictionary *> *)interpreters {
+    static NSArray *interpreters;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        interpreters = [self interpreterTable];
+    });
+    return interpreters;
+}
+
++ (NSArray <NSDictionary *> *)interpreterTable {
     return @[
              @{ @"Name":        @"sh",
                 @"Path":        @"/bin/sh",
@@ -88,7 +99,8 @@
                 @"Path":        @"/usr/bin/python3",
                 @"Hello":       @"print(\"Hello, World\")",
                 @"Suffixes":    @[@".py", @".python"],
-                @"SyntaxCheck": @[@"-m", @"py_compile"] },
+                @"SyntaxCheck": @[@"-m", @"py_compile"],
+                @"Precompile":  @[@"-m", @"compileall", @"-q", @"-j", @"0", @"--invalidation-mode", @"checked-hash"] },
              
              @{ @"Name":        @"Ruby",
                 @"Path":        @"/usr/bin/ruby",
@@ -149,6 +161,35 @@
 
 #pragma mark -
 
+// Interpreter info dictionaries keyed by value of given key. First entry wins.
++ (NSDictionary <NSString *, NSDictionary *> *)interpreterIndexForKey:(NSString *)key {
+    NSMutableDictionary *index = [NSMutableDictionary dictionary];
+    for (NSDictionary *infoDict in [self interpreters]) {
+        if (index[infoDict[key]] == nil) {
+            index[infoDict[key]] = infoDict;
+        }
+    }
+    return [index copy];
+}
+
++ (NSDictionary *)interpreterInfoForPath:(NSString *)path {
+    static NSDictionary *byPath;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        byPath = [self interpreterIndexForKey:@"Path"];
+    });
+    return path ? byPath[path] : nil;
+}
+
++ (NSDictionary *)interpreterInfoForDisplayName:(NSString *)displayName {
+    static NSDictionary *byName;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        byName = [self interpreterIndexForKey:@"Name"];
+    });
+    return displayName ? byName[displayName] : nil;
+}
+
 + (NSArray <NSString *> *)arrayOfInterpreterValuesForKey:(NSString *)key {
     NSArray *interpreters = [self interpreters];
     NSMutableArray *arr = [NSMutableArray array];
@@ -169,53 +210,33 @@
 #pragma mark - Mapping
 
 + (NSString *)interpreterPathForDisplayName:(NSString *)displayName {
-    NSArray <NSDictionary *> *interpreters = [self interpreters];
-    for (NSDictionary *infoDict in interpreters) {
-        if ([infoDict[@"Name"] isEqualToString:displayName]) {
-            return infoDict[@"Path"];
-        }
-    }
-    return @"";
+    NSString *path = [self interpreterInfoForDisplayName:displayName][@"Path"];
+    return path ? path : @"";
 }
 
 + (NSArray <NSString *> *)interpreterArgsForInterpreterPath:(NSString *)path {
-    NSArray <NSDictionary *> *interpreters = [self interpreters];
-    for (NSDictionary *infoDict in interpreters) {
-        if ([infoDict[@"Path"] isEqualToString:path]) {
-            return infoDict[@"Args"];
-        }
-    }
-    return nil;
+    return [self interpreterInfoForPath:path][@"Args"];
 }
 
 + (NSArray <NSString *> *)scriptArgsForInterpreterPath:(NSString *)path {
-    NSArray <NSDictionary *> *interpreters = [self interpreters];
-    for (NSDictionary *infoDict in interpreters) {
-        if ([infoDict[@"Path"] isEqualToString:path]) {
-            return infoDict[@"ScriptArgs"];
-        }
-    }
-    return nil;
+    return [self interpreterInfoForPath:path][@"ScriptArgs"];
+}
+
+// Arguments making the interpreter compile the sources in the folder given
+// after them to bytecode it loads at runtime, for interpreters with a bytecode
+// cache that is checked against the sources' hashes
++ (NSArray <NSString *> *)precompileArgsForInterpreterPath:(NSString *)path {
+    return [self interpreterInfoForPath:path][@"Precompile"];
 }
 
 + (NSString *)displayNameForInterpreterPath:(NSString *)interpreterPath {
-    NSArray <NSDictionary *> *interpreters = [self interpreters];
-    for (NSDictionary *infoDict in interpreters) {
-        if ([infoDict[@"Path"] isEqualToString:interpreterPath]) {
-            return infoDict[@"Name"];
-        }
-    }
-    return @"Other...";
+    NSString *name = [self interpreterInfoForPath:interpreterPath][@"Name"];
+    return name ? name : @"Other...";
 }
 
 + (NSString *)helloWorldProgramForDisplayName:(NSString *)displayName {
-    NSArray <NSDictionary *> *interpreters = [self interpreters];
-    for (NSDictionary *infoDict in interpreters) {
-        if ([infoDict[@"Name"] isEqualToString:displayName]) {
-            return infoDict[@"Hello"];
-        }
-    }
-    return @"";
+    NSString *hello = [self interpreterInfoForDisplayName:displayName][@"Hello"];
+    return hello ? hello : @"";
 }
 
 #pragma mark - File suffixes
@@ -234,13 +255,8 @@
 }
 
 + (NSString *)standardFilenameSuffixForInterpreterPath:(NSString *)interpreterPath {
-    NSArray <NSDictionary *> *interpreters = [self interpreters];
-    for (NSDictionary *infoDict in interpreters) {
-        if ([infoDict[@"Path"] isEqualToString:interpreterPath]) {
-            return [infoDict[@"Suffixes"] firstObject];
-        }
-    }
-    return @"";
+    NSDictionary *infoDict = [self interpreterInfoForPath:interpreterPath];
+    return infoDict ? [infoDict[@"Suffixes"] firstObject] : @"";
 }
 
 #pragma mark - Script file convenience methods
@@ -254,55 +270,46 @@
     if ([FILEMGR isExecutableFileAtPath:path]) {
         return YES;
     }
-    if ([WORKSPACE type:[WORKSPACE typeOfFile:path error:nil] conformsToType:(NSString *)kUTTypePlainText]) {
-        return YES;
-    }
-    if ([PlatypusScriptUtils hasShebangLineAtPath:path]) {
-        return YES;
+    
+    // Sniff the start of the file. Only ask Launch Services
+    // if the file is empty or can't be read.
+    PlatypusScriptSniffResult sniff;
+    if (PlatypusScriptSniffFile([path fileSystemRepresentation], &sniff) == 0 && sniff.bytesRead > 0) {
+        return sniff.hasShebang || !sniff.isBinary;
     }
-    return NO;
+    return [WORKSPACE type:[WORKSPACE typeOfFile:path error:nil] conformsToType:(NSString *)kUTTypePlainText];
 }
 
 + (BOOL)hasShebangLineAtPath:(NSString *)path {
-    if (![FILEMGR isReadableFileAtPath:path]) {
-        DLog(@"Unable to read file %@", path);
+    PlatypusScriptSniffResult sniff;
+    int err = PlatypusScriptSniffFile([path fileSystemRepresentation], &sniff);
+    if (err) {
+        DLog(@"Unable to read file %@: %s", path, strerror(err));
         return NO;
     }
-    
-    FILE *file;
-    unsigned char buf[2];
-    file = fopen([path fileSystemRepresentation], "r");
-    fread(buf, 1, 2, file);
-    fclose(file);
-    
-    return (buf[0] == '#' && buf[1] == '!');
+    return sniff.hasShebang;
 }
 
 + (NSArray <NSString *> *)parseInterpreterInScriptFile:(NSString *)path {
     
-    // Read script text
-    NSString *script = [NSString stringWithContentsOfFile:path
-                                                 encoding:DEFAULT_TEXT_ENCODING
-                                                    error:nil];
-    if (script == nil || [script length] == 0) {
+    // Only the start of the script is read
+    PlatypusScriptSniffResult sniff;
+    if (PlatypusScriptSniffFile([path fileSystemRepresentation], &sniff) != 0 || sniff.argc == 0) {
         return @[@""];
     }
     
-    // Split into lines
-    NSArray *lines = [script componentsSeparatedByString:@"\n"];
-    NSString *firstLine = lines[0];
-
-    // Inspect first line. If shorter than 2 chars, it can't possibly be a shebang line
-    if ([firstLine length] <= 2 || ([[firstLine substringToIndex:2] isEqualToString:@"#!"] == NO)) {
-        return @[@""];
+    // Interpreter followed by its arguments. For /usr/bin/env,
+    // env remains the interpreter with the command as an argument.
+    NSMutableArray *interpreterAndArgs = [NSMutableArray array];
+    for (int i = 0; i < sniff.argc; i++) {
+        NSString *arg = @(sniff.argv[i]);
+        if (arg == nil) {
+            // Not valid UTF-8
+            return @[@""];
+        }
+        [interpreterAndArgs addObject:arg];
     }
     
-    NSString *interpreterCmd = [firstLine substringFromIndex:2];
-    
-    // Get everything that follows after the #!
-    // Separate it by whitespaces, in order not to get also the params to the interpreter
-    NSMutableArray *interpreterAndArgs = [[interpreterCmd componentsSeparatedByString:@" "] mutableCopy];
-    
     // If shebang interpreter is not an absolute path, then check if
     // the binary name is the same as one of our preset interpreters
     NSString *parsedPath = interpreterAndArgs[0];
@@ -315,17 +322,6 @@
         }
     }
     
-    // Remove all empty strings in array
-    for (NSInteger i = [interpreterAndArgs count]-1; i > 0; i--) {
-        NSCharacterSet *set = [NSCharacterSet whitespaceCharacterSet];
-        NSString *trimmedStr = [interpreterAndArgs[i] stringByTrimmingCharactersInSet:set];
-        
-        if ([trimmedStr isEqualToString:@""]) {
-            [interpreterAndArgs removeObjectAtIndex:i];
-        } else {
-            interpreterAndArgs[i] = trimmedStr;
-        }
-    }
     // Array w. interpreter path + arguments
     return interpreterAndArgs;
 }
@@ -370,55 +366,9 @@
 #pragma mark - Syntax checking
 
 + (NSString *)checkSyntaxOfFile:(NSString *)scriptPath usingInterpreterAtPath:(NSString *)suggestedInterpreter {
-    if ([FILEMGR fileExistsAtPath:scriptPath] == NO) {
-        return [NSString stringWithFormat:@"File does not exist"];
-    }
-    
-    NSString *interpreterPath = suggestedInterpreter;
-    
-    if (interpreterPath == nil || [interpreterPath isEqualToString:@""]) {
-        interpreterPath = [self determineInterpreterPathForScriptFile:scriptPath];
-        
-        if (interpreterPath == nil || [interpreterPath isEqualToString:@""]) {
-            return @"Unable to determine script interpreter";
-        }
-    }
-    
-    //let's see if the script type is supported for syntax checking
-    //if so, we set up the task's launch path as the script interpreter and set the relevant flags and arguments
-    NSMutableArray *args = nil;
-    NSArray *interpreters = [self interpreters];
-    for (NSDictionary *dict in interpreters) {
-        if ([dict[@"Path"] isEqualToString:interpreterPath] && dict[@"SyntaxCheck"]) {
-            args = [NSMutableArray arrayWithArray:dict[@"SyntaxCheck"]];
-            interpreterPath = dict[@"SyntaxCheckBinary"] ? dict[@"SyntaxCheckBinary"] : interpreterPath;
-        }
-    }
-    if (args == nil) {
-        return [NSString stringWithFormat:@"Syntax Checking is not supported for interpreter %@", interpreterPath];
-    }
-    [args addObject:scriptPath];
-    
-    NSTask *task = [[NSTask alloc] init];
-    [task setLaunchPath:interpreterPath];
-    [task setArguments:args];
-    NSPipe *outputPipe = [NSPipe pipe];
-    [task setStandardOutput:outputPipe];
-    [task setStandardError:outputPipe];
-    NSFileHandle *readHandle = [outputPipe fileHandleForReading];
-    
-    //launch task
-    [task launch];
-    [task waitUntilExit];
-    
-    //get output in string
-    NSString *outputStr = [[NSString alloc] initWithData:[readHandle readDataToEndOfFile] encoding:DEFAULT_TEXT_ENCODING];
-
-    //if the syntax report string is empty --> no complaints, so we report syntax as OK
-    outputStr = [outputStr length] ? outputStr : @"Syntax OK";
-    outputStr = [NSString stringWithFormat:@"%@", outputStr];
-
-    return outputStr;
+    PlatypusSyntaxCheckResult *result = [[[PlatypusSyntaxChecker sharedChecker] resultsOfCheckingFiles:@[scriptPath]
+                                                                                 usingInterpreterAtPath:suggestedInterpreter] firstObject];
+    return [result report];
 }
 
 @end
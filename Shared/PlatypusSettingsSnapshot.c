@@ -0,0 +1,468 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+#include "PlatypusSettingsSnapshot.h"
+
+// Reads the whole file, which is a small property list, to get its CRC-32
+static int ChecksumFile(int fd, uint32_t *checksum) {
+    uLong crc = crc32(0L, Z_NULL, 0);
+    uint8_t buffer[16384];
+    ssize_t n;
+    while ((n = read(fd, buffer, sizeof(buffer))) != 0) {
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno;
+        }
+        crc = crc32(crc, buffer, (uInt)n);
+    }
+    *checksum = (uint32_t)crc;
+    return 0;
+}
+
+#pragma mark - Loading
+
+static int ValidateStringRef(const uint8_t *bytes, size_t size, PlatypusSnapshotRef ref) {
+    if (ref.offset == 0) {
+        return ref.length == 0;
+    }
+    if (ref.offset < sizeof(PlatypusSnapshotHeader) || (uint64_t)ref.offset + ref.length + 1 > size) {
+        return 0;
+    }
+    return bytes[ref.offset + ref.length] == '\0';
+}
+
+static int ValidateSnapshot(const uint8_t *bytes, size_t size) {
+    if (size < sizeof(PlatypusSnapshotHeader)) {
+        return 0;
+    }
+    const PlatypusSnapshotHeader *h = (const PlatypusSnapshotHeader *)bytes;
+    if (h->magic != PLATYPUS_SNAPSHOT_MAGIC ||
+        h->version != PLATYPUS_SNAPSHOT_VERSION ||
+        h->headerSize != sizeof(PlatypusSnapshotHeader) ||
+        h->totalSize != size) {
+        return 0;
+    }
+    
+    for (int i = 0; i < PlatypusSnapshotString_Count; i++) {
+        if (!ValidateStringRef(bytes, size, h->strings[i])) {
+            return 0;
+        }
+    }
+    
+    for (int i = 0; i < PlatypusSnapshotList_Count; i++) {
+        PlatypusSnapshotRef list = h->lists[i];
+        if (list.offset == 0) {
+            if (list.length != 0) {
+                return 0;
+            }
+            continue;
+        }
+        if (list.offset < sizeof(PlatypusSnapshotHeader) ||
+            list.offset % sizeof(uint32_t) != 0 ||
+            (uint64_t)list.offset + (uint64_t)list.length * sizeof(PlatypusSnapshotRef) > size) {
+            return 0;
+        }
+        const PlatypusSnapshotRef *items = (const PlatypusSnapshotRef *)(bytes + list.offset);
+        for (uint32_t j = 0; j < list.length; j++) {
+            if (items[j].offset == 0 || !ValidateStringRef(bytes, size, items[j])) {
+                return 0;
+            }
+        }
+    }
+    
+    for (int i = 0; i < PlatypusSnapshotBlob_Count; i++) {
+        PlatypusSnapshotRef blob = h->blobs[i];
+        if (blob.offset == 0) {
+            if (blob.length != 0) {
+                return 0;
+            }
+            continue;
+        }
+        if (blob.offset < sizeof(PlatypusSnapshotHeader) || (uint64_t)blob.offset + blob.length > size) {
+            return 0;
+        }
+    }
+    
+    return 1;
+}
+
+static int AdoptBuffer(void *buffer, size_t size, PlatypusSnapshot *snapshot) {
+    if (!ValidateSnapshot(buffer, size)) {
+        free(buffer);
+        return EINVAL;
+    }
+    snapshot->buffer = buffer;
+    snapshot->size = size;
+    snapshot->header = buffer;
+    return 0;
+}
+
+int PlatypusSnapshotLoad(const char *path, PlatypusSnapshot *snapshot) {
+    memset(snapshot, 0, sizeof(PlatypusSnapshot));
+    
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return errno;
+    }
+    
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        int err = errno;
+        close(fd);
+        return err;
+    }
+    if (st.st_size < (off_t)sizeof(PlatypusSnapshotHeader) || st.st_size > PLATYPUS_SNAPSHOT_MAX_SIZE) {
+        close(fd);
+        return EINVAL;
+    }
+    
+    size_t size = (size_t)st.st_size;
+    uint8_t *buffer = malloc(size);
+    if (buffer == NULL) {
+        close(fd);
+        return ENOMEM;
+    }
+    
+    // The whole file is normally delivered by the first read
+    size_t total = 0;
+    while (total < size) {
+        ssize_t n = read(fd, buffer + total, size - total);
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            int err = (n == 0) ? EINVAL : errno;
+            free(buffer);
+            close(fd);
+            return err;
+        }
+        total += (size_t)n;
+    }
+    close(fd);
+    
+    return AdoptBuffer(buffer, size, snapshot);
+}
+
+int PlatypusSnapshotLoadFromBuffer(const void *bytes, size_t size, PlatypusSnapshot *snapshot) {
+    memset(snapshot, 0, sizeof(PlatypusSnapshot));
+    if (size < sizeof(PlatypusSnapshotHeader) || size > PLATYPUS_SNAPSHOT_MAX_SIZE) {
+        return EINVAL;
+    }
+    // Copy, since the caller's buffer isn't necessarily suitably aligned
+    void *buffer = malloc(size);
+    if (buffer == NULL) {
+        return ENOMEM;
+    }
+    memcpy(buffer, bytes, size);
+    return AdoptBuffer(buffer, size, snapshot);
+}
+
+void PlatypusSnapshotUnload(PlatypusSnapshot *snapshot) {
+    free(snapshot->buffer);
+    memset(snapshot, 0, sizeof(PlatypusSnapshot));
+}
+
+int PlatypusSnapshotMatchesSource(const PlatypusSnapshot *snapshot, const char *sourcePath) {
+    int fd = open(sourcePath, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return errno == ENOENT;
+    }
+    const PlatypusSnapshotHeader *h = snapshot->header;
+    struct stat st;
+    uint32_t checksum;
+    // Only read the file when the size leaves any doubt
+    int matches = fstat(fd, &st) == 0 &&
+                  h->sourceSize == (uint64_t)st.st_size &&
+                  ChecksumFile(fd, &checksum) == 0 &&
+                  h->sourceChecksum == checksum;
+    close(fd);
+    return matches;
+}
+
+#pragma mark - Accessors
+
+const char *PlatypusSnapshotGetString(const PlatypusSnapshot *snapshot, PlatypusSnapshotString which) {
+    PlatypusSnapshotRef ref = snapshot->header->strings[which];
+    return ref.offset ? (const char *)snapshot->buffer + ref.offset : NULL;
+}
+
+uint32_t PlatypusSnapshotGetListCount(const PlatypusSnapshot *snapshot, PlatypusSnapshotList which) {
+    return snapshot->header->lists[which].length;
+}
+
+const char *PlatypusSnapshotGetListItem(const PlatypusSnapshot *snapshot, PlatypusSnapshotList which, uint32_t index) {
+    PlatypusSnapshotRef list = snapshot->header->lists[which];
+    if (index >= list.length) {
+        return NULL;
+    }
+    const PlatypusSnapshotRef *items = (const PlatypusSnapshotRef *)((const uint8_t *)snapshot->buffer + list.offset);
+    return (const char *)snapshot->buffer + items[index].offset;
+}
+
+const void *PlatypusSnapshotGetBlob(const PlatypusSnapshot *snapshot, PlatypusSnapshotBlob which, size_t *length) {
+    PlatypusSnapshotRef ref = snapshot->header->blobs[which];
+    if (length) {
+        *length = ref.length;
+    }
+    return ref.offset ? (const uint8_t *)snapshot->buffer + ref.offset : NULL;
+}
+
+uint32_t PlatypusSnapshotRGBFromHexString(const char *hexString) {
+    if (hexString == NULL || hexString[0] == '\0') {
+        return 0;
+    }
+    return (uint32_t)strtoul(hexString + 1, NULL, 16) & 0xFFFFFF;
+}
+
+#pragma mark - Writing
+
+typedef struct RefArray {
+    PlatypusSnapshotRef *refs;
+    uint32_t count;
+    uint32_t capacity;
+} RefArray;
+
+struct PlatypusSnapshotWriter {
+    PlatypusSnapshotHeader header;
+    // Data area, which follows the header in the snapshot image.
+    // Offsets handed out are relative to the start of the image.
+    uint8_t *data;
+    size_t dataLength;
+    size_t dataCapacity;
+    RefArray lists[PlatypusSnapshotList_Count];
+};
+
+PlatypusSnapshotWriter *PlatypusSnapshotWriterCreate(void) {
+    PlatypusSnapshotWriter *writer = calloc(1, sizeof(PlatypusSnapshotWriter));
+    if (writer == NULL) {
+        return NULL;
+    }
+    writer->header.magic = PLATYPUS_SNAPSHOT_MAGIC;
+    writer->header.version = PLATYPUS_SNAPSHOT_VERSION;
+    writer->header.headerSize = sizeof(PlatypusSnapshotHeader);
+    return writer;
+}
+
+void PlatypusSnapshotWriterFree(PlatypusSnapshotWriter *writer) {
+    if (writer == NULL) {
+        return;
+    }
+    for (int i = 0; i < PlatypusSnapshotList_Count; i++) {
+        free(writer->lists[i].refs);
+    }
+    free(writer->data);
+    free(writer);
+}
+
+PlatypusSnapshotHeader *PlatypusSnapshotWriterHeader(PlatypusSnapshotWriter *writer) {
+    return &writer->header;
+}
+
+// Append bytes to data area, returning their offset in the image via 'offset'
+static int AppendData(PlatypusSnapshotWriter *writer, const void *bytes, size_t length, int terminate, uint32_t *offset) {
+    size_t needed = writer->dataLength + length + (terminate ? 1 : 0);
+    if (needed + sizeof(PlatypusSnapshotHeader) > PLATYPUS_SNAPSHOT_MAX_SIZE) {
+        return EFBIG;
+    }
+    if (needed > writer->dataCapacity) {
+        size_t capacity = writer->dataCapacity ? writer->dataCapacity * 2 : 1024;
+        while (capacity < needed) {
+            capacity *= 2;
+        }
+        uint8_t *data = realloc(writer->data, capacity);
+        if (data == NULL) {
+            return ENOMEM;
+        }
+        writer->data = data;
+        writer->dataCapacity = capacity;
+    }
+    *offset = (uint32_t)(sizeof(PlatypusSnapshotHeader) + writer->dataLength);
+    if (length) {
+        memcpy(writer->data + writer->dataLength, bytes, length);
+    }
+    writer->dataLength += length;
+    if (terminate) {
+        writer->data[writer->dataLength++] = '\0';
+    }
+    return 0;
+}
+
+int PlatypusSnapshotWriterSetString(PlatypusSnapshotWriter *writer, PlatypusSnapshotString which, const char *str) {
+    if (str == NULL) {
+        writer->header.strings[which] = (PlatypusSnapshotRef){ 0, 0 };
+        return 0;
+    }
+    uint32_t offset;
+    size_t length = strlen(str);
+    int err = AppendData(writer, str, length, 1, &offset);
+    if (err == 0) {
+        writer->header.strings[which] = (PlatypusSnapshotRef){ offset, (uint32_t)length };
+    }
+    return err;
+}
+
+int PlatypusSnapshotWriterAddListItem(PlatypusSnapshotWriter *writer, PlatypusSnapshotList which, const char *str) {
+    RefArray *list = &writer->lists[which];
+    if (list->count == list->capacity) {
+        uint32_t capacity = list->capacity ? list->capacity * 2 : 8;
+        PlatypusSnapshotRef *refs = realloc(list->refs, capacity * sizeof(PlatypusSnapshotRef));
+        if (refs == NULL) {
+            return ENOMEM;
+        }
+        list->refs = refs;
+        list->capacity = capacity;
+    }
+    uint32_t offset;
+    size_t length = strlen(str);
+    int err = AppendData(writer, str, length, 1, &offset);
+    if (err == 0) {
+        list->refs[list->count++] = (PlatypusSnapshotRef){ offset, (uint32_t)length };
+    }
+    return err;
+}
+
+int PlatypusSnapshotWriterSetBlob(PlatypusSnapshotWriter *writer, PlatypusSnapshotBlob which, const void *bytes, size_t length) {
+    if (bytes == NULL || length == 0) {
+        writer->header.blobs[which] = (PlatypusSnapshotRef){ 0, 0 };
+        return 0;
+    }
+    uint32_t offset;
+    int err = AppendData(writer, bytes, length, 0, &offset);
+    if (err == 0) {
+        writer->header.blobs[which] = (PlatypusSnapshotRef){ offset, (uint32_t)length };
+    }
+    return err;
+}
+
+int PlatypusSnapshotWriterSetSource(PlatypusSnapshotWriter *writer, const char *sourcePath) {
+    int fd = open(sourcePath, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return errno;
+    }
+    struct stat st;
+    uint32_t checksum;
+    int err = fstat(fd, &st) == 0 ? ChecksumFile(fd, &checksum) : errno;
+    close(fd);
+    if (err) {
+        return err;
+    }
+    writer->header.sourceSize = (uint64_t)st.st_size;
+    writer->header.sourceChecksum = checksum;
+    return 0;
+}
+
+void *PlatypusSnapshotWriterCopyBytes(PlatypusSnapshotWriter *writer, size_t *size) {
+    // Layout: header, data area, then 4-byte aligned list reference arrays
+    size_t dataEnd = sizeof(PlatypusSnapshotHeader) + writer->dataLength;
+    size_t listsStart = (dataEnd + 3) & ~(size_t)3;
+    size_t total = listsStart;
+    for (int i = 0; i < PlatypusSnapshotList_Count; i++) {
+        total += writer->lists[i].count * sizeof(PlatypusSnapshotRef);
+    }
+    if (total > PLATYPUS_SNAPSHOT_MAX_SIZE) {
+        errno = EFBIG;
+        return NULL;
+    }
+    
+    uint8_t *bytes = calloc(1, total);
+    if (bytes == NULL) {
+        return NULL;
+    }
+    
+    PlatypusSnapshotHeader *header = (PlatypusSnapshotHeader *)bytes;
+    *header = writer->header;
+    header->totalSize = (uint32_t)total;
+    if (writer->dataLength) {
+        memcpy(bytes + sizeof(PlatypusSnapshotHeader), writer->data, writer->dataLength);
+    }
+    
+    size_t offset = listsStart;
+    for (int i = 0; i < PlatypusSnapshotList_Count; i++) {
+        RefArray *list = &writer->lists[i];
+        if (list->count == 0) {
+            header->lists[i] = (PlatypusSnapshotRef){ 0, 0 };
+            continue;
+        }
+        size_t length = list->count * sizeof(PlatypusSnapshotRef);
+        memcpy(bytes + offset, list->refs, length);
+        header->lists[i] = (PlatypusSnapshotRef){ (uint32_t)offset, list->count };
+        offset += length;
+    }
+    
+    if (size) {
+        *size = total;
+    }
+    return bytes;
+}
+
+int PlatypusSnapshotWriterWriteToFile(PlatypusSnapshotWriter *writer, const char *path) {
+    size_t size;
+    uint8_t *bytes = PlatypusSnapshotWriterCopyBytes(writer, &size);
+    if (bytes == NULL) {
+        return errno ? errno : ENOMEM;
+    }
+    
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1) {
+        int err = errno;
+        free(bytes);
+        return err;
+    }
+    
+    int err = 0;
+    size_t total = 0;
+    while (total < size) {
+        ssize_t n = write(fd, bytes + total, size - total);
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            err = errno;
+            break;
+        }
+        total += (size_t)n;
+    }
+    
+    if (close(fd) == -1 && err == 0) {
+        err = errno;
+    }
+    free(bytes);
+    return err;
+}
@@ -0,0 +1,182 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Precompiled application settings snapshot.
+//
+// Platypus writes AppSettings.bin next to AppSettings.plist when it creates an app.
+// The file is a flat, position-independent image of the settings that ScriptExec
+// needs at launch: a fixed-size header of scalars followed by a string table.
+// All references are byte offsets from the start of the file, so the image can be
+// read into memory with a single read() (or mmap'd) and used in place, without
+// any property list parsing. Values are stored in host byte order. A snapshot with
+// a magic number or version that ScriptExec doesn't recognise is simply ignored,
+// and it falls back to AppSettings.plist.
+//
+// The snapshot records the size and CRC-32 of the AppSettings.plist it was made
+// from. If the property list has since been edited by hand, the two no longer
+// match and ScriptExec uses the property list instead. Copying, zipping or
+// checking the app into git changes modification times but not the contents,
+// so these keep using the snapshot.
+
+#ifndef PLATYPUS_SETTINGS_SNAPSHOT_H
+#define PLATYPUS_SETTINGS_SNAPSHOT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PLATYPUS_SNAPSHOT_MAGIC         0x53505950 // "PYPS"
+#define PLATYPUS_SNAPSHOT_VERSION       13
+#define PLATYPUS_SNAPSHOT_MAX_SIZE      (16 * 1024 * 1024)
+
+// Boolean settings
+typedef enum PlatypusSnapshotFlag {
+    PlatypusSnapshotFlag_RemainRunning              = 1 << 0,
+    PlatypusSnapshotFlag_Droppable                  = 1 << 1,
+    PlatypusSnapshotFlag_SendNotifications          = 1 << 2,
+    PlatypusSnapshotFlag_AcceptFiles                = 1 << 3,
+    PlatypusSnapshotFlag_AcceptText                 = 1 << 4,
+    PlatypusSnapshotFlag_PromptForFile              = 1 << 5,
+    PlatypusSnapshotFlag_StatusItemUseSysfont       = 1 << 6,
+    PlatypusSnapshotFlag_StatusItemIconIsTemplate   = 1 << 7,
+    PlatypusSnapshotFlag_ExecInterpreter            = 1 << 8,
+    PlatypusSnapshotFlag_ControlChannelOnly         = 1 << 9,
+    PlatypusSnapshotFlag_LargeOutputView            = 1 << 10,
+    PlatypusSnapshotFlag_LogOutput                  = 1 << 11,
+    PlatypusSnapshotFlag_PersistentJobQueue         = 1 << 12,
+    PlatypusSnapshotFlag_JobServer                  = 1 << 13,
+    PlatypusSnapshotFlag_PrivilegedHelper           = 1 << 14,
+    PlatypusSnapshotFlag_PrespawnInterpreter        = 1 << 15
+} PlatypusSnapshotFlag;
+
+// String settings
+typedef enum PlatypusSnapshotString {
+    PlatypusSnapshotString_InterpreterPath = 0,
+    PlatypusSnapshotString_TextFont,
+    PlatypusSnapshotString_StatusItemDisplayType,
+    PlatypusSnapshotString_StatusItemTitle,
+    PlatypusSnapshotString_JobLimits,
+    PlatypusSnapshotString_Count
+} PlatypusSnapshotString;
+
+// String list settings
+typedef enum PlatypusSnapshotList {
+    PlatypusSnapshotList_InterpreterArgs = 0,
+    PlatypusSnapshotList_ScriptArgs,
+    PlatypusSnapshotList_Suffixes,
+    PlatypusSnapshotList_Utis,
+    PlatypusSnapshotList_URISchemes,
+    PlatypusSnapshotList_Count
+} PlatypusSnapshotList;
+
+// Binary data settings
+typedef enum PlatypusSnapshotBlob {
+    PlatypusSnapshotBlob_StatusItemIcon = 0,
+    PlatypusSnapshotBlob_Count
+} PlatypusSnapshotBlob;
+
+// Reference to a region of the snapshot. An offset of 0 means the value is absent.
+// For strings, length excludes the terminating NUL, which is always present.
+// For lists, offset points to an array of 'length' string references.
+typedef struct PlatypusSnapshotRef {
+    uint32_t offset;
+    uint32_t length;
+} PlatypusSnapshotRef;
+
+typedef struct PlatypusSnapshotHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t headerSize;
+    uint32_t totalSize;
+    uint32_t flags;
+    int32_t interfaceType;
+    int32_t execStyle;
+    float textSize;
+    uint32_t textColor;             // 0xRRGGBB
+    uint32_t textBackgroundColor;   // 0xRRGGBB
+    uint64_t sourceSize;            // AppSettings.plist the snapshot was made from
+    uint32_t sourceChecksum;        // CRC-32 of its contents
+    uint32_t reserved;
+    PlatypusSnapshotRef strings[PlatypusSnapshotString_Count];
+    PlatypusSnapshotRef lists[PlatypusSnapshotList_Count];
+    PlatypusSnapshotRef blobs[PlatypusSnapshotBlob_Count];
+} PlatypusSnapshotHeader;
+
+// Loaded snapshot. Validated once on load, so accessors do no bounds checking.
+typedef struct PlatypusSnapshot {
+    const PlatypusSnapshotHeader *header;
+    void *buffer;
+    size_t size;
+} PlatypusSnapshot;
+
+// Returns 0 on success, otherwise an errno value (EINVAL for malformed snapshots)
+int PlatypusSnapshotLoad(const char *path, PlatypusSnapshot *snapshot);
+int PlatypusSnapshotLoadFromBuffer(const void *bytes, size_t size, PlatypusSnapshot *snapshot);
+void PlatypusSnapshotUnload(PlatypusSnapshot *snapshot);
+
+// Returns 1 if the file at sourcePath has the size and contents recorded when
+// the snapshot was made, or doesn't exist, otherwise 0. Modification times are
+// not compared since zip, cp and git don't preserve them.
+int PlatypusSnapshotMatchesSource(const PlatypusSnapshot *snapshot, const char *sourcePath);
+
+// Returns NULL if the string is absent
+const char *PlatypusSnapshotGetString(const PlatypusSnapshot *snapshot, PlatypusSnapshotString which);
+uint32_t PlatypusSnapshotGetListCount(const PlatypusSnapshot *snapshot, PlatypusSnapshotList which);
+const char *PlatypusSnapshotGetListItem(const PlatypusSnapshot *snapshot, PlatypusSnapshotList which, uint32_t index);
+const void *PlatypusSnapshotGetBlob(const PlatypusSnapshot *snapshot, PlatypusSnapshotBlob which, size_t *length);
+
+// Parses a "#RRGGBB" color string into 0xRRGGBB. Invalid strings yield 0 (black),
+// which matches +[NSColor colorFromHexString:]
+uint32_t PlatypusSnapshotRGBFromHexString(const char *hexString);
+
+// Builder used by Platypus when creating apps. Scalars are set directly on
+// the header returned by PlatypusSnapshotWriterHeader().
+typedef struct PlatypusSnapshotWriter PlatypusSnapshotWriter;
+
+PlatypusSnapshotWriter *PlatypusSnapshotWriterCreate(void);
+void PlatypusSnapshotWriterFree(PlatypusSnapshotWriter *writer);
+PlatypusSnapshotHeader *PlatypusSnapshotWriterHeader(PlatypusSnapshotWriter *writer);
+int PlatypusSnapshotWriterSetString(PlatypusSnapshotWriter *writer, PlatypusSnapshotString which, const char *str);
+int PlatypusSnapshotWriterAddListItem(PlatypusSnapshotWriter *writer, PlatypusSnapshotList which, const char *str);
+int PlatypusSnapshotWriterSetBlob(PlatypusSnapshotWriter *writer, PlatypusSnapshotBlob which, const void *bytes, size_t length);
+// Records the size and checksum of the file the settings came from
+int PlatypusSnapshotWriterSetSource(PlatypusSnapshotWriter *writer, const char *sourcePath);
+// Caller frees the returned buffer
+void *PlatypusSnapshotWriterCopyBytes(PlatypusSnapshotWriter *writer, size_t *size);
+int PlatypusSnapshotWriterWriteToFile(PlatypusSnapshotWriter *writer, const char *path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
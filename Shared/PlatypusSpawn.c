@@ -0,0 +1,440 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#ifdef __APPLE__
+#include <crt_externs.h>
+#include <sys/event.h>
+#define ENVIRONMENT (*_NSGetEnviron())
+#else
+#include <sys/syscall.h>
+extern char **environ;
+#define ENVIRONMENT environ
+#endif
+
+#include "PlatypusSpawn.h"
+#include "PlatypusClock.h"
+
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 29))
+#define HAVE_ADDCHDIR 1
+#endif
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 34))
+#define HAVE_ADDCLOSEFROM 1
+#endif
+
+#define READ_SIZE           16384
+#define EXIT_POLL_INTERVAL  10000  // usecs, when exit can't be watched
+
+// Milliseconds left until deadline, for poll()
+static int Remaining(double deadline) {
+    if (deadline < 0) {
+        return -1;
+    }
+    double remaining = deadline - PlatypusClockNow();
+    return remaining > 0 ? (int)(remaining * 1000) + 1 : 0;
+}
+
+static int Pipe(int fds[2]) {
+#ifdef __linux__
+    return pipe2(fds, O_CLOEXEC);
+#else
+    if (pipe(fds) == -1) {
+        return -1;
+    }
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+    return 0;
+#endif
+}
+
+#ifdef __APPLE__
+// posix_spawn() can't change directory before macOS 10.15, so have the shell do it
+static char **ChangeDirectoryArguments(const PlatypusSpawnAttributes *attributes) {
+    size_t count = 0;
+    while (attributes->arguments[count]) {
+        count++;
+    }
+    char **args = calloc(count + 5, sizeof(char *));
+    if (args == NULL) {
+        return NULL;
+    }
+    args[0] = "/bin/sh";
+    args[1] = "-c";
+    args[2] = "cd -- \"$0\" && exec \"$@\"";
+    args[3] = (char *)attributes->directory;
+    args[4] = (char *)attributes->path;
+    for (size_t i = 1; i < count; i++) {
+        args[4 + i] = attributes->arguments[i];
+    }
+    return args;
+}
+#endif
+
+static int AddInherit(posix_spawn_file_actions_t *actions, int fd) {
+#ifdef __APPLE__
+    return posix_spawn_file_actions_addinherit_np(actions, fd);
+#else
+    // Clears close-on-exec on the child's copy, the same descriptor
+    // being dup2()ed. Anything below 3 is left open anyway.
+    return posix_spawn_file_actions_adddup2(actions, fd, fd);
+#endif
+}
+
+static int AddFileActions(posix_spawn_file_actions_t *actions, const PlatypusSpawnAttributes *attributes, int *useShell) {
+    int err = 0;
+    for (int i = 0; i < 3 && err == 0; i++) {
+        int fd = attributes->fds[i];
+        if (fd == PLATYPUS_SPAWN_NULL) {
+            err = posix_spawn_file_actions_addopen(actions, i, "/dev/null", i == 0 ? O_RDONLY : O_WRONLY, 0);
+        }
+        else if (fd == i) {
+            err = AddInherit(actions, i);
+        }
+        else if (fd == PLATYPUS_SPAWN_INHERIT) {
+#ifdef __APPLE__
+            err = AddInherit(actions, i);
+#endif
+        }
+        else {
+            err = posix_spawn_file_actions_adddup2(actions, fd, i);
+        }
+    }
+    if (err) {
+        return err;
+    }
+    
+#ifdef HAVE_ADDCLOSEFROM
+    // On macOS, POSIX_SPAWN_CLOEXEC_DEFAULT does this
+    err = posix_spawn_file_actions_addclosefrom_np(actions, 3);
+    if (err) {
+        return err;
+    }
+#endif
+    
+    if (attributes->directory) {
+#if defined(__APPLE__)
+        if (__builtin_available(macOS 10.15, *)) {
+            err = posix_spawn_file_actions_addchdir_np(actions, attributes->directory);
+        } else {
+            *useShell = 1;
+        }
+#elif defined(HAVE_ADDCHDIR)
+        err = posix_spawn_file_actions_addchdir_np(actions, attributes->directory);
+#else
+        err = ENOTSUP;
+#endif
+    }
+    return err;
+}
+
+void PlatypusSpawnAttributesInit(PlatypusSpawnAttributes *attributes, const char *path, char *const *arguments) {
+    memset(attributes, 0, sizeof(PlatypusSpawnAttributes));
+    attributes->path = path;
+    attributes->arguments = arguments;
+    attributes->fds[0] = PLATYPUS_SPAWN_NULL;
+    attributes->fds[1] = PLATYPUS_SPAWN_INHERIT;
+    attributes->fds[2] = PLATYPUS_SPAWN_INHERIT;
+}
+
+int PlatypusSpawn(const PlatypusSpawnAttributes *attributes, pid_t *pid) {
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t attr;
+    int err = posix_spawn_file_actions_init(&actions);
+    if (err) {
+        return err;
+    }
+    err = posix_spawnattr_init(&attr);
+    if (err) {
+        posix_spawn_file_actions_destroy(&actions);
+        return err;
+    }
+    
+    // The child starts out with default signal handling and no signals
+    // blocked, whatever the parent has set up, e.g. SIGPIPE ignored
+    short flags = POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF;
+#ifdef __APPLE__
+    flags |= POSIX_SPAWN_CLOEXEC_DEFAULT;
+#endif
+    if (attributes->processGroup) {
+        flags |= POSIX_SPAWN_SETPGROUP;
+        posix_spawnattr_setpgroup(&attr, 0);
+    }
+    sigset_t signals;
+    sigemptyset(&signals);
+    posix_spawnattr_setsigmask(&attr, &signals);
+    sigfillset(&signals);
+    posix_spawnattr_setsigdefault(&attr, &signals);
+    err = posix_spawnattr_setflags(&attr, flags);
+    
+    int useShell = 0;
+    if (err == 0) {
+        err = AddFileActions(&actions, attributes, &useShell);
+    }
+    
+    if (err == 0) {
+        const char *path = attributes->path;
+        char *const *arguments = attributes->arguments;
+        char **shellArguments = NULL;
+#ifdef __APPLE__
+        if (useShell) {
+            shellArguments = ChangeDirectoryArguments(attributes);
+            if (shellArguments == NULL) {
+                err = ENOMEM;
+            }
+            path = shellArguments ? shellArguments[0] : NULL;
+            arguments = shellArguments;
+        }
+#endif
+        if (err == 0) {
+            char *const *environment = attributes->environment ? attributes->environment : ENVIRONMENT;
+            err = posix_spawn(pid, path, &actions, &attr, arguments, environment);
+        }
+        free(shellArguments);
+    }
+    
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&actions);
+    return err;
+}
+
+int PlatypusSpawnWatch(pid_t pid) {
+#if defined(__APPLE__)
+    // kqueues aren't inherited by child processes, so need no close-on-exec
+    int kq = kqueue();
+    if (kq == -1) {
+        return -1;
+    }
+    struct kevent event;
+    EV_SET(&event, pid, EVFILT_PROC, EV_ADD | EV_ONESHOT, NOTE_EXIT, 0, NULL);
+    if (kevent(kq, &event, 1, NULL, 0, NULL) == -1) {
+        int err = errno;
+        close(kq);
+        errno = err;
+        return -1;
+    }
+    return kq;
+#elif defined(SYS_pidfd_open)
+    // pidfds are always close-on-exec. Fails with ENOSYS before Linux 5.3.
+    return (int)syscall(SYS_pidfd_open, pid, 0);
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+static int WaitUntilReadable(int fd, double deadline) {
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+    while (1) {
+        int n = poll(&pfd, 1, Remaining(deadline));
+        if (n > 0) {
+            return 0;
+        }
+        if (n == 0) {
+            return ETIMEDOUT;
+        }
+        if (errno != EINTR) {
+            return errno;
+        }
+    }
+}
+
+// For systems that can't watch processes. Returns 0 if the child was reaped.
+static int PollForExit(pid_t pid, double deadline, int *status) {
+    while (1) {
+        pid_t result = waitpid(pid, status, WNOHANG);
+        if (result == pid) {
+            return 0;
+        }
+        if (result == -1 && errno != EINTR) {
+            return errno;
+        }
+        if (Remaining(deadline) == 0) {
+            return ETIMEDOUT;
+        }
+        usleep(EXIT_POLL_INTERVAL);
+    }
+}
+
+int PlatypusSpawnWait(pid_t pid, int watch, double timeout, int *status) {
+    if (timeout >= 0) {
+        double deadline = PlatypusClockNow() + timeout;
+        int ownWatch = -1;
+        if (watch == -1) {
+            watch = ownWatch = PlatypusSpawnWatch(pid);
+        }
+        if (watch != -1) {
+            int err = WaitUntilReadable(watch, deadline);
+            if (ownWatch != -1) {
+                close(ownWatch);
+            }
+            if (err) {
+                return err;
+            }
+        }
+        else if (errno != ESRCH) {
+            return PollForExit(pid, deadline, status);
+        }
+    }
+    
+    while (waitpid(pid, status, 0) == -1) {
+        if (errno != EINTR) {
+            return errno;
+        }
+    }
+    return 0;
+}
+
+int PlatypusSpawnExitStatus(int status) {
+    if (WIFSIGNALED(status)) {
+        return WTERMSIG(status);
+    }
+    return WEXITSTATUS(status);
+}
+
+// Reads whatever is available from a non-blocking descriptor
+static int ReadAvailable(int fd, char **buffer, size_t *length, size_t *capacity, int *eof) {
+    while (1) {
+        if (*capacity - *length < READ_SIZE + 1) {
+            size_t newCapacity = *capacity ? *capacity * 2 : READ_SIZE * 2;
+            char *newBuffer = realloc(*buffer, newCapacity);
+            if (newBuffer == NULL) {
+                return ENOMEM;
+            }
+            *buffer = newBuffer;
+            *capacity = newCapacity;
+        }
+        ssize_t n = read(fd, *buffer + *length, READ_SIZE);
+        if (n > 0) {
+            *length += n;
+            continue;
+        }
+        if (n == 0) {
+            *eof = 1;
+            return 0;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : errno;
+    }
+}
+
+int PlatypusSpawnRun(const PlatypusSpawnAttributes *attributes, double timeout,
+                     char **output, size_t *length, int *status) {
+    int fds[2];
+    if (Pipe(fds) == -1) {
+        return errno;
+    }
+    PlatypusSpawnAttributes attrs = *attributes;
+    attrs.fds[1] = fds[1];
+    attrs.fds[2] = fds[1];
+    
+    pid_t pid;
+    int err = PlatypusSpawn(&attrs, &pid);
+    close(fds[1]);
+    if (err) {
+        close(fds[0]);
+        return err;
+    }
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);
+    
+    int watch = PlatypusSpawnWatch(pid);
+    int exited = (watch == -1 && errno == ESRCH);
+    double deadline = (timeout < 0) ? -1 : PlatypusClockNow() + timeout;
+    char *buffer = NULL;
+    size_t len = 0, capacity = 0;
+    int eof = 0;
+    
+    // Stop reading once the child has exited and its output is drained,
+    // rather than waiting for EOF, which a background process may hold off
+    while (1) {
+        err = ReadAvailable(fds[0], &buffer, &len, &capacity, &eof);
+        if (err || eof || exited) {
+            break;
+        }
+        int wait = Remaining(deadline);
+        if (wait == 0) {
+            err = ETIMEDOUT;
+            break;
+        }
+        struct pollfd pfds[2] = {
+            { .fd = fds[0], .events = POLLIN },
+            { .fd = watch, .events = POLLIN }
+        };
+        if (poll(pfds, (watch == -1) ? 1 : 2, wait) == -1 && errno != EINTR) {
+            err = errno;
+            break;
+        }
+        if (watch != -1 && (pfds[1].revents & (POLLIN | POLLHUP))) {
+            exited = 1;
+        }
+    }
+    close(fds[0]);
+    
+    if (err) {
+        kill(attributes->processGroup ? -pid : pid, SIGKILL);
+    }
+    int waitStatus;
+    int waitErr = PlatypusSpawnWait(pid, watch, -1, &waitStatus);
+    if (watch != -1) {
+        close(watch);
+    }
+    if (err == 0) {
+        err = waitErr;
+    }
+    if (err) {
+        free(buffer);
+        return err;
+    }
+    
+    // Always room for the terminator, from ReadAvailable()
+    buffer[len] = '\0';
+    *output = buffer;
+    if (length) {
+        *length = len;
+    }
+    if (status) {
+        *status = waitStatus;
+    }
+    return 0;
+}
@@ -0,0 +1,121 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Lightweight process launcher built on posix_spawn().
+//
+// Used in place of NSTask for short-lived helper processes and wherever a
+// child has to be started quickly. The child gets exactly the descriptors it
+// is given for standard input, output and error, and no others: any other
+// descriptor open in the parent is closed in the child, whether or not it
+// has the close-on-exec flag set. Descriptors created here are close-on-exec,
+// so children launched concurrently by other threads don't inherit them.
+//
+// Exit can be waited for with a timeout, or watched for with a descriptor
+// that becomes readable once the child has exited (a kqueue on macOS, a pidfd
+// on Linux), e.g. alongside the child's output in a poll() loop. The child
+// still has to be reaped with PlatypusSpawnWait() afterwards.
+
+#ifndef PLATYPUS_SPAWN_H
+#define PLATYPUS_SPAWN_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Special values for PlatypusSpawnAttributes.fds
+#define PLATYPUS_SPAWN_INHERIT  -1      // Child shares the parent's descriptor
+#define PLATYPUS_SPAWN_NULL     -2      // Child gets /dev/null
+
+typedef struct PlatypusSpawnAttributes {
+    const char *path;
+    char *const *arguments;         // NULL-terminated, the first being the process name
+    char *const *environment;       // NULL-terminated "NAME=value" list, or NULL to inherit
+    const char *directory;          // Working directory, or NULL to inherit
+    int fds[3];                     // Standard input, output and error
+    int processGroup;               // Nonzero to make the child leader of a new process group
+} PlatypusSpawnAttributes;
+
+// Sets up attributes with no standard input and inherited output and error
+void PlatypusSpawnAttributesInit(PlatypusSpawnAttributes *attributes, const char *path, char *const *arguments);
+
+// Launches a child process. Returns 0 on success or an errno value, e.g.
+// ENOENT if the executable doesn't exist.
+int PlatypusSpawn(const PlatypusSpawnAttributes *attributes, pid_t *pid);
+
+// Returns a close-on-exec descriptor that becomes readable once the child
+// exits, or -1 with errno set. ESRCH means it has exited already, and
+// ENOSYS that the system can't watch processes this way.
+int PlatypusSpawnWatch(pid_t pid);
+
+// Reaps the child, waiting up to 'timeout' seconds for it to exit, or
+// indefinitely if the timeout is negative. Returns 0 and stores the wait()
+// status on success, ETIMEDOUT if the child is still running, or an errno
+// value. 'watch' is a descriptor from PlatypusSpawnWatch(), or -1 to create
+// one as needed.
+int PlatypusSpawnWait(pid_t pid, int watch, double timeout, int *status);
+
+// Converts a wait() status as NSTask's terminationStatus does: the exit
+// status, or the number of the signal that terminated the child.
+int PlatypusSpawnExitStatus(int status);
+
+// Runs a child to completion and collects its output and error, which
+// replace attributes->fds[1] and [2]. Reading stops when the child exits,
+// even if a background process it left behind still holds the output open.
+// The child is killed if it runs for longer than 'timeout' seconds, unless
+// the timeout is negative, and ETIMEDOUT returned. If the child leads its
+// own process group, the whole group is killed. Otherwise returns 0 or an
+// errno value. On success *output is a NUL-terminated malloc()ed buffer, to
+// be freed by the caller.
+int PlatypusSpawnRun(const PlatypusSpawnAttributes *attributes, double timeout,
+                     char **output, size_t *length, int *status);
+
+#ifdef __cplusplus
+}
+#endif
+
+#ifdef __OBJC__
+#import <Foundation/Foundation.h>
+
+// NULL-terminated argument list for PlatypusSpawn(), converted as NSTask
+// converts arguments. To be free()d, but the strings themselves belong to
+// the current autorelease pool.
+static inline char **PlatypusSpawnArguments(NSArray <NSString *> *strings) {
+    char **args = calloc([strings count] + 1, sizeof(char *));
+    for (NSUInteger i = 0; args && i < [strings count]; i++) {
+        args[i] = (char *)[strings[i] fileSystemRepresentation];
+    }
+    return args;
+}
+#endif
+
+#endif
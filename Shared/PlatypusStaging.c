@@ -0,0 +1,257 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+#include "PlatypusStaging.h"
+#include "PlatypusSpawn.h"
+
+#define STAGING_SUFFIX  ".staging-XXXXXX"
+
+#if defined(__APPLE__)
+// renameatx_np() is declared in stdio.h, from macOS 10.12
+static int RenameExclusive(const char *from, const char *to) {
+    return renameatx_np(AT_FDCWD, from, AT_FDCWD, to, RENAME_EXCL) == 0 ? 0 : errno;
+}
+static int RenameSwap(const char *from, const char *to) {
+    return renameatx_np(AT_FDCWD, from, AT_FDCWD, to, RENAME_SWAP) == 0 ? 0 : errno;
+}
+#elif defined(SYS_renameat2)
+// Not every C library wraps renameat2(). Fails with ENOSYS before Linux 3.15,
+// and EINVAL on filesystems that don't support the flag.
+#define RENAME_FLAG_NOREPLACE   (1 << 0)
+#define RENAME_FLAG_EXCHANGE    (1 << 1)
+static int RenameExclusive(const char *from, const char *to) {
+    return syscall(SYS_renameat2, AT_FDCWD, from, AT_FDCWD, to, RENAME_FLAG_NOREPLACE) == 0 ? 0 : errno;
+}
+static int RenameSwap(const char *from, const char *to) {
+    return syscall(SYS_renameat2, AT_FDCWD, from, AT_FDCWD, to, RENAME_FLAG_EXCHANGE) == 0 ? 0 : errno;
+}
+#else
+static int RenameExclusive(const char *from, const char *to) {
+    return ENOTSUP;
+}
+static int RenameSwap(const char *from, const char *to) {
+    return ENOTSUP;
+}
+#endif
+
+static int Unsupported(int err) {
+    return err == ENOTSUP || err == EOPNOTSUPP || err == ENOSYS || err == EINVAL;
+}
+
+// Splits a path into its directory and last component, ignoring trailing slashes
+static int SplitPath(const char *path, char *dir, size_t dirSize, const char **name, size_t *nameLength) {
+    size_t length = strlen(path);
+    while (length > 1 && path[length - 1] == '/') {
+        length--;
+    }
+    size_t start = length;
+    while (start > 0 && path[start - 1] != '/') {
+        start--;
+    }
+    if (start == length) {
+        return EINVAL;
+    }
+    *name = path + start;
+    *nameLength = length - start;
+    
+    const char *dirPath = ".";
+    size_t dirLength = 1;
+    if (start > 0) {
+        dirPath = path;
+        dirLength = (start > 1) ? start - 1 : 1;
+    }
+    if (dirLength >= dirSize) {
+        return ENAMETOOLONG;
+    }
+    memcpy(dir, dirPath, dirLength);
+    dir[dirLength] = '\0';
+    return 0;
+}
+
+int PlatypusStagingCreate(const char *destPath, char *stagedPath, size_t size) {
+    char dir[PATH_MAX];
+    const char *name;
+    size_t nameLength;
+    int err = SplitPath(destPath, dir, sizeof(dir), &name, &nameLength);
+    if (err) {
+        return err;
+    }
+    
+    // e.g. /Applications/.MyApp.app.staging-a1B2c3/MyApp.app
+    char staging[PATH_MAX];
+    int n = snprintf(staging, sizeof(staging), "%s/.%.*s" STAGING_SUFFIX, dir, (int)nameLength, name);
+    if (n < 0 || (size_t)n >= sizeof(staging)) {
+        return ENAMETOOLONG;
+    }
+    if (mkdtemp(staging) == NULL) {
+        return errno;
+    }
+    n = snprintf(stagedPath, size, "%s/%.*s", staging, (int)nameLength, name);
+    if (n < 0 || (size_t)n >= size) {
+        rmdir(staging);
+        return ENAMETOOLONG;
+    }
+    return 0;
+}
+
+int PlatypusStagingCommit(const char *stagedPath, const char *destPath, int overwrite, int *replaced) {
+    *replaced = 0;
+    int err = RenameExclusive(stagedPath, destPath);
+    if (Unsupported(err)) {
+        struct stat st;
+        err = (lstat(destPath, &st) == 0) ? EEXIST : 0;
+        if (err == 0) {
+            err = (rename(stagedPath, destPath) == 0) ? 0 : errno;
+        }
+    }
+    if (err != EEXIST) {
+        return err;
+    }
+    if (!overwrite) {
+        return EEXIST;
+    }
+    
+    err = RenameSwap(stagedPath, destPath);
+    if (!Unsupported(err)) {
+        *replaced = (err == 0);
+        return err;
+    }
+    
+    // Where items can't be swapped, the old one is moved aside first, and
+    // the destination is briefly empty
+    char aside[PATH_MAX];
+    int n = snprintf(aside, sizeof(aside), "%s.replaced", stagedPath);
+    if (n < 0 || (size_t)n >= sizeof(aside)) {
+        return ENAMETOOLONG;
+    }
+    if (rename(destPath, aside) == -1) {
+        return errno;
+    }
+    if (rename(stagedPath, destPath) == -1) {
+        err = errno;
+        rename(aside, destPath);
+        return err;
+    }
+    rename(aside, stagedPath);
+    *replaced = 1;
+    return 0;
+}
+
+// Removes a file or directory tree, without following symlinks
+static int RemoveAt(int dirFd, const char *name) {
+    if (unlinkat(dirFd, name, 0) == 0 || errno == ENOENT) {
+        return 0;
+    }
+    // Directories fail with EPERM on macOS, EISDIR on Linux
+    int err = errno;
+    if (err != EPERM && err != EISDIR) {
+        return err;
+    }
+    int fd = openat(dirFd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd == -1) {
+        return (errno == ENOTDIR) ? err : errno;
+    }
+    DIR *dir = fdopendir(fd);
+    if (dir == NULL) {
+        err = errno;
+        close(fd);
+        return err;
+    }
+    err = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+            continue;
+        }
+        int childErr = RemoveAt(fd, entry->d_name);
+        if (err == 0) {
+            err = childErr;
+        }
+    }
+    closedir(dir);
+    if (unlinkat(dirFd, name, AT_REMOVEDIR) == -1 && err == 0) {
+        err = errno;
+    }
+    return err;
+}
+
+static int StagingDirectory(const char *stagedPath, char *staging, size_t size) {
+    const char *name;
+    size_t nameLength;
+    int err = SplitPath(stagedPath, staging, size, &name, &nameLength);
+    if (err) {
+        return err;
+    }
+    // Never anything but a staging directory
+    const char *dirName = strrchr(staging, '/');
+    dirName = dirName ? dirName + 1 : staging;
+    if (dirName[0] != '.' || strstr(dirName, ".staging-") == NULL) {
+        return EINVAL;
+    }
+    return 0;
+}
+
+int PlatypusStagingRemove(const char *stagedPath) {
+    char staging[PATH_MAX];
+    int err = StagingDirectory(stagedPath, staging, sizeof(staging));
+    return err ? err : RemoveAt(AT_FDCWD, staging);
+}
+
+int PlatypusStagingRemoveInBackground(const char *stagedPath, pid_t *pid) {
+    char staging[PATH_MAX];
+    int err = StagingDirectory(stagedPath, staging, sizeof(staging));
+    if (err) {
+        return err;
+    }
+    char *const args[] = { "/bin/rm", "-rf", "--", staging, NULL };
+    PlatypusSpawnAttributes attributes;
+    PlatypusSpawnAttributesInit(&attributes, args[0], args);
+    attributes.fds[1] = PLATYPUS_SPAWN_NULL;
+    attributes.fds[2] = PLATYPUS_SPAWN_NULL;
+    return PlatypusSpawn(&attributes, pid);
+}
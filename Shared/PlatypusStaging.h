@@ -0,0 +1,75 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Staging app bundles on the destination volume.
+//
+// A bundle is built in a hidden directory next to its destination, so that
+// it's on the same filesystem and can be moved into place with a single
+// rename(), however large it is, instead of being copied across volumes.
+// An item already at the destination is swapped with the new bundle in one
+// atomic step where the filesystem supports it (renameatx_np() with
+// RENAME_SWAP on macOS, renameat2() with RENAME_EXCHANGE on Linux), so the
+// destination always holds a complete app. The replaced item is left in the
+// staging directory, to be removed afterwards, e.g. in the background.
+// Portable C, runs on macOS and Linux.
+
+#ifndef PLATYPUS_STAGING_H
+#define PLATYPUS_STAGING_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Creates a staging directory next to destPath, and stores the path to build
+// the bundle at, inside it, in stagedPath. Returns 0 on success or an errno
+// value, e.g. EACCES if the destination's directory isn't writable.
+int PlatypusStagingCreate(const char *destPath, char *stagedPath, size_t size);
+
+// Moves the staged bundle to destPath. If an item exists there already, it
+// is replaced if overwrite is set, and ends up at stagedPath, with *replaced
+// set. Returns 0 on success, EEXIST if the destination exists and overwrite
+// isn't set, or another errno value.
+int PlatypusStagingCommit(const char *stagedPath, const char *destPath, int overwrite, int *replaced);
+
+// Removes the staging directory containing stagedPath, with everything in
+// it. Returns 0 on success or an errno value.
+int PlatypusStagingRemove(const char *stagedPath);
+// As above, but in a child process, which outlives the caller if need be.
+// The child is to be reaped with PlatypusSpawnWait().
+int PlatypusStagingRemoveInBackground(const char *stagedPath, pid_t *pid);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,79 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Asynchronous syntax checking service for scripts. Checks run concurrently
+// on a background operation queue and results are cached, keyed by the
+// script's path, a hash of its contents and the identity of the checker binary.
+
+#import <Foundation/Foundation.h>
+
+typedef NS_ENUM(NSInteger, PlatypusSyntaxCheckStatus) {
+    PlatypusSyntaxCheckStatus_OK = 0,
+    PlatypusSyntaxCheckStatus_Error,
+    PlatypusSyntaxCheckStatus_Unsupported,
+    PlatypusSyntaxCheckStatus_NoInterpreter,
+    PlatypusSyntaxCheckStatus_Missing
+};
+
+@interface PlatypusSyntaxCheckResult : NSObject
+
+@property (nonatomic, readonly, copy) NSString *path;
+@property (nonatomic, readonly, copy) NSString *interpreterPath;
+@property (nonatomic, readonly) PlatypusSyntaxCheckStatus status;
+@property (nonatomic, readonly, copy) NSString *output;
+@property (nonatomic, readonly) int exitStatus;
+@property (nonatomic, readonly) BOOL cached;
+
+// Human-readable report, as shown in the Platypus syntax checker window
+- (NSString *)report;
+- (NSString *)statusString;
+- (NSDictionary *)dictionaryRepresentation;
+
+@end
+
+typedef void (^PlatypusSyntaxCheckCompletionHandler)(NSArray <PlatypusSyntaxCheckResult *> *results);
+
+@interface PlatypusSyntaxChecker : NSObject
+
++ (instancetype)sharedChecker;
+
+// Completion handler is invoked on the main queue, results in same order as paths.
+// A nil interpreter path means the interpreter is determined for each file.
+- (void)checkFiles:(NSArray <NSString *> *)paths
+usingInterpreterAtPath:(NSString *)interpreterPath
+ completionHandler:(PlatypusSyntaxCheckCompletionHandler)handler;
+
+// Blocks until all files have been checked
+- (NSArray <PlatypusSyntaxCheckResult *> *)resultsOfCheckingFiles:(NSArray <NSString *> *)paths
+                                            usingInterpreterAtPath:(NSString *)interpreterPath;
+
+- (void)clearCache;
+
+@end
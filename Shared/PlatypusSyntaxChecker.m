@@ -0,0 +1,290 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#import <CommonCrypto/CommonDigest.h>
+#import <sys/stat.h>
+
+#import "Common.h"
+#import "PlatypusSyntaxChecker.h"
+#import "PlatypusScriptUtils.h"
+#import "PlatypusSpawn.h"
+
+@interface PlatypusSyntaxCheckResult()
+
+@property (nonatomic, readwrite, copy) NSString *path;
+@property (nonatomic, readwrite, copy) NSString *interpreterPath;
+@property (nonatomic, readwrite) PlatypusSyntaxCheckStatus status;
+@property (nonatomic, readwrite, copy) NSString *output;
+@property (nonatomic, readwrite) int exitStatus;
+@property (nonatomic, readwrite) BOOL cached;
+
+@end
+
+@implementation PlatypusSyntaxCheckResult
+
++ (instancetype)resultForPath:(NSString *)path
+                  interpreter:(NSString *)interpreterPath
+                       status:(PlatypusSyntaxCheckStatus)status
+                       output:(NSString *)output {
+    PlatypusSyntaxCheckResult *result = [[self alloc] init];
+    result.path = path;
+    result.interpreterPath = interpreterPath;
+    result.status = status;
+    result.output = output ? output : @"";
+    return result;
+}
+
+- (NSString *)statusString {
+    switch (self.status) {
+        case PlatypusSyntaxCheckStatus_OK:
+            return @"ok";
+        case PlatypusSyntaxCheckStatus_Error:
+            return @"error";
+        case PlatypusSyntaxCheckStatus_Unsupported:
+            return @"unsupported";
+        case PlatypusSyntaxCheckStatus_NoInterpreter:
+            return @"no-interpreter";
+        case PlatypusSyntaxCheckStatus_Missing:
+            return @"missing";
+    }
+    return @"unknown";
+}
+
+- (NSString *)report {
+    switch (self.status) {
+        case PlatypusSyntaxCheckStatus_OK:
+        case PlatypusSyntaxCheckStatus_Error:
+            // If the checker had no complaints, we report syntax as OK
+            return [self.output length] ? self.output : @"Syntax OK";
+        case PlatypusSyntaxCheckStatus_Unsupported:
+            return [NSString stringWithFormat:@"Syntax Checking is not supported for interpreter %@", self.interpreterPath];
+        case PlatypusSyntaxCheckStatus_NoInterpreter:
+            return @"Unable to determine script interpreter";
+        case PlatypusSyntaxCheckStatus_Missing:
+            return @"File does not exist";
+    }
+    return self.output;
+}
+
+- (NSDictionary *)dictionaryRepresentation {
+    return @{ @"path": self.path,
+              @"interpreter": self.interpreterPath ? self.interpreterPath : @"",
+              @"status": [self statusString],
+              @"exitStatus": @(self.exitStatus),
+              @"output": self.output,
+              @"cached": @(self.cached) };
+}
+
+- (instancetype)cachedCopy {
+    PlatypusSyntaxCheckResult *copy = [PlatypusSyntaxCheckResult resultForPath:self.path
+                                                                    interpreter:self.interpreterPath
+                                                                         status:self.status
+                                                                         output:self.output];
+    copy.exitStatus = self.exitStatus;
+    copy.cached = YES;
+    return copy;
+}
+
+@end
+
+@interface PlatypusSyntaxChecker()
+{
+    NSOperationQueue *queue;
+    NSCache <NSString *, PlatypusSyntaxCheckResult *> *cache;
+}
+@end
+
+@implementation PlatypusSyntaxChecker
+
++ (instancetype)sharedChecker {
+    static PlatypusSyntaxChecker *sharedChecker;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sharedChecker = [[self alloc] init];
+    });
+    return sharedChecker;
+}
+
+- (instancetype)init {
+    self = [super init];
+    if (self) {
+        queue = [[NSOperationQueue alloc] init];
+        [queue setName:@"org.sveinbjorn.platypus.syntaxcheck"];
+        [queue setMaxConcurrentOperationCount:[[NSProcessInfo processInfo] activeProcessorCount]];
+        cache = [[NSCache alloc] init];
+    }
+    return self;
+}
+
+- (void)clearCache {
+    [cache removeAllObjects];
+}
+
+#pragma mark -
+
+- (NSArray <NSOperation *> *)operationsForFiles:(NSArray <NSString *> *)paths
+                         usingInterpreterAtPath:(NSString *)interpreterPath
+                                        results:(NSMutableArray *)results {
+    NSMutableArray *ops = [NSMutableArray array];
+    for (NSUInteger i = 0; i < [paths count]; i++) {
+        [results addObject:[NSNull null]];
+        NSString *path = paths[i];
+        [ops addObject:[NSBlockOperation blockOperationWithBlock:^{
+            PlatypusSyntaxCheckResult *result = [self checkFile:path usingInterpreterAtPath:interpreterPath];
+            @synchronized(results) {
+                results[i] = result;
+            }
+        }]];
+    }
+    return ops;
+}
+
+- (void)checkFiles:(NSArray <NSString *> *)paths
+usingInterpreterAtPath:(NSString *)interpreterPath
+ completionHandler:(PlatypusSyntaxCheckCompletionHandler)handler {
+    NSMutableArray *results = [NSMutableArray array];
+    NSArray *ops = [self operationsForFiles:paths usingInterpreterAtPath:interpreterPath results:results];
+    
+    NSOperation *completion = [NSBlockOperation blockOperationWithBlock:^{
+        dispatch_async(dispatch_get_main_queue(), ^{
+            handler([results copy]);
+        });
+    }];
+    for (NSOperation *op in ops) {
+        [completion addDependency:op];
+    }
+    [queue addOperations:ops waitUntilFinished:NO];
+    [queue addOperation:completion];
+}
+
+- (NSArray <PlatypusSyntaxCheckResult *> *)resultsOfCheckingFiles:(NSArray <NSString *> *)paths
+                                            usingInterpreterAtPath:(NSString *)interpreterPath {
+    NSMutableArray *results = [NSMutableArray array];
+    NSArray *ops = [self operationsForFiles:paths usingInterpreterAtPath:interpreterPath results:results];
+    [queue addOperations:ops waitUntilFinished:YES];
+    return [results copy];
+}
+
+#pragma mark -
+
+// SHA-256 of file contents as hex string
+static NSString *ContentHash(NSString *path) {
+    NSData *data = [NSData dataWithContentsOfFile:path options:NSDataReadingMappedIfSafe error:nil];
+    if (data == nil) {
+        return nil;
+    }
+    unsigned char digest[CC_SHA256_DIGEST_LENGTH];
+    CC_SHA256([data bytes], (CC_LONG)[data length], digest);
+    
+    NSMutableString *hash = [NSMutableString stringWithCapacity:CC_SHA256_DIGEST_LENGTH * 2];
+    for (int i = 0; i < CC_SHA256_DIGEST_LENGTH; i++) {
+        [hash appendFormat:@"%02x", digest[i]];
+    }
+    return hash;
+}
+
+// Cheap stand-in for the interpreter version. Changes whenever the
+// checker binary is upgraded or replaced, without having to run it.
+static NSString *BinaryIdentity(NSString *path) {
+    struct stat st;
+    if (stat([path fileSystemRepresentation], &st) != 0) {
+        return path;
+    }
+    return [NSString stringWithFormat:@"%@:%llu:%lld:%ld",
+            path, (unsigned long long)st.st_ino, (long long)st.st_size, (long)st.st_mtimespec.tv_sec];
+}
+
+- (PlatypusSyntaxCheckResult *)checkFile:(NSString *)path usingInterpreterAtPath:(NSString *)suggestedInterpreter {
+    BOOL isDir;
+    if ([FILEMGR fileExistsAtPath:path isDirectory:&isDir] == NO || isDir) {
+        return [PlatypusSyntaxCheckResult resultForPath:path interpreter:suggestedInterpreter status:PlatypusSyntaxCheckStatus_Missing output:nil];
+    }
+    
+    NSString *interpreterPath = suggestedInterpreter;
+    if (interpreterPath == nil || [interpreterPath isEqualToString:@""]) {
+        interpreterPath = [PlatypusScriptUtils determineInterpreterPathForScriptFile:path];
+        if (interpreterPath == nil || [interpreterPath isEqualToString:@""]) {
+            return [PlatypusSyntaxCheckResult resultForPath:path interpreter:nil status:PlatypusSyntaxCheckStatus_NoInterpreter output:nil];
+        }
+    }
+    
+    // Let's see if the script type is supported for syntax checking
+    NSDictionary *info = [PlatypusScriptUtils interpreterInfoForPath:interpreterPath];
+    if (info[@"SyntaxCheck"] == nil) {
+        return [PlatypusSyntaxCheckResult resultForPath:path interpreter:interpreterPath status:PlatypusSyntaxCheckStatus_Unsupported output:nil];
+    }
+    NSString *checkerPath = info[@"SyntaxCheckBinary"] ? info[@"SyntaxCheckBinary"] : interpreterPath;
+    NSMutableArray *args = [NSMutableArray arrayWithArray:info[@"SyntaxCheck"]];
+    
+    // Look up previous result for the same file with identical contents and
+    // checker. The path is part of the key since checker output names the file.
+    NSString *hash = ContentHash(path);
+    NSString *cacheKey = nil;
+    if (hash) {
+        cacheKey = [NSString stringWithFormat:@"%@|%@|%@|%@", path, hash, BinaryIdentity(checkerPath), [args componentsJoinedByString:@" "]];
+        PlatypusSyntaxCheckResult *cachedResult = [cache objectForKey:cacheKey];
+        if (cachedResult) {
+            return [cachedResult cachedCopy];
+        }
+    }
+    
+    [args addObject:path];
+    [args insertObject:checkerPath atIndex:0];
+    
+    // Output is collected until the checker exits, so a checker that fills
+    // the pipe buffer doesn't block, nor does one that leaves a process behind
+    char **argv = PlatypusSpawnArguments(args);
+    PlatypusSpawnAttributes attributes;
+    PlatypusSpawnAttributesInit(&attributes, argv[0], argv);
+    char *outputBytes = NULL;
+    size_t outputLength = 0;
+    int waitStatus = 0;
+    int err = PlatypusSpawnRun(&attributes, -1, &outputBytes, &outputLength, &waitStatus);
+    free(argv);
+    if (err) {
+        NSString *msg = [NSString stringWithFormat:@"Unable to run syntax checker %@", checkerPath];
+        return [PlatypusSyntaxCheckResult resultForPath:path interpreter:interpreterPath status:PlatypusSyntaxCheckStatus_Error output:msg];
+    }
+    
+    NSString *output = [[NSString alloc] initWithBytes:outputBytes length:outputLength encoding:DEFAULT_TEXT_ENCODING];
+    free(outputBytes);
+    int exitStatus = PlatypusSpawnExitStatus(waitStatus);
+    PlatypusSyntaxCheckStatus status = (exitStatus == 0) ? PlatypusSyntaxCheckStatus_OK : PlatypusSyntaxCheckStatus_Error;
+    PlatypusSyntaxCheckResult *result = [PlatypusSyntaxCheckResult resultForPath:path interpreter:interpreterPath status:status output:output];
+    result.exitStatus = exitStatus;
+    
+    if (cacheKey) {
+        [cache setObject:result forKey:cacheKey];
+    }
+    
+    return result;
+}
+
+@end
@@ -29,7 +29,9 @@
 */
 
 #import <Cocoa/Cocoa.h>
+#ifndef SE_WITHOUT_WEBKIT
 #import <WebKit/WebKit.h>
+#endif
 
 @protocol STDragWebViewDelegate <NSObject>
 @required
@@ -42,6 +44,12 @@
 - (void)concludeDragOperation:(id <NSDraggingInfo>)sender;
 @end
 
+#ifdef SE_WITHOUT_WEBKIT
+// ScriptExec variants built without WebKit load the web view in their nib as
+// a plain view, which is never shown
+@interface STDragWebView : NSView<STDragWebViewDelegate>
+#else
 @interface STDragWebView : WebView<STDragWebViewDelegate> 
+#endif
 @property (assign) IBOutlet id<STDragWebViewDelegate> dragDelegate;
 @end
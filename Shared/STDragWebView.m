@@ -32,6 +32,12 @@
 
 @implementation STDragWebView
 
+#ifdef SE_WITHOUT_WEBKIT
+// The nib connects the web view's WebKit delegates, which a plain view lacks
+- (void)setValue:(id)value forUndefinedKey:(NSString *)key {
+}
+#endif
+
 #pragma mark Accepting Drags
 
 - (NSDragOperation)draggingEntered:(id <NSDraggingInfo> )sender {
@@ -0,0 +1,335 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Conformance tests and throughput benchmark for the ANSI escape sequence
+// parser. Portable C, runs on macOS and Linux. Built and run by
+// "make ansi_parser_tests", or with the benchmark by "make ansi_parser_bench".
+//
+//   ansi_parser_bench [benchmark size in MB]
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "PlatypusClock.h"
+#include "SEANSIParser.h"
+
+static SEANSIOutput output;
+
+// Parses a string in one go and checks the result is the same when it's
+// fed one byte at a time, as happens when sequences are split between reads
+static void Parse(const char *str) {
+    size_t len = strlen(str);
+    SEANSIParser parser;
+    
+    SEANSIOutput split;
+    SEANSIOutputInit(&split);
+    SEANSIParserInit(&parser);
+    for (size_t i = 0; i < len; i++) {
+        assert(SEANSIParserFeed(&parser, str + i, 1, &split) == 0);
+    }
+    
+    SEANSIOutputClear(&output);
+    SEANSIParserInit(&parser);
+    assert(SEANSIParserFeed(&parser, str, len, &output) == 0);
+    
+    assert(split.length == output.length);
+    assert(output.length == 0 || memcmp(split.text, output.text, output.length) == 0);
+    assert(split.runCount == output.runCount);
+    for (size_t i = 0; i < output.runCount; i++) {
+        assert(split.runs[i].length == output.runs[i].length);
+        assert(SEANSIStyleEqual(&split.runs[i].style, &output.runs[i].style));
+    }
+    SEANSIOutputFree(&split);
+}
+
+static int TextIs(const char *expected) {
+    return output.length == strlen(expected) && (output.length == 0 || memcmp(output.text, expected, output.length) == 0);
+}
+
+static const SEANSIStyle *RunStyle(size_t run) {
+    assert(run < output.runCount);
+    return &output.runs[run].style;
+}
+
+static void TestText(void) {
+    Parse("plain text\n");
+    assert(TextIs("plain text\n") && output.runCount == 1 && SEANSIStyleIsDefault(RunStyle(0)));
+    
+    Parse("");
+    assert(output.length == 0 && output.runCount == 0);
+    
+    // UTF-8 passes through untouched
+    Parse("caf\xc3\xa9 \xe2\x9c\x93\n");
+    assert(TextIs("caf\xc3\xa9 \xe2\x9c\x93\n"));
+    
+    // Bell is dropped
+    Parse("ding\a!");
+    assert(TextIs("ding!"));
+}
+
+static void TestSGR(void) {
+    Parse("\x1b[31mred\x1b[0m plain");
+    assert(TextIs("red plain") && output.runCount == 2);
+    assert(output.runs[0].length == 3 && RunStyle(0)->foreground.type == SEANSIColor_Indexed && RunStyle(0)->foreground.index == 1);
+    assert(SEANSIStyleIsDefault(RunStyle(1)));
+    
+    // ESC[m resets, as does an empty parameter
+    Parse("\x1b[1mA\x1b[mB\x1b[1mC\x1b[;mD");
+    assert(TextIs("ABCD") && output.runCount == 4);
+    assert(RunStyle(0)->flags == SEANSIStyle_Bold && SEANSIStyleIsDefault(RunStyle(1)));
+    assert(RunStyle(2)->flags == SEANSIStyle_Bold && SEANSIStyleIsDefault(RunStyle(3)));
+    
+    // Several attributes in one sequence
+    Parse("\x1b[1;3;4;7;9;42;97mX");
+    assert(RunStyle(0)->flags == (SEANSIStyle_Bold | SEANSIStyle_Italic | SEANSIStyle_Underline |
+                                  SEANSIStyle_Inverse | SEANSIStyle_Strikethrough));
+    assert(RunStyle(0)->background.index == 2 && RunStyle(0)->foreground.index == 15);
+    
+    // Attributes are turned off individually
+    Parse("\x1b[1;2;3;4;7;9mX\x1b[22;23;24;27;29mY");
+    assert(RunStyle(0)->flags != 0 && RunStyle(1)->flags == 0);
+    Parse("\x1b[31;41mX\x1b[39mY\x1b[49mZ");
+    assert(RunStyle(1)->foreground.type == SEANSIColor_Default && RunStyle(1)->background.index == 1);
+    assert(SEANSIStyleIsDefault(RunStyle(2)));
+    
+    // Bright colors
+    Parse("\x1b[90mX\x1b[107mY");
+    assert(RunStyle(0)->foreground.index == 8 && RunStyle(1)->background.index == 15);
+    
+    // 256 colors and RGB, with semicolons or colons
+    Parse("\x1b[38;5;208mX\x1b[48;2;1;2;3mY\x1b[38:2:255:128:0mZ");
+    assert(RunStyle(0)->foreground.type == SEANSIColor_Indexed && RunStyle(0)->foreground.index == 208);
+    assert(RunStyle(1)->background.type == SEANSIColor_RGB && RunStyle(1)->background.red == 1 &&
+           RunStyle(1)->background.green == 2 && RunStyle(1)->background.blue == 3);
+    assert(RunStyle(2)->foreground.type == SEANSIColor_RGB && RunStyle(2)->foreground.red == 255 &&
+           RunStyle(2)->foreground.green == 128);
+    
+    // Out of range values are clamped, truncated extended colors ignored
+    Parse("\x1b[38;5;999mX\x1b[0;38;2;1mY\x1b[0;38mZ");
+    assert(RunStyle(0)->foreground.index == 255);
+    assert(SEANSIStyleIsDefault(RunStyle(1)) && output.runCount == 2);
+    
+    // Parameters after an extended color still apply
+    Parse("\x1b[38;5;1;1mX");
+    assert(RunStyle(0)->foreground.index == 1 && RunStyle(0)->flags == SEANSIStyle_Bold);
+    
+    // Unsupported attributes are ignored
+    Parse("\x1b[5;8;53mX");
+    assert(SEANSIStyleIsDefault(RunStyle(0)));
+    
+    // Huge parameters don't overflow
+    Parse("\x1b[99999999999999999999mX");
+    assert(TextIs("X") && SEANSIStyleIsDefault(RunStyle(0)));
+}
+
+static void TestRunBatching(void) {
+    // Redundant sequences don't create runs
+    Parse("\x1b[31ma\x1b[31mb\x1b[1m\x1b[22mc\x1b[2Kd");
+    assert(TextIs("abcd") && output.runCount == 1 && output.runs[0].length == 4);
+    
+    // Style carries over between feeds
+    SEANSIParser parser;
+    SEANSIParserInit(&parser);
+    SEANSIOutputClear(&output);
+    SEANSIParserFeed(&parser, "\x1b[32mgreen ", 10, &output);
+    SEANSIParserFeed(&parser, "still green", 11, &output);
+    assert(output.runCount == 1 && RunStyle(0)->foreground.index == 2);
+}
+
+static void TestOtherSequences(void) {
+    // Cursor movement and erasing are dropped
+    Parse("\x1b[2J\x1b[H\x1b[10;20Hx\x1b[K\x1b[3A\x1b[?25l\x1b[?25hy");
+    assert(TextIs("xy") && output.runCount == 1 && SEANSIStyleIsDefault(RunStyle(0)));
+    
+    // Private mode sequences ending in m aren't SGR
+    Parse("\x1b[>4;2mX");
+    assert(TextIs("X") && SEANSIStyleIsDefault(RunStyle(0)));
+    
+    // OSC window title, terminated by BEL or ST
+    Parse("\x1b]0;My Title\aA\x1b]2;Other\x1b\\B");
+    assert(TextIs("AB"));
+    
+    // OSC 8 hyperlinks keep their text
+    Parse("\x1b]8;;https://sveinbjorn.org\x1b\\link\x1b]8;;\x1b\\");
+    assert(TextIs("link"));
+    
+    // An unterminated string ends at the end of the line
+    Parse("\x1b]0;title\nnext line");
+    assert(TextIs("\nnext line"));
+    
+    // A new escape sequence ends a string
+    Parse("\x1b]0;title\x1b[31mred");
+    assert(TextIs("red") && RunStyle(0)->foreground.index == 1);
+    
+    // Character set selection, keypad mode, two byte sequences
+    Parse("\x1b(Ba\x1b)0b\x1b=c\x1b>d\x1b" "7e\x1b" "8f");
+    assert(TextIs("abcdef"));
+    
+    // Full reset clears the style
+    Parse("\x1b[1;31mA\x1b" "cB");
+    assert(TextIs("AB") && SEANSIStyleIsDefault(RunStyle(1)));
+    
+    // DCS string
+    Parse("\x1bPq#0;2;0;0;0\x1b\\done");
+    assert(TextIs("done"));
+}
+
+static void TestMalformed(void) {
+    // A control character aborts a CSI sequence and is kept
+    Parse("\x1b[31\nX");
+    assert(TextIs("\nX") && SEANSIStyleIsDefault(RunStyle(0)));
+    
+    // Escape inside CSI starts a new sequence
+    Parse("\x1b[3\x1b[1mX");
+    assert(TextIs("X") && RunStyle(0)->flags == SEANSIStyle_Bold);
+    
+    // Repeated escapes
+    Parse("\x1b\x1b\x1b[4mX");
+    assert(TextIs("X") && RunStyle(0)->flags == SEANSIStyle_Underline);
+    
+    // Trailing escape produces nothing
+    Parse("abc\x1b");
+    assert(TextIs("abc"));
+    Parse("abc\x1b[1;2");
+    assert(TextIs("abc"));
+    
+    // Too many parameters
+    char buf[512] = "\x1b[";
+    for (int i = 0; i < 100; i++) {
+        strcat(buf, "1;");
+    }
+    strcat(buf, "4mX");
+    Parse(buf);
+    assert(TextIs("X") && (RunStyle(0)->flags & SEANSIStyle_Bold));
+}
+
+static void TestPalette(void) {
+    uint8_t r, g, b;
+    SEANSIPaletteColor(1, &r, &g, &b);
+    assert(r == 0xcd && g == 0 && b == 0);
+    SEANSIPaletteColor(16, &r, &g, &b);
+    assert(r == 0 && g == 0 && b == 0);
+    SEANSIPaletteColor(196, &r, &g, &b);
+    assert(r == 255 && g == 0 && b == 0);
+    SEANSIPaletteColor(231, &r, &g, &b);
+    assert(r == 255 && g == 255 && b == 255);
+    SEANSIPaletteColor(232, &r, &g, &b);
+    assert(r == 8 && g == 8 && b == 8);
+    SEANSIPaletteColor(255, &r, &g, &b);
+    assert(r == 238 && g == 238 && b == 238);
+}
+
+static void Fuzz(long iterations) {
+    static const char alphabet[] = "\x1b\x1b\x1b[[]];;:0123456789mmmHJK?>\a\\()Bc\nabc";
+    SEANSIParser parser;
+    srand(1);
+    for (long n = 0; n < iterations; n++) {
+        char buf[64];
+        size_t len = (size_t)(rand() % (int)sizeof(buf));
+        for (size_t i = 0; i < len; i++) {
+            buf[i] = alphabet[rand() % (int)(sizeof(alphabet) - 1)];
+        }
+        SEANSIParserInit(&parser);
+        SEANSIOutputClear(&output);
+        int err = SEANSIParserFeed(&parser, buf, len, &output);
+        assert(err == 0);
+        
+        // Runs cover the text exactly and adjacent runs differ
+        size_t total = 0;
+        for (size_t i = 0; i < output.runCount; i++) {
+            assert(output.runs[i].length > 0);
+            assert(i == 0 || !SEANSIStyleEqual(&output.runs[i - 1].style, &output.runs[i].style));
+            total += output.runs[i].length;
+        }
+        assert(total == output.length && output.length <= len);
+        assert(memchr(output.text, 0x1b, output.length) == NULL);
+    }
+}
+
+#pragma mark - Benchmark
+
+#ifdef BENCHMARK
+
+static void Benchmark(const char *label, const char *line, size_t megabytes) {
+    size_t lineLength = strlen(line);
+    size_t lines = (megabytes * 1024 * 1024) / lineLength;
+    size_t size = lines * lineLength;
+    char *buf = malloc(size);
+    assert(buf);
+    for (size_t i = 0; i < lines; i++) {
+        memcpy(buf + (i * lineLength), line, lineLength);
+    }
+    
+    // Feed in 64 KB chunks, as reads from the output pipe arrive
+    SEANSIParser parser;
+    SEANSIParserInit(&parser);
+    double t = PlatypusClockNow();
+    size_t runs = 0;
+    for (size_t offset = 0; offset < size; offset += 65536) {
+        size_t chunk = (size - offset < 65536) ? size - offset : 65536;
+        SEANSIOutputClear(&output);
+        SEANSIParserFeed(&parser, buf + offset, chunk, &output);
+        runs += output.runCount;
+    }
+    double elapsed = PlatypusClockNow() - t;
+    printf("%-28s %8.1f MB/s (%zu runs)\n", label, size / elapsed / (1024 * 1024), runs);
+    free(buf);
+}
+
+#endif
+
+int main(int argc, const char *argv[]) {
+    SEANSIOutputInit(&output);
+    
+    TestText();
+    TestSGR();
+    TestRunBatching();
+    TestOtherSequences();
+    TestMalformed();
+    TestPalette();
+    Fuzz(200000);
+    printf("ANSI parser tests passed\n");
+    
+#ifdef BENCHMARK
+    size_t megabytes = (argc > 1) ? (size_t)atol(argv[1]) : 256;
+    Benchmark("plain text:", "Processing file 1234 of the batch, please wait\n", megabytes);
+    Benchmark("colored status:", "\x1b[1;32m[ OK ]\x1b[0m Processing file 1234 of the batch\n", megabytes);
+    Benchmark("256 colors per word:", "\x1b[38;5;33mone \x1b[38;5;34mtwo \x1b[38;5;35mthree\x1b[0m\n", megabytes);
+#endif
+    
+    SEANSIOutputFree(&output);
+    
+    return EXIT_SUCCESS;
+}
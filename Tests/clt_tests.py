@@ -5,6 +5,7 @@
 
 import os
 import re
+import json
 import subprocess
 import plistlib
 
@@ -73,6 +74,15 @@ boolean_opts = {
     "-d": "DevelopmentVersion",
     "-l": "OptimizeApplication",
     "-y": "Overwrite",
+    "-E": "ExecInterpreter",
+    "-j": "ControlChannelOnly",
+    "-J": "LargeOutputView",
+    "-w": "LogOutput",
+    "-r": "PersistentJobQueue",
+    "-M": "JobServer",
+    "-S": "PrivilegedHelper",
+    "-H": "PrespawnInterpreter",
+    "-z": "PrecompileBytecode",
 }
 
 for k, v in boolean_opts.items():
@@ -104,6 +114,7 @@ string_opts = {
     #     '-n': ['TextFont', 'Comic Sans 13'],
     "-K": ["StatusItemDisplayType", "Icon"],
     "-Y": ["StatusItemTitle", "MySillyTitle"],
+    "-e": ["JobLimits", "timeout=600,cpu=300"],
 }
 
 for k, v in string_opts.items():
@@ -137,6 +148,7 @@ multiple_items_opts = {
     "-X": ["Suffixes", ["txt", "png", "pdf"]],
     "-T": ["UniformTypes", ["public.text", "public.rtf"]],
     "-U": ["URISchemes", ["https", "ssh"]],
+    "-t": ["Architectures", ["arm64", "x86_64"]],
 }
 
 for k, v in multiple_items_opts.items():
@@ -151,6 +163,28 @@ os.remove("dummy1")
 os.remove("dummy2")
 
 
+print("Verifying syntax check mode")
+
+with open("good.sh", "w") as f:
+    f.write("#!/bin/sh\necho hello\n")
+with open("bad.sh", "w") as f:
+    f.write("#!/bin/sh\nif then fi\n")
+
+out = subprocess.check_output([CLT_BINARY, "-k", "good.sh"])
+results = json.loads(out)
+assert len(results) == 1
+assert results[0]["status"] == "ok"
+assert results[0]["interpreter"] == "/bin/sh"
+
+proc = subprocess.run([CLT_BINARY, "-k", "good.sh", "bad.sh"], stdout=subprocess.PIPE)
+assert proc.returncode != 0
+statuses = {os.path.basename(r["path"]): r["status"] for r in json.loads(proc.stdout)}
+assert statuses == {"good.sh": "ok", "bad.sh": "error"}
+
+os.remove("good.sh")
+os.remove("bad.sh")
+
+
 print("Verifying app directory structure and permissions")
 
 app_path = create_app_with_args(["-R"])
@@ -165,6 +199,7 @@ files = [
     app_path + "/Contents/Resources/AppSettings.plist",
     app_path + "/Contents/Resources/MainMenu.nib",
     app_path + "/Contents/Resources/script",
+    app_path + "/Contents/Resources/AppSettings.bin",
 ]
 
 for p in files:
@@ -186,6 +221,18 @@ print("Verifying app argument handling")
 assert run_app(args=["a", "b", "c"]) == ["a", "b", "c"]
 
 
+# Bundled Python sources are compiled to bytecode that is checked
+# against the source hash (PEP 552 flags: hash-based, check_source)
+print("Verifying bytecode precompilation")
+app_path = create_app_with_args(["-p", "/usr/bin/python3", "-z", "-f", "args.py"])
+cache_path = app_path + "/Contents/Resources/__pycache__"
+pycs = [f for f in os.listdir(cache_path) if f.startswith("args.") and f.endswith(".pyc")]
+assert len(pycs) == 1
+with open(cache_path + "/" + pycs[0], "rb") as f:
+    assert int.from_bytes(f.read(8)[4:8], "little") == 3
+assert run_app(args=["a"]) == ["a"]
+
+
 # Create app with droppable settings, test opening file
 
 
@@ -0,0 +1,254 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Tests and benchmark for the job queue journal. Portable C, runs on macOS
+// and Linux. Built and run by "make job_journal_tests", or with the benchmark
+// by "make job_journal_bench".
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "PlatypusClock.h"
+#include "SEJobJournal.h"
+
+static char dir[] = "/tmp/job_journal_tests.XXXXXX";
+static char path[256];
+
+static SEJobJournal *Open(void) {
+    int err = 0;
+    SEJobJournal *journal = SEJobJournalOpen(path, &err);
+    assert(journal && err == 0);
+    return journal;
+}
+
+static void AssertRecovered(SEJobJournal *journal, size_t index, const char *payload, unsigned int attempts) {
+    const SEJournaledJob *job = SEJobJournalRecoveredJob(journal, index);
+    assert(job->length == strlen(payload));
+    assert(memcmp(job->payload, payload, job->length) == 0);
+    assert(job->attempts == attempts);
+}
+
+static off_t FileSize(void) {
+    struct stat st;
+    int err = stat(path, &st);
+    assert(err == 0);
+    return st.st_size;
+}
+
+static void TestRecovery(void) {
+    unlink(path);
+    SEJobJournal *journal = Open();
+    assert(SEJobJournalRecoveredCount(journal) == 0);
+    
+    uint64_t a = SEJobJournalAppendQueued(journal, "a", 1);
+    uint64_t b = SEJobJournalAppendQueued(journal, "bb", 2);
+    uint64_t c = SEJobJournalAppendQueued(journal, "", 0);
+    uint64_t d = SEJobJournalAppendQueued(journal, "dddd", 4);
+    assert(a && b > a && c > b && d > c);
+    assert(SEJobJournalMarkStarted(journal, a) == 0);
+    assert(SEJobJournalMarkCompleted(journal, a) == 0);
+    assert(SEJobJournalMarkStarted(journal, b) == 0);
+    // Queued jobs can be completed, i.e. removed, without being started
+    assert(SEJobJournalMarkCompleted(journal, d) == 0);
+    assert(SEJobJournalMarkCompleted(journal, d) != 0);
+    assert(SEJobJournalMarkStarted(journal, 999) != 0);
+    
+    // Simulate a crash: the file is left as is
+    SEJobJournalClose(journal);
+    journal = Open();
+    assert(SEJobJournalRecoveredCount(journal) == 2);
+    AssertRecovered(journal, 0, "bb", 1);
+    AssertRecovered(journal, 1, "", 0);
+    assert(SEJobJournalRecoveredJob(journal, 0)->identifier == b);
+    
+    // Identifiers keep increasing across launches
+    uint64_t e = SEJobJournalAppendQueued(journal, "e", 1);
+    assert(e > d);
+    SEJobJournalClose(journal);
+}
+
+static void TestDamage(void) {
+    unlink(path);
+    SEJobJournal *journal = Open();
+    SEJobJournalAppendQueued(journal, "one", 3);
+    SEJobJournalAppendQueued(journal, "two", 3);
+    off_t beforeThree = FileSize();
+    SEJobJournalAppendQueued(journal, "three", 5);
+    SEJobJournalClose(journal);
+    
+    // Partially written last record is ignored
+    int err = truncate(path, FileSize() - 2);
+    assert(err == 0);
+    journal = Open();
+    assert(SEJobJournalRecoveredCount(journal) == 2);
+    AssertRecovered(journal, 1, "two", 0);
+    SEJobJournalAppendQueued(journal, "three", 5);
+    SEJobJournalClose(journal);
+    
+    // So are records after a damaged one
+    int fd = open(path, O_RDWR);
+    assert(fd != -1);
+    char byte;
+    ssize_t n = pread(fd, &byte, 1, beforeThree - 1);
+    assert(n == 1);
+    byte ^= 0xff;
+    n = pwrite(fd, &byte, 1, beforeThree - 1);
+    assert(n == 1);
+    close(fd);
+    journal = Open();
+    assert(SEJobJournalRecoveredCount(journal) == 1);
+    AssertRecovered(journal, 0, "one", 0);
+    SEJobJournalClose(journal);
+    
+    // Not a journal
+    fd = open(path, O_WRONLY | O_TRUNC);
+    n = write(fd, "garbage", 7);
+    assert(n == 7);
+    close(fd);
+    journal = Open();
+    assert(SEJobJournalRecoveredCount(journal) == 0);
+    SEJobJournalClose(journal);
+}
+
+static void TestCrashingJob(void) {
+    unlink(path);
+    SEJobJournal *journal = Open();
+    SEJobJournalAppendQueued(journal, "crash", 5);
+    SEJobJournalAppendQueued(journal, "ok", 2);
+    SEJobJournalClose(journal);
+    
+    // A job that never completes is dropped after being started too often
+    for (int i = 1; i <= SE_JOB_JOURNAL_MAX_ATTEMPTS; i++) {
+        journal = Open();
+        assert(SEJobJournalRecoveredCount(journal) == 2);
+        AssertRecovered(journal, 0, "crash", (unsigned int)i - 1);
+        assert(SEJobJournalMarkStarted(journal, SEJobJournalRecoveredJob(journal, 0)->identifier) == 0);
+        SEJobJournalClose(journal);
+    }
+    journal = Open();
+    assert(SEJobJournalRecoveredCount(journal) == 1);
+    AssertRecovered(journal, 0, "ok", 0);
+    SEJobJournalClose(journal);
+}
+
+static void TestCompaction(void) {
+    unlink(path);
+    SEJobJournal *journal = Open();
+    char payload[64];
+    uint64_t first = 0;
+    for (int i = 0; i < 5000; i++) {
+        int n = snprintf(payload, sizeof(payload), "/Users/test/Files/file-%05d.txt", i);
+        uint64_t identifier = SEJobJournalAppendQueued(journal, payload, (size_t)n);
+        first = first ? first : identifier;
+    }
+    for (uint64_t id = first; id < first + 4990; id++) {
+        assert(SEJobJournalMarkStarted(journal, id) == 0);
+        assert(SEJobJournalMarkCompleted(journal, id) == 0);
+    }
+    // Compacted as completed jobs piled up
+    assert(FileSize() < 64 * 1024);
+    SEJobJournalClose(journal);
+    
+    journal = Open();
+    assert(SEJobJournalRecoveredCount(journal) == 10);
+    AssertRecovered(journal, 0, "/Users/test/Files/file-04990.txt", 0);
+    AssertRecovered(journal, 9, "/Users/test/Files/file-04999.txt", 0);
+    SEJobJournalClose(journal);
+    
+    // Missing directory
+    int err = 0;
+    assert(SEJobJournalOpen("/nonexistent/dir/journal", &err) == NULL && err != 0);
+}
+
+#pragma mark - Benchmark
+
+#ifdef BENCHMARK
+
+static void Benchmark(void) {
+    unlink(path);
+    SEJobJournal *journal = Open();
+    const int count = 100000;
+    const char payload[] = "/Users/test/Documents/Batch/Input/IMG_0001.jpg";
+    
+    double start = PlatypusClockNow();
+    uint64_t first = 0;
+    for (int i = 0; i < count; i++) {
+        uint64_t identifier = SEJobJournalAppendQueued(journal, payload, sizeof(payload) - 1);
+        first = first ? first : identifier;
+    }
+    SEJobJournalSync(journal);
+    double queued = PlatypusClockNow() - start;
+    
+    start = PlatypusClockNow();
+    for (uint64_t id = first; id < first + count; id++) {
+        SEJobJournalMarkStarted(journal, id);
+        SEJobJournalMarkCompleted(journal, id);
+    }
+    SEJobJournalSync(journal);
+    double completed = PlatypusClockNow() - start;
+    SEJobJournalClose(journal);
+    
+    start = PlatypusClockNow();
+    journal = Open();
+    double recovered = PlatypusClockNow() - start;
+    SEJobJournalClose(journal);
+    
+    printf("%d jobs: %.2f us per queue, %.2f us per start and completion, reopened in %.1f ms\n",
+           count, queued * 1e6 / count, completed * 1e6 / count, recovered * 1e3);
+    unlink(path);
+}
+
+#endif
+
+int main(void) {
+    char *created = mkdtemp(dir);
+    assert(created);
+    snprintf(path, sizeof(path), "%s/JobQueue.journal", dir);
+    
+    TestRecovery();
+    TestDamage();
+    TestCrashingJob();
+    TestCompaction();
+    printf("All job journal tests passed\n");
+    
+#ifdef BENCHMARK
+    Benchmark();
+#endif
+    rmdir(dir);
+    return 0;
+}
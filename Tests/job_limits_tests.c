@@ -0,0 +1,139 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Tests for parsing and applying job limits. Portable C, runs on macOS and
+// Linux. Built and run by "make job_limits_tests".
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "PlatypusJobLimits.h"
+
+static void TestParse(void) {
+    PlatypusJobLimits limits;
+    assert(PlatypusJobLimitsParse("timeout=1.5,cpu=30,memory=512,files=64", &limits) == 0);
+    assert(limits.timeout == 1.5);
+    assert(limits.cpuTime == 30);
+    assert(limits.memory == 512ULL * 1024 * 1024);
+    assert(limits.openFiles == 64);
+    assert(PlatypusJobLimitsAny(&limits));
+    assert(PlatypusJobLimitsAnyResource(&limits));
+    
+    assert(PlatypusJobLimitsParse("timeout=10", &limits) == 0);
+    assert(PlatypusJobLimitsAny(&limits));
+    assert(!PlatypusJobLimitsAnyResource(&limits));
+    
+    assert(PlatypusJobLimitsParse("", &limits) == 0);
+    assert(!PlatypusJobLimitsAny(&limits));
+    assert(PlatypusJobLimitsParse("files=0", &limits) == 0);
+    assert(!PlatypusJobLimitsAny(&limits));
+    
+    // Malformed strings leave limits as they were
+    const char *bad[] = { "cpu", "cpu=", "cpu=-1", "cpu=1.5", "cpu=1,", ",cpu=1", "cpu=1,,files=2",
+                          "timeout=-2", "timeout=inf", "timeout=nan", "disk=10", "CPU=10",
+                          "memory=99999999999999999999", "files=12x" };
+    PlatypusJobLimitsParse("cpu=7", &limits);
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+        assert(PlatypusJobLimitsParse(bad[i], &limits) == EINVAL);
+        assert(limits.cpuTime == 7);
+    }
+}
+
+static void TestFormat(void) {
+    const char *strings[] = { "", "timeout=600", "cpu=300,memory=2048", "timeout=0.25,cpu=1,memory=1,files=256" };
+    for (size_t i = 0; i < sizeof(strings) / sizeof(strings[0]); i++) {
+        PlatypusJobLimits limits;
+        assert(PlatypusJobLimitsParse(strings[i], &limits) == 0);
+        char buf[PLATYPUS_JOB_LIMITS_MAX_LENGTH];
+        assert(PlatypusJobLimitsFormat(&limits, buf, sizeof(buf)) == (int)strlen(strings[i]));
+        assert(strcmp(buf, strings[i]) == 0);
+    }
+}
+
+static void TestCombine(void) {
+    PlatypusJobLimits app, job;
+    PlatypusJobLimitsParse("timeout=60,cpu=30,files=100", &app);
+    PlatypusJobLimitsParse("timeout=120,cpu=10,memory=256", &job);
+    PlatypusJobLimitsCombine(&app, &job);
+    char buf[PLATYPUS_JOB_LIMITS_MAX_LENGTH];
+    PlatypusJobLimitsFormat(&app, buf, sizeof(buf));
+    assert(strcmp(buf, "timeout=60,cpu=10,memory=256,files=100") == 0);
+}
+
+// In a child, since limits can't be raised again
+static void TestApply(void) {
+    pid_t pid = fork();
+    assert(pid != -1);
+    if (pid == 0) {
+        PlatypusJobLimits limits;
+        PlatypusJobLimitsParse("cpu=20,memory=4096,files=48", &limits);
+        if (PlatypusJobLimitsApply(&limits) != 0) {
+            _exit(1);
+        }
+        struct rlimit rl;
+        getrlimit(RLIMIT_CPU, &rl);
+        if (rl.rlim_cur != 20 || rl.rlim_max > 20 + PLATYPUS_JOB_LIMITS_CPU_GRACE) {
+            _exit(2);
+        }
+        getrlimit(RLIMIT_AS, &rl);
+        if (rl.rlim_cur != 4096ULL * 1024 * 1024) {
+            _exit(3);
+        }
+        getrlimit(RLIMIT_NOFILE, &rl);
+        if (rl.rlim_cur != 48) {
+            _exit(4);
+        }
+        // Can't be raised back up
+        PlatypusJobLimitsParse("files=100000", &limits);
+        PlatypusJobLimitsApply(&limits);
+        getrlimit(RLIMIT_NOFILE, &rl);
+        _exit(rl.rlim_cur == 48 ? 0 : 5);
+    }
+    int status;
+    pid_t reaped = waitpid(pid, &status, 0);
+    assert(reaped == pid);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
+int main(void) {
+    TestParse();
+    TestFormat();
+    TestCombine();
+    TestApply();
+    printf("All job limits tests passed\n");
+    return 0;
+}
@@ -0,0 +1,270 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Tests and benchmark for the job server wire format. Portable C, runs on
+// macOS and Linux. Built and run by "make job_protocol_tests", or with the
+// benchmark by "make job_protocol_bench".
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "PlatypusClock.h"
+#include "PlatypusJobProtocol.h"
+
+static void BuildSubmission(PlatypusJobBuffer *buffer, const char *arg, uint32_t stream) {
+    PlatypusJobFrameBegin(buffer, PlatypusJobFrame_Submit);
+    PlatypusJobFrameAddString(buffer, PlatypusJobField_Argument, arg);
+    PlatypusJobFrameAddString(buffer, PlatypusJobField_Argument, "");
+    PlatypusJobFrameAddField(buffer, PlatypusJobField_Input, "in\0put", 6);
+    PlatypusJobFrameAddString(buffer, PlatypusJobField_Metadata, "KEY=value");
+    PlatypusJobFrameAddUInt32(buffer, PlatypusJobField_StreamOutput, stream);
+    assert(PlatypusJobFrameEnd(buffer) == 0);
+}
+
+static void AssertSubmission(const PlatypusJobFrame *frame, const char *arg, uint32_t stream) {
+    assert(frame->type == PlatypusJobFrame_Submit);
+    
+    size_t offset = 0;
+    PlatypusJobField field;
+    const uint8_t *value;
+    size_t length;
+    
+    assert(PlatypusJobFrameNextField(frame, &offset, &field, &value, &length) == 1);
+    assert(field == PlatypusJobField_Argument && length == strlen(arg) && memcmp(value, arg, length) == 0);
+    assert(PlatypusJobFrameNextField(frame, &offset, &field, &value, &length) == 1);
+    assert(field == PlatypusJobField_Argument && length == 0);
+    assert(PlatypusJobFrameNextField(frame, &offset, &field, &value, &length) == 1);
+    assert(field == PlatypusJobField_Input && length == 6 && memcmp(value, "in\0put", 6) == 0);
+    assert(PlatypusJobFrameNextField(frame, &offset, &field, &value, &length) == 1);
+    assert(field == PlatypusJobField_Metadata && length == 9);
+    assert(PlatypusJobFrameNextField(frame, &offset, &field, &value, &length) == 1);
+    assert(field == PlatypusJobField_StreamOutput && PlatypusJobFieldUInt32(value, length) == stream);
+    assert(PlatypusJobFrameNextField(frame, &offset, &field, &value, &length) == 0);
+}
+
+static void TestRoundTrip(void) {
+    PlatypusJobBuffer buffer;
+    PlatypusJobBufferInit(&buffer);
+    BuildSubmission(&buffer, "/tmp/a", 1);
+    BuildSubmission(&buffer, "/tmp/bb", 0);
+    
+    PlatypusJobReader reader;
+    PlatypusJobReaderInit(&reader);
+    PlatypusJobFrame frame;
+    assert(PlatypusJobReaderNext(&reader, &frame) == 0);
+    assert(PlatypusJobReaderAppend(&reader, buffer.bytes, buffer.length) == 0);
+    assert(PlatypusJobReaderNext(&reader, &frame) == 1);
+    AssertSubmission(&frame, "/tmp/a", 1);
+    assert(PlatypusJobReaderNext(&reader, &frame) == 1);
+    AssertSubmission(&frame, "/tmp/bb", 0);
+    assert(PlatypusJobReaderNext(&reader, &frame) == 0);
+    
+    PlatypusJobReaderFree(&reader);
+    PlatypusJobBufferFree(&buffer);
+}
+
+// Frames split at every possible point still come out whole
+static void TestFragmentation(void) {
+    PlatypusJobBuffer buffer;
+    PlatypusJobBufferInit(&buffer);
+    BuildSubmission(&buffer, "/tmp/a", 1);
+    BuildSubmission(&buffer, "/tmp/bb", 0);
+    
+    for (size_t chunk = 1; chunk <= buffer.length; chunk++) {
+        PlatypusJobReader reader;
+        PlatypusJobReaderInit(&reader);
+        int frames = 0;
+        for (size_t i = 0; i < buffer.length; i += chunk) {
+            size_t len = buffer.length - i < chunk ? buffer.length - i : chunk;
+            int err = PlatypusJobReaderAppend(&reader, buffer.bytes + i, len);
+            assert(err == 0);
+            PlatypusJobFrame frame;
+            int result;
+            while ((result = PlatypusJobReaderNext(&reader, &frame)) == 1) {
+                AssertSubmission(&frame, frames ? "/tmp/bb" : "/tmp/a", frames ? 0 : 1);
+                frames++;
+            }
+            assert(result == 0);
+        }
+        assert(frames == 2);
+        PlatypusJobReaderFree(&reader);
+    }
+    
+    // Consuming part of a buffer keeps the rest intact
+    size_t first = buffer.length / 2;
+    PlatypusJobBufferConsume(&buffer, first);
+    assert(buffer.length > 0 && buffer.frameStart == buffer.length);
+    PlatypusJobBufferConsume(&buffer, buffer.length);
+    assert(buffer.length == 0);
+    PlatypusJobBufferFree(&buffer);
+}
+
+static void TestMalformed(void) {
+    PlatypusJobReader reader;
+    PlatypusJobFrame frame;
+    
+    // Oversized frame
+    const uint8_t huge[] = { 0x7f, 0xff, 0xff, 0xff, PlatypusJobFrame_Submit };
+    PlatypusJobReaderInit(&reader);
+    assert(PlatypusJobReaderAppend(&reader, huge, sizeof(huge)) == 0);
+    assert(PlatypusJobReaderNext(&reader, &frame) == -1);
+    PlatypusJobReaderFree(&reader);
+    
+    // Empty frame
+    const uint8_t empty[] = { 0, 0, 0, 0 };
+    PlatypusJobReaderInit(&reader);
+    assert(PlatypusJobReaderAppend(&reader, empty, sizeof(empty)) == 0);
+    assert(PlatypusJobReaderNext(&reader, &frame) == -1);
+    PlatypusJobReaderFree(&reader);
+    
+    // Field running past the end of the frame
+    const uint8_t truncated[] = { 0, 0, 0, 7, PlatypusJobFrame_Submit, PlatypusJobField_Argument, 0, 0, 0, 9, 'x' };
+    PlatypusJobReaderInit(&reader);
+    assert(PlatypusJobReaderAppend(&reader, truncated, sizeof(truncated)) == 0);
+    assert(PlatypusJobReaderNext(&reader, &frame) == 1);
+    assert(frame.type == PlatypusJobFrame_Submit && frame.length == 6);
+    size_t offset = 0;
+    PlatypusJobField field;
+    const uint8_t *value;
+    size_t length;
+    assert(PlatypusJobFrameNextField(&frame, &offset, &field, &value, &length) == -1);
+    PlatypusJobReaderFree(&reader);
+    
+    // Integers of the wrong size
+    assert(PlatypusJobFieldUInt32((const uint8_t *)"\0\0\0\1", 4) == 1);
+    assert(PlatypusJobFieldUInt32((const uint8_t *)"\0\0\1", 3) == 0);
+}
+
+static void TestFrameLimit(void) {
+    PlatypusJobBuffer buffer;
+    PlatypusJobBufferInit(&buffer);
+    
+    size_t size = PLATYPUS_JOB_FRAME_MAX_SIZE / 2 + 1;
+    char *data = calloc(1, PLATYPUS_JOB_FRAME_MAX_SIZE);
+    assert(data);
+    
+    // Too big: discarded, leaving earlier frames alone
+    PlatypusJobFrameBegin(&buffer, PlatypusJobFrame_Output);
+    PlatypusJobFrameAddUInt32(&buffer, PlatypusJobField_Sequence, 1);
+    assert(PlatypusJobFrameEnd(&buffer) == 0);
+    size_t length = buffer.length;
+    PlatypusJobFrameBegin(&buffer, PlatypusJobFrame_Output);
+    PlatypusJobFrameAddField(&buffer, PlatypusJobField_Data, data, size);
+    PlatypusJobFrameAddField(&buffer, PlatypusJobField_Data, data, size);
+    assert(PlatypusJobFrameEnd(&buffer) == EMSGSIZE);
+    assert(buffer.length == length);
+    
+    // Just fits
+    PlatypusJobFrameBegin(&buffer, PlatypusJobFrame_Output);
+    PlatypusJobFrameAddField(&buffer, PlatypusJobField_Data, data, PLATYPUS_JOB_FRAME_MAX_SIZE - 1 - 5);
+    assert(PlatypusJobFrameEnd(&buffer) == 0);
+    
+    PlatypusJobReader reader;
+    PlatypusJobReaderInit(&reader);
+    assert(PlatypusJobReaderAppend(&reader, buffer.bytes, buffer.length) == 0);
+    PlatypusJobFrame frame;
+    assert(PlatypusJobReaderNext(&reader, &frame) == 1);
+    assert(PlatypusJobReaderNext(&reader, &frame) == 1);
+    assert(frame.length == PLATYPUS_JOB_FRAME_MAX_SIZE - 1);
+    assert(PlatypusJobReaderNext(&reader, &frame) == 0);
+    
+    PlatypusJobReaderFree(&reader);
+    PlatypusJobBufferFree(&buffer);
+    free(data);
+}
+
+#pragma mark - Benchmark
+
+#ifdef BENCHMARK
+
+static void Benchmark(void) {
+    const int count = 1000000;
+    PlatypusJobBuffer buffer;
+    PlatypusJobBufferInit(&buffer);
+    
+    int failed = 0;
+    double start = PlatypusClockNow();
+    for (int i = 0; i < count; i++) {
+        PlatypusJobFrameBegin(&buffer, PlatypusJobFrame_Submit);
+        PlatypusJobFrameAddString(&buffer, PlatypusJobField_Argument, "/Users/test/Documents/Batch/Input/IMG_0001.jpg");
+        PlatypusJobFrameAddUInt32(&buffer, PlatypusJobField_Priority, 0);
+        failed |= PlatypusJobFrameEnd(&buffer);
+    }
+    double built = PlatypusClockNow() - start;
+    assert(failed == 0);
+    
+    // Fed in socket-sized reads, as the server sees them
+    start = PlatypusClockNow();
+    PlatypusJobReader reader;
+    PlatypusJobReaderInit(&reader);
+    int frames = 0;
+    for (size_t i = 0; i < buffer.length; i += 65536) {
+        size_t len = buffer.length - i < 65536 ? buffer.length - i : 65536;
+        failed |= PlatypusJobReaderAppend(&reader, buffer.bytes + i, len);
+        PlatypusJobFrame frame;
+        while (PlatypusJobReaderNext(&reader, &frame) == 1) {
+            size_t offset = 0;
+            PlatypusJobField field;
+            const uint8_t *value;
+            size_t length;
+            while (PlatypusJobFrameNextField(&frame, &offset, &field, &value, &length) == 1) {
+            }
+            frames++;
+        }
+    }
+    double parsed = PlatypusClockNow() - start;
+    assert(failed == 0 && frames == count);
+    
+    printf("%d submissions (%zu bytes): %.0f ns per frame built, %.0f ns per frame parsed\n",
+           count, buffer.length, built * 1e9 / count, parsed * 1e9 / count);
+    PlatypusJobReaderFree(&reader);
+    PlatypusJobBufferFree(&buffer);
+}
+
+#endif
+
+int main(void) {
+    TestRoundTrip();
+    TestFragmentation();
+    TestMalformed();
+    TestFrameLimit();
+    printf("All job protocol tests passed\n");
+    
+#ifdef BENCHMARK
+    Benchmark();
+#endif
+    return 0;
+}
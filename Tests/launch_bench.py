@@ -0,0 +1,139 @@
+#!/usr/bin/python3 -u
+#
+# Launch time benchmark for Platypus-generated apps
+#
+# Measures wall time from spawning the app binary until the first
+# byte of script output arrives. Compares the exec and headless launch
+# paths for interface type None against the regular AppKit launch path
+# (with and without the precompiled AppSettings.bin settings snapshot)
+# and against running the interpreter directly. If the ScriptExec variants
+# are installed, also compares the AppKit launch path of the variant for
+# interface type None against the generic ScriptExec binary.
+#
+
+import os
+import sys
+import plistlib
+import time
+import shutil
+import statistics
+import subprocess
+
+
+CLT_BINARY = os.path.dirname(os.path.realpath(__file__)) + "/platypus"
+GENERIC_EXEC = "/usr/local/share/platypus/ScriptExec"
+VARIANT_EXEC = GENERIC_EXEC + "-None"
+RUNS = int(sys.argv[1]) if len(sys.argv) > 1 else 25
+
+
+SCRIPT = "#!/bin/sh\necho x\n"
+
+
+def create_app(name, args=[]):
+    with open("bench_script.sh", "w") as f:
+        f.write(SCRIPT)
+    pnargs = [CLT_BINARY]
+    pnargs.extend(args)
+    pnargs.extend(["--overwrite", "--name", name, "bench_script.sh", name + ".app"])
+    subprocess.check_output(pnargs, stderr=subprocess.DEVNULL)
+    os.remove("bench_script.sh")
+    return name + ".app"
+
+
+def bundle_identifier(app_path):
+    with open(app_path + "/Contents/Info.plist", "rb") as f:
+        return plistlib.load(f)["CFBundleIdentifier"]
+
+
+def set_headless_disabled(app_path, disabled):
+    ident = bundle_identifier(app_path)
+    if disabled:
+        cmd = ["defaults", "write", ident, "DisableHeadless", "-bool", "YES"]
+    else:
+        cmd = ["defaults", "delete", ident, "DisableHeadless"]
+    subprocess.call(cmd, stderr=subprocess.DEVNULL)
+
+
+def app_command(app_path):
+    name = os.path.basename(app_path)[:-4]
+    return [app_path + "/Contents/MacOS/" + name]
+
+
+def linked_libraries(binary):
+    out = subprocess.check_output(["otool", "-L", binary]).decode()
+    return [l.strip().split(" ")[0] for l in out.splitlines()[1:]]
+
+
+def time_to_first_byte(cmd):
+    start = time.monotonic()
+    # With interface type None, script output is written to stderr
+    p = subprocess.Popen(cmd, stdout=subprocess.DEVNULL, stderr=subprocess.PIPE)
+    p.stderr.read(1)
+    elapsed = time.monotonic() - start
+    p.wait()
+    return elapsed
+
+
+def bench(label, cmd):
+    time_to_first_byte(cmd)  # Warm up
+    times = [time_to_first_byte(cmd) for _ in range(RUNS)]
+    print(
+        "%-28s median %7.2f ms   min %7.2f ms   max %7.2f ms"
+        % (
+            label,
+            statistics.median(times) * 1000,
+            min(times) * 1000,
+            max(times) * 1000,
+        )
+    )
+    return statistics.median(times)
+
+
+os.chdir(os.path.dirname(os.path.realpath(__file__)))
+
+exec_app = create_app("BenchExec", ["-o", "None", "-R", "-E"])
+headless_app = create_app("BenchHeadless", ["-o", "None", "-R"])
+snapshot_app = create_app("BenchSnapshot", ["-o", "None", "-R"])
+plist_app = create_app("BenchPlist", ["-o", "None", "-R"])
+set_headless_disabled(snapshot_app, True)
+set_headless_disabled(plist_app, True)
+# Apps without a snapshot fall back to AppSettings.plist
+os.remove(plist_app + "/Contents/Resources/AppSettings.bin")
+
+with open("bench_script.sh", "w") as f:
+    f.write("echo x >&2\n")
+
+print("Time to first script byte (%d runs)" % RUNS)
+raw = bench("Interpreter only", ["/bin/sh", "bench_script.sh"])
+execd = bench("Exec interpreter", app_command(exec_app))
+headless = bench("Headless", app_command(headless_app))
+snapshot = bench("AppKit, AppSettings.bin", app_command(snapshot_app))
+plist = bench("AppKit, AppSettings.plist", app_command(plist_app))
+print("Exec overhead over interpreter: %.2f ms" % ((execd - raw) * 1000))
+print("Headless overhead over interpreter: %.2f ms" % ((headless - raw) * 1000))
+print("Snapshot saving over plist: %.2f ms" % ((plist - snapshot) * 1000))
+
+apps = [exec_app, headless_app, snapshot_app, plist_app]
+
+if os.path.exists(VARIANT_EXEC):
+    # The snapshot app got the variant, this one gets the generic binary
+    generic_app = create_app("BenchGeneric", ["-o", "None", "-R"])
+    set_headless_disabled(generic_app, True)
+    shutil.copy(GENERIC_EXEC, app_command(generic_app)[0])
+    apps.append(generic_app)
+    generic = bench("AppKit, generic ScriptExec", app_command(generic_app))
+    print("Variant saving over generic: %.2f ms" % ((generic - snapshot) * 1000))
+    for label, binary in [("Generic", GENERIC_EXEC), ("Variant", VARIANT_EXEC)]:
+        libs = linked_libraries(binary)
+        webkit = any("WebKit" in l for l in libs)
+        print(
+            "%s ScriptExec: %d bytes, %d linked libraries, WebKit %s"
+            % (label, os.path.getsize(binary), len(libs), "linked" if webkit else "not linked")
+        )
+    set_headless_disabled(generic_app, False)
+
+set_headless_disabled(snapshot_app, False)
+set_headless_disabled(plist_app, False)
+os.remove("bench_script.sh")
+for app in apps:
+    shutil.rmtree(app)
@@ -0,0 +1,245 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Tests and search benchmark for the output line store. Portable C, runs
+// on macOS and Linux. Built and run by "make line_store_tests", or with the
+// benchmark by "make line_store_bench".
+//
+//   line_store_bench [benchmark lines]
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+
+#include "PlatypusClock.h"
+#include "SELineStore.h"
+
+static void TestLines(size_t memoryLimit) {
+    SELineStore *store = SELineStoreCreate(memoryLimit);
+    size_t len;
+    const char *line;
+    
+    assert(SELineStoreLineCount(store) == 0);
+    assert(SELineStoreAppend(store, "hello\nwor", 9) == 0);
+    assert(SELineStoreLineCount(store) == 2);
+    assert(SELineStoreAppend(store, "ld\n\nlast", 8) == 0);
+    assert(SELineStoreLineCount(store) == 4);
+    
+    line = SELineStoreGetLine(store, 1, 100, &len);
+    assert(len == 5 && memcmp(line, "world", 5) == 0);
+    line = SELineStoreGetLine(store, 2, 100, &len);
+    assert(line && len == 0);
+    line = SELineStoreGetLine(store, 3, 2, &len);
+    assert(len == 2 && memcmp(line, "la", 2) == 0);
+    assert(SELineStoreGetLine(store, 4, 100, &len) == NULL);
+    assert(SELineStoreMaxLineLength(store) == 5);
+    
+    // A final newline doesn't start a line
+    assert(SELineStoreAppend(store, "\n", 1) == 0);
+    assert(SELineStoreLineCount(store) == 4);
+    
+    FILE *f = tmpfile();
+    assert(SELineStoreWriteToFile(store, fileno(f)) == 0);
+    rewind(f);
+    char buf[64] = { 0 };
+    assert(fread(buf, 1, sizeof(buf) - 1, f) == 18);
+    assert(strcmp(buf, "hello\nworld\n\nlast\n") == 0);
+    fclose(f);
+    
+    SELineStoreClear(store);
+    assert(SELineStoreLineCount(store) == 0 && SELineStoreByteCount(store) == 0);
+    for (int i = 0; i < 100000; i++) {
+        char text[32];
+        int n = snprintf(text, sizeof(text), "line %d\n", i);
+        assert(SELineStoreAppend(store, text, (size_t)n) == 0);
+    }
+    assert(SELineStoreLineCount(store) == 100000);
+    line = SELineStoreGetLine(store, 99999, 100, &len);
+    assert(len == 10 && memcmp(line, "line 99999", 10) == 0);
+    
+    SELineStoreFree(store);
+}
+
+// Lines containing needle, found the slow way
+static size_t NaiveSearch(SELineStore *store, const char *needle, uint64_t *lines) {
+    size_t count = 0;
+    size_t needleLength = strlen(needle);
+    for (uint64_t i = 0; i < SELineStoreLineCount(store); i++) {
+        size_t len;
+        const char *line = SELineStoreGetLine(store, i, SIZE_MAX, &len);
+        for (size_t j = 0; j + needleLength <= len; j++) {
+            if (strncasecmp(line + j, needle, needleLength) == 0) {
+                lines[count++] = i;
+                break;
+            }
+        }
+    }
+    return count;
+}
+
+static void CheckSearch(SELineStore *store, const char *needle, uint64_t *expected) {
+    size_t count = NaiveSearch(store, needle, expected);
+    
+    SELineMatches matches;
+    SELineMatchesInit(&matches);
+    assert(SELineStoreSearch(store, needle, strlen(needle), 0, &matches) == 0);
+    assert(matches.count == count);
+    assert(count == 0 || memcmp(matches.lines, expected, count * sizeof(uint64_t)) == 0);
+    
+    // Searching from a line onwards, as when new output arrives
+    uint64_t from = SELineStoreLineCount(store) / 3;
+    size_t skipped = 0;
+    while (skipped < count && expected[skipped] < from) {
+        skipped++;
+    }
+    matches.count = 0;
+    assert(SELineStoreSearch(store, needle, strlen(needle), from, &matches) == 0);
+    assert(matches.count == count - skipped);
+    
+    SELineMatchesFree(&matches);
+}
+
+static void TestSearch(size_t memoryLimit) {
+    static const char *words[] = { "error", "Warning", "info", "file", "copied", "x", "", "ERR", "é" };
+    SELineStore *store = SELineStoreCreate(memoryLimit);
+    srand(2);
+    
+    // Lines of random words, appended in chunks that split lines
+    char chunk[4096];
+    size_t chunkLength = 0;
+    for (int i = 0; i < 20000; i++) {
+        int words_ = rand() % 6;
+        for (int w = 0; w < words_; w++) {
+            const char *word = words[rand() % (sizeof(words) / sizeof(words[0]))];
+            chunkLength += (size_t)snprintf(chunk + chunkLength, sizeof(chunk) - chunkLength, "%s%d ", word, rand() % 50);
+        }
+        chunk[chunkLength++] = '\n';
+        if (chunkLength > 3000) {
+            size_t split = (size_t)rand() % chunkLength;
+            assert(SELineStoreAppend(store, chunk, split) == 0);
+            assert(SELineStoreAppend(store, chunk + split, chunkLength - split) == 0);
+            chunkLength = 0;
+        }
+    }
+    assert(SELineStoreAppend(store, chunk, chunkLength) == 0);
+    assert(SELineStoreAppend(store, "unterminated Error7", 19) == 0);
+    
+    uint64_t *expected = malloc(sizeof(uint64_t) * SELineStoreLineCount(store));
+    static const char *needles[] = {
+        "error", "ERROR", "rror1", "Error7", "warning4", "x1", "e", "E", "o3 ", "file49 copied",
+        "not there", "é", "info12 info", "copied0 x0 error0", "zzz"
+    };
+    for (size_t i = 0; i < sizeof(needles) / sizeof(needles[0]); i++) {
+        CheckSearch(store, needles[i], expected);
+    }
+    
+    // Narrowing down previous matches
+    SELineMatches wide, narrow;
+    SELineMatchesInit(&wide);
+    SELineMatchesInit(&narrow);
+    assert(SELineStoreSearch(store, "err", 3, 0, &wide) == 0);
+    assert(SELineStoreSearchLines(store, "error4", 6, wide.lines, wide.count, &narrow) == 0);
+    size_t count = NaiveSearch(store, "error4", expected);
+    assert(narrow.count == count && memcmp(narrow.lines, expected, count * sizeof(uint64_t)) == 0);
+    SELineMatchesFree(&wide);
+    SELineMatchesFree(&narrow);
+    
+    // Search index is reset with the store
+    SELineStoreClear(store);
+    SELineMatches matches;
+    SELineMatchesInit(&matches);
+    assert(SELineStoreSearch(store, "error", 5, 0, &matches) == 0 && matches.count == 0);
+    assert(SELineStoreAppend(store, "no\nerrors\n", 10) == 0);
+    assert(SELineStoreSearch(store, "error", 5, 0, &matches) == 0);
+    assert(matches.count == 1 && matches.lines[0] == 1);
+    SELineMatchesFree(&matches);
+    
+    free(expected);
+    SELineStoreFree(store);
+}
+
+#pragma mark - Benchmark
+
+#ifdef BENCHMARK
+
+static void Benchmark(long lines) {
+    SELineStore *store = SELineStoreCreate(SE_LINE_STORE_DEFAULT_MEMORY_LIMIT);
+    
+    double t = PlatypusClockNow();
+    char text[128];
+    for (long i = 0; i < lines; i++) {
+        int n;
+        if (i % 100000 == 77777) {
+            n = snprintf(text, sizeof(text), "%ld ERROR: Could not open file /tmp/batch/%ld.dat\n", i, i);
+        } else {
+            n = snprintf(text, sizeof(text), "%ld Processed file /tmp/batch/%ld.dat in %ld ms\n", i, i, i % 997);
+        }
+        SELineStoreAppend(store, text, (size_t)n);
+    }
+    double elapsed = PlatypusClockNow() - t;
+    printf("Appended %ld lines (%.0f MB) at %.1f M lines/s\n",
+           lines, SELineStoreByteCount(store) / (1024.0 * 1024.0), lines / elapsed / 1e6);
+    
+    static const char *needles[] = { "could not open", "error", "batch/123456.", "er", "no such thing" };
+    for (size_t i = 0; i < sizeof(needles) / sizeof(needles[0]); i++) {
+        SELineMatches matches;
+        SELineMatchesInit(&matches);
+        t = PlatypusClockNow();
+        SELineStoreSearch(store, needles[i], strlen(needles[i]), 0, &matches);
+        elapsed = PlatypusClockNow() - t;
+        printf("Search for \"%s\": %zu lines in %.2f ms\n", needles[i], matches.count, elapsed * 1000);
+        SELineMatchesFree(&matches);
+    }
+    
+    SELineStoreFree(store);
+}
+
+#endif
+
+int main(int argc, const char *argv[]) {
+    TestLines(SE_LINE_STORE_DEFAULT_MEMORY_LIMIT);
+    TestLines(16);
+    TestSearch(SE_LINE_STORE_DEFAULT_MEMORY_LIMIT);
+    TestSearch(1000);
+    printf("Line store tests passed\n");
+    
+#ifdef BENCHMARK
+    long lines = (argc > 1) ? atol(argv[1]) : 2000000;
+    Benchmark(lines);
+#endif
+    
+    return EXIT_SUCCESS;
+}
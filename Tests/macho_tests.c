@@ -0,0 +1,396 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Tests and benchmark for thinning Mach-O fat binaries. The fixtures are
+// built here: Mach-O headers followed by filler, in fat binaries laid out
+// the way lipo lays them out. On macOS, a system binary is thinned as well.
+// Portable C, runs on macOS and Linux. Built and run by "make macho_tests",
+// or with the benchmark by "make macho_bench".
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "PlatypusClock.h"
+#include "PlatypusMachO.h"
+
+#define X86_64      0x01000007, 3
+#define ARM64       0x0100000c, 0
+#define ARM64E      0x0100000c, (int32_t)0x80000002
+#define I386        7, 3
+
+typedef struct Fixture {
+    int32_t cpuType;
+    int32_t cpuSubtype;
+    size_t size;
+    uint32_t align;
+} Fixture;
+
+static void Put32(uint8_t *p, uint32_t v, int big) {
+    for (int i = 0; i < 4; i++) {
+        p[big ? i : 3 - i] = (uint8_t)(v >> (24 - 8 * i));
+    }
+}
+
+static uint32_t Get32(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+// A little-endian 64-bit Mach-O header, then bytes telling slices apart
+static void MakeSlice(uint8_t *p, const Fixture *f, uint8_t fill) {
+    memset(p, fill, f->size);
+    Put32(p, 0xfeedfacf, 0);
+    Put32(p + 4, (uint32_t)f->cpuType, 0);
+    Put32(p + 8, (uint32_t)f->cpuSubtype, 0);
+}
+
+static uint8_t *MakeFat(const Fixture *fixtures, size_t count, int fat64, size_t *size) {
+    size_t archSize = fat64 ? 32 : 20;
+    size_t end = 8 + count * archSize;
+    size_t offsets[8];
+    for (size_t i = 0; i < count; i++) {
+        size_t alignment = (size_t)1 << fixtures[i].align;
+        offsets[i] = (end + alignment - 1) & ~(alignment - 1);
+        end = offsets[i] + fixtures[i].size;
+    }
+    uint8_t *p = calloc(1, end);
+    Put32(p, fat64 ? 0xcafebabf : 0xcafebabe, 1);
+    Put32(p + 4, (uint32_t)count, 1);
+    for (size_t i = 0; i < count; i++) {
+        uint8_t *a = p + 8 + i * archSize;
+        Put32(a, (uint32_t)fixtures[i].cpuType, 1);
+        Put32(a + 4, (uint32_t)fixtures[i].cpuSubtype, 1);
+        if (fat64) {
+            Put32(a + 12, (uint32_t)offsets[i], 1);
+            Put32(a + 20, (uint32_t)fixtures[i].size, 1);
+            Put32(a + 24, fixtures[i].align, 1);
+        } else {
+            Put32(a + 8, (uint32_t)offsets[i], 1);
+            Put32(a + 12, (uint32_t)fixtures[i].size, 1);
+            Put32(a + 16, fixtures[i].align, 1);
+        }
+        MakeSlice(p + offsets[i], &fixtures[i], (uint8_t)('a' + i));
+    }
+    *size = end;
+    return p;
+}
+
+static const uint8_t *SliceData(const uint8_t *fat, size_t size, size_t index, size_t *sliceSize) {
+    PlatypusMachOSlice slices[PLATYPUS_MACHO_MAX_SLICES];
+    size_t count;
+    int isFat;
+    assert(PlatypusMachOSlices(fat, size, slices, PLATYPUS_MACHO_MAX_SLICES, &count, &isFat) == 0);
+    assert(index < count);
+    *sliceSize = slices[index].size;
+    return fat + slices[index].offset;
+}
+
+#pragma mark - Tests
+
+static void TestArchitectureNames(void) {
+    assert(strcmp(PlatypusMachOArchitectureName(X86_64), "x86_64") == 0);
+    assert(strcmp(PlatypusMachOArchitectureName(ARM64), "arm64") == 0);
+    assert(strcmp(PlatypusMachOArchitectureName(ARM64E), "arm64e") == 0);
+    assert(PlatypusMachOArchitectureName(0x0100000c, 77) == NULL);
+    assert(PlatypusMachOArchitectureIsKnown("arm64"));
+    assert(PlatypusMachOArchitectureIsKnown("i386"));
+    assert(!PlatypusMachOArchitectureIsKnown("arm"));
+    assert(!PlatypusMachOArchitectureIsKnown(""));
+    assert(!PlatypusMachOArchitectureIsKnown(NULL));
+}
+
+static void TestSlices(void) {
+    Fixture fixtures[] = { { X86_64, 5000, 12 }, { ARM64, 7000, 14 } };
+    size_t size;
+    uint8_t *fat = MakeFat(fixtures, 2, 0, &size);
+    
+    PlatypusMachOSlice slices[PLATYPUS_MACHO_MAX_SLICES];
+    size_t count;
+    int isFat;
+    assert(PlatypusMachOSlices(fat, size, slices, PLATYPUS_MACHO_MAX_SLICES, &count, &isFat) == 0);
+    assert(count == 2 && isFat);
+    assert(slices[0].offset == 4096 && slices[0].size == 5000 && slices[0].align == 12);
+    assert(slices[1].offset == 16384 && slices[1].size == 7000 && slices[1].align == 14);
+    assert(strcmp(PlatypusMachOArchitectureName(slices[1].cpuType, slices[1].cpuSubtype), "arm64") == 0);
+    assert(PlatypusMachOSlices(fat, size, slices, 1, &count, &isFat) == E2BIG);
+    
+    // A plain Mach-O binary is a single slice
+    size_t sliceSize;
+    const uint8_t *slice = SliceData(fat, size, 1, &sliceSize);
+    assert(PlatypusMachOSlices(slice, sliceSize, slices, PLATYPUS_MACHO_MAX_SLICES, &count, &isFat) == 0);
+    assert(count == 1 && !isFat);
+    assert(slices[0].offset == 0 && slices[0].size == sliceSize);
+    assert(strcmp(PlatypusMachOArchitectureName(slices[0].cpuType, slices[0].cpuSubtype), "arm64") == 0);
+    free(fat);
+}
+
+static void TestMalformed(void) {
+    Fixture fixtures[] = { { X86_64, 5000, 12 }, { ARM64, 7000, 14 } };
+    size_t size;
+    uint8_t *fat = MakeFat(fixtures, 2, 0, &size);
+    PlatypusMachOSlice slices[PLATYPUS_MACHO_MAX_SLICES];
+    size_t count;
+    int isFat;
+    
+    // Truncated
+    assert(PlatypusMachOSlices(fat, 4, slices, PLATYPUS_MACHO_MAX_SLICES, &count, &isFat) == EINVAL);
+    assert(PlatypusMachOSlices(fat, 30, slices, PLATYPUS_MACHO_MAX_SLICES, &count, &isFat) == EINVAL);
+    assert(PlatypusMachOSlices(fat, size - 1, slices, PLATYPUS_MACHO_MAX_SLICES, &count, &isFat) == EINVAL);
+    
+    // Not Mach-O at all
+    const char text[] = "#!/bin/sh\necho hello\n";
+    assert(PlatypusMachOSlices(text, sizeof(text), slices, PLATYPUS_MACHO_MAX_SLICES, &count, &isFat) == EINVAL);
+    
+    // A Java class file, with its version where the slice count would be
+    uint8_t *copy = malloc(size);
+    memcpy(copy, fat, size);
+    Put32(copy + 4, 52, 1);
+    assert(PlatypusMachOSlices(copy, size, slices, PLATYPUS_MACHO_MAX_SLICES, &count, &isFat) == EINVAL);
+    
+    // Overlapping slices
+    memcpy(copy, fat, size);
+    Put32(copy + 8 + 20 + 8, 4096 + 100, 1);
+    assert(PlatypusMachOSlices(copy, size, slices, PLATYPUS_MACHO_MAX_SLICES, &count, &isFat) == EINVAL);
+    
+    // Slice inside the header
+    memcpy(copy, fat, size);
+    Put32(copy + 8 + 8, 16, 1);
+    assert(PlatypusMachOSlices(copy, size, slices, PLATYPUS_MACHO_MAX_SLICES, &count, &isFat) == EINVAL);
+    
+    // Unreasonable alignment
+    memcpy(copy, fat, size);
+    Put32(copy + 8 + 16, 40, 1);
+    assert(PlatypusMachOSlices(copy, size, slices, PLATYPUS_MACHO_MAX_SLICES, &count, &isFat) == EINVAL);
+    
+    // Size wrapping around
+    memcpy(copy, fat, size);
+    Put32(copy + 8 + 12, 0xffffffff, 1);
+    assert(PlatypusMachOSlices(copy, size, slices, PLATYPUS_MACHO_MAX_SLICES, &count, &isFat) == EINVAL);
+    
+    free(copy);
+    free(fat);
+}
+
+static void TestThin(void) {
+    Fixture fixtures[] = { { X86_64, 5000, 12 }, { ARM64, 7000, 14 }, { I386, 3000, 12 } };
+    size_t size;
+    uint8_t *fat = MakeFat(fixtures, 3, 0, &size);
+    void *thinned;
+    size_t thinnedSize;
+    
+    // One architecture leaves just its slice
+    const char *arm[] = { "arm64" };
+    assert(PlatypusMachOThin(fat, size, arm, 1, &thinned, &thinnedSize) == 0);
+    size_t sliceSize;
+    const uint8_t *slice = SliceData(fat, size, 1, &sliceSize);
+    assert(thinnedSize == sliceSize && memcmp(thinned, slice, sliceSize) == 0);
+    free(thinned);
+    
+    // Several leave a fat binary with those, in their original order
+    const char *intel[] = { "i386", "x86_64" };
+    assert(PlatypusMachOThin(fat, size, intel, 2, &thinned, &thinnedSize) == 0);
+    assert(thinnedSize < size && Get32(thinned) == 0xcafebabe && Get32((uint8_t *)thinned + 4) == 2);
+    PlatypusMachOSlice slices[PLATYPUS_MACHO_MAX_SLICES];
+    size_t count;
+    int isFat;
+    assert(PlatypusMachOSlices(thinned, thinnedSize, slices, PLATYPUS_MACHO_MAX_SLICES, &count, &isFat) == 0);
+    assert(count == 2 && isFat);
+    for (size_t i = 0; i < 2; i++) {
+        size_t index = i ? 2 : 0;
+        slice = SliceData(fat, size, index, &sliceSize);
+        assert(slices[i].size == sliceSize && slices[i].align == fixtures[index].align);
+        assert(slices[i].offset % ((uint64_t)1 << slices[i].align) == 0);
+        assert(memcmp((uint8_t *)thinned + slices[i].offset, slice, sliceSize) == 0);
+    }
+    free(thinned);
+    
+    // All of them leave the binary as it was
+    const char *all[] = { "arm64", "i386", "x86_64" };
+    assert(PlatypusMachOThin(fat, size, all, 3, &thinned, &thinnedSize) == 0);
+    assert(thinnedSize == size && memcmp(thinned, fat, size) == 0);
+    free(thinned);
+    
+    const char *missing[] = { "arm64", "arm64e" };
+    assert(PlatypusMachOThin(fat, size, missing, 2, &thinned, &thinnedSize) == ENOENT);
+    assert(thinned == NULL);
+    const char *unknown[] = { "arm64", "sparc" };
+    assert(PlatypusMachOThin(fat, size, unknown, 2, &thinned, &thinnedSize) == EINVAL);
+    assert(PlatypusMachOThin(fat, size, arm, 0, &thinned, &thinnedSize) == EINVAL);
+    
+    // A plain Mach-O binary only has its own architecture
+    slice = SliceData(fat, size, 1, &sliceSize);
+    assert(PlatypusMachOThin(slice, sliceSize, arm, 1, &thinned, &thinnedSize) == 0);
+    assert(thinnedSize == sliceSize && memcmp(thinned, slice, sliceSize) == 0);
+    free(thinned);
+    assert(PlatypusMachOThin(slice, sliceSize, intel, 1, &thinned, &thinnedSize) == ENOENT);
+    free(fat);
+}
+
+static void TestThinFat64(void) {
+    // arm64e has capability bits set in its subtype
+    Fixture fixtures[] = { { X86_64, 6000, 12 }, { ARM64, 7000, 14 }, { ARM64E, 8000, 14 } };
+    size_t size;
+    uint8_t *fat = MakeFat(fixtures, 3, 1, &size);
+    const char *archs[] = { "arm64e", "x86_64" };
+    void *thinned;
+    size_t thinnedSize;
+    assert(PlatypusMachOThin(fat, size, archs, 2, &thinned, &thinnedSize) == 0);
+    assert(Get32(thinned) == 0xcafebabf);
+    PlatypusMachOSlice slices[PLATYPUS_MACHO_MAX_SLICES];
+    size_t count;
+    int isFat;
+    assert(PlatypusMachOSlices(thinned, thinnedSize, slices, PLATYPUS_MACHO_MAX_SLICES, &count, &isFat) == 0);
+    assert(count == 2);
+    assert(strcmp(PlatypusMachOArchitectureName(slices[0].cpuType, slices[0].cpuSubtype), "x86_64") == 0);
+    assert(strcmp(PlatypusMachOArchitectureName(slices[1].cpuType, slices[1].cpuSubtype), "arm64e") == 0);
+    assert(slices[1].cpuSubtype == (int32_t)0x80000002);
+    free(thinned);
+    free(fat);
+}
+
+static void TestThinFile(void) {
+    char path[] = "/tmp/macho_tests.XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd != -1);
+    Fixture fixtures[] = { { X86_64, 50000, 12 }, { ARM64, 70000, 14 } };
+    size_t size;
+    uint8_t *fat = MakeFat(fixtures, 2, 0, &size);
+    ssize_t written = write(fd, fat, size);
+    int err = fchmod(fd, 0751);
+    assert(written == (ssize_t)size && err == 0);
+    close(fd);
+    
+    const char *arm[] = { "arm64" };
+    size_t removed;
+    assert(PlatypusMachOThinFile(path, arm, 1, &removed) == 0);
+    struct stat st;
+    err = stat(path, &st);
+    assert(err == 0);
+    assert((size_t)st.st_size == 70000 && removed == size - 70000);
+    assert((st.st_mode & 07777) == 0751);
+    
+    // Nothing left to remove
+    ino_t inode = st.st_ino;
+    assert(PlatypusMachOThinFile(path, arm, 1, &removed) == 0 && removed == 0);
+    err = stat(path, &st);
+    assert(err == 0 && st.st_ino == inode);
+    
+    const char *intel[] = { "x86_64" };
+    assert(PlatypusMachOThinFile(path, intel, 1, &removed) == ENOENT);
+    err = stat(path, &st);
+    assert(err == 0 && (size_t)st.st_size == 70000);
+    assert(PlatypusMachOThinFile("/nonexistent/ScriptExec", arm, 1, &removed) == ENOENT);
+    unlink(path);
+    free(fat);
+}
+
+#ifdef __APPLE__
+// A real universal binary, if the system has one
+static void TestSystemBinary(void) {
+    const char *source = "/usr/bin/true";
+    FILE *f = fopen(source, "rb");
+    if (f == NULL) {
+        return;
+    }
+    uint8_t *data = malloc(1 << 20);
+    size_t size = fread(data, 1, 1 << 20, f);
+    fclose(f);
+    
+    PlatypusMachOSlice slices[PLATYPUS_MACHO_MAX_SLICES];
+    size_t count;
+    int isFat;
+    if (PlatypusMachOSlices(data, size, slices, PLATYPUS_MACHO_MAX_SLICES, &count, &isFat) == 0 && isFat) {
+        const char *name = PlatypusMachOArchitectureName(slices[0].cpuType, slices[0].cpuSubtype);
+        void *thinned;
+        size_t thinnedSize;
+        assert(PlatypusMachOThin(data, size, &name, 1, &thinned, &thinnedSize) == 0);
+        assert(thinnedSize == slices[0].size);
+        printf("Thinned %s to %s: %zu of %zu bytes\n", source, name, thinnedSize, size);
+        free(thinned);
+    }
+    free(data);
+}
+#endif
+
+#pragma mark - Benchmark
+
+#ifdef BENCHMARK
+
+// Thinning a two architecture binary the size of a large ScriptExec
+static void Benchmark(void) {
+    const size_t sliceSize = 8 << 20;
+    Fixture fixtures[] = { { X86_64, sliceSize, 12 }, { ARM64, sliceSize, 14 } };
+    size_t size;
+    uint8_t *fat = MakeFat(fixtures, 2, 0, &size);
+    char path[] = "/tmp/macho_bench.XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd != -1);
+    ssize_t written = write(fd, fat, size);
+    assert(written == (ssize_t)size);
+    close(fd);
+    
+    const char *arm[] = { "arm64" };
+    size_t removed;
+    double start = PlatypusClockNow();
+    int err = PlatypusMachOThinFile(path, arm, 1, &removed);
+    double elapsed = PlatypusClockNow() - start;
+    assert(err == 0);
+    printf("Thinning a %zu MB universal binary to arm64: %.1f ms, %zu MB saved\n",
+           size >> 20, elapsed * 1e3, removed >> 20);
+    unlink(path);
+    free(fat);
+}
+
+#endif
+
+int main(void) {
+    TestArchitectureNames();
+    TestSlices();
+    TestMalformed();
+    TestThin();
+    TestThinFat64();
+    TestThinFile();
+#ifdef __APPLE__
+    TestSystemBinary();
+#endif
+    printf("All Mach-O tests passed\n");
+    
+#ifdef BENCHMARK
+    Benchmark();
+#endif
+    return 0;
+}
@@ -0,0 +1,243 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Tests and benchmark for job metrics. Portable C, runs on macOS and
+// Linux. Built and run by "make metrics_tests", or with the benchmark by
+// "make metrics_bench".
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "SEMetrics.h"
+
+static SEJobRecord Record(double wait, double duration, int status) {
+    SEJobRecord r;
+    memset(&r, 0, sizeof(r));
+    r.enqueueTime = SEMetricsNow() - wait - duration;
+    r.startTime = r.enqueueTime + wait;
+    r.endTime = r.startTime + duration;
+    r.startDate = 1700000000.5;
+    r.userTime = 0.25;
+    r.systemTime = 0.125;
+    r.maxResidentSize = 1024 * 1024;
+    r.outputBytes = 100;
+    r.exitStatus = status;
+    return r;
+}
+
+static void TestAggregation(void) {
+    SEMetrics *m = SEMetricsCreate();
+    assert(SEMetricsPercentile(m, SEMetricsHistogram_Duration, 50) == 0);
+    
+    // 100 jobs taking 0.007 s to 0.997 s
+    for (int i = 1; i <= 100; i++) {
+        SEMetricsJobQueued(m);
+        SEMetricsJobStarted(m);
+        SEJobRecord r = Record(0.002, (i - 0.3) / 100, i % 10 == 0);
+        r.timedOut = (i % 50 == 0);
+        SEMetricsJobFinished(m, &r);
+    }
+    SEMetricsSetQueueDepth(m, 7);
+    SEMetricsSetQueueDepth(m, 2);
+    
+    // Bucket estimates are only as good as the bucket bounds
+    double p50 = SEMetricsPercentile(m, SEMetricsHistogram_Duration, 50);
+    double p90 = SEMetricsPercentile(m, SEMetricsHistogram_Duration, 90);
+    double p100 = SEMetricsPercentile(m, SEMetricsHistogram_Duration, 100);
+    assert(p50 > 0.1 && p50 <= 0.5);
+    assert(p90 > 0.5 && p90 <= 1);
+    assert(fabs(p100 - 0.997) < 1e-6);
+    double wait = SEMetricsPercentile(m, SEMetricsHistogram_QueueWait, 99);
+    assert(wait > 0.001 && wait <= 0.005);
+    assert(fabs(SEMetricsThroughput(m) - 100.0 / 60) < 1e-9);
+    
+    size_t length;
+    char *text = SEMetricsCopyPrometheusText(m, &length);
+    assert(text && strlen(text) == length);
+    assert(strstr(text, "\nplatypus_jobs_finished_total 100\n"));
+    assert(strstr(text, "\nplatypus_jobs_failed_total 10\n"));
+    assert(strstr(text, "\nplatypus_jobs_timed_out_total 2\n"));
+    assert(strstr(text, "\nplatypus_jobs_running 0\n"));
+    assert(strstr(text, "\nplatypus_job_queue_depth 2\n"));
+    assert(strstr(text, "\nplatypus_job_queue_depth_max 7\n"));
+    assert(strstr(text, "\nplatypus_job_output_bytes_total 10000\n"));
+    assert(strstr(text, "\nplatypus_job_user_cpu_seconds_total 25\n"));
+    assert(strstr(text, "\nplatypus_job_duration_seconds_bucket{le=\"0.01\"} 1\n"));
+    assert(strstr(text, "\nplatypus_job_duration_seconds_bucket{le=\"0.1\"} 10\n"));
+    assert(strstr(text, "\nplatypus_job_duration_seconds_bucket{le=\"+Inf\"} 100\n"));
+    assert(strstr(text, "\nplatypus_job_duration_seconds_count 100\n"));
+    assert(strstr(text, "\nplatypus_job_queue_wait_seconds_bucket{le=\"0.001\"} 0\n"));
+    free(text);
+    
+    SEMetricsFree(m);
+}
+
+static void TestJSON(void) {
+    SEJobRecord r = Record(1, 2, 3);
+    char line[512];
+    int n = SEJobRecordFormatJSON(&r, line, sizeof(line));
+    assert(n > 0 && line[n - 1] == '\n' && strchr(line, '\n') == line + n - 1);
+    assert(strncmp(line, "{\"start\":1700000000.500,\"queue_wait\":1.0", 40) == 0);
+    assert(strstr(line, "\"max_rss\":1048576,\"output_bytes\":100,\"exit_status\":3,\"timed_out\":false}"));
+    r.timedOut = 1;
+    n = SEJobRecordFormatJSON(&r, line, sizeof(line));
+    assert(strstr(line, "\"exit_status\":3,\"timed_out\":true}"));
+    
+    char path[] = "/tmp/metrics_tests.XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd != -1);
+    close(fd);
+    SEMetrics *m = SEMetricsCreate();
+    assert(SEMetricsOpenJSONLinesFile(m, path) == 0);
+    SEMetricsJobFinished(m, &r);
+    SEMetricsJobFinished(m, &r);
+    SEMetricsFree(m);
+    
+    FILE *f = fopen(path, "r");
+    char buf[2048];
+    size_t len = fread(buf, 1, sizeof(buf), f);
+    fclose(f);
+    unlink(path);
+    assert(len == 2 * (size_t)n);
+    assert(memcmp(buf, line, n) == 0 && memcmp(buf + n, line, n) == 0);
+}
+
+static char *Fetch(const char *socketPath, const char *request) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socketPath);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    int err = connect(fd, (struct sockaddr *)&addr, sizeof(addr));
+    assert(err == 0);
+    if (request) {
+        ssize_t written = write(fd, request, strlen(request));
+        assert(written == (ssize_t)strlen(request));
+    }
+    size_t capacity = 65536, length = 0;
+    char *buf = malloc(capacity);
+    ssize_t n;
+    while ((n = read(fd, buf + length, capacity - length - 1)) > 0) {
+        length += (size_t)n;
+    }
+    close(fd);
+    buf[length] = '\0';
+    return buf;
+}
+
+static void TestServer(void) {
+    char dir[] = "/tmp/metrics_tests.XXXXXX";
+    char *created = mkdtemp(dir);
+    assert(created);
+    char path[256];
+    snprintf(path, sizeof(path), "%s/metrics.sock", dir);
+    
+    SEMetrics *m = SEMetricsCreate();
+    assert(SEMetricsStartServer(m, path) == 0);
+    SEJobRecord r = Record(0, 0.5, 0);
+    SEMetricsJobFinished(m, &r);
+    
+    char *text = Fetch(path, NULL);
+    assert(strncmp(text, "# HELP platypus_jobs_queued_total", 33) == 0);
+    assert(strstr(text, "\nplatypus_jobs_finished_total 1\n"));
+    free(text);
+    
+    text = Fetch(path, "GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    assert(strncmp(text, "HTTP/1.0 200 OK\r\n", 17) == 0);
+    char *body = strstr(text, "\r\n\r\n");
+    assert(body);
+    size_t contentLength = 0;
+    assert(sscanf(strstr(text, "Content-Length: "), "Content-Length: %zu", &contentLength) == 1);
+    assert(strlen(body + 4) == contentLength);
+    free(text);
+    
+    SEMetricsFree(m);
+    assert(access(path, F_OK) != 0);
+    rmdir(dir);
+    
+    // Socket paths are limited in length
+    char longPath[300];
+    memset(longPath, 'x', sizeof(longPath) - 1);
+    longPath[0] = '/';
+    longPath[sizeof(longPath) - 1] = '\0';
+    m = SEMetricsCreate();
+    assert(SEMetricsStartServer(m, longPath) != 0);
+    SEMetricsFree(m);
+}
+
+#pragma mark - Benchmark
+
+#ifdef BENCHMARK
+
+static void Benchmark(void) {
+    SEMetrics *m = SEMetricsCreate();
+    SEJobRecord r = Record(0.01, 0.2, 0);
+    const int count = 1000000;
+    double start = SEMetricsNow();
+    for (int i = 0; i < count; i++) {
+        SEMetricsJobStarted(m);
+        SEMetricsJobFinished(m, &r);
+    }
+    double elapsed = SEMetricsNow() - start;
+    
+    start = SEMetricsNow();
+    size_t length = 0;
+    for (int i = 0; i < 1000; i++) {
+        free(SEMetricsCopyPrometheusText(m, &length));
+    }
+    double formatted = SEMetricsNow() - start;
+    
+    printf("%d jobs recorded: %.0f ns per job. Prometheus text (%zu bytes): %.1f us\n",
+           count, elapsed * 1e9 / count, length, formatted * 1e3);
+    SEMetricsFree(m);
+}
+
+#endif
+
+int main(void) {
+    TestAggregation();
+    TestJSON();
+    TestServer();
+    printf("All metrics tests passed\n");
+    
+#ifdef BENCHMARK
+    Benchmark();
+#endif
+    return 0;
+}
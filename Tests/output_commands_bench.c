@@ -0,0 +1,165 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Tests and microbenchmark for the output command dispatcher. Portable C,
+// runs on macOS and Linux. Built and run by "make output_commands_bench".
+//
+//   output_commands_bench [lines per run]
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "PlatypusClock.h"
+#include "SEOutputCommands.h"
+
+static SEOutputCommandType Parse(const char *line, SEOutputCommand *command) {
+    return SEOutputCommandParse(line, strlen(line), command);
+}
+
+static void TestParsing(void) {
+    SEOutputCommand c;
+    
+    assert(Parse("QUITAPP", &c) == SEOutputCommand_Quit);
+    assert(Parse("QUITAPP ", &c) == SEOutputCommand_None);
+    assert(Parse("REFRESH", &c) == SEOutputCommand_Refresh);
+    assert(Parse("DETAILS:SHOW", &c) == SEOutputCommand_DetailsShow);
+    assert(Parse("DETAILS:HIDE", &c) == SEOutputCommand_DetailsHide);
+    assert(Parse("DETAILS:", &c) == SEOutputCommand_None);
+    assert(Parse("", &c) == SEOutputCommand_None);
+    assert(Parse("hello world", &c) == SEOutputCommand_None);
+    assert(Parse("ALERT", &c) == SEOutputCommand_None);
+    
+    assert(Parse("ALERT:Title|Text", &c) == SEOutputCommand_Alert);
+    assert(c.argumentLength == 10 && memcmp(c.argument, "Title|Text", 10) == 0);
+    assert(Parse("NOTIFICATION:", &c) == SEOutputCommand_Notification && c.argumentLength == 0);
+    assert(Parse("LOCATION:https://sveinbjorn.org", &c) == SEOutputCommand_Location);
+    
+    assert(Parse("PROGRESS:42", &c) == SEOutputCommand_Progress && c.hasProgress && c.progress == 42);
+    assert(Parse("PROGRESS:42.5%", &c) == SEOutputCommand_Progress && c.hasProgress && c.progress == 42.5);
+    assert(Parse("PROGRESS: 7,25 % ", &c) == SEOutputCommand_Progress && c.hasProgress && c.progress == 7.25);
+    assert(Parse("PROGRESS:-3", &c) == SEOutputCommand_Progress && c.hasProgress && c.progress == -3);
+    assert(Parse("PROGRESS:", &c) == SEOutputCommand_Progress && !c.hasProgress);
+    assert(Parse("PROGRESS:abc", &c) == SEOutputCommand_Progress && !c.hasProgress);
+    assert(Parse("PROGRESS:1.2.3", &c) == SEOutputCommand_Progress && !c.hasProgress);
+    assert(Parse("PROGRESS:%", &c) == SEOutputCommand_Progress && !c.hasProgress);
+    assert(Parse("PROGRESS:99999999999999999999999", &c) == SEOutputCommand_Progress && c.hasProgress && c.progress > 9e22);
+}
+
+#pragma mark - Benchmark
+
+// What parseOutput: used to do for each line, minus the string allocations
+static SEOutputCommandType ParsePrefixChain(const char *line, size_t len, double *progress) {
+    if (len == 7 && strncmp(line, "QUITAPP", 7) == 0) return SEOutputCommand_Quit;
+    if (len == 7 && strncmp(line, "REFRESH", 7) == 0) return SEOutputCommand_Refresh;
+    if (len >= 13 && strncmp(line, "NOTIFICATION:", 13) == 0) return SEOutputCommand_Notification;
+    if (len >= 6 && strncmp(line, "ALERT:", 6) == 0) return SEOutputCommand_Alert;
+    if (len >= 9 && strncmp(line, "PROGRESS:", 9) == 0) {
+        char buf[64];
+        size_t n = len - 9 < sizeof(buf) - 1 ? len - 9 : sizeof(buf) - 1;
+        memcpy(buf, line + 9, n);
+        buf[n] = '\0';
+        *progress = strtod(buf, NULL);
+        return SEOutputCommand_Progress;
+    }
+    if (len == 12 && strncmp(line, "DETAILS:SHOW", 12) == 0) return SEOutputCommand_DetailsShow;
+    if (len == 12 && strncmp(line, "DETAILS:HIDE", 12) == 0) return SEOutputCommand_DetailsHide;
+    if (len >= 9 && strncmp(line, "LOCATION:", 9) == 0) return SEOutputCommand_Location;
+    return SEOutputCommand_None;
+}
+
+static char *MakeOutput(long lines, int progressEvery, size_t *size) {
+    char *buf = malloc((size_t)lines * 64);
+    assert(buf);
+    size_t n = 0;
+    for (long i = 0; i < lines; i++) {
+        if (progressEvery && i % progressEvery == 0) {
+            n += (size_t)sprintf(buf + n, "PROGRESS:%ld.%ld%%\n", (i / 7) % 100, i % 10);
+        } else {
+            n += (size_t)sprintf(buf + n, "Processing file %ld of the batch, please wait\n", i);
+        }
+    }
+    *size = n;
+    return buf;
+}
+
+// Split output into lines and classify each, as ScriptExec does
+static void Run(const char *label, const char *buf, size_t size, long lines, int prefixChain) {
+    double t = PlatypusClockNow();
+    long commands = 0;
+    double progress = 0;
+    const char *start = buf;
+    const char *end = buf + size;
+    while (start < end) {
+        const char *nl = memchr(start, '\n', (size_t)(end - start));
+        size_t len = (size_t)(nl - start);
+        SEOutputCommandType type;
+        if (prefixChain) {
+            type = ParsePrefixChain(start, len, &progress);
+        } else {
+            SEOutputCommand c;
+            type = SEOutputCommandParse(start, len, &c);
+            progress = c.hasProgress ? c.progress : progress;
+        }
+        commands += (type != SEOutputCommand_None);
+        start = nl + 1;
+    }
+    double elapsed = PlatypusClockNow() - t;
+    printf("%-34s %8.1f M lines/s (%ld commands, last progress %.1f)\n",
+           label, lines / elapsed / 1e6, commands, progress);
+}
+
+int main(int argc, const char *argv[]) {
+    long lines = (argc > 1) ? atol(argv[1]) : 5000000;
+    
+    TestParsing();
+    printf("Parser tests passed\n");
+    
+    static const struct { const char *label; int progressEvery; } mixes[] = {
+        { "data only", 0 },
+        { "1 in 10 progress", 10 },
+        { "progress only", 1 },
+    };
+    for (size_t i = 0; i < sizeof(mixes) / sizeof(mixes[0]); i++) {
+        size_t size;
+        char *buf = MakeOutput(lines, mixes[i].progressEvery, &size);
+        char label[64];
+        snprintf(label, sizeof(label), "dispatch table, %s:", mixes[i].label);
+        Run(label, buf, size, lines, 0);
+        snprintf(label, sizeof(label), "prefix chain, %s:", mixes[i].label);
+        Run(label, buf, size, lines, 1);
+        free(buf);
+    }
+    
+    return EXIT_SUCCESS;
+}
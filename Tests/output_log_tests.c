@@ -0,0 +1,236 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Tests and write benchmark for the output log. Portable C, runs on macOS
+// and Linux. Built and run by "make output_log_tests", or with the benchmark
+// by "make output_log_bench".
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include "PlatypusClock.h"
+#include "SEOutputLog.h"
+
+static char dir[] = "/tmp/output_log_tests.XXXXXX";
+
+static int Exists(const char *path) {
+    struct stat st;
+    return stat(path, &st) == 0;
+}
+
+// Appends the (possibly gzipped) contents of a file to buf
+static size_t ReadFile(const char *path, char *buf, size_t size) {
+    gzFile f = gzopen(path, "rb");
+    assert(f);
+    int n = gzread(f, buf, (unsigned int)size);
+    assert(n >= 0);
+    gzclose(f);
+    return (size_t)n;
+}
+
+static void RemoveLogs(const char *path) {
+    char seg[PATH_MAX];
+    unlink(path);
+    for (int i = 1; i < 10; i++) {
+        snprintf(seg, sizeof(seg), "%s.%d", path, i);
+        unlink(seg);
+        snprintf(seg, sizeof(seg), "%s.%d.gz", path, i);
+        unlink(seg);
+    }
+}
+
+// Output written to the log should be the concatenation of the segments,
+// oldest first, minus whatever was rotated away
+static void TestRotation(int compress) {
+    // Leaves room for segment suffixes in segment paths
+    char path[PATH_MAX / 2];
+    snprintf(path, sizeof(path), "%s/Output.log", dir);
+    RemoveLogs(path);
+    
+    SEOutputLogConfig config = { path, 4096, 0, 3, compress };
+    int err = 0;
+    SEOutputLog *log = SEOutputLogOpen(&config, &err);
+    assert(log && err == 0);
+    
+    size_t total = 0;
+    char *written = malloc(1 << 20);
+    for (int i = 0; i < 20000; i++) {
+        char line[64];
+        int n = snprintf(line, sizeof(line), "line %d\n", i);
+        SEOutputLogWrite(log, line, (size_t)n);
+        memcpy(written + total, line, (size_t)n);
+        total += (size_t)n;
+        // Flush now and then so rotation happens between batches
+        if (i % 200 == 199) {
+            SEOutputLogFlush(log);
+        }
+    }
+    SEOutputLogClose(log);
+    
+    char seg[PATH_MAX];
+    const char *suffix = compress ? ".gz" : "";
+    for (int i = 1; i <= 3; i++) {
+        snprintf(seg, sizeof(seg), "%s.%d%s", path, i, suffix);
+        assert(Exists(seg));
+        snprintf(seg, sizeof(seg), "%s.%d%s", path, i, compress ? "" : ".gz");
+        assert(!Exists(seg));
+    }
+    snprintf(seg, sizeof(seg), "%s.4%s", path, suffix);
+    assert(!Exists(seg));
+    
+    char *read = malloc(1 << 20);
+    size_t length = 0;
+    for (int i = 3; i >= 1; i--) {
+        snprintf(seg, sizeof(seg), "%s.%d%s", path, i, suffix);
+        length += ReadFile(seg, read + length, (1 << 20) - length);
+    }
+    length += ReadFile(path, read + length, (1 << 20) - length);
+    assert(length > 0 && length < total);
+    assert(memcmp(read, written + total - length, length) == 0);
+    // Segments begin with complete lines since writes are never split
+    assert(read[0] == 'l');
+    
+    free(read);
+    free(written);
+    RemoveLogs(path);
+}
+
+static void TestAppendAndInterval(void) {
+    // Leaves room for segment suffixes in segment paths
+    char path[PATH_MAX / 2];
+    snprintf(path, sizeof(path), "%s/Interval.log", dir);
+    RemoveLogs(path);
+    
+    SEOutputLogConfig config = { path, 0, 1, 2, 0 };
+    int err = 0;
+    SEOutputLog *log = SEOutputLogOpen(&config, &err);
+    assert(log);
+    SEOutputLogWrite(log, "first\n", 6);
+    SEOutputLogClose(log);
+    
+    // Reopening appends to the existing log
+    log = SEOutputLogOpen(&config, &err);
+    assert(log);
+    SEOutputLogWrite(log, "second\n", 7);
+    SEOutputLogFlush(log);
+    
+    char buf[64];
+    char seg[PATH_MAX];
+    size_t n = ReadFile(path, buf, sizeof(buf));
+    assert(n == 13 && memcmp(buf, "first\nsecond\n", 13) == 0);
+    
+    // Rotated by age at the next write after the interval
+    sleep(1);
+    SEOutputLogWrite(log, "third\n", 6);
+    SEOutputLogClose(log);
+    snprintf(seg, sizeof(seg), "%s.1", path);
+    n = ReadFile(seg, buf, sizeof(buf));
+    assert(n == 19 && memcmp(buf, "first\nsecond\nthird\n", 19) == 0);
+    struct stat st;
+    err = stat(path, &st);
+    assert(err == 0 && st.st_size == 0);
+    
+    RemoveLogs(path);
+}
+
+static void TestOpenFailure(void) {
+    SEOutputLogConfig config = { "/nonexistent/dir/Output.log", 0, 0, 0, 0 };
+    int err = 0;
+    assert(SEOutputLogOpen(&config, &err) == NULL);
+    assert(err != 0);
+    
+    // A path that only fits without the rotated segment suffix
+    char path[PATH_MAX];
+    memset(path, 'a', sizeof(path) - 4);
+    path[sizeof(path) - 4] = '\0';
+    config.path = path;
+    config.segments = 3;
+    err = 0;
+    assert(SEOutputLogOpen(&config, &err) == NULL);
+    assert(err == ENAMETOOLONG);
+}
+
+#pragma mark - Benchmark
+
+#ifdef BENCHMARK
+
+static void Benchmark(void) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/Bench.log", dir);
+    RemoveLogs(path);
+    
+    SEOutputLogConfig config = { path, 8 * 1024 * 1024, 0, 2, 1 };
+    int err = 0;
+    SEOutputLog *log = SEOutputLogOpen(&config, &err);
+    assert(log);
+    
+    const char line[] = "2024-01-01 12:00:00 INFO Processing item in the output log benchmark\n";
+    const int count = 1000000;
+    double start = PlatypusClockNow();
+    for (int i = 0; i < count; i++) {
+        SEOutputLogWrite(log, line, sizeof(line) - 1);
+    }
+    double written = PlatypusClockNow() - start;
+    SEOutputLogClose(log);
+    double closed = PlatypusClockNow() - start;
+    
+    printf("%d writes of %zu bytes: %.0f ns per write, %.2f s until on disk\n",
+           count, sizeof(line) - 1, written * 1e9 / count, closed);
+    RemoveLogs(path);
+}
+
+#endif
+
+int main(void) {
+    char *created = mkdtemp(dir);
+    assert(created);
+    
+    TestRotation(0);
+    TestRotation(1);
+    TestAppendAndInterval();
+    TestOpenFailure();
+    printf("All output log tests passed\n");
+    
+#ifdef BENCHMARK
+    Benchmark();
+#endif
+    rmdir(dir);
+    return 0;
+}
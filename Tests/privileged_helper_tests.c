@@ -0,0 +1,488 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Tests and benchmark for the privileged job helper, run unprivileged as a
+// local stand-in. Portable C, runs on macOS and Linux. Built and run by
+// "make privileged_helper_tests", or with the benchmark by
+// "make privileged_helper_bench".
+
+#define _XOPEN_SOURCE 700
+
+#include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "PlatypusClock.h"
+#include "SEPrivilegedHelper.h"
+#include "SETrampoline.h"
+#include "PlatypusJobProtocol.h"
+#include "PlatypusSpawn.h"
+
+#define MAX_OUTPUT 4096
+
+static char selfPath[PATH_MAX];
+
+typedef struct Helper {
+    pid_t pid;
+    int fd;
+    PlatypusJobReader reader;
+} Helper;
+
+typedef struct JobResult {
+    int done;
+    int failed;
+    pid_t pid;
+    int status;
+    int timedOut;
+    char output[MAX_OUTPUT];
+    size_t outputLength;
+    char error[MAX_OUTPUT];
+    size_t errorLength;
+} JobResult;
+
+// Runs this executable as the helper, with its standard input and output
+// on a socket as when launched by the app
+static Helper StartHelper(void) {
+    int fds[2];
+    int err = socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    assert(err == 0);
+    char *const args[] = { selfPath, SE_PRIVILEGED_HELPER_ARG, NULL };
+    PlatypusSpawnAttributes attributes;
+    PlatypusSpawnAttributesInit(&attributes, selfPath, args);
+    attributes.fds[0] = fds[1];
+    attributes.fds[1] = fds[1];
+    attributes.fds[2] = PLATYPUS_SPAWN_NULL;
+    Helper helper;
+    err = PlatypusSpawn(&attributes, &helper.pid);
+    assert(err == 0);
+    close(fds[1]);
+    helper.fd = fds[0];
+    PlatypusJobReaderInit(&helper.reader);
+    return helper;
+}
+
+static int StopHelper(Helper *helper) {
+    close(helper->fd);
+    int status;
+    pid_t pid = waitpid(helper->pid, &status, 0);
+    assert(pid == helper->pid);
+    PlatypusJobReaderFree(&helper->reader);
+    return status;
+}
+
+static void Send(Helper *helper, PlatypusJobBuffer *buffer) {
+    int err = PlatypusJobFrameEnd(buffer);
+    ssize_t written = write(helper->fd, buffer->bytes, buffer->length);
+    assert(err == 0 && written == (ssize_t)buffer->length);
+    PlatypusJobBufferConsume(buffer, buffer->length);
+}
+
+static void AddLaunch(PlatypusJobBuffer *buffer, uint32_t sequence, const char *script,
+                      const char *directory, const char *env, const char *limits) {
+    PlatypusJobFrameBegin(buffer, (PlatypusJobFrameType)SEHelperFrame_Launch);
+    PlatypusJobFrameAddUInt32(buffer, (PlatypusJobField)SEHelperField_Sequence, sequence);
+    PlatypusJobFrameAddString(buffer, (PlatypusJobField)SEHelperField_Argument, "/bin/sh");
+    PlatypusJobFrameAddString(buffer, (PlatypusJobField)SEHelperField_Argument, "-c");
+    PlatypusJobFrameAddString(buffer, (PlatypusJobField)SEHelperField_Argument, script);
+    if (directory) {
+        PlatypusJobFrameAddString(buffer, (PlatypusJobField)SEHelperField_Directory, directory);
+    }
+    if (env) {
+        PlatypusJobFrameAddString(buffer, (PlatypusJobField)SEHelperField_Environment, env);
+    }
+    if (limits) {
+        PlatypusJobFrameAddString(buffer, (PlatypusJobField)SEHelperField_Limits, limits);
+    }
+}
+
+static void Launch(Helper *helper, uint32_t sequence, const char *script,
+                   const char *directory, const char *env, const char *limits) {
+    PlatypusJobBuffer buffer;
+    PlatypusJobBufferInit(&buffer);
+    AddLaunch(&buffer, sequence, script, directory, env, limits);
+    Send(helper, &buffer);
+    PlatypusJobBufferFree(&buffer);
+}
+
+static void Terminate(Helper *helper, uint32_t sequence) {
+    PlatypusJobBuffer buffer;
+    PlatypusJobBufferInit(&buffer);
+    PlatypusJobFrameBegin(&buffer, (PlatypusJobFrameType)SEHelperFrame_Terminate);
+    PlatypusJobFrameAddUInt32(&buffer, (PlatypusJobField)SEHelperField_Sequence, sequence);
+    Send(helper, &buffer);
+    PlatypusJobBufferFree(&buffer);
+}
+
+static void Append(char *buf, size_t *length, const uint8_t *value, size_t size) {
+    assert(*length + size < MAX_OUTPUT);
+    memcpy(buf + *length, value, size);
+    *length += size;
+    buf[*length] = '\0';
+}
+
+// Reads a reply into results, indexed by sequence number from 1
+static void ReadReply(Helper *helper, JobResult *results, uint32_t count) {
+    PlatypusJobFrame frame;
+    int result;
+    while ((result = PlatypusJobReaderNext(&helper->reader, &frame)) == 0) {
+        char buf[65536];
+        ssize_t n = read(helper->fd, buf, sizeof(buf));
+        assert(n > 0);
+        int err = PlatypusJobReaderAppend(&helper->reader, buf, (size_t)n);
+        assert(err == 0);
+    }
+    assert(result == 1);
+    
+    JobResult *job = NULL;
+    size_t offset = 0;
+    PlatypusJobField field;
+    const uint8_t *value;
+    size_t length;
+    while ((result = PlatypusJobFrameNextField(&frame, &offset, &field, &value, &length)) == 1) {
+        switch ((int)field) {
+            case SEHelperField_Sequence: {
+                uint32_t seq = PlatypusJobFieldUInt32(value, length);
+                assert(seq >= 1 && seq <= count);
+                job = &results[seq - 1];
+                assert(!job->done);
+                break;
+            }
+            case SEHelperField_PID:
+                job->pid = (pid_t)PlatypusJobFieldUInt32(value, length);
+                break;
+            case SEHelperField_Status:
+                job->status = (int32_t)PlatypusJobFieldUInt32(value, length);
+                break;
+            case SEHelperField_TimedOut:
+                job->timedOut = PlatypusJobFieldUInt32(value, length) != 0;
+                break;
+            case SEHelperField_Message:
+                Append(job->error, &job->errorLength, value, length);
+                break;
+            case SEHelperField_Data:
+                if ((int)frame.type == SEHelperFrame_Output) {
+                    Append(job->output, &job->outputLength, value, length);
+                } else {
+                    assert((int)frame.type == SEHelperFrame_Error);
+                    Append(job->error, &job->errorLength, value, length);
+                }
+                break;
+        }
+    }
+    assert(result == 0 && job != NULL);
+    if ((int)frame.type == SEHelperFrame_Launched) {
+        assert(job->pid > 0);
+    } else if ((int)frame.type == SEHelperFrame_Exited) {
+        job->done = 1;
+    } else if ((int)frame.type == SEHelperFrame_Failed) {
+        job->done = 1;
+        job->failed = 1;
+    }
+}
+
+// Reads replies until the given job is done, or all of them if sequence is 0
+static void Collect(Helper *helper, JobResult *results, uint32_t count, uint32_t sequence) {
+    while (1) {
+        uint32_t remaining = 0;
+        for (uint32_t i = 0; i < count; i++) {
+            remaining += !results[i].done;
+        }
+        if (remaining == 0 || (sequence && results[sequence - 1].done)) {
+            return;
+        }
+        ReadReply(helper, results, count);
+    }
+}
+
+static int ProcessExists(pid_t pid) {
+    // Orphans are reaped by init, so give it a moment
+    double deadline = PlatypusClockNow() + 2;
+    struct timespec interval = { 0, 10000000 };
+    while (kill(pid, 0) == 0 && PlatypusClockNow() < deadline) {
+        nanosleep(&interval, NULL);
+    }
+    return kill(pid, 0) == 0;
+}
+
+#pragma mark - Tests
+
+// Spawned directly, and through the trampoline for resource limits. The
+// job's variables replace the helper's own.
+static void TestLaunch(void) {
+    setenv("GREETING", "inherited", 1);
+    setenv("INHERITED", "yes", 1);
+    Helper helper = StartHelper();
+    JobResult results[2] = {{ 0 }};
+    const char *script = "echo \"$GREETING $INHERITED\"; pwd; echo oops >&2; exit 3";
+    Launch(&helper, 1, script, "/", "GREETING=hello", NULL);
+    Launch(&helper, 2, script, "/", "GREETING=hello", "files=64");
+    Collect(&helper, results, 2, 0);
+    for (int i = 0; i < 2; i++) {
+        assert(!results[i].failed && results[i].pid > 0);
+        assert(strcmp(results[i].output, "hello yes\n/\n") == 0);
+        assert(strcmp(results[i].error, "oops\n") == 0);
+        assert(results[i].status == 3 && !results[i].timedOut);
+    }
+    int status = StopHelper(&helper);
+    assert(status == 0);
+    unsetenv("GREETING");
+    unsetenv("INHERITED");
+}
+
+// Jobs are pipelined and run concurrently, each with its own output
+static void TestManyJobs(void) {
+    enum { count = 50 };
+    Helper helper = StartHelper();
+    static JobResult results[count];
+    memset(results, 0, sizeof(results));
+    PlatypusJobBuffer buffer;
+    PlatypusJobBufferInit(&buffer);
+    int failed = 0;
+    for (uint32_t i = 1; i <= count; i++) {
+        char script[64];
+        snprintf(script, sizeof(script), "echo out%u; echo err%u >&2; exit %u", i, i, i);
+        AddLaunch(&buffer, i, script, NULL, NULL, NULL);
+        failed |= PlatypusJobFrameEnd(&buffer);
+    }
+    ssize_t written = write(helper.fd, buffer.bytes, buffer.length);
+    assert(failed == 0 && written == (ssize_t)buffer.length);
+    PlatypusJobBufferFree(&buffer);
+    
+    Collect(&helper, results, count, 0);
+    for (uint32_t i = 1; i <= count; i++) {
+        char expected[32];
+        snprintf(expected, sizeof(expected), "out%u\n", i);
+        assert(strcmp(results[i - 1].output, expected) == 0);
+        snprintf(expected, sizeof(expected), "err%u\n", i);
+        assert(strcmp(results[i - 1].error, expected) == 0);
+        assert(results[i - 1].status == (int)i);
+    }
+    int status = StopHelper(&helper);
+    assert(status == 0);
+}
+
+static void TestFailures(void) {
+    Helper helper = StartHelper();
+    JobResult results[5] = {{ 0 }};
+    
+    // No executable
+    PlatypusJobBuffer buffer;
+    PlatypusJobBufferInit(&buffer);
+    PlatypusJobFrameBegin(&buffer, (PlatypusJobFrameType)SEHelperFrame_Launch);
+    PlatypusJobFrameAddUInt32(&buffer, (PlatypusJobField)SEHelperField_Sequence, 1);
+    Send(&helper, &buffer);
+    PlatypusJobBufferFree(&buffer);
+    Collect(&helper, results, 5, 1);
+    assert(results[0].failed && results[0].status == EINVAL);
+    
+    Launch(&helper, 2, "true", NULL, NULL, "timeout=soon");
+    Collect(&helper, results, 5, 2);
+    assert(results[1].failed && strcmp(results[1].error, "Invalid job limits") == 0);
+    
+    Launch(&helper, 3, "true", "/nonexistent", NULL, NULL);
+    Collect(&helper, results, 5, 3);
+    assert(results[2].failed || results[2].status != 0);
+    
+    // A missing executable fails to launch, unless the job goes through the
+    // trampoline, which only finds out once it has been launched
+    PlatypusJobBufferInit(&buffer);
+    PlatypusJobFrameBegin(&buffer, (PlatypusJobFrameType)SEHelperFrame_Launch);
+    PlatypusJobFrameAddUInt32(&buffer, (PlatypusJobField)SEHelperField_Sequence, 4);
+    PlatypusJobFrameAddString(&buffer, (PlatypusJobField)SEHelperField_Argument, "/nonexistent");
+    Send(&helper, &buffer);
+    PlatypusJobFrameBegin(&buffer, (PlatypusJobFrameType)SEHelperFrame_Launch);
+    PlatypusJobFrameAddUInt32(&buffer, (PlatypusJobField)SEHelperField_Sequence, 5);
+    PlatypusJobFrameAddString(&buffer, (PlatypusJobField)SEHelperField_Argument, "/nonexistent");
+    PlatypusJobFrameAddString(&buffer, (PlatypusJobField)SEHelperField_Limits, "files=64");
+    Send(&helper, &buffer);
+    PlatypusJobBufferFree(&buffer);
+    Collect(&helper, results, 5, 4);
+    Collect(&helper, results, 5, 5);
+    assert(results[3].failed && results[3].status == ENOENT);
+    assert(!results[4].failed && results[4].status == 127 && results[4].errorLength > 0);
+    
+    // A malformed stream makes the helper give up
+    uint8_t junk[] = { 0, 0, 0, 0 };
+    ssize_t written = write(helper.fd, junk, sizeof(junk));
+    assert(written == sizeof(junk));
+    int status;
+    pid_t pid = waitpid(helper.pid, &status, 0);
+    assert(pid == helper.pid);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) != 0);
+    close(helper.fd);
+    PlatypusJobReaderFree(&helper.reader);
+}
+
+static void TestLimits(void) {
+    Helper helper = StartHelper();
+    JobResult results[2] = {{ 0 }};
+    Launch(&helper, 1, "ulimit -n", NULL, NULL, "files=20");
+    Collect(&helper, results, 2, 1);
+    assert(strcmp(results[0].output, "20\n") == 0);
+    
+    // Timed out along with the process it started
+    double start = PlatypusClockNow();
+    Launch(&helper, 2, "sleep 300 & echo $!; wait", NULL, NULL, "timeout=0.5");
+    Collect(&helper, results, 2, 2);
+    assert(results[1].timedOut && results[1].status == SIGTERM);
+    assert(PlatypusClockNow() - start < 3);
+    assert(!ProcessExists((pid_t)atoi(results[1].output)));
+    int status = StopHelper(&helper);
+    assert(status == 0);
+}
+
+static void TestTerminate(void) {
+    Helper helper = StartHelper();
+    JobResult results[2] = {{ 0 }};
+    Launch(&helper, 1, "exec sleep 300", NULL, NULL, NULL);
+    Launch(&helper, 2, "sleep 300 & echo $!; wait", NULL, NULL, NULL);
+    
+    // Wait for the second job's background process to have started
+    while (results[1].outputLength == 0) {
+        ReadReply(&helper, results, 2);
+    }
+    Terminate(&helper, 1);
+    Collect(&helper, results, 2, 1);
+    assert(results[0].status == SIGTERM && !results[0].timedOut);
+    assert(!results[1].done);
+    
+    // Quitting the app terminates jobs still running
+    pid_t background = (pid_t)atoi(results[1].output);
+    assert(background > 0 && ProcessExists(background));
+    int status = StopHelper(&helper);
+    assert(status == 0);
+    assert(!ProcessExists(background));
+}
+
+#pragma mark - Benchmark
+
+#ifdef BENCHMARK
+
+static double RunDirectly(void) {
+    char *const args[] = { "/bin/sh", "-c", "true", NULL };
+    double start = PlatypusClockNow();
+    PlatypusSpawnAttributes attributes;
+    PlatypusSpawnAttributesInit(&attributes, args[0], args);
+    char *output;
+    size_t length;
+    int status;
+    int err = PlatypusSpawnRun(&attributes, -1, &output, &length, &status);
+    double elapsed = PlatypusClockNow() - start;
+    assert(err == 0);
+    free(output);
+    return elapsed;
+}
+
+static double RunThroughHelper(Helper *helper, JobResult *results, uint32_t count,
+                               uint32_t sequence, const char *limits) {
+    double start = PlatypusClockNow();
+    Launch(helper, sequence, "true", NULL, NULL, limits);
+    Collect(helper, results, count, sequence);
+    return PlatypusClockNow() - start;
+}
+
+// Time to run a job through the helper, one at a time and pipelined,
+// against launching it directly. Jobs with resource limits take an extra
+// exec through the trampoline. The ways of running jobs one at a time take
+// turns, so that changes in system load affect them alike.
+static void Benchmark(void) {
+    enum { count = 200 };
+    Helper helper = StartHelper();
+    static JobResult results[2 * count];
+    memset(results, 0, sizeof(results));
+    
+    double direct = 0, sequential = 0, limited = 0;
+    for (uint32_t i = 1; i <= count; i++) {
+        direct += RunDirectly();
+        sequential += RunThroughHelper(&helper, results, 2 * count, 2 * i - 1, NULL);
+        limited += RunThroughHelper(&helper, results, 2 * count, 2 * i, "files=256");
+    }
+    
+    memset(results, 0, sizeof(results));
+    double start = PlatypusClockNow();
+    PlatypusJobBuffer buffer;
+    PlatypusJobBufferInit(&buffer);
+    int failed = 0;
+    for (uint32_t i = 1; i <= count; i++) {
+        AddLaunch(&buffer, i, "true", NULL, NULL, NULL);
+        failed |= PlatypusJobFrameEnd(&buffer);
+    }
+    ssize_t written = write(helper.fd, buffer.bytes, buffer.length);
+    assert(failed == 0 && written == (ssize_t)buffer.length);
+    PlatypusJobBufferFree(&buffer);
+    Collect(&helper, results, count, 0);
+    double pipelined = PlatypusClockNow() - start;
+    int status = StopHelper(&helper);
+    assert(status == 0);
+    
+    printf("Job launched directly: %.0f us, through helper: %.0f us, "
+           "with resource limits: %.0f us, pipelined: %.0f us\n",
+           direct / count * 1e6, sequential / count * 1e6,
+           limited / count * 1e6, pipelined / count * 1e6);
+}
+
+#endif
+
+int main(int argc, char *argv[]) {
+    // The helper runs jobs through this executable as the trampoline
+    if (argc == 2 && strcmp(argv[1], SE_TRAMPOLINE_ARG) == 0) {
+        int err = SETrampolineRun(STDIN_FILENO);
+        if (err) {
+            fprintf(stderr, "Unable to run interpreter: %s\n", strerror(err));
+        }
+        return 127;
+    }
+    char *resolved = realpath(argv[0], selfPath);
+    assert(resolved != NULL);
+    if (argc == 2 && strcmp(argv[1], SE_PRIVILEGED_HELPER_ARG) == 0) {
+        return SEPrivilegedHelperRun(STDIN_FILENO, STDOUT_FILENO, selfPath) ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+    
+    TestLaunch();
+    TestManyJobs();
+    TestFailures();
+    TestLimits();
+    TestTerminate();
+    printf("All privileged helper tests passed\n");
+    
+#ifdef BENCHMARK
+    Benchmark();
+#endif
+    return 0;
+}
@@ -0,0 +1,221 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Integration tests and benchmark for tearing down job process trees.
+// Portable C, runs on macOS and Linux. Built and run by "make process_tree_tests",
+// or with the benchmark by "make process_tree_bench".
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "PlatypusClock.h"
+#include "SEProcessTree.h"
+#include "PlatypusSpawn.h"
+
+#define NEW_SESSION_ARG "--new-session"
+
+static const char *selfPath;
+
+// Starts a shell script as a job would be started, and waits for it to
+// print a line once it has started its children
+static pid_t StartJob(const char *script, int processGroup) {
+    int fds[2];
+    int err = pipe(fds);
+    assert(err == 0);
+    char *const args[] = { "/bin/sh", "-c", (char *)script, "sh", (char *)selfPath, NULL };
+    PlatypusSpawnAttributes attributes;
+    PlatypusSpawnAttributesInit(&attributes, args[0], args);
+    attributes.fds[1] = fds[1];
+    attributes.fds[2] = PLATYPUS_SPAWN_NULL;
+    attributes.processGroup = processGroup;
+    pid_t pid;
+    err = PlatypusSpawn(&attributes, &pid);
+    assert(err == 0);
+    close(fds[1]);
+    char c;
+    while (read(fds[0], &c, 1) == 1 && c != '\n') {}
+    close(fds[0]);
+    return pid;
+}
+
+static void Reap(pid_t pid) {
+    int status;
+    int err = PlatypusSpawnWait(pid, -1, 5, &status);
+    assert(err == 0);
+}
+
+static pid_t StartBystander(void) {
+    char *const args[] = { "/bin/sleep", "300", NULL };
+    PlatypusSpawnAttributes attributes;
+    PlatypusSpawnAttributesInit(&attributes, args[0], args);
+    attributes.fds[1] = PLATYPUS_SPAWN_NULL;
+    attributes.fds[2] = PLATYPUS_SPAWN_NULL;
+    pid_t pid;
+    int err = PlatypusSpawn(&attributes, &pid);
+    assert(err == 0);
+    return pid;
+}
+
+static int IsRunning(pid_t pid) {
+    return waitpid(pid, NULL, WNOHANG) == 0;
+}
+
+// Nested children that ignore SIGTERM, have been orphaned or have left the
+// job's process group are all torn down, and nothing else is. Stopped
+// processes are sent SIGHUP when their group is orphaned, so that's ignored
+// too to make sure SIGKILL is needed.
+static void TestNestedChildren(void) {
+    pid_t bystander = StartBystander();
+    pid_t pid = StartJob("sh -c 'trap \"\" TERM HUP; sleep 300; :' &"
+                         "(sleep 300 &);"
+                         "\"$1\" " NEW_SESSION_ARG " &"
+                         "sleep 300 & echo ready; wait", 1);
+    
+    SEProcessTree tree;
+    SEProcessTreeInit(&tree);
+    assert(SEProcessTreeCollect(&tree, pid, 0) == 0);
+    // The shell, the shell ignoring signals and its sleep, the orphan, the
+    // process in a new session and the plain child
+    assert(SEProcessTreeCountRunning(&tree) == 6);
+    SEProcessTreeClear(&tree);
+    
+    double start = PlatypusClockNow();
+    assert(SEProcessTreeCollect(&tree, pid, 1) == 0);
+    size_t killed = SEProcessTreeTerminate(&tree, 0.5);
+    Reap(pid);
+    // Those ignoring signals held up termination until the grace period ended
+    assert(killed == 2);
+    assert(PlatypusClockNow() - start >= 0.5 && PlatypusClockNow() - start < 5);
+    assert(SEProcessTreeCountRunning(&tree) == 0);
+    assert(tree.count >= 6);
+    SEProcessTreeFree(&tree);
+    
+    assert(IsRunning(bystander));
+    kill(bystander, SIGKILL);
+    Reap(bystander);
+}
+
+// Without a process group of its own, a job's tree is its descendants only,
+// not the group it shares with its parent
+static void TestWithoutProcessGroup(void) {
+    pid_t bystander = StartBystander();
+    pid_t pid = StartJob("sleep 300 & sleep 300 & echo ready; wait", 0);
+    
+    SEProcessTree tree;
+    SEProcessTreeInit(&tree);
+    assert(SEProcessTreeCollect(&tree, pid, 1) == 0);
+    assert(tree.count == 3);
+    assert(SEProcessTreeTerminate(&tree, 5) == 0);
+    Reap(pid);
+    assert(SEProcessTreeCountRunning(&tree) == 0);
+    SEProcessTreeFree(&tree);
+    
+    assert(IsRunning(bystander));
+    kill(bystander, SIGKILL);
+    Reap(bystander);
+}
+
+// A job that keeps starting processes while being torn down
+static void TestForking(void) {
+    pid_t pid = StartJob("echo ready; i=0; while [ $i -lt 200 ]; do sleep 300 & i=$((i+1)); done; wait", 1);
+    
+    SEProcessTree tree;
+    SEProcessTreeInit(&tree);
+    assert(SEProcessTreeCollect(&tree, pid, 1) == 0);
+    SEProcessTreeTerminate(&tree, 5);
+    Reap(pid);
+    assert(SEProcessTreeCountRunning(&tree) == 0);
+    SEProcessTreeFree(&tree);
+    
+    SEProcessTreeInit(&tree);
+    assert(SEProcessTreeCollect(&tree, pid, 0) == ESRCH);
+    assert(SEProcessTreeCollect(&tree, getpid(), 0) == ESRCH);
+    SEProcessTreeFree(&tree);
+}
+
+#pragma mark - Benchmark
+
+#ifdef BENCHMARK
+
+static void Benchmark(void) {
+    const int count = 200;
+    pid_t pid = StartJob("i=0; while [ $i -lt 50 ]; do sleep 300 & i=$((i+1)); done; echo ready; wait", 1);
+    
+    SEProcessTree tree;
+    SEProcessTreeInit(&tree);
+    int failed = 0;
+    double start = PlatypusClockNow();
+    for (int i = 0; i < count; i++) {
+        SEProcessTreeClear(&tree);
+        failed |= SEProcessTreeCollect(&tree, pid, 0);
+    }
+    double elapsed = PlatypusClockNow() - start;
+    assert(failed == 0);
+    printf("Collecting a tree of %zu processes: %.0f us\n", tree.count, elapsed / count * 1e6);
+    
+    start = PlatypusClockNow();
+    SEProcessTreeClear(&tree);
+    int err = SEProcessTreeCollect(&tree, pid, 1);
+    assert(err == 0);
+    SEProcessTreeTerminate(&tree, 5);
+    printf("Terminating it: %.1f ms\n", (PlatypusClockNow() - start) * 1e3);
+    Reap(pid);
+    SEProcessTreeFree(&tree);
+}
+
+#endif
+
+int main(int argc, char *argv[]) {
+    // Child of the nested children test, leaving the job's session
+    if (argc > 1 && strcmp(argv[1], NEW_SESSION_ARG) == 0) {
+        setsid();
+        execl("/bin/sleep", "sleep", "300", (char *)NULL);
+        return 1;
+    }
+    selfPath = argv[0];
+    
+    TestNestedChildren();
+    TestWithoutProcessGroup();
+    TestForking();
+    printf("All process tree tests passed\n");
+    
+#ifdef BENCHMARK
+    Benchmark();
+#endif
+    return 0;
+}
@@ -0,0 +1,366 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Tests and benchmark for loading and validating app settings snapshots.
+// Portable C, runs on macOS and Linux. Built and run by "make settings_snapshot_tests",
+// or with the benchmark by "make settings_snapshot_bench".
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "PlatypusClock.h"
+#include "PlatypusSettingsSnapshot.h"
+
+static void WriteFile(const char *path, const char *contents) {
+    FILE *f = fopen(path, "w");
+    assert(f != NULL);
+    fputs(contents, f);
+    fclose(f);
+}
+
+// A snapshot with every kind of value set
+static uint8_t *MakeSnapshot(size_t *size) {
+    PlatypusSnapshotWriter *writer = PlatypusSnapshotWriterCreate();
+    assert(writer != NULL);
+    PlatypusSnapshotHeader *header = PlatypusSnapshotWriterHeader(writer);
+    header->flags = PlatypusSnapshotFlag_RemainRunning | PlatypusSnapshotFlag_Droppable;
+    header->interfaceType = 2;
+    header->execStyle = 1;
+    header->textSize = 13.0f;
+    header->textColor = PlatypusSnapshotRGBFromHexString("#00ff00");
+    header->textBackgroundColor = PlatypusSnapshotRGBFromHexString("#ffffff");
+    
+    int failed = 0;
+    failed |= PlatypusSnapshotWriterSetString(writer, PlatypusSnapshotString_InterpreterPath, "/bin/sh");
+    failed |= PlatypusSnapshotWriterSetString(writer, PlatypusSnapshotString_TextFont, "Monaco");
+    failed |= PlatypusSnapshotWriterSetString(writer, PlatypusSnapshotString_StatusItemTitle, "");
+    failed |= PlatypusSnapshotWriterAddListItem(writer, PlatypusSnapshotList_InterpreterArgs, "-e");
+    failed |= PlatypusSnapshotWriterAddListItem(writer, PlatypusSnapshotList_InterpreterArgs, "-u");
+    failed |= PlatypusSnapshotWriterAddListItem(writer, PlatypusSnapshotList_Suffixes, "txt");
+    const uint8_t icon[] = { 0x89, 'P', 'N', 'G', 0, 1, 2 };
+    failed |= PlatypusSnapshotWriterSetBlob(writer, PlatypusSnapshotBlob_StatusItemIcon, icon, sizeof(icon));
+    assert(failed == 0);
+    
+    uint8_t *bytes = PlatypusSnapshotWriterCopyBytes(writer, size);
+    assert(bytes != NULL);
+    PlatypusSnapshotWriterFree(writer);
+    return bytes;
+}
+
+static int Load(const uint8_t *bytes, size_t size) {
+    PlatypusSnapshot snapshot;
+    int err = PlatypusSnapshotLoadFromBuffer(bytes, size, &snapshot);
+    if (err == 0) {
+        PlatypusSnapshotUnload(&snapshot);
+    } else {
+        assert(snapshot.buffer == NULL);
+    }
+    return err;
+}
+
+#pragma mark - Tests
+
+static void TestRoundTrip(void) {
+    size_t size;
+    uint8_t *bytes = MakeSnapshot(&size);
+    
+    PlatypusSnapshot snapshot;
+    assert(PlatypusSnapshotLoadFromBuffer(bytes, size, &snapshot) == 0);
+    const PlatypusSnapshotHeader *h = snapshot.header;
+    assert(h->totalSize == size);
+    assert(h->flags == (PlatypusSnapshotFlag_RemainRunning | PlatypusSnapshotFlag_Droppable));
+    assert(h->interfaceType == 2 && h->execStyle == 1 && h->textSize == 13.0f);
+    assert(h->textColor == 0x00ff00 && h->textBackgroundColor == 0xffffff);
+    
+    assert(strcmp(PlatypusSnapshotGetString(&snapshot, PlatypusSnapshotString_InterpreterPath), "/bin/sh") == 0);
+    assert(strcmp(PlatypusSnapshotGetString(&snapshot, PlatypusSnapshotString_TextFont), "Monaco") == 0);
+    assert(strcmp(PlatypusSnapshotGetString(&snapshot, PlatypusSnapshotString_StatusItemTitle), "") == 0);
+    assert(PlatypusSnapshotGetString(&snapshot, PlatypusSnapshotString_JobLimits) == NULL);
+    
+    assert(PlatypusSnapshotGetListCount(&snapshot, PlatypusSnapshotList_InterpreterArgs) == 2);
+    assert(strcmp(PlatypusSnapshotGetListItem(&snapshot, PlatypusSnapshotList_InterpreterArgs, 0), "-e") == 0);
+    assert(strcmp(PlatypusSnapshotGetListItem(&snapshot, PlatypusSnapshotList_InterpreterArgs, 1), "-u") == 0);
+    assert(PlatypusSnapshotGetListItem(&snapshot, PlatypusSnapshotList_InterpreterArgs, 2) == NULL);
+    assert(PlatypusSnapshotGetListCount(&snapshot, PlatypusSnapshotList_Suffixes) == 1);
+    assert(PlatypusSnapshotGetListCount(&snapshot, PlatypusSnapshotList_ScriptArgs) == 0);
+    
+    size_t iconLength;
+    const uint8_t *icon = PlatypusSnapshotGetBlob(&snapshot, PlatypusSnapshotBlob_StatusItemIcon, &iconLength);
+    assert(icon != NULL && iconLength == 7 && icon[1] == 'P' && icon[6] == 2);
+    PlatypusSnapshotUnload(&snapshot);
+    
+    // Through a file
+    char path[] = "/tmp/snapshot_tests.XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd != -1);
+    ssize_t written = write(fd, bytes, size);
+    assert(written == (ssize_t)size);
+    close(fd);
+    assert(PlatypusSnapshotLoad(path, &snapshot) == 0);
+    assert(snapshot.size == size && memcmp(snapshot.buffer, bytes, size) == 0);
+    PlatypusSnapshotUnload(&snapshot);
+    unlink(path);
+    assert(PlatypusSnapshotLoad("/nonexistent/AppSettings.bin", &snapshot) == ENOENT);
+    
+    free(bytes);
+}
+
+static void TestTruncated(void) {
+    size_t size;
+    uint8_t *bytes = MakeSnapshot(&size);
+    for (size_t n = 0; n < size; n++) {
+        assert(Load(bytes, n) == EINVAL);
+    }
+    
+    // Truncated file, whose header still claims the full size
+    char path[] = "/tmp/snapshot_tests.XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd != -1);
+    ssize_t written = write(fd, bytes, size - 1);
+    assert(written == (ssize_t)(size - 1));
+    close(fd);
+    PlatypusSnapshot snapshot;
+    assert(PlatypusSnapshotLoad(path, &snapshot) == EINVAL);
+    unlink(path);
+    free(bytes);
+}
+
+static void TestBadHeader(void) {
+    size_t size;
+    uint8_t *bytes = MakeSnapshot(&size);
+    PlatypusSnapshotHeader *h = (PlatypusSnapshotHeader *)bytes;
+    assert(Load(bytes, size) == 0);
+    
+    h->version = PLATYPUS_SNAPSHOT_VERSION - 1;
+    assert(Load(bytes, size) == EINVAL);
+    h->version = PLATYPUS_SNAPSHOT_VERSION + 1;
+    assert(Load(bytes, size) == EINVAL);
+    h->version = PLATYPUS_SNAPSHOT_VERSION;
+    
+    h->magic = 0x50595053;
+    assert(Load(bytes, size) == EINVAL);
+    h->magic = PLATYPUS_SNAPSHOT_MAGIC;
+    
+    h->headerSize -= 4;
+    assert(Load(bytes, size) == EINVAL);
+    h->headerSize += 4;
+    
+    h->totalSize += 1;
+    assert(Load(bytes, size) == EINVAL);
+    h->totalSize -= 1;
+    
+    assert(Load(bytes, size) == 0);
+    free(bytes);
+}
+
+static void TestBadOffsets(void) {
+    size_t size;
+    uint8_t *bytes = MakeSnapshot(&size);
+    uint8_t *copy = malloc(size);
+    PlatypusSnapshotHeader *h = (PlatypusSnapshotHeader *)copy;
+    PlatypusSnapshotRef *ref;
+    
+    // String pointing into the header
+    memcpy(copy, bytes, size);
+    h->strings[PlatypusSnapshotString_InterpreterPath].offset = 8;
+    assert(Load(copy, size) == EINVAL);
+    
+    // String running past the end
+    memcpy(copy, bytes, size);
+    h->strings[PlatypusSnapshotString_TextFont].length = (uint32_t)size;
+    assert(Load(copy, size) == EINVAL);
+    memcpy(copy, bytes, size);
+    h->strings[PlatypusSnapshotString_TextFont].length = UINT32_MAX;
+    assert(Load(copy, size) == EINVAL);
+    
+    // String without its terminating NUL
+    memcpy(copy, bytes, size);
+    h->strings[PlatypusSnapshotString_InterpreterPath].length -= 1;
+    assert(Load(copy, size) == EINVAL);
+    
+    // Absent string with a length
+    memcpy(copy, bytes, size);
+    h->strings[PlatypusSnapshotString_JobLimits].length = 3;
+    assert(Load(copy, size) == EINVAL);
+    
+    // List running past the end, or misaligned
+    memcpy(copy, bytes, size);
+    h->lists[PlatypusSnapshotList_InterpreterArgs].length = UINT32_MAX;
+    assert(Load(copy, size) == EINVAL);
+    memcpy(copy, bytes, size);
+    h->lists[PlatypusSnapshotList_InterpreterArgs].offset += 2;
+    assert(Load(copy, size) == EINVAL);
+    
+    // List item pointing outside the snapshot, or absent
+    memcpy(copy, bytes, size);
+    ref = (PlatypusSnapshotRef *)(copy + h->lists[PlatypusSnapshotList_InterpreterArgs].offset);
+    ref[1].offset = (uint32_t)size;
+    assert(Load(copy, size) == EINVAL);
+    memcpy(copy, bytes, size);
+    ref[1] = (PlatypusSnapshotRef){ 0, 0 };
+    assert(Load(copy, size) == EINVAL);
+    
+    // Blob running past the end
+    memcpy(copy, bytes, size);
+    h->blobs[PlatypusSnapshotBlob_StatusItemIcon].offset = (uint32_t)size - 2;
+    assert(Load(copy, size) == EINVAL);
+    memcpy(copy, bytes, size);
+    h->blobs[PlatypusSnapshotBlob_StatusItemIcon].length = UINT32_MAX;
+    assert(Load(copy, size) == EINVAL);
+    
+    memcpy(copy, bytes, size);
+    assert(Load(copy, size) == 0);
+    free(copy);
+    free(bytes);
+}
+
+static void TestSource(void) {
+    char plist[] = "/tmp/snapshot_plist.XXXXXX";
+    int fd = mkstemp(plist);
+    assert(fd != -1);
+    close(fd);
+    WriteFile(plist, "<plist>original</plist>");
+    
+    PlatypusSnapshotWriter *writer = PlatypusSnapshotWriterCreate();
+    int err = PlatypusSnapshotWriterSetSource(writer, plist);
+    assert(err == 0);
+    assert(PlatypusSnapshotWriterSetSource(writer, "/nonexistent/AppSettings.plist") == ENOENT);
+    size_t size;
+    uint8_t *bytes = PlatypusSnapshotWriterCopyBytes(writer, &size);
+    PlatypusSnapshotWriterFree(writer);
+    
+    PlatypusSnapshot snapshot;
+    assert(PlatypusSnapshotLoadFromBuffer(bytes, size, &snapshot) == 0);
+    assert(PlatypusSnapshotMatchesSource(&snapshot, plist));
+    
+    // Nothing to prefer over the snapshot
+    assert(PlatypusSnapshotMatchesSource(&snapshot, "/nonexistent/AppSettings.plist"));
+    
+    // Edited to a different size
+    WriteFile(plist, "<plist>edited by hand</plist>");
+    assert(!PlatypusSnapshotMatchesSource(&snapshot, plist));
+    
+    // Edited to the same size
+    WriteFile(plist, "<plist>changed!</plist>");
+    assert(!PlatypusSnapshotMatchesSource(&snapshot, plist));
+    
+    // Unchanged, but with a new modification time, as after unzipping or checking out
+    WriteFile(plist, "<plist>original</plist>");
+    struct stat st;
+    err = stat(plist, &st);
+    assert(err == 0);
+    struct timespec times[2] = { { 0, UTIME_OMIT }, { st.st_mtime - 3600, 0 } };
+    err = utimensat(AT_FDCWD, plist, times, 0);
+    assert(err == 0);
+    assert(PlatypusSnapshotMatchesSource(&snapshot, plist));
+    
+    PlatypusSnapshotUnload(&snapshot);
+    unlink(plist);
+    free(bytes);
+}
+
+#pragma mark - Benchmark
+
+#ifdef BENCHMARK
+
+// Loading and validating a snapshot, as ScriptExec does at launch
+static void Benchmark(void) {
+    // A property list of typical size that the snapshot is up to date with
+    char plist[] = "/tmp/snapshot_bench_plist.XXXXXX";
+    int plistFD = mkstemp(plist);
+    assert(plistFD != -1);
+    close(plistFD);
+    char contents[4096];
+    memset(contents, 'x', sizeof(contents) - 1);
+    contents[sizeof(contents) - 1] = '\0';
+    WriteFile(plist, contents);
+    PlatypusSnapshotWriter *writer = PlatypusSnapshotWriterCreate();
+    int err = PlatypusSnapshotWriterSetSource(writer, plist);
+    assert(err == 0);
+    PlatypusSnapshotHeader source = *PlatypusSnapshotWriterHeader(writer);
+    PlatypusSnapshotWriterFree(writer);
+    
+    size_t size;
+    uint8_t *bytes = MakeSnapshot(&size);
+    PlatypusSnapshotHeader *h = (PlatypusSnapshotHeader *)bytes;
+    h->sourceSize = source.sourceSize;
+    h->sourceChecksum = source.sourceChecksum;
+    char path[] = "/tmp/snapshot_bench.XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd != -1);
+    ssize_t written = write(fd, bytes, size);
+    assert(written == (ssize_t)size);
+    close(fd);
+    
+    const int iterations = 100000;
+    PlatypusSnapshot snapshot;
+    int fresh = 0;
+    double start = PlatypusClockNow();
+    for (int i = 0; i < iterations; i++) {
+        if (PlatypusSnapshotLoad(path, &snapshot) != 0) {
+            break;
+        }
+        fresh += PlatypusSnapshotMatchesSource(&snapshot, plist);
+        PlatypusSnapshotUnload(&snapshot);
+    }
+    double elapsed = PlatypusClockNow() - start;
+    assert(fresh == iterations);
+    printf("Loading a %zu byte snapshot and checking a %zu byte source: %.2f us\n",
+           size, sizeof(contents) - 1, elapsed * 1e6 / iterations);
+    unlink(path);
+    unlink(plist);
+    free(bytes);
+}
+
+#endif
+
+int main(void) {
+    TestRoundTrip();
+    TestTruncated();
+    TestBadHeader();
+    TestBadOffsets();
+    TestSource();
+    printf("All settings snapshot tests passed\n");
+    
+#ifdef BENCHMARK
+    Benchmark();
+#endif
+    return 0;
+}
@@ -0,0 +1,285 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Tests, fuzzing and benchmark for the script sniffer. Portable C, runs on
+// macOS and Linux. Built and run by "make sniffer_tests", or with the
+// benchmark by "make sniffer_bench".
+//
+//   sniffer_tests [fuzz iterations]
+//   sniffer_bench [fuzz iterations] [benchmark file size in MB]
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "PlatypusClock.h"
+#include "PlatypusScriptSniffer.h"
+
+static PlatypusScriptSniffResult result;
+
+static void Sniff(const char *text) {
+    PlatypusScriptSniffBuffer(text, strlen(text), &result);
+}
+
+static void ExpectArgs(const char *text, int commandIndex, const char **expected) {
+    Sniff(text);
+    int n = 0;
+    while (expected[n]) {
+        n++;
+    }
+    if (result.argc != n || result.commandIndex != commandIndex) {
+        fprintf(stderr, "FAIL: %s: argc %d (expected %d), command %d (expected %d)\n",
+                text, result.argc, n, result.commandIndex, commandIndex);
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < n; i++) {
+        if (strcmp(result.argv[i], expected[i]) != 0) {
+            fprintf(stderr, "FAIL: %s: argv[%d] '%s' (expected '%s')\n", text, i, result.argv[i], expected[i]);
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+#define EXPECT_ARGS(text, cmd, ...) ExpectArgs(text, cmd, (const char *[]){ __VA_ARGS__, NULL })
+
+static void TestShebangs(void) {
+    EXPECT_ARGS("#!/bin/sh\necho hi\n", 0, "/bin/sh");
+    EXPECT_ARGS("#! /usr/bin/perl -w  -T \n", 0, "/usr/bin/perl", "-w", "-T");
+    EXPECT_ARGS("#!/bin/bash\r\necho\r\n", 0, "/bin/bash");
+    EXPECT_ARGS("#!python3", 0, "python3");
+    EXPECT_ARGS("#!/usr/bin/env python3\n", 1, "/usr/bin/env", "python3");
+    EXPECT_ARGS("#!/usr/bin/env -i FOO=bar -u HOME ruby -w\n", 5,
+                "/usr/bin/env", "-i", "FOO=bar", "-u", "HOME", "ruby", "-w");
+    EXPECT_ARGS("#!/usr/bin/env -S python3 -u -W ignore\n", 2,
+                "/usr/bin/env", "-S", "python3", "-u", "-W", "ignore");
+    EXPECT_ARGS("#!/usr/bin/env -Sperl -w\n", 2, "/usr/bin/env", "-S", "perl", "-w");
+    EXPECT_ARGS("#!/usr/bin/env --split-string=node --harmony\n", 2,
+                "/usr/bin/env", "--split-string", "node", "--harmony");
+    EXPECT_ARGS("#!/usr/bin/env -S A=1 'my interp' \"a b\\tc\" d\\_e # comment\n", 3,
+                "/usr/bin/env", "-S", "A=1", "my interp", "a b\tc", "d", "e");
+    EXPECT_ARGS("#!/usr/bin/env -S php \\c ignored\n", 2, "/usr/bin/env", "-S", "php");
+    EXPECT_ARGS("#!/usr/bin/env -S \"\" \\_x\n", 2, "/usr/bin/env", "-S", "", "x");
+    EXPECT_ARGS("#!/usr/bin/env -i\n", -1, "/usr/bin/env", "-i");
+    
+    Sniff("#!\n");
+    assert(result.hasShebang && result.argc == 0);
+    Sniff("# !/bin/sh\n");
+    assert(!result.hasShebang && !result.isBinary);
+    Sniff("");
+    assert(!result.hasShebang && !result.isBinary && result.bytesRead == 0);
+}
+
+static void TestEncodings(void) {
+    Sniff("\xEF\xBB\xBF#!/bin/zsh\n");
+    assert(result.encoding == PlatypusScriptEncoding_UTF8 && result.hasShebang);
+    assert(strcmp(result.argv[0], "/bin/zsh") == 0);
+    
+    static const char utf16le[] = "\xFF\xFE#\0!\0/\0b\0i\0n\0/\0s\0h\0\n\0";
+    PlatypusScriptSniffBuffer(utf16le, sizeof(utf16le) - 1, &result);
+    assert(result.encoding == PlatypusScriptEncoding_UTF16LE && !result.isBinary);
+    assert(result.hasShebang && strcmp(result.argv[0], "/bin/sh") == 0);
+    
+    static const char utf16be[] = "\xFE\xFF\0#\0!\0/\0x\0\n";
+    PlatypusScriptSniffBuffer(utf16be, sizeof(utf16be) - 1, &result);
+    assert(result.encoding == PlatypusScriptEncoding_UTF16BE && strcmp(result.argv[0], "/x") == 0);
+    
+    static const char utf32le[] = "\xFF\xFE\0\0#\0\0\0!\0\0\0/\0\0\0y\0\0\0";
+    PlatypusScriptSniffBuffer(utf32le, sizeof(utf32le) - 1, &result);
+    assert(result.encoding == PlatypusScriptEncoding_UTF32LE && strcmp(result.argv[0], "/y") == 0);
+}
+
+static void TestBinary(void) {
+    static const char macho[] = "\xCF\xFA\xED\xFE\x07\0\0\x01";
+    PlatypusScriptSniffBuffer(macho, sizeof(macho) - 1, &result);
+    assert(result.isBinary && !result.hasShebang);
+    
+    Sniff("#!/bin/sh\n\x01\x02\x03\x04\x05\x06");
+    assert(result.isBinary && !result.hasShebang);
+    
+    Sniff("Grüße, \x1B[1mbold\x1B[0m\n");
+    assert(!result.isBinary);
+}
+
+static void TestTruncation(void) {
+    char big[PLATYPUS_SNIFF_MAX_BYTES * 2];
+    memset(big, 'a', sizeof(big));
+    memcpy(big, "#!/bin/", 7);
+    PlatypusScriptSniffBuffer(big, sizeof(big), &result);
+    assert(result.bytesRead == PLATYPUS_SNIFF_MAX_BYTES);
+    assert(result.hasShebang && result.shebangTruncated && result.argc == 1);
+    assert(strlen(result.argv[0]) == PLATYPUS_SNIFF_MAX_BYTES - 2);
+    
+    // More arguments than fit
+    char many[PLATYPUS_SNIFF_MAX_BYTES];
+    strcpy(many, "#!/bin/sh");
+    for (int i = 0; i < PLATYPUS_SNIFF_MAX_ARGS * 2; i++) {
+        strcat(many, " x");
+    }
+    Sniff(many);
+    assert(result.argc == PLATYPUS_SNIFF_MAX_ARGS);
+}
+
+#pragma mark - Fuzzing
+
+static void CheckInvariants(void) {
+    assert(result.argc >= 0 && result.argc <= PLATYPUS_SNIFF_MAX_ARGS);
+    assert(result.commandIndex >= -1 && result.commandIndex < result.argc);
+    assert(result.bytesRead <= PLATYPUS_SNIFF_MAX_BYTES);
+    for (int i = 0; i < result.argc; i++) {
+        const char *a = result.argv[i];
+        assert(a >= result.storage && a < result.storage + sizeof(result.storage));
+        assert(memchr(a, '\0', (size_t)(result.storage + sizeof(result.storage) - a)) != NULL);
+    }
+}
+
+static void Fuzz(long iterations) {
+    static const struct { const char *bytes; size_t length; } seeds[] = {
+#define SEED(s) { s, sizeof(s) - 1 }
+        SEED("#!/bin/sh\n"),
+        SEED("#!/usr/bin/env -S python3 -u 'a b' \"c\\\"d\" e\\_f\\c g\n"),
+        SEED("#!/usr/bin/env -i A=B -u X -C /tmp -- node\n"),
+        SEED("\xEF\xBB\xBF#!/usr/bin/env --split-string=perl -w\n"),
+        SEED("\xFF\xFE#\0!\0/\0b\0"),
+#undef SEED
+    };
+    static const char alphabet[] = " \t\r\n#!/\\'\"_=-Sceu\0\xFF\xFE";
+    uint8_t buf[PLATYPUS_SNIFF_MAX_BYTES + 64];
+    
+    srand(1);
+    for (long n = 0; n < iterations; n++) {
+        size_t seed = (size_t)n % (sizeof(seeds) / sizeof(seeds[0]));
+        size_t len = seeds[seed].length;
+        memcpy(buf, seeds[seed].bytes, len);
+        
+        int mutations = 1 + rand() % 8;
+        for (int m = 0; m < mutations; m++) {
+            size_t pos = (size_t)rand() % (len + 1);
+            uint8_t c = (rand() % 2) ? (uint8_t)alphabet[rand() % (sizeof(alphabet) - 1)] : (uint8_t)rand();
+            switch (rand() % 3) {
+                case 0: // Insert
+                    if (len < sizeof(buf)) {
+                        memmove(buf + pos + 1, buf + pos, len - pos);
+                        buf[pos] = c;
+                        len++;
+                    }
+                    break;
+                case 1: // Replace
+                    if (pos < len) {
+                        buf[pos] = c;
+                    }
+                    break;
+                default: // Truncate
+                    len = pos;
+                    break;
+            }
+        }
+        
+        PlatypusScriptSniffBuffer(buf, len, &result);
+        CheckInvariants();
+    }
+}
+
+#pragma mark - Benchmark
+
+#ifdef BENCHMARK
+
+// What parseInterpreterInScriptFile: used to do: read the whole file, then find the first line
+static size_t ReadWholeFirstLine(const char *path) {
+    FILE *f = fopen(path, "r");
+    assert(f);
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    rewind(f);
+    char *text = malloc((size_t)size + 1);
+    size_t n = fread(text, 1, (size_t)size, f);
+    fclose(f);
+    text[n] = '\0';
+    size_t lineLen = strcspn(text, "\n");
+    free(text);
+    return lineLen;
+}
+
+static void Benchmark(int megabytes) {
+    char path[] = "/tmp/sniffer_bench_XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd != -1);
+    FILE *f = fdopen(fd, "w");
+    fputs("#!/usr/bin/env -S python3 -u\n", f);
+    for (int i = 0; i < megabytes * 16384; i++) {
+        fputs("print('Lorem ipsum dolor sit amet, consectetur adipiscing elit')\n", f);
+    }
+    fclose(f);
+    
+    int runs = 20, failed = 0;
+    double t = PlatypusClockNow();
+    for (int i = 0; i < runs; i++) {
+        failed |= PlatypusScriptSniffFile(path, &result) != 0 || result.commandIndex != 2;
+    }
+    double sniffTime = (PlatypusClockNow() - t) / runs;
+    
+    t = PlatypusClockNow();
+    for (int i = 0; i < runs; i++) {
+        failed |= ReadWholeFirstLine(path) == 0;
+    }
+    double wholeTime = (PlatypusClockNow() - t) / runs;
+    assert(failed == 0);
+    
+    printf("Benchmark (%d MB script): sniff %.1f us, whole file read %.1f us\n",
+           megabytes, sniffTime * 1e6, wholeTime * 1e6);
+    unlink(path);
+}
+
+#endif
+
+int main(int argc, const char *argv[]) {
+    long iterations = (argc > 1) ? atol(argv[1]) : 200000;
+    
+    TestShebangs();
+    TestEncodings();
+    TestBinary();
+    TestTruncation();
+    printf("Unit tests passed\n");
+    
+    Fuzz(iterations);
+    printf("Fuzzed %ld inputs\n", iterations);
+    
+#ifdef BENCHMARK
+    int megabytes = (argc > 2) ? atoi(argv[2]) : 16;
+    if (megabytes > 0) {
+        Benchmark(megabytes);
+    }
+#endif
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,303 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Tests and spawn latency benchmark for the posix_spawn() process launcher.
+// Portable C, runs on macOS and Linux. Built and run by "make spawn_tests",
+// or with the benchmark by "make spawn_bench".
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "PlatypusClock.h"
+#include "PlatypusSpawn.h"
+
+// Runs a shell command, returning its output
+static char *Shell(const char *command, double timeout, int *status, int *err) {
+    char *const args[] = { "/bin/sh", "-c", (char *)command, NULL };
+    PlatypusSpawnAttributes attributes;
+    PlatypusSpawnAttributesInit(&attributes, args[0], args);
+    char *output = NULL;
+    *err = PlatypusSpawnRun(&attributes, timeout, &output, NULL, status);
+    return output;
+}
+
+static void TestRun(void) {
+    int status, err;
+    char *output = Shell("echo out; echo err >&2; exit 3", -1, &status, &err);
+    assert(err == 0);
+    assert(strcmp(output, "out\nerr\n") == 0);
+    assert(WIFEXITED(status) && PlatypusSpawnExitStatus(status) == 3);
+    free(output);
+    
+    output = Shell("kill -TERM $$", -1, &status, &err);
+    assert(err == 0 && WIFSIGNALED(status));
+    assert(PlatypusSpawnExitStatus(status) == SIGTERM);
+    free(output);
+    
+    // Large output doesn't fill up the pipe and block the child
+    size_t length;
+    char *const args[] = { "/bin/sh", "-c", "i=0; while [ $i -lt 20000 ]; do echo 0123456789; i=$((i+1)); done", NULL };
+    PlatypusSpawnAttributes attributes;
+    PlatypusSpawnAttributesInit(&attributes, args[0], args);
+    assert(PlatypusSpawnRun(&attributes, 30, &output, &length, &status) == 0);
+    assert(length == 20000 * 11);
+    free(output);
+    
+    char *const missing[] = { "/nonexistent/interpreter", NULL };
+    PlatypusSpawnAttributesInit(&attributes, missing[0], missing);
+    assert(PlatypusSpawnRun(&attributes, -1, &output, NULL, &status) == ENOENT);
+}
+
+static void TestAttributes(void) {
+    int status;
+    char *output;
+    
+    // Standard input is /dev/null unless given
+    char *const cat[] = { "/bin/cat", NULL };
+    PlatypusSpawnAttributes attributes;
+    PlatypusSpawnAttributesInit(&attributes, cat[0], cat);
+    assert(PlatypusSpawnRun(&attributes, 10, &output, NULL, &status) == 0);
+    assert(strcmp(output, "") == 0);
+    free(output);
+    
+    int input[2];
+    int err = pipe(input);
+    ssize_t written = write(input[1], "hello", 5);
+    assert(err == 0 && written == 5);
+    close(input[1]);
+    attributes.fds[0] = input[0];
+    assert(PlatypusSpawnRun(&attributes, 10, &output, NULL, &status) == 0);
+    assert(strcmp(output, "hello") == 0);
+    free(output);
+    close(input[0]);
+    
+    char *const echo[] = { "/bin/sh", "-c", "echo \"$PLATYPUS_TEST\"; pwd", NULL };
+    char *const env[] = { "PLATYPUS_TEST=value", NULL };
+    PlatypusSpawnAttributesInit(&attributes, echo[0], echo);
+    attributes.environment = env;
+    attributes.directory = "/";
+    assert(PlatypusSpawnRun(&attributes, 10, &output, NULL, &status) == 0);
+    assert(strcmp(output, "value\n/\n") == 0);
+    free(output);
+}
+
+// Only the descriptors given reach the child, close-on-exec or not, and
+// the child gets default signal handling
+static void TestHygiene(void) {
+    int fd = open("/dev/null", O_RDONLY);
+    assert(fd != -1);
+    int duplicate = dup2(fd, 9);
+    assert(duplicate == 9);
+    close(fd);
+    
+    int status, err;
+    char *output = Shell("if { true <&9; } 2>/dev/null; then echo open; else echo closed; fi", 10, &status, &err);
+    assert(err == 0);
+    assert(strcmp(output, "closed\n") == 0);
+    free(output);
+    close(9);
+    
+    signal(SIGPIPE, SIG_IGN);
+    output = Shell("kill -PIPE $$", 10, &status, &err);
+    assert(err == 0 && WIFSIGNALED(status) && WTERMSIG(status) == SIGPIPE);
+    free(output);
+    signal(SIGPIPE, SIG_DFL);
+}
+
+static void TestExitNotification(void) {
+    char *const args[] = { "/bin/sleep", "10", NULL };
+    PlatypusSpawnAttributes attributes;
+    PlatypusSpawnAttributesInit(&attributes, args[0], args);
+    pid_t pid;
+    int err = PlatypusSpawn(&attributes, &pid);
+    assert(err == 0);
+    
+    int watch = PlatypusSpawnWatch(pid);
+    assert(watch != -1 || errno == ENOSYS);
+    int status;
+    assert(PlatypusSpawnWait(pid, watch, 0.05, &status) == ETIMEDOUT);
+    
+    kill(pid, SIGKILL);
+    if (watch != -1) {
+        struct pollfd pfd = { .fd = watch, .events = POLLIN };
+        int ready = poll(&pfd, 1, 5000);
+        assert(ready == 1);
+    }
+    assert(PlatypusSpawnWait(pid, watch, 5, &status) == 0);
+    assert(WIFSIGNALED(status) && WTERMSIG(status) == SIGKILL);
+    if (watch != -1) {
+        close(watch);
+    }
+}
+
+static void TestTimeouts(void) {
+    int status, err;
+    double start = PlatypusClockNow();
+    char *output = Shell("echo started; exec sleep 10", 0.2, &status, &err);
+    assert(err == ETIMEDOUT && output == NULL);
+    assert(PlatypusClockNow() - start < 5);
+    
+    // A background process holding the output open doesn't hold up the run
+    start = PlatypusClockNow();
+    output = Shell("sleep 3 & echo done", -1, &status, &err);
+    assert(err == 0);
+    assert(strcmp(output, "done\n") == 0);
+    assert(PlatypusClockNow() - start < 2.5);
+    free(output);
+    
+    // Timing out kills the child's whole process group. The processes hold
+    // the write end of a pipe as standard input, so it reads EOF once
+    // they are all gone.
+    int pipeFds[2];
+    err = pipe(pipeFds);
+    assert(err == 0);
+    char *const args[] = { "/bin/sh", "-c", "exec 3<&0; sleep 30 <&3 & exec sleep 10", NULL };
+    PlatypusSpawnAttributes attributes;
+    PlatypusSpawnAttributesInit(&attributes, args[0], args);
+    attributes.fds[0] = pipeFds[1];
+    attributes.processGroup = 1;
+    assert(PlatypusSpawnRun(&attributes, 0.2, &output, NULL, &status) == ETIMEDOUT);
+    close(pipeFds[1]);
+    struct pollfd pfd = { .fd = pipeFds[0], .events = POLLIN };
+    int ready = poll(&pfd, 1, 5000);
+    assert(ready == 1);
+    char c;
+    ssize_t n = read(pipeFds[0], &c, 1);
+    assert(n == 0);
+    close(pipeFds[0]);
+}
+
+#pragma mark - Benchmark
+
+#ifdef BENCHMARK
+
+static int CompareDoubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static void Report(const char *name, double *times, int count) {
+    double total = 0;
+    for (int i = 0; i < count; i++) {
+        total += times[i];
+    }
+    qsort(times, count, sizeof(double), CompareDoubles);
+    printf("%-28s %6.0f spawns/s, median %4.0f us, p99 %4.0f us\n", name,
+           count / total, times[count / 2] * 1e6, times[count * 99 / 100] * 1e6);
+}
+
+static void SpawnAndReap(const PlatypusSpawnAttributes *attributes, double timeout) {
+    pid_t pid;
+    int status;
+    int err = PlatypusSpawn(attributes, &pid);
+    assert(err == 0);
+    err = PlatypusSpawnWait(pid, -1, timeout, &status);
+    assert(err == 0);
+}
+
+static void ForkExecAndReap(char *const *args) {
+    extern char **environ;
+    pid_t pid = fork();
+    assert(pid != -1);
+    if (pid == 0) {
+        int fd = open("/dev/null", O_RDONLY);
+        dup2(fd, STDIN_FILENO);
+        execve(args[0], args, environ);
+        _exit(127);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+}
+
+// Time from launching a process that does nothing to having reaped it,
+// with the launcher and with fork() and exec() for comparison. Reaping with
+// a timeout adds watching for exit, as PlatypusSpawnRun() does. The methods
+// take turns, so that changes in system load affect them all alike.
+static void Benchmark(void) {
+    const int count = 2000;
+    const int warmup = 50;
+    char *const args[] = { "/usr/bin/true", NULL };
+    double *times[3];
+    for (int m = 0; m < 3; m++) {
+        times[m] = malloc(count * sizeof(double));
+        assert(times[m]);
+    }
+    
+    PlatypusSpawnAttributes attributes;
+    PlatypusSpawnAttributesInit(&attributes, args[0], args);
+    for (int i = -warmup; i < count; i++) {
+        for (int m = 0; m < 3; m++) {
+            double start = PlatypusClockNow();
+            if (m == 0) {
+                SpawnAndReap(&attributes, -1);
+            } else if (m == 1) {
+                SpawnAndReap(&attributes, 10);
+            } else {
+                ForkExecAndReap(args);
+            }
+            if (i >= 0) {
+                times[m][i] = PlatypusClockNow() - start;
+            }
+        }
+    }
+    Report("PlatypusSpawn", times[0], count);
+    Report("PlatypusSpawn, exit watched", times[1], count);
+    Report("fork/exec", times[2], count);
+    
+    for (int m = 0; m < 3; m++) {
+        free(times[m]);
+    }
+}
+
+#endif
+
+int main(void) {
+    TestRun();
+    TestAttributes();
+    TestHygiene();
+    TestExitNotification();
+    TestTimeouts();
+    printf("All spawn tests passed\n");
+    
+#ifdef BENCHMARK
+    Benchmark();
+#endif
+    return 0;
+}
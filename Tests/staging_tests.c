@@ -0,0 +1,290 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Tests and benchmark for staging app bundles on the destination volume.
+// Portable C, runs on macOS and Linux. Built and run by "make staging_tests",
+// or with the benchmark by "make staging_bench".
+
+#define _XOPEN_SOURCE 700
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "PlatypusClock.h"
+#include "PlatypusStaging.h"
+#include "PlatypusSpawn.h"
+
+static char root[PATH_MAX];
+
+// Fails the test rather than truncating the path
+__attribute__((format(printf, 3, 4)))
+static void FormatPath(char *path, size_t size, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(path, size, format, args);
+    va_end(args);
+    assert(length >= 0 && (size_t)length < size);
+}
+
+static const char *Path(const char *name) {
+    static char paths[4][PATH_MAX];
+    static int next;
+    char *path = paths[next++ % 4];
+    FormatPath(path, PATH_MAX, "%s/%s", root, name);
+    return path;
+}
+
+static int Exists(const char *path) {
+    struct stat st;
+    return lstat(path, &st) == 0;
+}
+
+static void WriteFile(const char *dir, const char *name, const char *contents) {
+    char path[PATH_MAX];
+    FormatPath(path, sizeof(path), "%s/%s", dir, name);
+    FILE *f = fopen(path, "w");
+    assert(f != NULL);
+    fputs(contents, f);
+    fclose(f);
+}
+
+static int FileContains(const char *dir, const char *name, const char *contents) {
+    char path[PATH_MAX];
+    FormatPath(path, sizeof(path), "%s/%s", dir, name);
+    char buf[256] = { 0 };
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        return 0;
+    }
+    size_t n = fread(buf, 1, sizeof(buf) - 1, f);
+    fclose(f);
+    return n == strlen(contents) && memcmp(buf, contents, n) == 0;
+}
+
+// A small bundle with the given marker in it
+static void MakeBundle(const char *path, const char *marker) {
+    char dir[PATH_MAX];
+    int err = mkdir(path, 0755);
+    assert(err == 0);
+    FormatPath(dir, sizeof(dir), "%s/Contents", path);
+    err = mkdir(dir, 0755);
+    assert(err == 0);
+    WriteFile(dir, "Info.plist", marker);
+    FormatPath(dir, sizeof(dir), "%s/Contents/Resources", path);
+    err = mkdir(dir, 0755);
+    assert(err == 0);
+    WriteFile(dir, "script", marker);
+}
+
+static void RemoveAll(const char *path) {
+    char *const args[] = { "/bin/rm", "-rf", (char *)path, NULL };
+    PlatypusSpawnAttributes attributes;
+    PlatypusSpawnAttributesInit(&attributes, args[0], args);
+    pid_t pid;
+    int status;
+    int err = PlatypusSpawn(&attributes, &pid);
+    assert(err == 0);
+    err = PlatypusSpawnWait(pid, -1, -1, &status);
+    assert(err == 0);
+}
+
+#pragma mark - Tests
+
+static void TestCreate(void) {
+    char staged[PATH_MAX];
+    assert(PlatypusStagingCreate(Path("My App.app"), staged, sizeof(staged)) == 0);
+    
+    // Hidden, next to the destination, and named after it
+    char prefix[PATH_MAX];
+    FormatPath(prefix, sizeof(prefix), "%s/.My App.app.staging-", root);
+    assert(strncmp(staged, prefix, strlen(prefix)) == 0);
+    assert(strcmp(strrchr(staged, '/'), "/My App.app") == 0);
+    assert(!Exists(staged));
+    assert(PlatypusStagingRemove(staged) == 0);
+    *strrchr(staged, '/') = '\0';
+    assert(!Exists(staged));
+    
+    // Trailing slashes are ignored
+    assert(PlatypusStagingCreate(Path("Slash.app//"), staged, sizeof(staged)) == 0);
+    assert(strcmp(strrchr(staged, '/'), "/Slash.app") == 0);
+    assert(PlatypusStagingRemove(staged) == 0);
+    
+    assert(PlatypusStagingCreate(Path("missing/My.app"), staged, sizeof(staged)) == ENOENT);
+    assert(PlatypusStagingCreate("/", staged, sizeof(staged)) == EINVAL);
+    assert(PlatypusStagingCreate(Path("My.app"), staged, 8) == ENAMETOOLONG);
+}
+
+static void TestCommit(void) {
+    char staged[PATH_MAX];
+    const char *dest = Path("New.app");
+    assert(PlatypusStagingCreate(dest, staged, sizeof(staged)) == 0);
+    MakeBundle(staged, "first");
+    int replaced = 1;
+    assert(PlatypusStagingCommit(staged, dest, 0, &replaced) == 0);
+    assert(!replaced && !Exists(staged));
+    char contents[PATH_MAX];
+    FormatPath(contents, sizeof(contents), "%s/Contents", dest);
+    assert(FileContains(contents, "Info.plist", "first"));
+    assert(PlatypusStagingRemove(staged) == 0);
+    
+    // Without overwriting, nothing changes
+    assert(PlatypusStagingCreate(dest, staged, sizeof(staged)) == 0);
+    MakeBundle(staged, "second");
+    assert(PlatypusStagingCommit(staged, dest, 0, &replaced) == EEXIST);
+    assert(!replaced && Exists(staged));
+    assert(FileContains(contents, "Info.plist", "first"));
+    
+    // Overwriting swaps the old app into the staging directory
+    assert(PlatypusStagingCommit(staged, dest, 1, &replaced) == 0);
+    assert(replaced);
+    assert(FileContains(contents, "Info.plist", "second"));
+    char old[PATH_MAX];
+    FormatPath(old, sizeof(old), "%s/Contents", staged);
+    assert(FileContains(old, "Info.plist", "first"));
+    assert(PlatypusStagingRemove(staged) == 0);
+    assert(!Exists(staged));
+    
+    // A file in the way is replaced just the same
+    const char *file = Path("File.app");
+    WriteFile(root, "File.app", "not an app");
+    assert(PlatypusStagingCreate(file, staged, sizeof(staged)) == 0);
+    MakeBundle(staged, "third");
+    assert(PlatypusStagingCommit(staged, file, 1, &replaced) == 0 && replaced);
+    FormatPath(contents, sizeof(contents), "%s/Contents", file);
+    assert(FileContains(contents, "Info.plist", "third"));
+    assert(PlatypusStagingRemove(staged) == 0);
+}
+
+static void TestRemove(void) {
+    // Only staging directories are ever removed
+    const char *dest = Path("Keep.app");
+    MakeBundle(dest, "keep");
+    char path[PATH_MAX];
+    FormatPath(path, sizeof(path), "%s/Contents", dest);
+    assert(PlatypusStagingRemove(path) == EINVAL);
+    pid_t pid;
+    assert(PlatypusStagingRemoveInBackground(path, &pid) == EINVAL);
+    
+    // Symlinks are removed, not followed
+    char staged[PATH_MAX];
+    assert(PlatypusStagingCreate(Path("Linked.app"), staged, sizeof(staged)) == 0);
+    MakeBundle(staged, "linked");
+    FormatPath(path, sizeof(path), "%s/Contents/Resources/link", staged);
+    int err = symlink(dest, path);
+    assert(err == 0);
+    assert(PlatypusStagingRemove(staged) == 0);
+    FormatPath(path, sizeof(path), "%s/Contents", dest);
+    assert(FileContains(path, "Info.plist", "keep"));
+    
+    assert(PlatypusStagingCreate(Path("Background.app"), staged, sizeof(staged)) == 0);
+    MakeBundle(staged, "background");
+    assert(PlatypusStagingRemoveInBackground(staged, &pid) == 0);
+    int status;
+    assert(PlatypusSpawnWait(pid, -1, -1, &status) == 0 && status == 0);
+    *strrchr(staged, '/') = '\0';
+    assert(!Exists(staged));
+}
+
+#pragma mark - Benchmark
+
+#ifdef BENCHMARK
+
+// Moving a large bundle into place, against copying it as a move across
+// volumes does
+static void Benchmark(void) {
+    const int count = 2000;
+    char staged[PATH_MAX];
+    const char *dest = Path("Large.app");
+    int err = PlatypusStagingCreate(dest, staged, sizeof(staged));
+    assert(err == 0);
+    MakeBundle(staged, "large");
+    char resources[PATH_MAX];
+    FormatPath(resources, sizeof(resources), "%s/Contents/Resources", staged);
+    char block[4096];
+    memset(block, 'x', sizeof(block) - 1);
+    block[sizeof(block) - 1] = '\0';
+    for (int i = 0; i < count; i++) {
+        char name[32];
+        snprintf(name, sizeof(name), "file%d", i);
+        WriteFile(resources, name, block);
+    }
+    
+    double start = PlatypusClockNow();
+    char *const args[] = { "/bin/cp", "-R", staged, (char *)Path("Copied.app"), NULL };
+    PlatypusSpawnAttributes attributes;
+    PlatypusSpawnAttributesInit(&attributes, args[0], args);
+    pid_t pid;
+    int status = -1;
+    err = PlatypusSpawn(&attributes, &pid);
+    if (err == 0) {
+        err = PlatypusSpawnWait(pid, -1, -1, &status);
+    }
+    double copied = PlatypusClockNow() - start;
+    assert(err == 0 && status == 0);
+    
+    start = PlatypusClockNow();
+    int replaced;
+    err = PlatypusStagingCommit(staged, dest, 1, &replaced);
+    double committed = PlatypusClockNow() - start;
+    assert(err == 0);
+    err = PlatypusStagingRemove(staged);
+    assert(err == 0);
+    
+    printf("Moving a %d file bundle into place: %.0f us, copying it: %.1f ms\n",
+           count, committed * 1e6, copied * 1e3);
+}
+
+#endif
+
+int main(void) {
+    FormatPath(root, sizeof(root), "%s/staging_tests.XXXXXX", getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp");
+    char *created = mkdtemp(root);
+    assert(created != NULL);
+    
+    TestCreate();
+    TestCommit();
+    TestRemove();
+    printf("All staging tests passed\n");
+    
+#ifdef BENCHMARK
+    Benchmark();
+#endif
+    RemoveAll(root);
+    return 0;
+}
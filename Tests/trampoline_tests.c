@@ -0,0 +1,260 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Tests and benchmark for the interpreter trampoline. Portable C, runs on
+// macOS and Linux. Built and run by "make trampoline_tests", or with the
+// benchmark by "make trampoline_bench".
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <errno.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "PlatypusClock.h"
+#include "SETrampoline.h"
+
+extern char **environ;
+
+typedef struct Trampoline {
+    pid_t pid;
+    int input;
+    int output;
+} Trampoline;
+
+// Child exits with the trampoline's error if it doesn't exec
+static Trampoline Spawn(void) {
+    int in[2], out[2];
+    int err = pipe(in);
+    assert(err == 0);
+    err = pipe(out);
+    assert(err == 0);
+    Trampoline t;
+    t.pid = fork();
+    assert(t.pid != -1);
+    if (t.pid == 0) {
+        dup2(in[0], STDIN_FILENO);
+        dup2(out[1], STDOUT_FILENO);
+        close(in[0]); close(in[1]); close(out[0]); close(out[1]);
+        _exit(SETrampolineRun(STDIN_FILENO));
+    }
+    close(in[0]);
+    close(out[1]);
+    t.input = in[1];
+    t.output = out[0];
+    return t;
+}
+
+static int Finish(Trampoline *t, char *output, size_t size) {
+    close(t->input);
+    size_t total = 0;
+    ssize_t n;
+    while (total < size - 1 && (n = read(t->output, output + total, size - 1 - total)) > 0) {
+        total += (size_t)n;
+    }
+    output[total] = '\0';
+    close(t->output);
+    int status;
+    pid_t pid = waitpid(t->pid, &status, 0);
+    assert(pid == t->pid && WIFEXITED(status));
+    return WEXITSTATUS(status);
+}
+
+static void SendWithLimits(Trampoline *t, const char *const *args, size_t argCount,
+                           const char *const *env, size_t envCount, const PlatypusJobLimits *limits) {
+    size_t length;
+    void *request = SETrampolineCreateRequest(args, argCount, env, envCount, limits, &length);
+    assert(request);
+    ssize_t written = write(t->input, request, length);
+    assert(written == (ssize_t)length);
+    free(request);
+}
+
+static void Send(Trampoline *t, const char *const *args, size_t argCount, const char *const *env, size_t envCount) {
+    SendWithLimits(t, args, argCount, env, envCount, NULL);
+}
+
+static void TestExec(void) {
+    const char *args[] = { "/bin/sh", "-c", "printf '%s|%s|' \"$GREETING\" \"$1\"; cat", "sh", "first arg" };
+    const char *env[] = { "GREETING=hello world" };
+    char output[256];
+    
+    // Request and standard input in one write, as the app would do if it had both at once
+    Trampoline t = Spawn();
+    size_t length;
+    char *request = SETrampolineCreateRequest(args, 5, env, 1, NULL, &length);
+    assert(request);
+    char *both = malloc(length + 5);
+    memcpy(both, request, length);
+    memcpy(both + length, "input", 5);
+    ssize_t written = write(t.input, both, length + 5);
+    assert(written == (ssize_t)(length + 5));
+    free(both);
+    free(request);
+    int code = Finish(&t, output, sizeof(output));
+    assert(code == 0);
+    assert(strcmp(output, "hello world|first arg|input") == 0);
+    
+    // Exit status is the script's
+    const char *failing[] = { "/bin/sh", "-c", "exit 3" };
+    t = Spawn();
+    Send(&t, failing, 3, NULL, 0);
+    code = Finish(&t, output, sizeof(output));
+    assert(code == 3);
+}
+
+// The job leads its own process group and gets its resource limits
+static void TestLimits(void) {
+    const char *args[] = { "/bin/sh", "-c", "kill -0 -$$ && ulimit -n && ulimit -t" };
+    char output[256];
+    
+    PlatypusJobLimits limits;
+    memset(&limits, 0, sizeof(limits));
+    limits.openFiles = 32;
+    limits.cpuTime = 60;
+    Trampoline t = Spawn();
+    SendWithLimits(&t, args, 3, NULL, 0, &limits);
+    int code = Finish(&t, output, sizeof(output));
+    assert(code == 0);
+    assert(strcmp(output, "32\n60\n") == 0);
+    
+    // A runaway job is stopped by its CPU time limit
+    const char *spin[] = { "/bin/sh", "-c", "while :; do :; done" };
+    limits.cpuTime = 1;
+    t = Spawn();
+    SendWithLimits(&t, spin, 3, NULL, 0, &limits);
+    close(t.input);
+    close(t.output);
+    int status;
+    pid_t pid = waitpid(t.pid, &status, 0);
+    assert(pid == t.pid);
+    assert(WIFSIGNALED(status) && WTERMSIG(status) == SIGXCPU);
+}
+
+static void TestFailures(void) {
+    char output[64];
+    
+    // Not needed after all
+    Trampoline t = Spawn();
+    int code = Finish(&t, output, sizeof(output));
+    assert(code == 0);
+    
+    // Missing interpreter
+    const char *missing[] = { "/nonexistent/interpreter" };
+    t = Spawn();
+    Send(&t, missing, 1, NULL, 0);
+    code = Finish(&t, output, sizeof(output));
+    assert(code == ENOENT);
+    
+    // Truncated and malformed requests
+    t = Spawn();
+    uint32_t partial[2] = { 100, 1 };
+    ssize_t written = write(t.input, partial, sizeof(partial));
+    assert(written == sizeof(partial));
+    code = Finish(&t, output, sizeof(output));
+    assert(code == EINVAL);
+    
+    t = Spawn();
+    uint32_t noArgs[3 + sizeof(PlatypusJobLimits) / sizeof(uint32_t)] = { 8 + sizeof(PlatypusJobLimits), 0, 0 };
+    written = write(t.input, noArgs, sizeof(noArgs));
+    assert(written == sizeof(noArgs));
+    code = Finish(&t, output, sizeof(output));
+    assert(code == EINVAL);
+    
+    const char *args[] = { "/bin/sh" };
+    const char *badEnv[] = { "=value" };
+    t = Spawn();
+    Send(&t, args, 1, badEnv, 1);
+    code = Finish(&t, output, sizeof(output));
+    assert(code == EINVAL);
+    
+    size_t length;
+    assert(SETrampolineCreateRequest(args, 0, NULL, 0, NULL, &length) == NULL);
+}
+
+#pragma mark - Benchmark
+
+#ifdef BENCHMARK
+
+// Time from starting a job to it exiting, spawning the interpreter directly
+// and through the trampoline, taking turns so that changes in system load
+// affect both alike. The trampoline is forked here rather than launched
+// from the app's executable, so the time it takes to load is not included:
+// going through it costs at least the difference shown, which is why
+// ScriptExec only does so for jobs with resource limits.
+static void Benchmark(void) {
+    const int count = 200;
+    const char *args[] = { "/bin/sh", "-c", "exit 0", NULL };
+    char output[16];
+    
+    double direct = 0, trampoline = 0;
+    for (int i = 0; i < count; i++) {
+        double start = PlatypusClockNow();
+        pid_t pid;
+        int err = posix_spawn(&pid, args[0], NULL, NULL, (char *const *)args, environ);
+        int status = -1;
+        if (err == 0) {
+            waitpid(pid, &status, 0);
+        }
+        direct += PlatypusClockNow() - start;
+        assert(err == 0 && status == 0);
+        
+        start = PlatypusClockNow();
+        Trampoline t = Spawn();
+        Send(&t, args, 3, NULL, 0);
+        int code = Finish(&t, output, sizeof(output));
+        assert(code == 0);
+        trampoline += PlatypusClockNow() - start;
+    }
+    
+    printf("%d jobs: %.0f us spawning the interpreter, %.0f us through the trampoline\n",
+           count, direct * 1e6 / count, trampoline * 1e6 / count);
+}
+
+#endif
+
+int main(void) {
+    TestExec();
+    TestLimits();
+    TestFailures();
+    printf("All trampoline tests passed\n");
+    
+#ifdef BENCHMARK
+    Benchmark();
+#endif
+    return 0;
+}
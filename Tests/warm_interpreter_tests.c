@@ -0,0 +1,343 @@
+/*
+    Copyright (c) 2003-2024, Sveinbjorn Thordarson <sveinbjorn@sveinbjorn.org>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without modification,
+    are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    2. Redistributions in binary form must reproduce the above copyright notice, this
+    list of conditions and the following disclaimer in the documentation and/or other
+    materials provided with the distribution.
+
+    3. Neither the name of the copyright holder nor the names of its contributors may
+    be used to endorse or promote products derived from this software without specific
+    prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+    ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+    NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+    PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Tests and job start latency benchmark for interpreters started ahead of
+// time. Portable C, runs on macOS and Linux. Built and run by
+// "make warm_interpreter_tests", or with the benchmark by
+// "make warm_interpreter_bench". Interpreters that aren't installed are
+// skipped.
+
+#define _XOPEN_SOURCE 700
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "PlatypusClock.h"
+#include "PlatypusSpawn.h"
+#include "SEWarmInterpreter.h"
+
+typedef struct Language {
+    const char *name;
+    const char *printExecutable;    // Arguments that print the real interpreter's path
+    const char *script;             // Prints its arguments, GREETING, cwd and input, and exits with 3
+    const char *suffix;
+} Language;
+
+static const Language languages[] = {
+    { "python3", "import sys;sys.stdout.write(sys.executable)",
+      "import os,sys\n"
+      "sys.stdout.write('%s|%s|%s|%s|%s' % (','.join(sys.argv[1:]), os.environ['GREETING'], os.getcwd(),\n"
+      "                                   sys.stdin.read(), __name__))\n"
+      "sys.exit(3)\n", "py" },
+    { "perl", "print $^X",
+      "use Cwd; local $/; my $in = <STDIN>;\n"
+      "print join(',', @ARGV) . \"|$ENV{GREETING}|\" . getcwd() . \"|$in|\" . __PACKAGE__;\n"
+      "exit 3;\n", "pl" },
+    { "ruby", "print RbConfig.ruby",
+      "print \"#{ARGV.join(',')}|#{ENV['GREETING']}|#{Dir.pwd}|#{STDIN.read}|#{__FILE__ == $0}\"\n"
+      "exit 3\n", "rb" }
+};
+
+// What each language's script prints as its last field
+static const char *const mainNames[] = { "__main__", "main", "true" };
+
+typedef struct Warm {
+    pid_t pid;
+    int input;
+    int output;
+} Warm;
+
+// Real path of an installed interpreter, rather than e.g. a version manager's
+// shim, or NULL if it isn't installed
+static char *FindInterpreter(const Language *language) {
+    const char *flag = (strcmp(language->name, "python3") == 0) ? "-c" : "-e";
+    char *const args[] = { "/usr/bin/env", (char *)language->name, (char *)flag, (char *)language->printExecutable, NULL };
+    PlatypusSpawnAttributes attributes;
+    PlatypusSpawnAttributesInit(&attributes, args[0], args);
+    attributes.fds[2] = PLATYPUS_SPAWN_NULL;
+    char *output = NULL;
+    int status;
+    int err = PlatypusSpawnRun(&attributes, 30, &output, NULL, &status);
+    if (err || status != 0 || output[0] != '/') {
+        free(output);
+        return NULL;
+    }
+    return output;
+}
+
+static char *WriteScript(const char *dir, const Language *language) {
+    char *path = malloc(strlen(dir) + 32);
+    assert(path);
+    sprintf(path, "%s/script.%s", dir, language->suffix);
+    FILE *f = fopen(path, "w");
+    assert(f);
+    fputs(language->script, f);
+    fclose(f);
+    return path;
+}
+
+// Starts the interpreter with its bootstrap, with no job yet
+static Warm Start(const char *interpreter, const char *const *args, size_t argCount) {
+    char **argv = SEWarmInterpreterCreateArguments(interpreter, args, argCount);
+    assert(argv);
+    int in[2], out[2];
+    int err = pipe(in);
+    assert(err == 0);
+    err = pipe(out);
+    assert(err == 0);
+    PlatypusSpawnAttributes attributes;
+    PlatypusSpawnAttributesInit(&attributes, argv[0], argv);
+    attributes.fds[0] = in[0];
+    attributes.fds[1] = out[1];
+    attributes.fds[2] = out[1];
+    attributes.processGroup = 1;
+    Warm w;
+    err = PlatypusSpawn(&attributes, &w.pid);
+    assert(err == 0);
+    free(argv);
+    close(in[0]);
+    close(out[1]);
+    w.input = in[1];
+    w.output = out[0];
+    return w;
+}
+
+// Closes standard input and returns the exit status, with the output
+static int Finish(Warm *w, char *output, size_t size) {
+    close(w->input);
+    size_t total = 0;
+    ssize_t n;
+    while (total < size - 1 && (n = read(w->output, output + total, size - 1 - total)) > 0) {
+        total += (size_t)n;
+    }
+    output[total] = '\0';
+    close(w->output);
+    int status;
+    int err = PlatypusSpawnWait(w->pid, -1, -1, &status);
+    assert(err == 0);
+    return PlatypusSpawnExitStatus(status);
+}
+
+static void Send(Warm *w, const char *dir, const char *script, const char *const *args, size_t argCount,
+                 const char *const *env, size_t envCount, const char *input) {
+    size_t length;
+    char *request = SEWarmInterpreterCreateRequest(dir, script, args, argCount, env, envCount, &length);
+    assert(request);
+    // Request and standard input in one write, as the app would do if it had both at once
+    size_t inputLength = strlen(input);
+    char *both = malloc(length + inputLength);
+    assert(both);
+    memcpy(both, request, length);
+    memcpy(both + length, input, inputLength);
+    ssize_t written = write(w->input, both, length + inputLength);
+    assert(written == (ssize_t)(length + inputLength));
+    free(both);
+    free(request);
+}
+
+static void TestTypes(void) {
+    assert(SEWarmInterpreterTypeForInterpreter("/usr/bin/python3", NULL, 0) == SEWarmInterpreterType_Python);
+    assert(SEWarmInterpreterTypeForInterpreter("/usr/local/bin/python3.12", NULL, 0) == SEWarmInterpreterType_Python);
+    assert(SEWarmInterpreterTypeForInterpreter("/usr/bin/perl5.30", NULL, 0) == SEWarmInterpreterType_Perl);
+    assert(SEWarmInterpreterTypeForInterpreter("ruby", NULL, 0) == SEWarmInterpreterType_Ruby);
+    assert(SEWarmInterpreterTypeForInterpreter("/bin/sh", NULL, 0) == SEWarmInterpreterType_None);
+    assert(SEWarmInterpreterTypeForInterpreter("/usr/bin/python3-config", NULL, 0) == SEWarmInterpreterType_None);
+    assert(SEWarmInterpreterTypeForInterpreter("/usr/bin/rubyx", NULL, 0) == SEWarmInterpreterType_None);
+    
+    // Only arguments that don't change what is run
+    const char *unbuffered[] = { "-u", "-B" };
+    const char *module[] = { "-m", "http.server" };
+    const char *taint[] = { "-T" };
+    assert(SEWarmInterpreterTypeForInterpreter("/usr/bin/python3", unbuffered, 2) == SEWarmInterpreterType_Python);
+    assert(SEWarmInterpreterTypeForInterpreter("/usr/bin/python3", module, 2) == SEWarmInterpreterType_None);
+    assert(SEWarmInterpreterTypeForInterpreter("/usr/bin/perl", taint, 1) == SEWarmInterpreterType_None);
+    assert(SEWarmInterpreterCreateArguments("/usr/bin/python3", module, 2) == NULL);
+    
+    char **argv = SEWarmInterpreterCreateArguments("/usr/bin/python3", unbuffered, 2);
+    assert(argv);
+    assert(strcmp(argv[0], "/usr/bin/python3") == 0 && strcmp(argv[1], "-u") == 0 && strcmp(argv[2], "-B") == 0);
+    assert(strcmp(argv[3], "-c") == 0 && argv[4] && argv[5] == NULL);
+    free(argv);
+    
+    assert(SEWarmInterpreterReadsAtStartup(SEWarmInterpreterType_Python, "PYTHONPATH"));
+    assert(SEWarmInterpreterReadsAtStartup(SEWarmInterpreterType_Perl, "PERL5LIB"));
+    assert(SEWarmInterpreterReadsAtStartup(SEWarmInterpreterType_Ruby, "LC_ALL"));
+    assert(!SEWarmInterpreterReadsAtStartup(SEWarmInterpreterType_Python, "PERL5LIB"));
+    assert(!SEWarmInterpreterReadsAtStartup(SEWarmInterpreterType_Ruby, "GREETING"));
+}
+
+static void TestRequest(void) {
+    const char *args[] = { "a", "" };
+    const char *env[] = { "X=1" };
+    size_t length;
+    char *request = SEWarmInterpreterCreateRequest("/tmp", "/s.py", args, 2, env, 1, &length);
+    assert(request);
+    const char expected[] = "00000014/tmp\0/s.py\0" "2\0a\0\0X=1\0";
+    assert(length == sizeof(expected) - 1);
+    assert(memcmp(request, expected, length) == 0);
+    free(request);
+    
+    char *huge = malloc(SE_WARM_INTERPRETER_MAX_REQUEST);
+    assert(huge);
+    memset(huge, 'x', SE_WARM_INTERPRETER_MAX_REQUEST - 1);
+    huge[SE_WARM_INTERPRETER_MAX_REQUEST - 1] = '\0';
+    const char *hugeArgs[] = { huge };
+    assert(SEWarmInterpreterCreateRequest("/tmp", "/s.py", hugeArgs, 1, NULL, 0, &length) == NULL);
+    free(huge);
+}
+
+// Each language's script sees the job as if the interpreter had been
+// started for it
+static void TestRun(const char *tmp) {
+    size_t count = sizeof(languages) / sizeof(languages[0]);
+    for (size_t i = 0; i < count; i++) {
+        char *interpreter = FindInterpreter(&languages[i]);
+        if (interpreter == NULL) {
+            printf("Skipping %s, which isn't installed\n", languages[i].name);
+            continue;
+        }
+        char *script = WriteScript(tmp, &languages[i]);
+        const char *args[] = { "first arg", "second" };
+        const char *env[] = { "GREETING=hello world" };
+        char output[1024];
+        char expected[1024];
+        snprintf(expected, sizeof(expected), "first arg,second|hello world|%s|input|%s", tmp, mainNames[i]);
+    
+        Warm w = Start(interpreter, NULL, 0);
+        Send(&w, tmp, script, args, 2, env, 1, "input");
+        int code = Finish(&w, output, sizeof(output));
+        assert(code == 3);
+        assert(strcmp(output, expected) == 0);
+    
+        // Not needed after all
+        w = Start(interpreter, NULL, 0);
+        code = Finish(&w, output, sizeof(output));
+        assert(code == 0);
+        assert(output[0] == '\0');
+    
+        unlink(script);
+        free(script);
+        free(interpreter);
+    }
+}
+
+#ifdef BENCHMARK
+
+static int CompareDoubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static void Report(const char *name, double *times, int count) {
+    qsort(times, count, sizeof(double), CompareDoubles);
+    printf("%-24s median %6.2f ms, p90 %6.2f ms\n", name, times[count / 2] * 1e3, times[count * 9 / 10] * 1e3);
+}
+
+// Time from a job arriving to its script having finished, for a script
+// that only prints a line, launching the interpreter then, and handing the
+// job to one started earlier. The earlier start isn't timed, and the
+// interpreter is given time to finish starting, as it would have while the
+// previous job ran. The methods take turns, so that changes in system load
+// affect both alike.
+static void Benchmark(const char *tmp) {
+    const int count = 40;
+    const Language *language = &languages[0];
+    char *interpreter = FindInterpreter(language);
+    if (interpreter == NULL) {
+        printf("Skipping benchmark, %s isn't installed\n", language->name);
+        return;
+    }
+    char *script = malloc(strlen(tmp) + 16);
+    assert(script);
+    sprintf(script, "%s/bench.py", tmp);
+    FILE *f = fopen(script, "w");
+    assert(f);
+    fputs("print('done')\n", f);
+    fclose(f);
+    
+    double cold[count], warm[count];
+    char output[64];
+    for (int i = 0; i < count; i++) {
+        Warm w = Start(interpreter, NULL, 0);
+        usleep(200000);
+        double start = PlatypusClockNow();
+        Send(&w, tmp, script, NULL, 0, NULL, 0, "");
+        int code = Finish(&w, output, sizeof(output));
+        warm[i] = PlatypusClockNow() - start;
+        assert(code == 0 && strcmp(output, "done\n") == 0);
+    
+        char *const args[] = { interpreter, script, NULL };
+        PlatypusSpawnAttributes attributes;
+        PlatypusSpawnAttributesInit(&attributes, args[0], args);
+        attributes.directory = tmp;
+        attributes.processGroup = 1;
+        char *coldOutput = NULL;
+        int status;
+        start = PlatypusClockNow();
+        int err = PlatypusSpawnRun(&attributes, -1, &coldOutput, NULL, &status);
+        cold[i] = PlatypusClockNow() - start;
+        assert(err == 0 && status == 0 && strcmp(coldOutput, "done\n") == 0);
+        free(coldOutput);
+    }
+    printf("%s (%s):\n", language->name, interpreter);
+    Report("Started for the job", cold, count);
+    Report("Started ahead of time", warm, count);
+    
+    unlink(script);
+    free(script);
+    free(interpreter);
+}
+
+#endif
+
+int main(void) {
+    // Resolved, since the scripts print the working directory they see
+    char tmp[] = "/tmp/warm_interpreter_tests.XXXXXX";
+    char *dir = mkdtemp(tmp) ? realpath(tmp, NULL) : NULL;
+    assert(dir);
+    
+    TestTypes();
+    TestRequest();
+    TestRun(dir);
+    printf("All warm interpreter tests passed\n");
+
+#ifdef BENCHMARK
+    Benchmark(dir);
+#endif
+    rmdir(dir);
+    free(dir);
+    return 0;
+}